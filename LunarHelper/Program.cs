@@ -44,6 +44,9 @@ namespace LunarHelper
         static ConsoleColor curr_profile_color = ConsoleColor.Gray;
 
         static private DependencyGraph dependency_graph;
+        // the build report as it was when the build started, tells the entries Lunar Monitor
+        // changed during the build apart from the ones that were already there
+        static private Report report_at_build_start;
 
         static private ProfileManager profile_manager;
 
@@ -395,6 +398,8 @@ namespace LunarHelper
                 return false;
             }
 
+            report_at_build_start = ReadReport(output_folder);
+
             Lognl("Starting Quick Build");
             if (profile_manager.current_profile != null)
             {
@@ -493,7 +498,10 @@ namespace LunarHelper
             }
 
             Log("Writing build report...\n", ConsoleColor.Cyan);
-            WriteReport(output_folder);
+            if (!WriteReport(output_folder))
+            {
+                return false;
+            }
 
             Importer.FinalizeGlobuleImprints(output_folder);
 
@@ -509,7 +517,7 @@ namespace LunarHelper
             return true;
         }
 
-        static private void WriteReport(string output_folder)
+        static private bool WriteReport(string output_folder)
         {
             var report = GetBuildReport();
 
@@ -517,15 +525,113 @@ namespace LunarHelper
             serializer.Formatting = Formatting.Indented;
             serializer.TypeNameHandling = TypeNameHandling.Objects;
 
-            StringWriter sw = new StringWriter();
+            var lunar_helper_folder = Path.Combine(output_folder, ".lunar_helper");
+            Directory.CreateDirectory(lunar_helper_folder);
+
+            var report_path = Path.Combine(lunar_helper_folder, "build_report.json");
+            var temp_path = $"{report_path}.{Environment.ProcessId}.tmp";
+
+            // Lunar Monitor updates the report while Lunar Magic is open and takes the same lock
+            // around its writes, so the report is never replaced while it's in the middle of one
+            using (var report_lock = AcquireReportLock(Path.Combine(lunar_helper_folder, "build_report.lock")))
+            {
+                if (report_lock == null)
+                {
+                    Error("Could not lock build report, Lunar Monitor may still be writing it, please try building again");
+                    return false;
+                }
+
+                MergeMonitorEntries(report, ReadReport(output_folder), report_at_build_start);
+
+                StringWriter sw = new StringWriter();
+
+                using (JsonWriter writer = new JsonTextWriter(sw))
+                {
+                    serializer.Serialize(writer, report);
+                }
+
+                File.WriteAllText(temp_path, sw.ToString());
+                File.Move(temp_path, report_path, true);
+            }
+
+            return true;
+        }
+
+        // takes over the entries Lunar Monitor changed while the build ran, they describe
+        // exports that are newer than the files this build hashed
+        static private void MergeMonitorEntries(Report report, Report current, Report at_build_start)
+        {
+            if (current == null)
+                return;
+
+            if (current.levels != null)
+            {
+                report.levels ??= new Dictionary<string, string>();
+
+                foreach (var (level, hash) in current.levels)
+                {
+                    string hash_at_build_start = null;
+                    at_build_start?.levels?.TryGetValue(level, out hash_at_build_start);
+
+                    if (hash != hash_at_build_start)
+                        report.levels[level] = hash;
+                }
+            }
+
+            if (current.map16 != at_build_start?.map16)
+                report.map16 = current.map16;
 
-            using (JsonWriter writer = new JsonTextWriter(sw))
+            if (current.global_data != at_build_start?.global_data)
+                report.global_data = current.global_data;
+
+            if (current.shared_palettes != at_build_start?.shared_palettes)
+                report.shared_palettes = current.shared_palettes;
+        }
+
+        // null if there is no report or it can't be read
+        static private Report ReadReport(string output_folder)
+        {
+            var report_path = Path.Combine(output_folder, ".lunar_helper/build_report.json");
+
+            if (!File.Exists(report_path))
+                return null;
+
+            try
             {
-                serializer.Serialize(writer, report);
+                JsonSerializer serializer = new JsonSerializer();
+                serializer.TypeNameHandling = TypeNameHandling.Objects;
+
+                using (StreamReader sr = new StreamReader(report_path))
+                using (JsonReader reader = new JsonTextReader(sr))
+                {
+                    return (Report)serializer.Deserialize(reader, typeof(Report));
+                }
+            }
+            catch (Exception)
+            {
+                return null;
             }
+        }
 
-            Directory.CreateDirectory(Path.Combine(output_folder, ".lunar_helper"));
-            File.WriteAllText(Path.Combine(output_folder,".lunar_helper/build_report.json"), sw.ToString());
+        static private FileStream AcquireReportLock(string lock_path)
+        {
+            var timeout = Stopwatch.StartNew();
+
+            while (true)
+            {
+                try
+                {
+                    return new FileStream(lock_path, FileMode.OpenOrCreate, FileAccess.ReadWrite, FileShare.None, 1, FileOptions.DeleteOnClose);
+                }
+                catch (Exception e) when (e is IOException || e is UnauthorizedAccessException)
+                {
+                    // Lunar Monitor only holds it for a single write, something is wrong if it takes this long
+                    if (timeout.ElapsedMilliseconds >= 5000)
+                        return null;
+
+                    System.Threading.Thread.Sleep(20);
+                }
+            }
         }
 
         static private Report GetBuildReport()
@@ -888,6 +994,10 @@ namespace LunarHelper
                 return false;
             }
 
+            // a quick build falling back to this one already read it
+            if (!skip_volatile_check)
+                report_at_build_start = ReadReport(output_folder);
+
             dependency_graph = new DependencyGraph(Config);
 
             if (!string.IsNullOrWhiteSpace(Config.GlobulesPath))
@@ -1001,7 +1111,10 @@ namespace LunarHelper
             if (dependency_graph_exists)
             {
                 Log("Writing build report...\n", ConsoleColor.Cyan);
-                WriteReport(output_folder);
+                if (!WriteReport(output_folder))
+                {
+                    return false;
+                }
             }
 
             Log($"ROM patched successfully to '{Config.OutputPath}'!", ConsoleColor.Green);
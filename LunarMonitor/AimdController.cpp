@@ -0,0 +1,105 @@
+#include "AimdController.h"
+
+#include <algorithm>
+
+namespace
+{
+	// how much slower than the baseline a window's jobs may get before the limit is cut
+	constexpr double LATENCY_TOLERANCE = 1.5;
+	// how much less a window with a higher limit may get written before the limit is cut
+	constexpr double THROUGHPUT_TOLERANCE = 0.9;
+	constexpr double DECREASE_FACTOR = 0.5;
+	// how far the baseline moves towards a slower window's latency
+	constexpr double BASELINE_DRIFT = 0.125;
+}
+
+AimdController::AimdController(size_t minLimit, size_t maxLimit)
+	: limit(0), minLimit(minLimit), maxLimit(std::max(minLimit, maxLimit)), windowLimit(0)
+{
+	// two at once is almost always faster than one, more has to prove itself
+	limit = static_cast<double>(std::clamp<size_t>(2, this->minLimit, this->maxLimit));
+	windowLimit = getLimit();
+}
+
+size_t AimdController::getLimit() const
+{
+	return static_cast<size_t>(limit);
+}
+
+void AimdController::setMaxLimit(size_t newMaxLimit)
+{
+	maxLimit = std::max(minLimit, newMaxLimit);
+	limit = std::min(limit, static_cast<double>(maxLimit));
+}
+
+void AimdController::onStarted(Clock::time_point now)
+{
+	if (running++ == 0)
+		busySince = now;
+}
+
+void AimdController::onFinished(Clock::time_point now)
+{
+	if (running == 0)
+		return;
+
+	countBusy(now);
+
+	if (--running == 0)
+		busySince = std::nullopt;
+}
+
+void AimdController::addSample(Clock::time_point now, std::chrono::milliseconds took, uint64_t bytes)
+{
+	++windowJobs;
+	windowLatency += took;
+	windowBytes += bytes;
+
+	if (windowJobs >= std::max<size_t>(windowLimit, 1))
+		endWindow(now);
+}
+
+void AimdController::countBusy(Clock::time_point now)
+{
+	if (!busySince.has_value())
+		return;
+
+	windowBusy += now - busySince.value();
+	busySince = now;
+}
+
+void AimdController::endWindow(Clock::time_point now)
+{
+	countBusy(now);
+
+	const double meanLatency = static_cast<double>(windowLatency.count()) / windowJobs;
+	const double busySeconds = std::chrono::duration<double>(windowBusy).count();
+	const std::optional<double> throughput = busySeconds > 0 ? std::optional(windowBytes / busySeconds) : std::nullopt;
+
+	if (!baselineLatency.has_value())
+		baselineLatency = meanLatency;
+
+	const bool slower = meanLatency > baselineLatency.value() * LATENCY_TOLERANCE;
+	// more running at once only pays off if more gets written
+	const bool moreForLess = throughput.has_value() && lastThroughput.has_value() && windowLimit > lastLimit &&
+		throughput.value() < lastThroughput.value() * THROUGHPUT_TOLERANCE;
+
+	if (slower || moreForLess)
+		limit = std::max(static_cast<double>(minLimit), limit * DECREASE_FACTOR);
+	else
+		limit = std::min(static_cast<double>(maxLimit), limit + 1);
+
+	if (meanLatency < baselineLatency.value())
+		baselineLatency = meanLatency;
+	else
+		baselineLatency = baselineLatency.value() + (meanLatency - baselineLatency.value()) * BASELINE_DRIFT;
+
+	lastThroughput = throughput;
+	lastLimit = windowLimit;
+
+	windowJobs = 0;
+	windowLatency = std::chrono::milliseconds::zero();
+	windowBytes = 0;
+	windowBusy = Clock::duration::zero();
+	windowLimit = getLimit();
+}
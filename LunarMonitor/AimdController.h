@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+// decides how many jobs of a kind run at once, additive increase and
+// multiplicative decrease like TCP's congestion control, the limit grows by
+// one after every window of as many finished jobs as it allowed and is halved
+// after a window whose jobs took much longer than jobs used to, or that got
+// less written per second of being busy than the window before it even though
+// more jobs were allowed, both mean the disk or CPU is saturated
+//
+// not thread safe, the owner serializes calls
+class AimdController
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	AimdController(size_t minLimit, size_t maxLimit);
+
+	size_t getLimit() const;
+	// the limit is brought within it right away
+	void setMaxLimit(size_t maxLimit);
+
+	// a job started or finished, busy time is counted while any is running
+	void onStarted(Clock::time_point now);
+	void onFinished(Clock::time_point now);
+	// a job that did its work, took is its wall time and bytes what it wrote,
+	// failed and cancelled jobs say nothing about how loaded the system is
+	void addSample(Clock::time_point now, std::chrono::milliseconds took, uint64_t bytes);
+
+private:
+	void endWindow(Clock::time_point now);
+	// moves the busy time up to now into the window
+	void countBusy(Clock::time_point now);
+
+	double limit;
+	size_t minLimit;
+	size_t maxLimit;
+
+	size_t running = 0;
+	std::optional<Clock::time_point> busySince = std::nullopt;
+
+	// the window being filled
+	size_t windowJobs = 0;
+	std::chrono::milliseconds windowLatency{ 0 };
+	uint64_t windowBytes = 0;
+	std::chrono::steady_clock::duration windowBusy{ 0 };
+	size_t windowLimit;
+
+	// mean latency of jobs when things were going well, moves up slowly so
+	// a stretch of bigger jobs doesn't read as congestion forever
+	std::optional<double> baselineLatency = std::nullopt;
+	std::optional<double> lastThroughput = std::nullopt;
+	size_t lastLimit = 0;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// shared definitions of the bps patch format, see byuu's "BPS Patch Format Specification"
+//
+// a patch is "BPS1", the source size, target size and metadata size as varints,
+// the metadata, a list of actions that build the target front to back and a
+// footer with the crc32 of the source, the target and the patch itself
+
+constexpr char BPS_MAGIC[4] = { 'B', 'P', 'S', '1' };
+constexpr size_t BPS_FOOTER_SIZE = 12;
+
+// non-owning view of a contiguous run of bytes
+struct ByteSpan
+{
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+};
+
+struct BpsAction
+{
+	enum class Type : uint8_t
+	{
+		SourceRead = 0, // copy from the same offset in the source
+		TargetRead = 1, // literal bytes stored in the patch
+		SourceCopy = 2, // copy from anywhere in the source
+		TargetCopy = 3  // copy from earlier in the target, may overlap what it writes
+	};
+
+	Type type;
+	uint64_t length;
+
+	// absolute source offset of a SourceCopy or target offset of a TargetCopy,
+	// offsets are only made relative on serialization, for a TargetRead parsed
+	// from a patch it's where its bytes are in the patch, unused otherwise
+	uint64_t offset;
+};
@@ -0,0 +1,497 @@
+#include "BpsDecoder.h"
+#include "Crc32.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <Windows.h>
+
+namespace
+{
+	// how much of the target a streamed apply keeps in memory before writing it out
+	constexpr size_t TARGET_WINDOW_SIZE = 1 << 20;
+	// target copies from what was already written out are read back in pieces of this size
+	constexpr size_t READ_BACK_SIZE = 64 * 1024;
+
+	class PatchReader
+	{
+	public:
+		PatchReader(ByteSpan patch, size_t end) : patch(patch), end(end)
+		{
+		}
+
+		uint64_t readNumber()
+		{
+			uint64_t value = 0;
+			uint64_t shift = 1;
+
+			while (true)
+			{
+				if (position == end || shift > (UINT64_MAX >> 7))
+					throw std::runtime_error("Malformed number in bps patch");
+
+				const unsigned char byte = patch.data[position++];
+				value += (byte & 0x7f) * shift;
+
+				if ((byte & 0x80) != 0)
+					return value;
+
+				shift <<= 7;
+				value += shift;
+			}
+		}
+
+		int64_t readSignedNumber()
+		{
+			const uint64_t value = readNumber();
+			const int64_t magnitude = static_cast<int64_t>(value >> 1);
+			return (value & 1) != 0 ? -magnitude : magnitude;
+		}
+
+		void skip(uint64_t length)
+		{
+			if (length > end - position)
+				throw std::runtime_error("Bps patch ends unexpectedly");
+
+			position += static_cast<size_t>(length);
+		}
+
+		uint32_t readCrc()
+		{
+			if (end - position < 4)
+				throw std::runtime_error("Bps patch ends unexpectedly");
+
+			const unsigned char* p = patch.data + position;
+			position += 4;
+
+			return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+				(static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+		}
+
+		size_t getPosition() const
+		{
+			return position;
+		}
+
+		void setEnd(size_t newEnd)
+		{
+			end = newEnd;
+		}
+
+	private:
+		ByteSpan patch;
+		size_t end;
+		size_t position = 0;
+	};
+
+	// moves a relative offset, failing instead of going out of range
+	uint64_t moveOffset(uint64_t offset, int64_t delta, uint64_t limit)
+	{
+		if (delta < 0 ? static_cast<uint64_t>(-delta) > offset : static_cast<uint64_t>(delta) > limit - offset)
+			throw std::runtime_error("Bps patch copies from out of range");
+
+		return offset + delta;
+	}
+
+	// validates the whole patch and fills in everything but the actions, which
+	// are handed to visit one at a time in target order, the checksum of the
+	// patch itself is checked before any of them
+	template <typename Visitor>
+	void readPatch(ByteSpan patch, BpsDecoder::Patch& header, Visitor&& visit)
+	{
+		if (patch.size < sizeof(BPS_MAGIC) + 3 + BPS_FOOTER_SIZE || memcmp(patch.data, BPS_MAGIC, sizeof(BPS_MAGIC)) != 0)
+			throw std::runtime_error("Not a bps patch");
+
+		const size_t actionsEnd = patch.size - BPS_FOOTER_SIZE;
+
+		PatchReader footer(patch, patch.size);
+		footer.skip(actionsEnd);
+		header.sourceCrc = footer.readCrc();
+		header.targetCrc = footer.readCrc();
+
+		if (footer.readCrc() != Crc32::compute(patch.data, patch.size - 4))
+			throw std::runtime_error("Bps patch checksum mismatch");
+
+		PatchReader reader(patch, actionsEnd);
+		reader.skip(sizeof(BPS_MAGIC));
+
+		header.sourceSize = reader.readNumber();
+		header.targetSize = reader.readNumber();
+		reader.skip(reader.readNumber()); // metadata
+
+		uint64_t outputOffset = 0;
+		uint64_t sourceRelativeOffset = 0;
+		uint64_t targetRelativeOffset = 0;
+
+		while (reader.getPosition() != actionsEnd)
+		{
+			const uint64_t command = reader.readNumber();
+
+			BpsAction action{ static_cast<BpsAction::Type>(command & 3), (command >> 2) + 1, 0 };
+
+			if (action.length > header.targetSize - outputOffset)
+				throw std::runtime_error("Bps patch writes past the end of the target");
+
+			switch (action.type)
+			{
+			case BpsAction::Type::SourceRead:
+				if (outputOffset + action.length > header.sourceSize)
+					throw std::runtime_error("Bps patch reads past the end of the source");
+				break;
+
+			case BpsAction::Type::TargetRead:
+				action.offset = reader.getPosition();
+				reader.skip(action.length);
+				break;
+
+			case BpsAction::Type::SourceCopy:
+				action.offset = moveOffset(sourceRelativeOffset, reader.readSignedNumber(), header.sourceSize);
+				if (action.length > header.sourceSize - action.offset)
+					throw std::runtime_error("Bps patch copies past the end of the source");
+				sourceRelativeOffset = action.offset + action.length;
+				break;
+
+			case BpsAction::Type::TargetCopy:
+				action.offset = moveOffset(targetRelativeOffset, reader.readSignedNumber(), header.targetSize);
+				if (action.offset >= outputOffset)
+					throw std::runtime_error("Bps patch copies from a part of the target that wasn't written yet");
+				targetRelativeOffset = action.offset + action.length;
+				break;
+			}
+
+			visit(action, outputOffset);
+			outputOffset += action.length;
+		}
+
+		if (outputOffset != header.targetSize)
+			throw std::runtime_error("Bps patch doesn't cover the whole target");
+	}
+
+	void checkSource(ByteSpan source, const BpsDecoder::Patch& header)
+	{
+		if (header.sourceSize != source.size || header.sourceCrc != Crc32::computeParallel(source.data, source.size))
+			throw std::runtime_error("Bps patch was made for a different source");
+	}
+
+	// compares every action against the expected target instead of producing
+	// the target, everything before the current action already matched so
+	// target copies can read from the expected target as well
+	class TargetVerifier
+	{
+	public:
+		TargetVerifier(ByteSpan source, ByteSpan patch, ByteSpan expected) : source(source), patch(patch), expected(expected)
+		{
+		}
+
+		void operator()(const BpsAction& action, uint64_t outputOffset)
+		{
+			const size_t length = static_cast<size_t>(action.length);
+			const size_t offset = static_cast<size_t>(action.offset);
+			const size_t position = static_cast<size_t>(outputOffset);
+
+			const unsigned char* produced = nullptr;
+
+			switch (action.type)
+			{
+			case BpsAction::Type::SourceRead:
+				produced = source.data + position;
+				break;
+			case BpsAction::Type::TargetRead:
+				produced = patch.data + offset;
+				break;
+			case BpsAction::Type::SourceCopy:
+				produced = source.data + offset;
+				break;
+			case BpsAction::Type::TargetCopy:
+				// a copy overlapping what it writes compares each byte with one
+				// that was compared before, so this holds byte by byte as well
+				produced = expected.data + offset;
+				break;
+			}
+
+			if (memcmp(produced, expected.data + position, length) != 0)
+			{
+				const size_t mismatch = static_cast<size_t>(std::mismatch(produced, produced + length, expected.data + position).first - produced);
+				throw std::runtime_error("Bps patch produces a different target starting at offset " + std::to_string(position + mismatch));
+			}
+		}
+
+	private:
+		ByteSpan source;
+		ByteSpan patch;
+		ByteSpan expected;
+	};
+
+	// writes the target to a file through a fixed size window, target copies
+	// from before the window read the file back
+	class TargetFileWriter
+	{
+	public:
+		TargetFileWriter(ByteSpan source, ByteSpan patch, const fs::path& path) :
+			source(source), patch(patch), file(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc)
+		{
+			if (!file)
+				throw std::runtime_error("Failed to open \"" + path.string() + "\" for writing");
+
+			window.reserve(TARGET_WINDOW_SIZE);
+		}
+
+		void operator()(const BpsAction& action, uint64_t)
+		{
+			switch (action.type)
+			{
+			case BpsAction::Type::SourceRead:
+				write(source.data + position(), static_cast<size_t>(action.length));
+				break;
+			case BpsAction::Type::TargetRead:
+				write(patch.data + action.offset, static_cast<size_t>(action.length));
+				break;
+			case BpsAction::Type::SourceCopy:
+				write(source.data + action.offset, static_cast<size_t>(action.length));
+				break;
+			case BpsAction::Type::TargetCopy:
+				copy(action.offset, action.length);
+				break;
+			}
+		}
+
+		// writes out what's left and returns the checksum of the whole target
+		uint32_t finish()
+		{
+			flush();
+			file.close();
+
+			if (file.fail())
+				throw std::runtime_error("Failed to write bps patch target");
+
+			return crc;
+		}
+
+	private:
+		uint64_t position() const
+		{
+			return flushed + window.size();
+		}
+
+		void write(const unsigned char* data, size_t length)
+		{
+			while (length != 0)
+			{
+				const size_t piece = std::min(length, TARGET_WINDOW_SIZE - window.size());
+				window.insert(window.end(), data, data + piece);
+				data += piece;
+				length -= piece;
+
+				if (window.size() == TARGET_WINDOW_SIZE)
+					flush();
+			}
+		}
+
+		// reads pieces that never reach past what was already written, a copy
+		// overlapping its own output repeats the bytes between its offset and
+		// the end of the target, so those are repeated to fill a whole piece
+		void copy(uint64_t offset, uint64_t length)
+		{
+			while (length != 0)
+			{
+				const uint64_t distance = position() - offset;
+				size_t piece = static_cast<size_t>(std::min<uint64_t>({ length, distance, READ_BACK_SIZE }));
+
+				if (offset >= flushed)
+				{
+					readBack.assign(window.begin() + static_cast<size_t>(offset - flushed), window.begin() + static_cast<size_t>(offset - flushed) + piece);
+				}
+				else
+				{
+					piece = static_cast<size_t>(std::min<uint64_t>(piece, flushed - offset));
+					readBack.resize(piece);
+
+					file.seekg(static_cast<std::streamoff>(offset));
+					file.read(reinterpret_cast<char*>(readBack.data()), static_cast<std::streamsize>(piece));
+
+					if (!file)
+						throw std::runtime_error("Failed to read back bps patch target");
+				}
+
+				if (piece == distance && length > piece)
+				{
+					const size_t repeated = static_cast<size_t>(std::min<uint64_t>(length, READ_BACK_SIZE));
+					readBack.resize(repeated);
+
+					for (size_t i = piece; i != repeated; ++i)
+						readBack[i] = readBack[i - piece];
+
+					piece = repeated;
+				}
+
+				write(readBack.data(), piece);
+				offset += piece;
+				length -= piece;
+			}
+		}
+
+		void flush()
+		{
+			if (window.empty())
+				return;
+
+			file.seekp(static_cast<std::streamoff>(flushed));
+			file.write(reinterpret_cast<const char*>(window.data()), static_cast<std::streamsize>(window.size()));
+
+			if (!file)
+				throw std::runtime_error("Failed to write bps patch target");
+
+			crc = Crc32::compute(window.data(), window.size(), crc);
+			flushed += window.size();
+			window.clear();
+		}
+
+		ByteSpan source;
+		ByteSpan patch;
+		std::fstream file;
+		std::vector<unsigned char> window;
+		std::vector<unsigned char> readBack;
+		uint64_t flushed = 0;
+		uint32_t crc = 0;
+	};
+}
+
+BpsDecoder::Patch BpsDecoder::parse(ByteSpan patch)
+{
+	Patch result{};
+	readPatch(patch, result, [&](const BpsAction& action, uint64_t) { result.actions.push_back(action); });
+
+	return result;
+}
+
+std::vector<unsigned char> BpsDecoder::apply(ByteSpan source, ByteSpan patch)
+{
+	return apply(source, patch, parse(patch));
+}
+
+std::vector<unsigned char> BpsDecoder::apply(ByteSpan source, ByteSpan patch, const Patch& parsed)
+{
+	checkSource(source, parsed);
+
+	if (parsed.targetSize > SIZE_MAX)
+		throw std::runtime_error("Bps patch target too large");
+
+	std::vector<unsigned char> target(static_cast<size_t>(parsed.targetSize));
+	size_t outputOffset = 0;
+
+	for (const BpsAction& action : parsed.actions)
+	{
+		const size_t length = static_cast<size_t>(action.length);
+		const size_t offset = static_cast<size_t>(action.offset);
+
+		switch (action.type)
+		{
+		case BpsAction::Type::SourceRead:
+			memcpy(target.data() + outputOffset, source.data + outputOffset, length);
+			break;
+
+		case BpsAction::Type::TargetRead:
+			memcpy(target.data() + outputOffset, patch.data + offset, length);
+			break;
+
+		case BpsAction::Type::SourceCopy:
+			memcpy(target.data() + outputOffset, source.data + offset, length);
+			break;
+
+		case BpsAction::Type::TargetCopy:
+			// byte by byte, the copy may read what it just wrote
+			for (size_t i = 0; i != length; ++i)
+				target[outputOffset + i] = target[offset + i];
+			break;
+		}
+
+		outputOffset += length;
+	}
+
+	if (Crc32::computeParallel(target.data(), target.size()) != parsed.targetCrc)
+		throw std::runtime_error("Bps patch produced a target with the wrong checksum");
+
+	return target;
+}
+
+void BpsDecoder::applyFile(const fs::path& sourcePath, const fs::path& patchPath, const fs::path& targetPath)
+{
+	const MappedFile source(sourcePath);
+	const MappedFile patch(patchPath);
+
+	Patch header{};
+
+	fs::path tempPath = targetPath;
+	tempPath += ".tmp";
+
+	try
+	{
+		TargetFileWriter writer(source.span(), patch.span(), tempPath);
+
+		// the source is checked once its size is known, before anything is written
+		readPatch(patch.span(), header, [&](const BpsAction& action, uint64_t outputOffset) {
+			if (outputOffset == 0)
+				checkSource(source.span(), header);
+			writer(action, outputOffset);
+		});
+
+		if (header.targetSize == 0)
+			checkSource(source.span(), header);
+
+		if (writer.finish() != header.targetCrc)
+			throw std::runtime_error("Bps patch produced a target with the wrong checksum");
+	}
+	catch (const std::runtime_error&)
+	{
+		std::error_code ignored;
+		fs::remove(tempPath, ignored);
+		throw;
+	}
+
+	if (MoveFileExW(tempPath.c_str(), targetPath.c_str(), MOVEFILE_REPLACE_EXISTING) == 0)
+		throw std::runtime_error("Failed to replace \"" + targetPath.string() + "\"");
+}
+
+void BpsDecoder::verify(ByteSpan source, ByteSpan patch, ByteSpan expectedTarget)
+{
+	Patch header{};
+
+	// sizes are known after the header, everything else needs them
+	bool checked = false;
+	const auto checkSizes = [&]() {
+		if (checked)
+			return;
+		checked = true;
+
+		checkSource(source, header);
+
+		if (header.targetSize != expectedTarget.size)
+			throw std::runtime_error("Bps patch produces a target of " + std::to_string(header.targetSize) +
+				" bytes instead of " + std::to_string(expectedTarget.size));
+	};
+
+	TargetVerifier verifier(source, patch, expectedTarget);
+
+	readPatch(patch, header, [&](const BpsAction& action, uint64_t outputOffset) {
+		checkSizes();
+		verifier(action, outputOffset);
+	});
+
+	checkSizes();
+
+	if (Crc32::computeParallel(expectedTarget.data, expectedTarget.size) != header.targetCrc)
+		throw std::runtime_error("Bps patch produced a target with the wrong checksum");
+}
+
+void BpsDecoder::verifyFile(const fs::path& sourcePath, const fs::path& patchPath)
+{
+	const MappedFile source(sourcePath);
+	const MappedFile patch(patchPath);
+
+	// apply checks the source and the produced target against the footer
+	apply(source.span(), patch.span());
+}
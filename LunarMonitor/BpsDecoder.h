@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "Bps.h"
+
+namespace fs = std::filesystem;
+
+// reads bps patches, every function throws std::runtime_error on a malformed
+// patch or one whose checksums don't match
+class BpsDecoder
+{
+public:
+	struct Patch
+	{
+		uint64_t sourceSize;
+		uint64_t targetSize;
+		uint32_t sourceCrc;
+		uint32_t targetCrc;
+
+		// in target order with absolute offsets
+		std::vector<BpsAction> actions;
+	};
+
+	static Patch parse(ByteSpan patch);
+
+	// the target the patch creates from source
+	static std::vector<unsigned char> apply(ByteSpan source, ByteSpan patch);
+	static std::vector<unsigned char> apply(ByteSpan source, ByteSpan patch, const Patch& parsed);
+
+	// streams the target into targetPath without holding it in memory, source
+	// and patch are mapped, the target is written next to targetPath first and
+	// only replaces it once its checksum matched
+	static void applyFile(const fs::path& sourcePath, const fs::path& patchPath, const fs::path& targetPath);
+
+	// checks that the patch turns source into exactly expectedTarget, actions
+	// are compared against expectedTarget directly so nothing is produced
+	static void verify(ByteSpan source, ByteSpan patch, ByteSpan expectedTarget);
+
+	// checks a patch file on its own, it has to be intact and applying it to
+	// the source has to produce a target of the size and checksum the patch
+	// states, which are those of the target it was created from, so the target
+	// itself never has to be read again
+	static void verifyFile(const fs::path& sourcePath, const fs::path& patchPath);
+};
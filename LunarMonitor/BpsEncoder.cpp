@@ -0,0 +1,710 @@
+#include "BpsEncoder.h"
+#include "BpsDecoder.h"
+#include "Crc32.h"
+#include "MappedFile.h"
+#include "SourceIndexCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+	// number of bytes hashed to find target copy candidates, also the shortest
+	// target copy that is ever looked up
+	constexpr size_t HASH_LENGTH = 4;
+	constexpr unsigned MIN_HASH_BITS = 12;
+	constexpr unsigned MAX_HASH_BITS = 20;
+
+	// candidates looked at per position, bounds the time spent on long runs of
+	// identical bytes where every position lands in the same chain
+	constexpr size_t MAX_CHAIN_LENGTH = 16;
+
+	// a SourceRead at least this long is taken without searching for copies
+	constexpr uint64_t GOOD_ENOUGH_LENGTH = 64;
+
+	// bytes at the end of a source match that are still added to the target chain
+	constexpr size_t SKIPPED_TAIL_LENGTH = 64;
+
+	// changed ranges closer than this are re-encoded as one
+	constexpr size_t RANGE_MERGE_GAP = 32;
+
+	constexpr uint32_t NO_POSITION = UINT32_MAX;
+
+	uint32_t hashAt(const unsigned char* p, unsigned bits)
+	{
+		uint32_t word;
+		memcpy(&word, p, sizeof(word));
+		return (word * 2654435761u) >> (32 - bits);
+	}
+
+	size_t numberSize(uint64_t value)
+	{
+		size_t size = 1;
+		while ((value >>= 7) != 0)
+		{
+			--value;
+			++size;
+		}
+		return size;
+	}
+
+	void writeNumber(std::vector<unsigned char>& out, uint64_t value)
+	{
+		while (true)
+		{
+			const unsigned char bits = value & 0x7f;
+			value >>= 7;
+
+			if (value == 0)
+			{
+				out.push_back(0x80 | bits);
+				return;
+			}
+
+			out.push_back(bits);
+			--value;
+		}
+	}
+
+	void writeSignedNumber(std::vector<unsigned char>& out, int64_t value)
+	{
+		const uint64_t magnitude = value < 0 ? static_cast<uint64_t>(-value) : static_cast<uint64_t>(value);
+		writeNumber(out, (magnitude << 1) | (value < 0 ? 1 : 0));
+	}
+
+	void writeCrc(std::vector<unsigned char>& out, uint32_t crc)
+	{
+		for (int i = 0; i != 4; ++i)
+			out.push_back(static_cast<unsigned char>(crc >> (8 * i)));
+	}
+
+	uint64_t commandCost(uint64_t length)
+	{
+		return numberSize((length - 1) << 2);
+	}
+
+	uint64_t copyCost(uint64_t length, uint64_t offset, uint64_t relativeOffset)
+	{
+		const uint64_t distance = offset > relativeOffset ? offset - relativeOffset : relativeOffset - offset;
+		return commandCost(length) + numberSize(distance << 1);
+	}
+
+	// bytes saved compared to storing the same bytes literally
+	int64_t savedBytes(uint64_t length, uint64_t cost)
+	{
+		return static_cast<int64_t>(length) - static_cast<int64_t>(cost);
+	}
+
+	// positions of data grouped by the hash of the bytes starting there, newest first
+	class HashChain
+	{
+	public:
+		// the table is sized for about expectedInsertions positions, previous is
+		// left uninitialized, an entry is only ever read after insert wrote it
+		HashChain(ByteSpan data, size_t expectedInsertions) : data(data), previous(new uint32_t[data.size])
+		{
+			while (bits < MAX_HASH_BITS && (size_t(1) << bits) < expectedInsertions)
+				++bits;
+
+			heads.assign(size_t(1) << bits, NO_POSITION);
+		}
+
+		void insert(size_t position)
+		{
+			if (position + HASH_LENGTH > data.size)
+				return;
+
+			uint32_t& head = heads[hashAt(data.data + position, bits)];
+			previous[position] = head;
+			head = static_cast<uint32_t>(position);
+		}
+
+		void insertUpTo(size_t end)
+		{
+			for (; inserted < end; ++inserted)
+				insert(inserted);
+		}
+
+		// leaves positions before end out of the chain
+		void skipTo(size_t end)
+		{
+			inserted = std::max(inserted, end);
+		}
+
+		template <typename F>
+		void forEachCandidate(const unsigned char* key, F&& f) const
+		{
+			uint32_t position = heads[hashAt(key, bits)];
+
+			for (size_t i = 0; i != MAX_CHAIN_LENGTH && position != NO_POSITION; ++i)
+			{
+				f(static_cast<size_t>(position));
+				position = previous[position];
+			}
+		}
+
+	private:
+		ByteSpan data;
+		unsigned bits = MIN_HASH_BITS;
+		std::vector<uint32_t> heads;
+		std::unique_ptr<uint32_t[]> previous;
+		size_t inserted = 0;
+	};
+
+	size_t matchLength(const unsigned char* a, const unsigned char* b, size_t maxLength)
+	{
+		size_t length = 0;
+
+		// whole words first, the word that differs is narrowed down byte by byte
+		for (uint64_t x, y; maxLength - length >= sizeof(x); length += sizeof(x))
+		{
+			memcpy(&x, a + length, sizeof(x));
+			memcpy(&y, b + length, sizeof(y));
+			if (x != y)
+				break;
+		}
+
+		while (length != maxLength && a[length] == b[length])
+			++length;
+
+		return length;
+	}
+
+	struct Candidate
+	{
+		BpsAction action{ BpsAction::Type::TargetRead, 0, 0 };
+		int64_t gain = 0;
+
+		// how many bytes before the current position the match starts
+		size_t backtrack = 0;
+
+		void consider(BpsAction::Type type, uint64_t length, uint64_t offset, uint64_t cost, size_t matchBacktrack = 0)
+		{
+			const int64_t candidateGain = savedBytes(length, cost);
+
+			if (candidateGain > gain)
+			{
+				action = { type, length, offset };
+				gain = candidateGain;
+				backtrack = matchBacktrack;
+			}
+		}
+	};
+
+	// finds actions for ranges of the target, ranges have to come in ascending
+	// order, between them actions can also be appended directly, target copies
+	// may reach back into anything before the range being encoded
+	class RangeEncoder
+	{
+	public:
+		// encodedLength is roughly how many bytes will go through encode
+		RangeEncoder(ByteSpan source, ByteSpan target, const BpsSourceIndex& sourceIndex, std::vector<BpsAction>& actions, size_t encodedLength) :
+			source(source), target(target), sourceIndex(sourceIndex), actions(actions), targetChain(target, encodedLength)
+		{
+			if (source.size >= NO_POSITION || target.size >= NO_POSITION)
+				throw std::runtime_error("Files too large to be diffed");
+		}
+
+		// adds an action right after the previous one, merging the two if the
+		// second one just continues the first
+		void append(const BpsAction& action)
+		{
+			if (!actions.empty() && actions.back().type == action.type)
+			{
+				BpsAction& last = actions.back();
+
+				const bool continues = action.type == BpsAction::Type::SourceRead || action.type == BpsAction::Type::TargetRead ||
+					last.offset + last.length == action.offset;
+
+				if (continues)
+				{
+					last.length += action.length;
+					updateRelativeOffsets(last);
+					return;
+				}
+			}
+
+			actions.push_back(action);
+			updateRelativeOffsets(action);
+		}
+
+		void encode(size_t begin, size_t end)
+		{
+			targetChain.skipTo(begin - std::min(begin, SKIPPED_TAIL_LENGTH));
+
+			size_t literalStart = begin;
+			size_t outputOffset = begin;
+
+			const auto flushLiteral = [&]() {
+				if (outputOffset != literalStart)
+					append({ BpsAction::Type::TargetRead, outputOffset - literalStart, 0 });
+			};
+
+			while (outputOffset < end)
+			{
+				const size_t remaining = end - outputOffset;
+				const unsigned char* current = target.data + outputOffset;
+
+				Candidate best;
+
+				if (outputOffset < source.size)
+				{
+					const size_t length = matchLength(source.data + outputOffset, current, std::min(remaining, source.size - outputOffset));
+					if (length != 0)
+						best.consider(BpsAction::Type::SourceRead, length, 0, commandCost(length));
+				}
+
+				const bool searchCopies = best.action.length < GOOD_ENOUGH_LENGTH;
+
+				if (searchCopies && remaining >= BpsSourceIndex::WINDOW)
+				{
+					sourceIndex.forEachCandidate(current, [&](size_t position) {
+						// the match may start before the sampled position, as far back
+						// as the literals that haven't been written out yet
+						size_t backtrack = 0;
+						while (backtrack != position && outputOffset - backtrack != literalStart &&
+							source.data[position - backtrack - 1] == target.data[outputOffset - backtrack - 1])
+						{
+							++backtrack;
+						}
+
+						const size_t start = position - backtrack;
+						const size_t length = backtrack + matchLength(source.data + position, current, std::min(remaining, source.size - position));
+						best.consider(BpsAction::Type::SourceCopy, length, start, copyCost(length, start, sourceRelativeOffset), backtrack);
+					});
+				}
+
+				if (searchCopies && remaining >= HASH_LENGTH)
+				{
+					// only positions before outputOffset can be copied from, the copy
+					// itself may run past outputOffset since it's performed byte by byte
+					targetChain.insertUpTo(outputOffset);
+					targetChain.forEachCandidate(current, [&](size_t position) {
+						const size_t length = matchLength(target.data + position, current, remaining);
+						best.consider(BpsAction::Type::TargetCopy, length, position, copyCost(length, position, targetRelativeOffset));
+					});
+				}
+
+				// a copy also has to pay for splitting up a run of literals
+				if (best.gain <= 1)
+				{
+					++outputOffset;
+					continue;
+				}
+
+				outputOffset -= best.backtrack;
+
+				flushLiteral();
+				append(best.action);
+
+				outputOffset += static_cast<size_t>(best.action.length);
+				literalStart = outputOffset;
+
+				// whatever came from the source is found through the source index,
+				// keeping it out of the target chain saves hashing most of the ROM, only
+				// its end stays in so a run continuing past it can be copied from right behind
+				if (best.action.type != BpsAction::Type::TargetCopy)
+					targetChain.skipTo(outputOffset - std::min(static_cast<size_t>(best.action.length), SKIPPED_TAIL_LENGTH));
+			}
+
+			flushLiteral();
+		}
+
+	private:
+		void updateRelativeOffsets(const BpsAction& action)
+		{
+			if (action.type == BpsAction::Type::SourceCopy)
+				sourceRelativeOffset = action.offset + action.length;
+			else if (action.type == BpsAction::Type::TargetCopy)
+				targetRelativeOffset = action.offset + action.length;
+		}
+
+		ByteSpan source;
+		ByteSpan target;
+		const BpsSourceIndex& sourceIndex;
+		std::vector<BpsAction>& actions;
+
+		HashChain targetChain;
+		uint64_t sourceRelativeOffset = 0;
+		uint64_t targetRelativeOffset = 0;
+	};
+
+	struct Range
+	{
+		size_t begin;
+		size_t end;
+	};
+
+	// ranges of the target sorted by position, ranges less than RANGE_MERGE_GAP
+	// bytes apart are merged into one
+	class RangeList
+	{
+	public:
+		// ranges have to be added in ascending order
+		void add(size_t begin, size_t end)
+		{
+			if (!ranges.empty() && begin <= ranges.back().end + RANGE_MERGE_GAP)
+				ranges.back().end = std::max(ranges.back().end, end);
+			else
+				ranges.push_back({ begin, end });
+		}
+
+		// adds the ranges where a and b differ, offset is where they are in the target
+		void addDifferences(const unsigned char* a, const unsigned char* b, size_t length, size_t offset)
+		{
+			size_t position = 0;
+
+			while (true)
+			{
+				position += matchLength(a + position, b + position, length - position);
+				if (position == length)
+					return;
+
+				const size_t begin = position++;
+
+				while (position != length)
+				{
+					const size_t same = matchLength(a + position, b + position, length - position);
+					if (same >= RANGE_MERGE_GAP || position + same == length)
+						break;
+
+					position += same + 1;
+				}
+
+				add(offset + begin, offset + position);
+			}
+		}
+
+		bool intersects(size_t begin, size_t end) const
+		{
+			auto it = std::upper_bound(ranges.begin(), ranges.end(), begin,
+				[](size_t value, const Range& range) { return value < range.end; });
+
+			return it != ranges.end() && it->begin < end;
+		}
+
+		const std::vector<Range>& get() const
+		{
+			return ranges;
+		}
+
+	private:
+		std::vector<Range> ranges;
+	};
+
+	// where the target differs from what the previous actions produce, without
+	// producing it, target copies whose result isn't known for sure anymore
+	// because they read from a changed range count as changed entirely
+	RangeList findChangedRanges(ByteSpan source, ByteSpan target, ByteSpan previousPatch, const std::vector<BpsAction>& previousActions)
+	{
+		RangeList changed;
+		size_t outputOffset = 0;
+
+		for (const BpsAction& action : previousActions)
+		{
+			const size_t length = static_cast<size_t>(action.length);
+			const size_t offset = static_cast<size_t>(action.offset);
+			const unsigned char* current = target.data + outputOffset;
+
+			switch (action.type)
+			{
+			case BpsAction::Type::SourceRead:
+				changed.addDifferences(source.data + outputOffset, current, length, outputOffset);
+				break;
+
+			case BpsAction::Type::TargetRead:
+				changed.addDifferences(previousPatch.data + offset, current, length, outputOffset);
+				break;
+
+			case BpsAction::Type::SourceCopy:
+				changed.addDifferences(source.data + offset, current, length, outputOffset);
+				break;
+
+			case BpsAction::Type::TargetCopy:
+				if (changed.intersects(offset, offset + length) || matchLength(target.data + offset, current, length) != length)
+					changed.add(outputOffset, outputOffset + length);
+				break;
+			}
+
+			outputOffset += length;
+		}
+
+		return changed;
+	}
+
+	// keeps the previous actions outside of the changed ranges and encodes the
+	// changed ranges again
+	std::vector<BpsAction> reencodeChangedRanges(ByteSpan source, ByteSpan target, const BpsSourceIndex& sourceIndex,
+		const std::vector<BpsAction>& previousActions, const RangeList& changed)
+	{
+		size_t changedLength = 0;
+		for (const Range& range : changed.get())
+			changedLength += range.end - range.begin;
+
+		std::vector<BpsAction> actions;
+		RangeEncoder encoder(source, target, sourceIndex, actions, changedLength);
+
+		auto previous = previousActions.begin();
+		size_t previousOffset = 0;
+
+		// the parts of previous actions within [begin, end), which still produce
+		// the right bytes since neither they nor what they copy changed
+		const auto keep = [&](size_t begin, size_t end) {
+			while (begin < end)
+			{
+				while (previousOffset + previous->length <= begin)
+				{
+					previousOffset += static_cast<size_t>(previous->length);
+					++previous;
+				}
+
+				const size_t pieceEnd = std::min(end, previousOffset + static_cast<size_t>(previous->length));
+
+				BpsAction piece{ previous->type, pieceEnd - begin, 0 };
+				if (piece.type == BpsAction::Type::SourceCopy || piece.type == BpsAction::Type::TargetCopy)
+					piece.offset = previous->offset + (begin - previousOffset);
+
+				encoder.append(piece);
+				begin = pieceEnd;
+			}
+		};
+
+		size_t kept = 0;
+
+		for (const Range& range : changed.get())
+		{
+			keep(kept, range.begin);
+			encoder.encode(range.begin, range.end);
+			kept = range.end;
+		}
+
+		keep(kept, target.size);
+
+		return actions;
+	}
+
+	// crc of what the actions produce, computed from the bytes they read while
+	// checking that every one of them matches the target
+	uint32_t producedCrc(ByteSpan source, ByteSpan target, const std::vector<BpsAction>& actions)
+	{
+		uint32_t crc = 0;
+		size_t outputOffset = 0;
+
+		for (const BpsAction& action : actions)
+		{
+			const size_t length = static_cast<size_t>(action.length);
+
+			if (length > target.size - outputOffset)
+				throw std::runtime_error("Bps actions write past the end of the target");
+
+			const unsigned char* produced = nullptr;
+
+			switch (action.type)
+			{
+			case BpsAction::Type::SourceRead:
+				produced = source.data + outputOffset;
+				break;
+			case BpsAction::Type::TargetRead:
+				produced = target.data + outputOffset;
+				break;
+			case BpsAction::Type::SourceCopy:
+				produced = source.data + action.offset;
+				break;
+			case BpsAction::Type::TargetCopy:
+				// everything before outputOffset was already checked against the target
+				produced = target.data + action.offset;
+				break;
+			}
+
+			if (matchLength(produced, target.data + outputOffset, length) != length)
+				throw std::runtime_error("Bps actions don't reproduce the target");
+
+			// a target copy may overlap what it writes, the bytes it produces
+			// were just shown to be the target's own
+			crc = Crc32::compute(action.type == BpsAction::Type::TargetCopy ? target.data + outputOffset : produced, length, crc);
+			outputOffset += length;
+		}
+
+		if (outputOffset != target.size)
+			throw std::runtime_error("Bps actions don't cover the whole target");
+
+		return crc;
+	}
+}
+
+std::vector<BpsAction> BpsEncoder::diff(ByteSpan source, ByteSpan target)
+{
+	return diff(source, target, BpsSourceIndex::build(source));
+}
+
+std::vector<BpsAction> BpsEncoder::diff(ByteSpan source, ByteSpan target, const BpsSourceIndex& sourceIndex)
+{
+	std::vector<BpsAction> actions;
+
+	RangeEncoder encoder(source, target, sourceIndex, actions, target.size);
+	encoder.encode(0, target.size);
+
+	return actions;
+}
+
+std::vector<BpsAction> BpsEncoder::rediff(ByteSpan source, ByteSpan target, const BpsSourceIndex& sourceIndex,
+	ByteSpan previousPatch, const std::vector<BpsAction>& previousActions)
+{
+	uint64_t previousTargetSize = 0;
+	for (const BpsAction& action : previousActions)
+		previousTargetSize += action.length;
+
+	if (previousTargetSize != target.size)
+		return diff(source, target, sourceIndex);
+
+	const RangeList changed = findChangedRanges(source, target, previousPatch, previousActions);
+	return reencodeChangedRanges(source, target, sourceIndex, previousActions, changed);
+}
+
+std::vector<unsigned char> BpsEncoder::serialize(ByteSpan source, ByteSpan target, const std::vector<BpsAction>& actions)
+{
+	return serialize(source, target, actions, Crc32::computeParallel(source.data, source.size), Crc32::computeParallel(target.data, target.size));
+}
+
+std::vector<unsigned char> BpsEncoder::serialize(ByteSpan source, ByteSpan target, const std::vector<BpsAction>& actions,
+	uint32_t sourceCrc, uint32_t targetCrc)
+{
+	std::vector<unsigned char> patch;
+	patch.reserve(target.size / 8 + 64);
+
+	patch.insert(patch.end(), std::begin(BPS_MAGIC), std::end(BPS_MAGIC));
+	writeNumber(patch, source.size);
+	writeNumber(patch, target.size);
+	writeNumber(patch, 0); // no metadata
+
+	uint64_t outputOffset = 0;
+	uint64_t sourceRelativeOffset = 0;
+	uint64_t targetRelativeOffset = 0;
+
+	for (const BpsAction& action : actions)
+	{
+		writeNumber(patch, ((action.length - 1) << 2) | static_cast<uint8_t>(action.type));
+
+		switch (action.type)
+		{
+		case BpsAction::Type::SourceRead:
+			break;
+
+		case BpsAction::Type::TargetRead:
+			patch.insert(patch.end(), target.data + outputOffset, target.data + outputOffset + action.length);
+			break;
+
+		case BpsAction::Type::SourceCopy:
+			writeSignedNumber(patch, static_cast<int64_t>(action.offset - sourceRelativeOffset));
+			sourceRelativeOffset = action.offset + action.length;
+			break;
+
+		case BpsAction::Type::TargetCopy:
+			writeSignedNumber(patch, static_cast<int64_t>(action.offset - targetRelativeOffset));
+			targetRelativeOffset = action.offset + action.length;
+			break;
+		}
+
+		outputOffset += action.length;
+	}
+
+	if (outputOffset != target.size)
+		throw std::runtime_error("Bps actions don't cover the whole target");
+
+	writeCrc(patch, sourceCrc);
+	writeCrc(patch, targetCrc);
+	writeCrc(patch, Crc32::compute(patch.data(), patch.size()));
+
+	return patch;
+}
+
+std::vector<unsigned char> BpsEncoder::createPatch(ByteSpan source, ByteSpan target)
+{
+	return serialize(source, target, diff(source, target));
+}
+
+bool BpsEncoder::createPatchFile(const fs::path& sourcePath, const fs::path& targetPath, const fs::path& previousPatchPath,
+	const fs::path& destinationPath, const std::function<void()>& checkCancelled)
+{
+	const auto checkpoint = [&] {
+		if (checkCancelled)
+			checkCancelled();
+	};
+
+	// the target is the ROM Lunar Magic saves to, so it's read rather than mapped
+	const MappedFile source(sourcePath);
+	const std::vector<unsigned char> targetContents = readFileSnapshot(targetPath);
+	const ByteSpan target{ targetContents.data(), targetContents.size() };
+
+	const std::shared_ptr<const BpsSourceIndex> sourceIndex = SourceIndexCache::get(sourcePath, source.span());
+
+	checkpoint();
+
+	std::optional<std::vector<unsigned char>> patch = std::nullopt;
+
+	if (fs::exists(previousPatchPath))
+	{
+		try
+		{
+			patch = createIncrementalPatch(source.span(), target, *sourceIndex, previousPatchPath);
+		}
+		catch (const std::runtime_error&)
+		{
+			// previous patch is unusable, it's simply replaced by a full one
+		}
+
+		// nothing changed since the previous patch was written
+		if (patch.has_value() && patch.value().empty())
+			return false;
+
+		checkpoint();
+	}
+
+	if (!patch.has_value())
+	{
+		patch = serialize(source.span(), target, diff(source.span(), target, *sourceIndex));
+		checkpoint();
+	}
+
+	std::ofstream out(destinationPath, std::ios::binary | std::ios::trunc);
+
+	if (!out.write(reinterpret_cast<const char*>(patch.value().data()), patch.value().size()) || !out.flush())
+		throw std::runtime_error("Failed to write \"" + destinationPath.string() + "\"");
+
+	return true;
+}
+
+std::optional<std::vector<unsigned char>> BpsEncoder::createIncrementalPatch(ByteSpan source, ByteSpan target,
+	const BpsSourceIndex& sourceIndex, const fs::path& previousPatchPath)
+{
+	const uint32_t sourceCrc = Crc32::computeParallel(source.data, source.size);
+	const uint32_t targetCrc = Crc32::computeParallel(target.data, target.size);
+
+	std::vector<BpsAction> actions;
+
+	{
+		// unmapped again before the previous patch gets replaced
+		const MappedFile previousPatch(previousPatchPath);
+		const BpsDecoder::Patch previous = BpsDecoder::parse(previousPatch.span());
+
+		if (previous.sourceSize != source.size || previous.sourceCrc != sourceCrc || previous.targetSize != target.size)
+			return std::nullopt;
+
+		const RangeList changed = findChangedRanges(source, target, previousPatch.span(), previous.actions);
+
+		if (changed.get().empty())
+			return std::vector<unsigned char>{};
+
+		actions = reencodeChangedRanges(source, target, sourceIndex, previous.actions, changed);
+	}
+
+	// what the new actions produce has to come out with the crc of the actual
+	// target or the patch is thrown away
+	if (producedCrc(source, target, actions) != targetCrc)
+		throw std::runtime_error("Incrementally encoded bps patch failed verification");
+
+	return serialize(source, target, actions, sourceCrc, targetCrc);
+}
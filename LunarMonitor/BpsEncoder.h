@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "Bps.h"
+#include "BpsSourceIndex.h"
+
+namespace fs = std::filesystem;
+
+// creates bps patches in process, source matches are found through a sampled
+// index of the source and target matches through hash chains over the part of
+// the target that was already produced
+class BpsEncoder
+{
+public:
+	// actions that turn source into target, front to back
+	static std::vector<BpsAction> diff(ByteSpan source, ByteSpan target);
+	static std::vector<BpsAction> diff(ByteSpan source, ByteSpan target, const BpsSourceIndex& sourceIndex);
+
+	// like diff but starts from the actions parsed from a previous patch for
+	// the same source, only ranges of the target that differ from what those
+	// actions produce are encoded again, the rest of the actions is kept
+	static std::vector<BpsAction> rediff(ByteSpan source, ByteSpan target, const BpsSourceIndex& sourceIndex,
+		ByteSpan previousPatch, const std::vector<BpsAction>& previousActions);
+
+	// complete patch file contents for actions produced by diff
+	static std::vector<unsigned char> serialize(ByteSpan source, ByteSpan target, const std::vector<BpsAction>& actions);
+	static std::vector<unsigned char> serialize(ByteSpan source, ByteSpan target, const std::vector<BpsAction>& actions,
+		uint32_t sourceCrc, uint32_t targetCrc);
+
+	static std::vector<unsigned char> createPatch(ByteSpan source, ByteSpan target);
+
+	// maps the source and reads a snapshot of the target, which is the ROM
+	// Lunar Magic saves to and mustn't be mapped, and writes the patch to
+	// destinationPath, the source index comes from SourceIndexCache
+	//
+	// if previousPatchPath holds a patch for the same source it's updated
+	// through rediff instead of diffing the whole target again, false is
+	// returned and nothing is written if the target didn't change since
+	//
+	// destinationPath is meant to be staged, a patch that fails to be written
+	// is left half written there, checkCancelled is called between steps and
+	// throws to stop
+	static bool createPatchFile(const fs::path& sourcePath, const fs::path& targetPath, const fs::path& previousPatchPath,
+		const fs::path& destinationPath, const std::function<void()>& checkCancelled = {});
+
+private:
+	// nullopt if the previous patch can't be built upon, an empty patch if
+	// the target didn't change since it was written
+	static std::optional<std::vector<unsigned char>> createIncrementalPatch(ByteSpan source, ByteSpan target,
+		const BpsSourceIndex& sourceIndex, const fs::path& previousPatchPath);
+};
@@ -0,0 +1,148 @@
+#include "BpsSourceIndex.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#include <Windows.h>
+
+namespace
+{
+	constexpr char SOURCE_INDEX_MAGIC[4] = { 'L', 'M', 'S', 'I' };
+	constexpr uint32_t SOURCE_INDEX_FORMAT_VERSION = 1;
+
+	constexpr unsigned MIN_BUCKET_BITS = 10;
+	constexpr unsigned MAX_BUCKET_BITS = 24;
+
+	// fixed size so the slots right after it stay aligned in a mapped file
+	struct SourceIndexHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t stride;
+		uint32_t window;
+		uint32_t bucketSize;
+		uint32_t bucketBits;
+		uint64_t sourceSize;
+		char sourceDigest[32];
+	};
+
+	static_assert(sizeof(SourceIndexHeader) == 64, "source index header has to stay 64 bytes");
+}
+
+BpsSourceIndex BpsSourceIndex::build(ByteSpan source)
+{
+	if (source.size >= EMPTY_SLOT)
+		throw std::runtime_error("Source too large to be indexed");
+
+	BpsSourceIndex index;
+	index.sourceSize = source.size;
+
+	// about two samples per bucket leaves room for runs of repeated data
+	const size_t samples = source.size / STRIDE;
+	index.bucketBits = MIN_BUCKET_BITS;
+	while (index.bucketBits < MAX_BUCKET_BITS && (size_t(1) << index.bucketBits) < samples / 2)
+		++index.bucketBits;
+
+	index.ownedSlots.assign((size_t(1) << index.bucketBits) * BUCKET_SIZE, EMPTY_SLOT);
+
+	for (size_t position = 0; position + WINDOW <= source.size; position += STRIDE)
+	{
+		uint32_t* bucket = index.ownedSlots.data() + static_cast<size_t>(index.hash(source.data + position)) * BUCKET_SIZE;
+
+		// full buckets keep their earliest positions
+		for (size_t i = 0; i != BUCKET_SIZE; ++i)
+		{
+			if (bucket[i] == EMPTY_SLOT)
+			{
+				bucket[i] = static_cast<uint32_t>(position);
+				break;
+			}
+		}
+	}
+
+	return index;
+}
+
+std::optional<BpsSourceIndex> BpsSourceIndex::load(const fs::path& path, const std::string& sourceDigest, size_t sourceSize)
+{
+	if (!fs::exists(path) || sourceDigest.size() != sizeof(SourceIndexHeader::sourceDigest))
+		return std::nullopt;
+
+	std::shared_ptr<MappedFile> file;
+
+	try
+	{
+		file = std::make_shared<MappedFile>(path);
+	}
+	catch (const std::runtime_error&)
+	{
+		return std::nullopt;
+	}
+
+	if (file->size() < sizeof(SourceIndexHeader))
+		return std::nullopt;
+
+	SourceIndexHeader header;
+	memcpy(&header, file->data(), sizeof(header));
+
+	if (memcmp(header.magic, SOURCE_INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != SOURCE_INDEX_FORMAT_VERSION ||
+		header.stride != STRIDE || header.window != WINDOW || header.bucketSize != BUCKET_SIZE ||
+		header.bucketBits < MIN_BUCKET_BITS || header.bucketBits > MAX_BUCKET_BITS ||
+		header.sourceSize != sourceSize ||
+		memcmp(header.sourceDigest, sourceDigest.data(), sizeof(header.sourceDigest)) != 0)
+	{
+		return std::nullopt;
+	}
+
+	const size_t slotCount = (size_t(1) << header.bucketBits) * BUCKET_SIZE;
+
+	if (file->size() != sizeof(SourceIndexHeader) + slotCount * sizeof(uint32_t))
+		return std::nullopt;
+
+	BpsSourceIndex index;
+	index.bucketBits = header.bucketBits;
+	index.sourceSize = sourceSize;
+	index.mappedFile = std::move(file);
+
+	return index;
+}
+
+bool BpsSourceIndex::save(const fs::path& path, const std::string& sourceDigest) const
+{
+	if (sourceDigest.size() != sizeof(SourceIndexHeader::sourceDigest) || !fs::exists(path.parent_path()))
+		return false;
+
+	SourceIndexHeader header{};
+	memcpy(header.magic, SOURCE_INDEX_MAGIC, sizeof(header.magic));
+	header.version = SOURCE_INDEX_FORMAT_VERSION;
+	header.stride = STRIDE;
+	header.window = WINDOW;
+	header.bucketSize = BUCKET_SIZE;
+	header.bucketBits = bucketBits;
+	header.sourceSize = sourceSize;
+	memcpy(header.sourceDigest, sourceDigest.data(), sizeof(header.sourceDigest));
+
+	fs::path tempPath = path;
+	tempPath += ".tmp";
+
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(getSlots()), (size_t(1) << bucketBits) * BUCKET_SIZE * sizeof(uint32_t));
+
+		if (!out)
+			return false;
+	}
+
+	return MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+const uint32_t* BpsSourceIndex::getSlots() const
+{
+	if (mappedFile != nullptr)
+		return reinterpret_cast<const uint32_t*>(mappedFile->data() + sizeof(SourceIndexHeader));
+
+	return ownedSlots.data();
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Bps.h"
+#include "MappedFile.h"
+
+namespace fs = std::filesystem;
+
+// hash table of every STRIDE-th position of a bps source, keyed by the WINDOW
+// bytes starting there
+//
+// since only sampled positions are indexed, any match of at least
+// STRIDE + WINDOW - 1 bytes is found from one of the target positions it
+// covers and has to be extended backwards from there by the encoder
+//
+// the table is a flat array of fixed size buckets, so it can be saved as is and
+// used straight out of a memory mapped file later
+class BpsSourceIndex
+{
+public:
+	static constexpr size_t STRIDE = 8;
+	static constexpr size_t WINDOW = 8;
+	static constexpr size_t BUCKET_SIZE = 4;
+
+	static BpsSourceIndex build(ByteSpan source);
+
+	// nullopt if there is no index at path or it belongs to a different source
+	static std::optional<BpsSourceIndex> load(const fs::path& path, const std::string& sourceDigest, size_t sourceSize);
+	bool save(const fs::path& path, const std::string& sourceDigest) const;
+
+	template <typename F>
+	void forEachCandidate(const unsigned char* key, F&& f) const
+	{
+		const uint32_t* bucket = getSlots() + static_cast<size_t>(hash(key)) * BUCKET_SIZE;
+
+		for (size_t i = 0; i != BUCKET_SIZE && bucket[i] != EMPTY_SLOT; ++i)
+			f(static_cast<size_t>(bucket[i]));
+	}
+
+private:
+	static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+	BpsSourceIndex() = default;
+
+	uint32_t hash(const unsigned char* key) const
+	{
+		uint64_t word;
+		memcpy(&word, key, sizeof(word));
+		return static_cast<uint32_t>((word * 0x9e3779b97f4a7c15ull) >> (64 - bucketBits));
+	}
+
+	const uint32_t* getSlots() const;
+
+	unsigned bucketBits = 0;
+	size_t sourceSize = 0;
+
+	// slots are either owned after a build or point into a mapped index file
+	std::vector<uint32_t> ownedSlots;
+	std::shared_ptr<MappedFile> mappedFile;
+};
@@ -0,0 +1,144 @@
+#include "BuildReportHashIndex.h"
+
+#include <vector>
+
+BuildReportHashIndex BuildReportHashIndex::build(std::string_view text)
+{
+	struct Container
+	{
+		bool isObject;
+		std::string_view key;
+		bool keyIsPlain;
+	};
+
+	BuildReportHashIndex index;
+	std::vector<Container> containers;
+	bool expectingKey = false;
+
+	for (size_t i = 0; i != text.size(); ++i)
+	{
+		switch (text[i])
+		{
+		case '{':
+			containers.push_back({ true, {}, false });
+			expectingKey = true;
+			break;
+
+		case '[':
+			containers.push_back({ false, {}, false });
+			expectingKey = false;
+			break;
+
+		case '}':
+		case ']':
+			if (containers.empty())
+				return {};
+			containers.pop_back();
+			expectingKey = false;
+			break;
+
+		case ',':
+			expectingKey = !containers.empty() && containers.back().isObject;
+			break;
+
+		case ':':
+			expectingKey = false;
+			break;
+
+		case '"':
+		{
+			const size_t begin = i + 1;
+			bool escaped = false;
+
+			size_t end = begin;
+			while (end < text.size() && text[end] != '"')
+			{
+				if (text[end] == '\\')
+				{
+					escaped = true;
+					++end;
+				}
+				++end;
+			}
+
+			if (end >= text.size() || containers.empty())
+				return {};
+
+			const std::string_view value = text.substr(begin, end - begin);
+			Container& current = containers.back();
+
+			if (expectingKey)
+			{
+				current.key = value;
+				current.keyIsPlain = !escaped;
+			}
+			else if (current.isObject && current.keyIsPlain && isHash(value))
+			{
+				if (containers.size() == 1)
+					index.offsets[makeKey({}, current.key)] = begin;
+				else if (containers.size() == 2 && containers.front().keyIsPlain)
+					index.offsets[makeKey(containers.front().key, current.key)] = begin;
+			}
+
+			i = end;
+			break;
+		}
+		}
+	}
+
+	if (!containers.empty())
+		return {};
+
+	return index;
+}
+
+bool BuildReportHashIndex::isHash(std::string_view value)
+{
+	if (value.size() != HASH_LENGTH)
+		return false;
+
+	for (const char c : value)
+	{
+		if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+			return false;
+	}
+
+	return true;
+}
+
+std::optional<uint64_t> BuildReportHashIndex::find(const std::string& object, const std::string& key) const
+{
+	const auto it = offsets.find(makeKey(object, key));
+
+	if (it == offsets.end())
+		return std::nullopt;
+
+	return it->second;
+}
+
+void BuildReportHashIndex::insert(const std::string& object, const std::string& key, uint64_t offset)
+{
+	offsets[makeKey(object, key)] = offset;
+}
+
+void BuildReportHashIndex::insertNested(const std::string& object, const BuildReportHashIndex& nested, uint64_t base)
+{
+	for (const auto& [nestedKey, offset] : nested.offsets)
+	{
+		// top level keys of the nested index start with the separator
+		if (!nestedKey.empty() && nestedKey.front() == '\0')
+			offsets[makeKey(object, std::string_view(nestedKey).substr(1))] = base + offset;
+	}
+}
+
+std::string BuildReportHashIndex::makeKey(std::string_view object, std::string_view key)
+{
+	// json keys can't contain a raw null character, so this never mixes up two entries
+	std::string result;
+	result.reserve(object.size() + 1 + key.size());
+	result.append(object);
+	result.push_back('\0');
+	result.append(key);
+
+	return result;
+}
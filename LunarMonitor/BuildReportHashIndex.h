@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// where the md5 values of a serialized build report sit, so a single value can
+// be replaced by overwriting its 32 characters in place without touching the
+// rest of the file
+//
+// values are found by key at the top level, like "global_data", or one
+// object deep, like "levels" / "level 105.mwl", keys that contain escape
+// sequences aren't indexed
+class BuildReportHashIndex
+{
+public:
+	static constexpr size_t HASH_LENGTH = 32;
+
+	// one pass over the serialized report, an index of malformed json is empty
+	static BuildReportHashIndex build(std::string_view text);
+
+	// 32 lowercase hex digits, the only values that can be replaced in place
+	static bool isHash(std::string_view value);
+
+	// offset of the first character of the value, object is empty for the top level
+	std::optional<uint64_t> find(const std::string& object, const std::string& key) const;
+
+	void insert(const std::string& object, const std::string& key, uint64_t offset);
+	// adds the top level values of an index built from a nested object as
+	// values of object, base is where the nested object starts
+	void insertNested(const std::string& object, const BuildReportHashIndex& nested, uint64_t base);
+
+private:
+	static std::string makeKey(std::string_view object, std::string_view key);
+
+	std::unordered_map<std::string, uint64_t> offsets;
+};
@@ -0,0 +1,43 @@
+#include "BuildReportLock.h"
+
+#include <thread>
+
+namespace
+{
+	constexpr std::chrono::milliseconds RETRY_INTERVAL{ 20 };
+}
+
+BuildReportLock::BuildReportLock(const fs::path& lockPath, std::chrono::milliseconds timeout)
+{
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+	while (true)
+	{
+		file = CreateFileW(lockPath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS,
+			FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+
+		if (file != INVALID_HANDLE_VALUE || std::chrono::steady_clock::now() >= deadline)
+			return;
+
+		std::this_thread::sleep_for(RETRY_INTERVAL);
+	}
+}
+
+BuildReportLock::~BuildReportLock()
+{
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+}
+
+bool BuildReportLock::isHeld() const
+{
+	return file != INVALID_HANDLE_VALUE;
+}
+
+fs::path BuildReportLock::lockPathFor(const fs::path& reportPath)
+{
+	fs::path lockPath = reportPath;
+	lockPath.replace_extension(".lock");
+
+	return lockPath;
+}
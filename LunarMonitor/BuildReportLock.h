@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+
+#include <Windows.h>
+
+namespace fs = std::filesystem;
+
+// exclusive hold on the build report's lock file, LunarHelper takes the same
+// lock around its own report write, so whoever holds it can compare the
+// report against what it last saw and replace it without anyone writing in
+// between, the file is opened without sharing and deleted on close, so a
+// holder that crashes releases it as well
+class BuildReportLock
+{
+public:
+	// keeps trying for up to timeout, check isHeld afterwards
+	BuildReportLock(const fs::path& lockPath, std::chrono::milliseconds timeout);
+	~BuildReportLock();
+
+	BuildReportLock(const BuildReportLock&) = delete;
+	BuildReportLock& operator=(const BuildReportLock&) = delete;
+
+	bool isHeld() const;
+
+	// the lock file that belongs to a report
+	static fs::path lockPathFor(const fs::path& reportPath);
+
+private:
+	HANDLE file = INVALID_HANDLE_VALUE;
+};
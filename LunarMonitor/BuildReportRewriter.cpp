@@ -0,0 +1,469 @@
+#include "BuildReportRewriter.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <unordered_set>
+
+namespace
+{
+	constexpr const char* LEVELS_KEY = "levels";
+
+	bool isWhitespace(int c)
+	{
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	}
+
+	// json tokens read straight from the stream buffer, everything that's read
+	// is handed to a sink so it can be copied, kept or dropped
+	class ReportReader
+	{
+	public:
+		explicit ReportReader(std::istream& in) : buffer(*in.rdbuf())
+		{
+		}
+
+		int peek()
+		{
+			return buffer.sgetc();
+		}
+
+		int get()
+		{
+			const int c = buffer.sbumpc();
+			if (c != std::char_traits<char>::eof())
+				++position;
+			return c;
+		}
+
+		uint64_t getPosition() const
+		{
+			return position;
+		}
+
+		template <typename Sink>
+		void whitespace(Sink&& sink)
+		{
+			while (isWhitespace(peek()))
+				sink(static_cast<char>(get()));
+		}
+
+		// rest of a string after its opening quote, up to and including the
+		// closing one, escapes are handed on as they are
+		template <typename Sink>
+		bool string(Sink&& sink)
+		{
+			while (true)
+			{
+				int c = get();
+				if (c == std::char_traits<char>::eof())
+					return false;
+				sink(static_cast<char>(c));
+
+				if (c == '"')
+					return true;
+
+				if (c == '\\')
+				{
+					c = get();
+					if (c == std::char_traits<char>::eof())
+						return false;
+					sink(static_cast<char>(c));
+				}
+			}
+		}
+
+		// a whole value, objects and arrays with everything in them
+		template <typename Sink>
+		bool value(Sink&& sink)
+		{
+			int c = get();
+			if (c == std::char_traits<char>::eof())
+				return false;
+			sink(static_cast<char>(c));
+
+			if (c == '"')
+				return string(sink);
+
+			if (c == '{' || c == '[')
+			{
+				int depth = 1;
+
+				while (depth != 0)
+				{
+					c = get();
+					if (c == std::char_traits<char>::eof())
+						return false;
+					sink(static_cast<char>(c));
+
+					if (c == '"' && !string(sink))
+						return false;
+					else if (c == '{' || c == '[')
+						++depth;
+					else if (c == '}' || c == ']')
+						--depth;
+				}
+
+				return true;
+			}
+
+			// number, true, false or null
+			while (peek() != std::char_traits<char>::eof() && !isWhitespace(peek()) && peek() != ',' && peek() != '}' && peek() != ']')
+				sink(static_cast<char>(get()));
+
+			return true;
+		}
+
+		// key of the next member and the colon after it, the key still escaped
+		template <typename Sink>
+		bool key(std::string& rawKey, Sink&& sink)
+		{
+			if (get() != '"')
+				return false;
+			sink('"');
+
+			if (!string([&](char c) { rawKey.push_back(c); sink(c); }))
+				return false;
+			rawKey.pop_back();
+
+			whitespace(sink);
+			if (get() != ':')
+				return false;
+			sink(':');
+			whitespace(sink);
+
+			return true;
+		}
+
+	private:
+		std::streambuf& buffer;
+		uint64_t position = 0;
+	};
+
+	// members are written in the layout of the report, taken from the
+	// whitespace in front of its first member, by default like json::dump(2)
+	struct Layout
+	{
+		std::string lineBreak = "\n";
+		std::string indent = "  ";
+		bool compact = false;
+
+		static Layout from(const std::string& whitespace)
+		{
+			Layout layout;
+
+			const size_t lineStart = whitespace.rfind('\n');
+
+			if (lineStart == std::string::npos)
+			{
+				layout.compact = true;
+				layout.lineBreak.clear();
+				layout.indent.clear();
+			}
+			else
+			{
+				layout.lineBreak = lineStart > 0 && whitespace[lineStart - 1] == '\r' ? "\r\n" : "\n";
+				layout.indent = whitespace.substr(lineStart + 1);
+			}
+
+			return layout;
+		}
+	};
+
+	class ReportWriter
+	{
+	public:
+		explicit ReportWriter(std::ostream& out) : out(out)
+		{
+		}
+
+		void put(char c)
+		{
+			out.put(c);
+			++position;
+		}
+
+		void write(const std::string& text)
+		{
+			out.write(text.data(), static_cast<std::streamsize>(text.size()));
+			position += text.size();
+		}
+
+		// value of a top level member, md5 values in it are added to index
+		void member(const std::string& key, const json& value, const Layout& layout, BuildReportHashIndex& index)
+		{
+			std::string text;
+			for (const char c : value.dump(layout.compact ? -1 : static_cast<int>(layout.indent.size())))
+			{
+				if (c != '\n')
+				{
+					text.push_back(c);
+					continue;
+				}
+
+				text.append(layout.lineBreak);
+				text.append(layout.indent);
+			}
+
+			if (value.is_string() && BuildReportHashIndex::isHash(value.get_ref<const std::string&>()))
+				index.insert("", key, position + 1);
+			else if (value.is_object())
+				index.insertNested(key, BuildReportHashIndex::build(text), position);
+
+			write(text);
+		}
+
+	private:
+		std::ostream& out;
+		uint64_t position = 0;
+	};
+
+	std::string unescapeKey(const std::string& rawKey)
+	{
+		return json::parse("\"" + rawKey + "\"").get<std::string>();
+	}
+}
+
+std::optional<BuildReportRewriter::OwnedMembers> BuildReportRewriter::read(const fs::path& reportPath)
+{
+	std::ifstream in(reportPath, std::ios::binary);
+
+	if (!in)
+		return std::nullopt;
+
+	ReportReader reader(in);
+	const auto drop = [](char) {};
+
+	OwnedMembers result{ json::object(), {} };
+
+	try
+	{
+		reader.whitespace(drop);
+		if (reader.get() != '{')
+			return std::nullopt;
+
+		reader.whitespace(drop);
+		if (reader.peek() == '}')
+			return result;
+
+		while (true)
+		{
+			std::string rawKey;
+			if (!reader.key(rawKey, drop))
+				return std::nullopt;
+
+			const uint64_t start = reader.getPosition();
+			const std::string key = unescapeKey(rawKey);
+
+			if (key != LEVELS_KEY && (reader.peek() == '{' || reader.peek() == '['))
+			{
+				if (!reader.value(drop))
+					return std::nullopt;
+			}
+			else
+			{
+				std::string raw;
+				if (!reader.value([&](char c) { raw.push_back(c); }))
+					return std::nullopt;
+
+				json value = json::parse(raw);
+
+				if (value.is_string() && BuildReportHashIndex::isHash(value.get_ref<const std::string&>()))
+					result.hashIndex.insert("", key, start + 1);
+				else if (value.is_object())
+					result.hashIndex.insertNested(key, BuildReportHashIndex::build(raw), start);
+
+				result.members[key] = std::move(value);
+			}
+
+			reader.whitespace(drop);
+			const int c = reader.get();
+
+			if (c == '}')
+				return result;
+			if (c != ',')
+				return std::nullopt;
+
+			reader.whitespace(drop);
+		}
+	}
+	catch (const json::exception&)
+	{
+		return std::nullopt;
+	}
+}
+
+std::optional<json> BuildReportRewriter::readTopLevel(const fs::path& reportPath, const std::vector<std::string>& keys)
+{
+	std::ifstream in(reportPath, std::ios::binary);
+
+	if (!in)
+		return std::nullopt;
+
+	ReportReader reader(in);
+	const auto drop = [](char) {};
+
+	json result = json::object();
+
+	try
+	{
+		reader.whitespace(drop);
+		if (reader.get() != '{')
+			return std::nullopt;
+
+		reader.whitespace(drop);
+		if (reader.peek() == '}')
+			return result;
+
+		while (result.size() != keys.size())
+		{
+			std::string rawKey;
+			if (!reader.key(rawKey, drop))
+				return std::nullopt;
+
+			const std::string key = unescapeKey(rawKey);
+
+			if (std::find(keys.begin(), keys.end(), key) != keys.end() && !result.contains(key))
+			{
+				std::string raw;
+				if (!reader.value([&](char c) { raw.push_back(c); }))
+					return std::nullopt;
+
+				result[key] = json::parse(raw);
+			}
+			else if (!reader.value(drop))
+			{
+				return std::nullopt;
+			}
+
+			reader.whitespace(drop);
+			const int c = reader.get();
+
+			if (c == '}')
+				break;
+			if (c != ',')
+				return std::nullopt;
+
+			reader.whitespace(drop);
+		}
+	}
+	catch (const json::exception&)
+	{
+		return std::nullopt;
+	}
+
+	return result;
+}
+
+std::optional<BuildReportHashIndex> BuildReportRewriter::rewrite(std::istream& in, std::ostream& out, const json& members)
+{
+	ReportReader reader(in);
+	ReportWriter writer(out);
+
+	const auto copy = [&](char c) { writer.put(c); };
+	const auto drop = [](char) {};
+
+	BuildReportHashIndex index;
+	std::unordered_set<std::string> written;
+	bool hadMembers = false;
+	Layout layout;
+
+	// held back until it's clear whether members get added in front of it
+	std::string whitespace;
+	const auto collect = [&](char c) { whitespace.push_back(c); };
+
+	try
+	{
+		reader.whitespace(copy);
+		if (reader.get() != '{')
+			return std::nullopt;
+		writer.put('{');
+
+		reader.whitespace(collect);
+
+		if (reader.peek() != '}')
+		{
+			hadMembers = true;
+			layout = Layout::from(whitespace);
+
+			while (true)
+			{
+				writer.write(whitespace);
+				whitespace.clear();
+
+				std::string rawKey;
+				if (!reader.key(rawKey, copy))
+					return std::nullopt;
+
+				const std::string key = unescapeKey(rawKey);
+				const auto replacement = members.find(key);
+
+				if (replacement != members.end())
+				{
+					if (!reader.value(drop))
+						return std::nullopt;
+
+					writer.member(key, replacement.value(), layout, index);
+					written.insert(key);
+				}
+				else if (!reader.value(copy))
+				{
+					return std::nullopt;
+				}
+
+				reader.whitespace(collect);
+				const int c = reader.get();
+
+				if (c == '}')
+					break;
+				if (c != ',')
+					return std::nullopt;
+
+				writer.write(whitespace);
+				whitespace.clear();
+				writer.put(',');
+
+				reader.whitespace(collect);
+			}
+		}
+		else
+		{
+			reader.get();
+		}
+
+		bool added = false;
+
+		for (const auto& [key, value] : members.items())
+		{
+			if (written.count(key) != 0)
+				continue;
+
+			if (hadMembers || added)
+				writer.put(',');
+			writer.write(layout.lineBreak);
+			writer.write(layout.indent);
+			writer.write(json(key).dump());
+			writer.write(layout.compact ? ":" : ": ");
+			writer.member(key, value, layout, index);
+
+			added = true;
+		}
+
+		if (added && !hadMembers)
+			whitespace = layout.lineBreak;
+
+		writer.write(whitespace);
+		writer.put('}');
+
+		reader.whitespace(copy);
+	}
+	catch (const json::exception&)
+	{
+		return std::nullopt;
+	}
+
+	if (!out)
+		return std::nullopt;
+
+	return index;
+}
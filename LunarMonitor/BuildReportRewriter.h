@@ -0,0 +1,43 @@
+#pragma once
+
+#include <filesystem>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+using json = nlohmann::json;
+
+#include "BuildReportHashIndex.h"
+
+namespace fs = std::filesystem;
+
+// streams the build report instead of parsing it as a whole, only the members
+// the monitor owns are ever parsed, those are top level values that aren't
+// objects or arrays, like build_time and the md5 values of resources, and the
+// levels object, everything else like LunarHelper's dependency_graph is
+// skipped when reading and copied through byte for byte when writing
+class BuildReportRewriter
+{
+public:
+	struct OwnedMembers
+	{
+		json members;
+		BuildReportHashIndex hashIndex;
+	};
+
+	// nullopt if the report can't be read or isn't a json object
+	static std::optional<OwnedMembers> read(const fs::path& reportPath);
+
+	// values of just the given top level members, the scan stops as soon as
+	// all of them were found, members missing from the report are missing
+	// from the result
+	static std::optional<json> readTopLevel(const fs::path& reportPath, const std::vector<std::string>& keys);
+
+	// copies the report from in to out with every member that's also in
+	// members replaced, members the report doesn't have yet are added at the
+	// end, returns the index of the md5 values that were written from members
+	static std::optional<BuildReportHashIndex> rewrite(std::istream& in, std::ostream& out, const json& members);
+};
@@ -0,0 +1,342 @@
+#include "BuildReportStore.h"
+#include "BuildReportRewriter.h"
+#include "Logger.h"
+
+#include <fstream>
+#include <thread>
+
+#include <Windows.h>
+
+namespace
+{
+	// LunarHelper only holds the lock while it replaces the report, not for a whole build
+	constexpr std::chrono::milliseconds LOCK_TIMEOUT{ 1000 };
+	constexpr std::chrono::milliseconds LOCK_RETRY_DELAY{ 2000 };
+}
+
+void BuildReportStore::enable(const fs::path& path, std::chrono::milliseconds delay)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	flushDelay = delay;
+
+	if (reportPath.has_value() && reportPath.value() == path)
+		return;
+
+	if (!pendingChanges.empty())
+		save();
+
+	reportPath = path;
+	report.reset();
+	knownFingerprint.reset();
+	pendingChanges.clear();
+	hashIndex = {};
+	pendingHashWrites.clear();
+	needsWholeWrite = false;
+	flushDeadline.reset();
+
+	if (!flusherRunning)
+	{
+		flusherRunning = true;
+		std::thread(runFlusher).detach();
+	}
+}
+
+void BuildReportStore::shutdown()
+{
+	std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+
+	if (lock.owns_lock() && !pendingChanges.empty())
+		save();
+}
+
+bool BuildReportStore::isAvailable()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return ensureLoaded();
+}
+
+bool BuildReportStore::update(const Change& change)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!applyChange(change))
+		return false;
+
+	needsWholeWrite = true;
+
+	return scheduleSave();
+}
+
+bool BuildReportStore::updateHash(const std::string& object, const std::string& key, const std::string& hash)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const Change change = [object, key, hash](json& j) {
+		(object.empty() ? j : j[object])[key] = hash;
+	};
+
+	if (!applyChange(change))
+		return false;
+
+	const std::optional<uint64_t> offset = hashIndex.find(object, key);
+
+	if (offset.has_value() && BuildReportHashIndex::isHash(hash))
+		pendingHashWrites.emplace_back(offset.value(), hash);
+	else
+		needsWholeWrite = true;
+
+	return scheduleSave();
+}
+
+bool BuildReportStore::read(const std::function<void(const json&)>& reader)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!ensureLoaded())
+		return false;
+
+	try
+	{
+		reader(report.value());
+	}
+	catch (const json::exception&)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool BuildReportStore::flush()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (pendingChanges.empty())
+		return true;
+
+	return save() == SaveResult::Saved;
+}
+
+bool BuildReportStore::checkForExternalWrite()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!reportPath.has_value())
+		return false;
+
+	if (knownFingerprint.has_value() && HashCache::getFingerprint(reportPath.value()) == knownFingerprint)
+		return false;
+
+	report.reset();
+	knownFingerprint.reset();
+
+	return true;
+}
+
+bool BuildReportStore::applyChange(const Change& change)
+{
+	if (!ensureLoaded())
+		return false;
+
+	try
+	{
+		change(report.value());
+	}
+	catch (const json::exception&)
+	{
+		return false;
+	}
+
+	pendingChanges.push_back(change);
+
+	return true;
+}
+
+bool BuildReportStore::scheduleSave()
+{
+	if (flushDelay.count() == 0)
+	{
+		const SaveResult result = save();
+
+		if (result != SaveResult::LockBusy)
+			return result == SaveResult::Saved;
+
+		// left to the flusher
+		flushDeadline = std::chrono::steady_clock::now() + LOCK_RETRY_DELAY;
+		flushRequested.notify_one();
+
+		return true;
+	}
+
+	flushDeadline = std::chrono::steady_clock::now() + flushDelay;
+	flushRequested.notify_one();
+
+	return true;
+}
+
+bool BuildReportStore::ensureLoaded()
+{
+	if (report.has_value())
+		return true;
+
+	if (!reportPath.has_value())
+		return false;
+
+	return load();
+}
+
+bool BuildReportStore::load()
+{
+	// taken before reading so a write that happens during the read is noticed later
+	const std::optional<FileFingerprint> fingerprint = HashCache::getFingerprint(reportPath.value());
+
+	if (!fingerprint.has_value())
+		return false;
+
+	std::optional<BuildReportRewriter::OwnedMembers> owned = BuildReportRewriter::read(reportPath.value());
+
+	if (!owned.has_value())
+		return false;
+
+	json& j = owned.value().members;
+
+	for (const Change& change : pendingChanges)
+	{
+		try
+		{
+			change(j);
+		}
+		catch (const json::exception&)
+		{
+			// pass
+		}
+	}
+
+	report = std::move(j);
+	knownFingerprint = fingerprint;
+	hashIndex = std::move(owned.value().hashIndex);
+
+	// offsets of pending writes were for the previous file
+	pendingHashWrites.clear();
+	needsWholeWrite = !pendingChanges.empty();
+
+	return true;
+}
+
+BuildReportStore::SaveResult BuildReportStore::save()
+{
+	const BuildReportLock lock(BuildReportLock::lockPathFor(reportPath.value()), LOCK_TIMEOUT);
+
+	if (!lock.isHeld())
+		return SaveResult::LockBusy;
+
+	// a report written by someone else in the meantime wins, what's pending goes on top of it
+	if (HashCache::getFingerprint(reportPath.value()) != knownFingerprint)
+		report.reset();
+
+	if (!ensureLoaded())
+		return SaveResult::Failed;
+
+	if (needsWholeWrite || !writeHashesInPlace())
+	{
+		if (!writeWhole())
+			return SaveResult::Failed;
+	}
+
+	knownFingerprint = HashCache::getFingerprint(reportPath.value());
+	pendingChanges.clear();
+	pendingHashWrites.clear();
+	needsWholeWrite = false;
+	flushDeadline.reset();
+
+	HashCache::flush();
+
+	return SaveResult::Saved;
+}
+
+bool BuildReportStore::writeHashesInPlace()
+{
+	std::fstream file(reportPath.value(), std::ios::binary | std::ios::in | std::ios::out);
+
+	if (!file)
+		return false;
+
+	for (const auto& [offset, hash] : pendingHashWrites)
+	{
+		file.seekp(static_cast<std::streamoff>(offset));
+		file.write(hash.data(), static_cast<std::streamsize>(hash.size()));
+	}
+
+	file.close();
+
+	return !file.fail();
+}
+
+bool BuildReportStore::writeWhole()
+{
+	fs::path tempPath = reportPath.value();
+	tempPath += ".tmp";
+
+	std::optional<BuildReportHashIndex> writtenIndex;
+
+	{
+		std::ifstream in(reportPath.value(), std::ios::binary);
+		// binary so the offsets in hashIndex are the ones in the file
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+
+		if (!in || !out)
+			return false;
+
+		writtenIndex = BuildReportRewriter::rewrite(in, out, report.value());
+
+		if (!writtenIndex.has_value() || !out.flush())
+			return false;
+	}
+
+	if (MoveFileExW(tempPath.c_str(), reportPath.value().c_str(), MOVEFILE_REPLACE_EXISTING) == 0)
+		return false;
+
+	hashIndex = std::move(writtenIndex.value());
+
+	return true;
+}
+
+void BuildReportStore::runFlusher()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		if (!flushDeadline.has_value())
+		{
+			flushRequested.wait(lock);
+			continue;
+		}
+
+		// every change moves the deadline, so only write once it stayed put
+		const auto deadline = flushDeadline.value();
+		flushRequested.wait_until(lock, deadline);
+
+		if (!flushDeadline.has_value() || std::chrono::steady_clock::now() < flushDeadline.value())
+			continue;
+
+		switch (save())
+		{
+		case SaveResult::Saved:
+			break;
+
+		case SaveResult::LockBusy:
+			flushDeadline = std::chrono::steady_clock::now() + LOCK_RETRY_DELAY;
+			Logger::log_message(L"Build report is locked by LunarHelper, retrying later");
+			break;
+
+		case SaveResult::Failed:
+			// pending changes stay around for the next attempt
+			flushDeadline.reset();
+			Logger::log_error(L"Failed to write build report to \"%s\"", reportPath.value().c_str());
+			break;
+		}
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "json.hpp"
+using json = nlohmann::json;
+
+#include "HashCache.h"
+#include "BuildReportHashIndex.h"
+#include "BuildReportLock.h"
+
+namespace fs = std::filesystem;
+
+// keeps the members of LunarHelper's build report the monitor owns parsed in
+// memory so updates don't read and write the whole file each time, changes are
+// applied one at a time and the report is written back once no further change
+// came in for flushDelay, see BuildReportRewriter for which members those are
+//
+// the report is only read again after someone else wrote it, changes that
+// weren't written yet are applied on top of the report that was read
+//
+// when every pending change replaced an existing md5 value the file is patched
+// in place at the offsets in hashIndex, anything else rewrites it entirely
+//
+// writes are optimistic, under the lock LunarHelper also takes for its own
+// writes the report's fingerprint is compared against the one of the report
+// the pending changes were made to, if someone else replaced it in the
+// meantime the pending changes are applied to the new report first
+class BuildReportStore
+{
+public:
+	using Change = std::function<void(json&)>;
+
+	// serves the report at reportPath from now on, pending changes to a
+	// previously enabled report are written first
+	static void enable(const fs::path& reportPath, std::chrono::milliseconds flushDelay);
+
+	// writes pending changes unless a write is already under way, for when the
+	// dll is unloaded and threads may have been stopped mid write
+	static void shutdown();
+
+	// true if there's a readable report
+	static bool isAvailable();
+
+	// false if there's no readable report, a change that throws is dropped,
+	// changes may only touch owned members
+	static bool update(const Change& change);
+	// sets object / key to an md5 hash, object is empty for a top level key
+	static bool updateHash(const std::string& object, const std::string& key, const std::string& hash);
+	// reader only sees the owned members
+	static bool read(const std::function<void(const json&)>& reader);
+
+	// writes pending changes right away
+	static bool flush();
+
+	// true if the report on disk isn't the one last read or written by the
+	// store, it's read again on next access
+	static bool checkForExternalWrite();
+
+private:
+	enum class SaveResult
+	{
+		Saved,
+		// someone else holds the lock, the save is retried later
+		LockBusy,
+		Failed
+	};
+
+	static bool ensureLoaded();
+	static bool load();
+	static bool applyChange(const Change& change);
+	static bool scheduleSave();
+	static SaveResult save();
+	static bool writeHashesInPlace();
+	static bool writeWhole();
+	static void runFlusher();
+
+	static inline std::mutex mutex{};
+	static inline std::condition_variable flushRequested{};
+	static inline bool flusherRunning = false;
+
+	static inline std::optional<fs::path> reportPath = std::nullopt;
+	static inline std::chrono::milliseconds flushDelay{ 0 };
+	static inline std::optional<json> report = std::nullopt;
+	static inline std::optional<FileFingerprint> knownFingerprint = std::nullopt;
+	static inline std::vector<Change> pendingChanges{};
+	static inline BuildReportHashIndex hashIndex{};
+	// offset and value of every pending change, as long as all of them can be written in place
+	static inline std::vector<std::pair<uint64_t, std::string>> pendingHashWrites{};
+	static inline bool needsWholeWrite = false;
+	static inline std::optional<std::chrono::steady_clock::time_point> flushDeadline = std::nullopt;
+};
@@ -1,121 +1,95 @@
 #include "BuildResultUpdater.h"
+#include "BuildReportRewriter.h"
+#include "HashCache.h"
+#include "Logger.h"
 
-std::optional<json> BuildResultUpdater::readInJson()
+std::optional<BuildIdentity> BuildResultUpdater::readBuildIdentity()
 {
-	if (!fs::exists(jsonPath))
-	{
-		return std::nullopt;
-	}
+	const std::optional<json> fields = BuildReportRewriter::readTopLevel(jsonPath, { "build_time", "rom_hash" });
 
-	std::ifstream i(jsonPath);
-	json j;
-	try
-	{
-		i >> j;
-	}
-	catch (const json::exception&)
+	if (!fields.has_value())
 	{
-		i.close();
 		return std::nullopt;
 	}
 
-	i.close();
+	const auto dumpField = [&](const char* key) {
+		const auto it = fields.value().find(key);
+		return it != fields.value().end() ? it->dump() : json().dump();
+	};
 
-	return j;
+	return BuildIdentity{ dumpField("build_time"), dumpField("rom_hash") };
 }
 
 bool BuildResultUpdater::updateLevelEntry(const std::string& entryName, const fs::path& mwlPath)
 {
-	if (!fs::exists(mwlPath))
+	// nothing gets hashed when there's no report to put the hash into
+	if (!fs::exists(mwlPath) || !BuildReportStore::isAvailable())
 	{
 		return false;
 	}
 
-	std::optional<json> j = readInJson();
+	const std::string hash = md5IfExists(mwlPath).value();
 
-	if (!j.has_value())
-	{
-		return false;
-	}
-
-	try
-	{
-		j.value()["levels"][entryName] = md5IfExists(mwlPath).value();
-	}
-	catch (const json::exception&)
-	{
-		return false;
-	}
-
-	std::ofstream o(jsonPath);
-	o << std::setw(2) << j.value();
-	o.close();
-
-	return true;
+	return BuildReportStore::updateHash("levels", entryName, hash);
 }
 
 bool BuildResultUpdater::updateAllLevelEntries(const fs::path& rootPath, const fs::path& levelDirectoryPath)
 {
-	if (!fs::exists(levelDirectoryPath))
+	// nothing gets hashed when there's no report to put the hash into
+	if (!fs::exists(levelDirectoryPath) || !BuildReportStore::isAvailable())
 	{
 		return false;
 	}
 
-	std::optional<json> j = readInJson();
+	std::vector<std::pair<std::string, std::string>> entries;
 
-	if (!j.has_value())
-	{
-		return false;
-	}
+	std::vector<fs::path> mwlPaths;
+	std::vector<std::string> mwlSubPaths;
 
-	try
+	for (const auto& mwlPath : fs::directory_iterator(levelDirectoryPath))
 	{
-		for (const auto& mwlPath : fs::directory_iterator(levelDirectoryPath))
-		{
-			std::string mwlSubPath = mwlPath.path().string().substr(rootPath.string().length() + 1, std::string::npos);
-			std::replace(mwlSubPath.begin(), mwlSubPath.end(), '\\', '/');
+		std::string mwlSubPath = mwlPath.path().string().substr(rootPath.string().length() + 1, std::string::npos);
+		std::replace(mwlSubPath.begin(), mwlSubPath.end(), '\\', '/');
 
-			j.value()["levels"][mwlSubPath] = md5IfExists(mwlPath).value();
+		if (mwlPath.is_directory())
+		{
+			entries.emplace_back(std::move(mwlSubPath), md5IfExists(mwlPath).value());
+			continue;
 		}
+
+		mwlPaths.push_back(mwlPath.path());
+		mwlSubPaths.push_back(std::move(mwlSubPath));
 	}
-	catch (const json::exception&)
+
+	// every level is hashed independently, so hash them as one batch
+	const std::vector<std::string> hashes = md5Files(mwlPaths);
+
+	for (size_t i = 0; i != hashes.size(); ++i)
 	{
-		return false;
+		entries.emplace_back(std::move(mwlSubPaths[i]), hashes[i]);
 	}
 
-	std::ofstream o(jsonPath);
-	o << std::setw(2) << j.value();
-	o.close();
+	Logger::log_message(L"Hash cache totals: %llu hits, %llu misses", HashCache::getHitCount(), HashCache::getMissCount());
 
-	return true;
-}
+	bool updatedAll = true;
 
-bool BuildResultUpdater::updateResourceEntry(const std::string& entryName, const fs::path& resourcePath)
-{
-	if (!fs::exists(resourcePath))
+	for (const auto& [subPath, hash] : entries)
 	{
-		return false;
+		updatedAll &= BuildReportStore::updateHash("levels", subPath, hash);
 	}
 
-	std::optional<json> j = readInJson();
-	
-	if (!j.has_value())
-	{
-		return false;
-	}
+	return updatedAll;
+}
 
-	try
-	{
-		j.value()[entryName] = md5IfExists(resourcePath).value();
-	}
-	catch (const json::exception&)
+bool BuildResultUpdater::updateResourceEntry(const std::string& entryName, const fs::path& resourcePath)
+{
+	// nothing gets hashed when there's no report to put the hash into
+	if (!fs::exists(resourcePath) || !BuildReportStore::isAvailable())
 	{
 		return false;
 	}
 
-	std::ofstream o(jsonPath);
-	o << std::setw(2) << j.value();
-	o.close();
+	const std::string hash = md5IfExists(resourcePath).value();
 
-	return true;
+	return BuildReportStore::updateHash("", entryName, hash);
 }
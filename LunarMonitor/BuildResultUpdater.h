@@ -9,14 +9,25 @@ namespace fs = std::filesystem;
 using json = nlohmann::json;
 
 #include "md5.h"
+#include "BuildReportStore.h"
 
 constexpr auto jsonPath = ".lunar_helper/build_report.json";
 
+// what identifies the ROM build the report was written for
+struct BuildIdentity
+{
+	std::string buildTime;
+	std::string romHash;
+};
+
 class BuildResultUpdater
 {
 	public:
 		static bool updateLevelEntry(const std::string& entryName, const fs::path& mwlPath);
 		static bool updateAllLevelEntries(const fs::path& rootPath, const fs::path& levelDirectoryPath);
 		static bool updateResourceEntry(const std::string& entryName, const fs::path& resourcePath);
-		static std::optional<json> readInJson();
+		// build_time and rom_hash of the report as dumped json, "null" for one
+		// that's missing, nullopt if there's no readable report, read straight
+		// from the file without parsing anything else
+		static std::optional<BuildIdentity> readBuildIdentity();
 };
@@ -12,6 +12,75 @@ static inline std::string trim_whitespace_dequote(const std::string& orig) {
 	return s;
 }
 
+static inline bool is_number(const std::string& s) {
+	return !s.empty() && std::all_of(s.begin(), s.end(), [](auto ch) { return std::isdigit(ch); });
+}
+
+// reads a comma separated list of key=value pairs into policy, keys that aren't
+// listed keep their defaults
+static void parse_tool_policy(const std::string& varName, const std::string& varVal, ProcessOptions& policy) {
+	const auto invalid = [&varName](const std::string& what) {
+		return std::runtime_error("Invalid " + what + " in " + varName + " valid keys are max_instances, priority, "
+			"io_priority, timeout and kill_on_exit");
+	};
+
+	size_t start = 0;
+
+	while (start <= varVal.size())
+	{
+		size_t end = varVal.find(',', start);
+		if (end == std::string::npos)
+			end = varVal.size();
+
+		const std::string entry = trim_whitespace_dequote(varVal.substr(start, end - start));
+		start = end + 1;
+
+		if (entry.empty())
+			continue;
+
+		const size_t separator = entry.find('=');
+		if (separator == std::string::npos)
+			throw invalid("entry \"" + entry + "\"");
+
+		const std::string key = trim_whitespace_dequote(entry.substr(0, separator));
+		const std::string value = trim_whitespace_dequote(entry.substr(separator + 1));
+
+		if (key == "max_instances"sv && is_number(value)) {
+			policy.maxInstances = std::stoul(value);
+		}
+		else if (key == "timeout"sv && is_number(value)) {
+			policy.timeout = std::chrono::milliseconds(std::stoul(value));
+		}
+		else if (key == "priority"sv && value == "idle"sv) {
+			policy.priority = ProcessPriority::Idle;
+		}
+		else if (key == "priority"sv && value == "below_normal"sv) {
+			policy.priority = ProcessPriority::BelowNormal;
+		}
+		else if (key == "priority"sv && value == "normal"sv) {
+			policy.priority = ProcessPriority::Normal;
+		}
+		else if (key == "priority"sv && value == "above_normal"sv) {
+			policy.priority = ProcessPriority::AboveNormal;
+		}
+		else if (key == "io_priority"sv && value == "very_low"sv) {
+			policy.ioPriority = IoPriority::VeryLow;
+		}
+		else if (key == "io_priority"sv && value == "low"sv) {
+			policy.ioPriority = IoPriority::Low;
+		}
+		else if (key == "io_priority"sv && value == "normal"sv) {
+			policy.ioPriority = IoPriority::Normal;
+		}
+		else if (key == "kill_on_exit"sv && (value == "true"sv || value == "false"sv)) {
+			policy.killOnExit = value == "true"sv;
+		}
+		else {
+			throw invalid("entry \"" + entry + "\"");
+		}
+	}
+}
+
 Config::Config(const fs::path& configFilePath)
 {
 	for (auto& option : configOptions)
@@ -150,6 +219,38 @@ void Config::setConfigVar(const std::string& varName, const std::string& varVal,
 			throw std::runtime_error("Invalid log level option, valid options are Warn, Log and Silent");
 		}
 	}
+	else if (varName == globalDataEncoderOption) {
+		if (varVal == "Native"sv) {
+			globalDataEncoder = GlobalDataEncoder::Native;
+		}
+		else if (varVal == "Flips"sv) {
+			globalDataEncoder = GlobalDataEncoder::Flips;
+		}
+		else {
+			throw std::runtime_error("Invalid global data encoder option, valid options are Native and Flips");
+		}
+	}
+	else if (varName == buildReportFlushDelayOption) {
+		if (varVal.empty() || !std::all_of(varVal.begin(), varVal.end(), [](auto ch) { return std::isdigit(ch); })) {
+			throw std::runtime_error("Invalid build report flush delay, expected a number of milliseconds");
+		}
+		buildReportFlushDelay = std::chrono::milliseconds(std::stoul(varVal));
+	}
+	else if (varName == exportDebounceDelayOption) {
+		if (varVal.empty() || !std::all_of(varVal.begin(), varVal.end(), [](auto ch) { return std::isdigit(ch); })) {
+			throw std::runtime_error("Invalid export debounce delay, expected a number of milliseconds");
+		}
+		exportDebounceDelay = std::chrono::milliseconds(std::stoul(varVal));
+	}
+	else if (varName == lunarMagicPolicyOption) {
+		parse_tool_policy(varName, varVal, lunarMagicPolicy);
+	}
+	else if (varName == flipsPolicyOption) {
+		parse_tool_policy(varName, varVal, flipsPolicy);
+	}
+	else if (varName == humanReadableMap16PolicyOption) {
+		parse_tool_policy(varName, varVal, humanReadableMap16Policy);
+	}
 	else
 	{
 		throw std::runtime_error("Invalid config var detected");
@@ -171,6 +272,34 @@ LogLevel Config::getLogLevel() const
 	return Logger::getLogLevel();
 }
 
+GlobalDataEncoder Config::getGlobalDataEncoder() const
+{
+	return globalDataEncoder;
+}
+
+std::chrono::milliseconds Config::getBuildReportFlushDelay() const
+{
+	return buildReportFlushDelay;
+}
+
+std::chrono::milliseconds Config::getExportDebounceDelay() const
+{
+	return exportDebounceDelay;
+}
+
+const ProcessOptions& Config::getToolPolicy(Tool tool) const
+{
+	switch (tool)
+	{
+	case Tool::Flips:
+		return flipsPolicy;
+	case Tool::HumanReadableMap16:
+		return humanReadableMap16Policy;
+	default:
+		return lunarMagicPolicy;
+	}
+}
+
 const fs::path& Config::getMap16Path() const
 {
 	return map16Path;
@@ -5,12 +5,30 @@
 #include <array>
 #include <tuple>
 #include <optional>
+#include <chrono>
 #include "Logger.h"
+#include "ProcessRunner.h"
 
 namespace fs = std::filesystem;
 
 using namespace std::string_view_literals;
 
+// how global data patches are created, Native diffs the ROMs in process while
+// Flips runs the FLIPS executable from flips_path like older versions did
+enum class GlobalDataEncoder
+{
+	Native,
+	Flips
+};
+
+// the external tools exports run, each has an execution policy of its own
+enum class Tool
+{
+	LunarMagic,
+	Flips,
+	HumanReadableMap16
+};
+
 class Config
 {
 
@@ -27,6 +45,11 @@ public:
 	const std::optional<const fs::path> getHumanReadableMap16DirectoryPath() const;
 	const fs::path& getLogFilePath() const;
 	LogLevel getLogLevel() const;
+	GlobalDataEncoder getGlobalDataEncoder() const;
+	std::chrono::milliseconds getBuildReportFlushDelay() const;
+	std::chrono::milliseconds getExportDebounceDelay() const;
+	// how the tool's processes are run, its group is the tool's name
+	const ProcessOptions& getToolPolicy(Tool tool) const;
 private:
 	enum class Optional : bool {
 		Yes = true,
@@ -38,7 +61,7 @@ private:
 	};
 	using OptionTuple = std::tuple<const std::string_view, Optional, Set>;
 	
-	static inline std::array<OptionTuple, 10> configOptions{ {
+	static inline std::array<OptionTuple, 16> configOptions{ {
 		{"level_directory:"sv, Optional::No, Set::No},
 		{"flips_path:"sv, Optional::No, Set::No},
 		{"map16_path:"sv, Optional::No, Set::No},
@@ -48,7 +71,13 @@ private:
 		{"human_readable_map16_cli_path:"sv, Optional::Yes, Set::No},
 		{"human_readable_map16_directory_path:"sv, Optional::Yes, Set::No},
 		{"log_path:"sv, Optional::Yes, Set::No},
-		{"log_level:"sv, Optional::Yes, Set::No}
+		{"log_level:"sv, Optional::Yes, Set::No},
+		{"global_data_encoder:"sv, Optional::Yes, Set::No},
+		{"build_report_flush_delay:"sv, Optional::Yes, Set::No},
+		{"export_debounce_delay:"sv, Optional::Yes, Set::No},
+		{"lunar_magic_cli_policy:"sv, Optional::Yes, Set::No},
+		{"flips_policy:"sv, Optional::Yes, Set::No},
+		{"human_readable_map16_cli_policy:"sv, Optional::Yes, Set::No}
 	}};
 
 	static inline const std::string_view& levelDirectoryOption = std::get<const std::string_view>(configOptions[0]);
@@ -61,6 +90,12 @@ private:
 	static inline const std::string_view& humanReadableMap16DirectoryOption = std::get<const std::string_view>(configOptions[7]);
 	static inline const std::string_view& logFilePathOption = std::get<const std::string_view>(configOptions[8]);
 	static inline const std::string_view& logLevelOption = std::get<const std::string_view>(configOptions[9]);
+	static inline const std::string_view& globalDataEncoderOption = std::get<const std::string_view>(configOptions[10]);
+	static inline const std::string_view& buildReportFlushDelayOption = std::get<const std::string_view>(configOptions[11]);
+	static inline const std::string_view& exportDebounceDelayOption = std::get<const std::string_view>(configOptions[12]);
+	static inline const std::string_view& lunarMagicPolicyOption = std::get<const std::string_view>(configOptions[13]);
+	static inline const std::string_view& flipsPolicyOption = std::get<const std::string_view>(configOptions[14]);
+	static inline const std::string_view& humanReadableMap16PolicyOption = std::get<const std::string_view>(configOptions[15]);
 
 	fs::path levelDirectory;
 	fs::path flipsPath;
@@ -70,6 +105,17 @@ private:
 	std::optional<fs::path> humanReadableMap16ExecutablePath = std::nullopt;
 	std::optional<fs::path> humanReadableMap16DirectoryPath = std::nullopt;
 	fs::path globalDataPath;
+	GlobalDataEncoder globalDataEncoder = GlobalDataEncoder::Native;
+	// how long the build report waits for further changes before it's written
+	std::chrono::milliseconds buildReportFlushDelay{ 500 };
+	// how long an export waits for further saves of the same resource before it runs
+	std::chrono::milliseconds exportDebounceDelay{ 250 };
+	// every Lunar Magic export loads the whole ROM and FLIPS reads two, so by
+	// default they run below the editor's priority and only a few at a time,
+	// level exports adapt how many of Lunar Magic's they use to the machine
+	ProcessOptions lunarMagicPolicy{ 0, std::chrono::milliseconds(600000), ProcessPriority::BelowNormal, IoPriority::Low, true, "lunar_magic_cli", 4 };
+	ProcessOptions flipsPolicy{ 0, std::chrono::milliseconds(300000), ProcessPriority::BelowNormal, IoPriority::Low, true, "flips", 1 };
+	ProcessOptions humanReadableMap16Policy{ 0, std::chrono::milliseconds(300000), ProcessPriority::BelowNormal, IoPriority::Low, true, "human_readable_map16_cli", 1 };
 
 	void setConfigVar(const std::string& varName, const std::string& varVal, const fs::path& basePath);
 };
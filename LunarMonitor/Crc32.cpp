@@ -0,0 +1,296 @@
+#include "Crc32.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	constexpr uint32_t POLYNOMIAL = 0xedb88320;
+
+	// below this a chunk isn't worth a thread of its own
+	constexpr size_t PARALLEL_MIN_CHUNK_SIZE = 512 * 1024;
+
+	// the folding loop needs at least one 64 byte block to start from
+	constexpr size_t PCLMUL_MIN_LENGTH = 64;
+
+	using SliceTables = std::array<std::array<uint32_t, 256>, 16>;
+
+	// tables[0] is the classic byte at a time table, tables[k] advances a byte
+	// that is followed by k more bytes in the same step
+	constexpr SliceTables makeSliceTables()
+	{
+		SliceTables tables{};
+
+		for (uint32_t i = 0; i != 256; ++i)
+		{
+			uint32_t crc = i;
+			for (int bit = 0; bit != 8; ++bit)
+				crc = (crc & 1) != 0 ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+			tables[0][i] = crc;
+		}
+
+		for (size_t k = 1; k != 16; ++k)
+		{
+			for (size_t i = 0; i != 256; ++i)
+				tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xff];
+		}
+
+		return tables;
+	}
+
+	constexpr SliceTables SLICE_TABLES = makeSliceTables();
+
+	uint32_t loadWord(const unsigned char* p)
+	{
+		// little-endian target, same byte order as the reflected crc
+		uint32_t word;
+		memcpy(&word, p, sizeof(word));
+		return word;
+	}
+
+	// crc is the raw (inverted) register value here and below
+	uint32_t updatePortable(uint32_t crc, const unsigned char* data, size_t length)
+	{
+		const SliceTables& t = SLICE_TABLES;
+
+		while (length >= 16)
+		{
+			const uint32_t w0 = loadWord(data) ^ crc;
+			const uint32_t w1 = loadWord(data + 4);
+			const uint32_t w2 = loadWord(data + 8);
+			const uint32_t w3 = loadWord(data + 12);
+
+			crc = t[15][w0 & 0xff] ^ t[14][(w0 >> 8) & 0xff] ^ t[13][(w0 >> 16) & 0xff] ^ t[12][w0 >> 24] ^
+				t[11][w1 & 0xff] ^ t[10][(w1 >> 8) & 0xff] ^ t[9][(w1 >> 16) & 0xff] ^ t[8][w1 >> 24] ^
+				t[7][w2 & 0xff] ^ t[6][(w2 >> 8) & 0xff] ^ t[5][(w2 >> 16) & 0xff] ^ t[4][w2 >> 24] ^
+				t[3][w3 & 0xff] ^ t[2][(w3 >> 8) & 0xff] ^ t[1][(w3 >> 16) & 0xff] ^ t[0][w3 >> 24];
+
+			data += 16;
+			length -= 16;
+		}
+
+		while (length-- != 0)
+			crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+
+		return crc;
+	}
+
+	// folding constants for the reflected polynomial, see Intel's "Fast CRC
+	// Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+	alignas(16) constexpr uint64_t K1K2[2] = { 0x0154442bd4, 0x01c6e41596 };
+	alignas(16) constexpr uint64_t K3K4[2] = { 0x01751997d0, 0x00ccaa009e };
+	alignas(16) constexpr uint64_t K5K0[2] = { 0x0163cd6124, 0x0000000000 };
+	alignas(16) constexpr uint64_t POLY_MU[2] = { 0x01db710641, 0x01f7011641 };
+
+	__m128i fold(__m128i x, __m128i k, __m128i next)
+	{
+		const __m128i low = _mm_clmulepi64_si128(x, k, 0x00);
+		const __m128i high = _mm_clmulepi64_si128(x, k, 0x11);
+		return _mm_xor_si128(_mm_xor_si128(high, low), next);
+	}
+
+	// folds four 16 byte lanes at a time until fewer than 64 bytes are left,
+	// then one lane at a time, length must be at least 64 and a multiple of 16
+	uint32_t updatePclmul(uint32_t crc, const unsigned char* data, size_t length)
+	{
+		const auto load = [](const unsigned char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); };
+
+		__m128i x1 = _mm_xor_si128(load(data), _mm_cvtsi32_si128(static_cast<int>(crc)));
+		__m128i x2 = load(data + 16);
+		__m128i x3 = load(data + 32);
+		__m128i x4 = load(data + 48);
+
+		data += 64;
+		length -= 64;
+
+		__m128i k = _mm_load_si128(reinterpret_cast<const __m128i*>(K1K2));
+
+		while (length >= 64)
+		{
+			x1 = fold(x1, k, load(data));
+			x2 = fold(x2, k, load(data + 16));
+			x3 = fold(x3, k, load(data + 32));
+			x4 = fold(x4, k, load(data + 48));
+
+			data += 64;
+			length -= 64;
+		}
+
+		k = _mm_load_si128(reinterpret_cast<const __m128i*>(K3K4));
+
+		x1 = fold(x1, k, x2);
+		x1 = fold(x1, k, x3);
+		x1 = fold(x1, k, x4);
+
+		while (length >= 16)
+		{
+			x1 = fold(x1, k, load(data));
+
+			data += 16;
+			length -= 16;
+		}
+
+		// 128 bits down to 64
+		const __m128i lowMask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+		x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+		x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+		k = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(K5K0));
+
+		x2 = _mm_srli_si128(x1, 4);
+		x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, lowMask), k, 0x00);
+		x1 = _mm_xor_si128(x1, x2);
+
+		// barrett reduction down to 32 bits
+		k = _mm_load_si128(reinterpret_cast<const __m128i*>(POLY_MU));
+
+		x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, lowMask), k, 0x10);
+		x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, lowMask), k, 0x00);
+		x1 = _mm_xor_si128(x1, x2);
+
+		return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+	}
+
+	bool cpuSupportsPclmul()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 1)) != 0 && (info[3] & (1 << 26)) != 0;
+#else
+		return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse2");
+#endif
+	}
+
+	// product of two polynomials modulo the crc polynomial, both reflected
+	uint32_t multiplyModP(uint32_t a, uint32_t b)
+	{
+		uint32_t product = 0;
+
+		for (uint32_t m = 1u << 31; m != 0; m >>= 1)
+		{
+			if ((a & m) != 0)
+			{
+				product ^= b;
+				if ((a & (m - 1)) == 0)
+					break;
+			}
+
+			b = (b & 1) != 0 ? (b >> 1) ^ POLYNOMIAL : b >> 1;
+		}
+
+		return product;
+	}
+
+	// x^(2^k) modulo the crc polynomial for every k
+	std::array<uint32_t, 32> makePowerTable()
+	{
+		std::array<uint32_t, 32> table{};
+
+		uint32_t power = 1u << 30; // x^1
+		for (uint32_t& entry : table)
+		{
+			entry = power;
+			power = multiplyModP(power, power);
+		}
+
+		return table;
+	}
+
+	// x^(n * 2^k) modulo the crc polynomial
+	uint32_t powerModP(uint64_t n, unsigned k)
+	{
+		static const std::array<uint32_t, 32> powers = makePowerTable();
+
+		uint32_t result = 1u << 31; // x^0
+		for (; n != 0; n >>= 1, ++k)
+		{
+			if ((n & 1) != 0)
+				result = multiplyModP(powers[k & 31], result);
+		}
+
+		return result;
+	}
+}
+
+Crc32::Backend Crc32::getBestBackend()
+{
+	static const Backend backend = cpuSupportsPclmul() ? Backend::Pclmul : Backend::Portable;
+	return backend;
+}
+
+uint32_t Crc32::compute(const void* data, size_t length, uint32_t crc)
+{
+	return compute(data, length, crc, getBestBackend());
+}
+
+uint32_t Crc32::compute(const void* data, size_t length, uint32_t crc, Backend backend)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint32_t state = ~crc;
+
+	if (backend == Backend::Pclmul && length >= PCLMUL_MIN_LENGTH)
+	{
+		const size_t folded = length & ~static_cast<size_t>(15);
+		state = updatePclmul(state, bytes, folded);
+		bytes += folded;
+		length -= folded;
+	}
+
+	return ~updatePortable(state, bytes, length);
+}
+
+uint32_t Crc32::combine(uint32_t firstCrc, uint32_t secondCrc, uint64_t secondLength)
+{
+	// shifting the first crc past the second chunk is a multiplication by
+	// x^(8 * secondLength), the second crc's own initial inversion cancels out
+	return multiplyModP(powerModP(secondLength, 3), firstCrc) ^ secondCrc;
+}
+
+uint32_t Crc32::computeParallel(const void* data, size_t length)
+{
+	const size_t maxChunks = std::max<size_t>(1, std::thread::hardware_concurrency());
+	const size_t chunkCount = std::min(maxChunks, length / PARALLEL_MIN_CHUNK_SIZE);
+
+	if (chunkCount <= 1)
+		return compute(data, length);
+
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	const size_t chunkSize = length / chunkCount;
+
+	std::vector<std::future<uint32_t>> chunks;
+	chunks.reserve(chunkCount - 1);
+
+	for (size_t i = 1; i != chunkCount; ++i)
+	{
+		const size_t begin = i * chunkSize;
+		const size_t end = i + 1 == chunkCount ? length : begin + chunkSize;
+
+		chunks.push_back(std::async(std::launch::async, [=] {
+			return compute(bytes + begin, end - begin);
+		}));
+	}
+
+	// the first chunk is done on this thread while the others run
+	uint32_t crc = compute(bytes, chunkSize);
+
+	for (size_t i = 1; i != chunkCount; ++i)
+	{
+		const size_t end = i + 1 == chunkCount ? length : (i + 1) * chunkSize;
+		crc = combine(crc, chunks[i - 1].get(), end - i * chunkSize);
+	}
+
+	return crc;
+}
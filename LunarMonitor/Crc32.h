@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// crc32 as used by zip, png and bps patches (reflected polynomial 0xedb88320)
+//
+// values returned are finished checksums, passing one back in as crc continues
+// the checksum over more data, so compute(b, nb, compute(a, na)) equals the crc
+// of a followed by b
+//
+// the backend is picked at runtime, carry-less multiplication folding where the
+// cpu supports PCLMULQDQ and slicing-by-16 table lookups everywhere else
+class Crc32
+{
+public:
+	enum class Backend
+	{
+		Portable,
+		Pclmul
+	};
+
+	static Backend getBestBackend();
+
+	static uint32_t compute(const void* data, size_t length, uint32_t crc = 0);
+	static uint32_t compute(const void* data, size_t length, uint32_t crc, Backend backend);
+
+	// crc of two adjacent chunks given the crc of each and the length of the second
+	static uint32_t combine(uint32_t firstCrc, uint32_t secondCrc, uint64_t secondLength);
+
+	// splits large buffers into chunks that are checksummed on separate threads
+	// and combined afterwards, small ones are checksummed on the calling thread
+	static uint32_t computeParallel(const void* data, size_t length);
+};
@@ -0,0 +1,41 @@
+#include "ExportAllPipeline.h"
+
+bool ExportAllPipeline::start(Executor executor, std::vector<ExportAllStage> stages, ProgressCallback onProgress, FinishedCallback onFinished)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (running)
+			return false;
+
+		running = true;
+	}
+
+	// the graph's state is kept alive by its queued tasks, it doesn't have to outlive this
+	ExportGraph graph{ L"Export all" };
+
+	for (ExportAllStage& stage : stages)
+		graph.addTask(std::move(stage.name), std::move(stage.task));
+
+	graph.onTaskEvent(std::move(onProgress));
+	graph.onDone([onFinished = std::move(onFinished)](bool succeeded, std::chrono::milliseconds took) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			running = false;
+		}
+
+		onFinished(succeeded, took);
+	});
+
+	graph.start(std::move(executor));
+
+	return true;
+}
+
+bool ExportAllPipeline::isRunning()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return running;
+}
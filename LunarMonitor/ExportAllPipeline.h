@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ExportGraph.h"
+
+struct ExportAllStage
+{
+	std::wstring name;
+	ExportGraph::Task task;
+};
+
+// runs Export All in the background on executor, its stages only
+// read the ROM and run at once, marking the ROM as fully exported once every
+// one of them succeeded is left to onFinished's receiver, since the editor may
+// be writing the ROM from its own thread
+//
+// nothing in here knows about the editor's windows, progress and the result
+// are handed to callbacks so Export All can be driven and timed headlessly
+// with stand in stages
+class ExportAllPipeline
+{
+public:
+	using ProgressCallback = ExportGraph::EventCallback;
+	using FinishedCallback = ExportGraph::DoneCallback;
+	using Executor = ExportGraph::Executor;
+
+	// false if an export all is still running, the callbacks are called on the
+	// executor's threads and should only hand what they get to the thread that's
+	// interested in it, once onFinished is called isRunning is false again
+	static bool start(Executor executor, std::vector<ExportAllStage> stages, ProgressCallback onProgress, FinishedCallback onFinished);
+
+	static bool isRunning();
+
+private:
+	static inline std::mutex mutex{};
+	static inline bool running = false;
+};
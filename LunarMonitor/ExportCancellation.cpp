@@ -0,0 +1,260 @@
+#include "ExportCancellation.h"
+
+#include "Logger.h"
+
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+
+namespace
+{
+	constexpr size_t MAX_LOGGED_OUTPUT = 1000;
+
+	// read at a time when comparing a staged file with the one it replaces
+	constexpr size_t COMPARE_CHUNK_SIZE = 64 * 1024;
+
+	bool sameContents(const fs::path& first, const fs::path& second)
+	{
+		std::error_code ec;
+
+		if (!fs::is_regular_file(second, ec) || fs::file_size(first, ec) != fs::file_size(second, ec) || ec)
+			return false;
+
+		std::ifstream firstStream(first, std::ios::binary);
+		std::ifstream secondStream(second, std::ios::binary);
+
+		if (!firstStream || !secondStream)
+			return false;
+
+		std::vector<char> firstChunk(COMPARE_CHUNK_SIZE);
+		std::vector<char> secondChunk(COMPARE_CHUNK_SIZE);
+
+		while (firstStream && secondStream)
+		{
+			firstStream.read(firstChunk.data(), firstChunk.size());
+			secondStream.read(secondChunk.data(), secondChunk.size());
+
+			if (firstStream.gcount() != secondStream.gcount() ||
+				!std::equal(firstChunk.begin(), firstChunk.begin() + firstStream.gcount(), secondChunk.begin()))
+			{
+				return false;
+			}
+		}
+
+		return firstStream.eof() && secondStream.eof();
+	}
+
+	void moveFile(const fs::path& from, const fs::path& to)
+	{
+		// copying is only needed for destinations outside the project, those may be on another drive
+		if (!MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED))
+			throw std::runtime_error("Failed to move staged export into place");
+	}
+}
+
+bool ExportCancellation::isCancelled() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return cancelled;
+}
+
+void ExportCancellation::throwIfCancelled() const
+{
+	if (isCancelled())
+		throw ExportCancelled();
+}
+
+void ExportCancellation::cancel()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	cancelled = true;
+
+	for (const ProcessRunner::ProcessId process : processes)
+		ProcessRunner::terminate(process);
+}
+
+void ExportCancellation::attach(ProcessRunner::ProcessId id)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// 0 never started
+	if (id == 0)
+		return;
+
+	processes.push_back(id);
+
+	// cancel came in while it was being started
+	if (cancelled)
+		ProcessRunner::terminate(id);
+}
+
+void ExportCancellation::detach(ProcessRunner::ProcessId id)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	processes.erase(std::remove(processes.begin(), processes.end(), id), processes.end());
+}
+
+std::optional<DWORD> ExportCancellation::runProcess(const std::wstring& commandLine, const ProcessOptions& options)
+{
+	throwIfCancelled();
+
+	std::promise<ProcessResult> exited;
+	std::future<ProcessResult> exit = exited.get_future();
+
+	const ProcessRunner::ProcessId id = ProcessRunner::start(commandLine, options,
+		[&exited](ProcessResult result) { exited.set_value(std::move(result)); });
+
+	attach(id);
+
+	const ProcessResult result = exit.get();
+
+	detach(id);
+
+	// it may have exited on its own right before it would have been terminated,
+	// its output is about to be replaced either way
+	throwIfCancelled();
+
+	if (result.status == ProcessStatus::TimedOut)
+	{
+		Logger::log_error(L"%s timed out after %u ms", commandLine.c_str(), static_cast<unsigned int>(options.timeout.value().count()));
+		return std::nullopt;
+	}
+
+	if (result.status != ProcessStatus::Exited)
+		return std::nullopt;
+
+	if (result.exitCode != 0)
+	{
+		// tools print why they failed, the exit code alone rarely says
+		const std::string& output = result.errorOutput.empty() ? result.output : result.errorOutput;
+		const std::wstring reason(output.begin(), output.begin() + std::min(output.size(), MAX_LOGGED_OUTPUT));
+
+		if (reason.empty())
+			Logger::log_error(L"%s exited with code %u", commandLine.c_str(), result.exitCode);
+		else
+			Logger::log_error(L"%s exited with code %u: \"%s\"", commandLine.c_str(), result.exitCode, reason.c_str());
+	}
+
+	return result.exitCode;
+}
+
+StagedOutput::StagedOutput(const fs::path& destination)
+	: destination(destination)
+{
+	fs::path root;
+	fs::path staging;
+
+	{
+		std::lock_guard<std::mutex> lock(rootMutex);
+		root = projectRoot;
+		staging = stagingDirectory;
+	}
+
+	const fs::path relative = destination.lexically_normal().lexically_relative(root.lexically_normal());
+
+	// marks the staged file or folder itself, never the folders above it, so a
+	// staged folder never holds another export's staged output, the extension
+	// is kept, the tools writing staged files may go by it
+	const std::wstring stagedName = destination.stem().wstring() + L".staged" + destination.extension().wstring();
+
+	// only until a config was loaded, nothing is exported before that
+	if (staging.empty())
+		path = fs::path(destination).concat(L".tmp");
+	// destinations outside the project are staged at the top, by name
+	else if (relative.empty() || *relative.begin() == L".." || relative == L".")
+		path = staging / stagedName;
+	else
+		path = staging / relative.parent_path() / stagedName;
+
+	std::error_code ec;
+	fs::create_directories(path.parent_path(), ec);
+
+	// left behind by an export that didn't get to clean up after itself
+	fs::remove_all(path, ec);
+}
+
+StagedOutput::~StagedOutput()
+{
+	std::error_code ec;
+	fs::remove_all(path, ec);
+}
+
+const fs::path& StagedOutput::getPath() const
+{
+	return path;
+}
+
+void StagedOutput::commit(StaleFiles staleFiles)
+{
+	if (fs::is_directory(path))
+	{
+		commitFolder(staleFiles);
+		return;
+	}
+
+	// the staged file is removed when this goes out of scope
+	if (sameContents(path, destination))
+		return;
+
+	moveFile(path, destination);
+}
+
+void StagedOutput::enable(const fs::path& root, const fs::path& staging)
+{
+	std::lock_guard<std::mutex> lock(rootMutex);
+
+	projectRoot = root;
+	stagingDirectory = staging;
+}
+
+void StagedOutput::commitFolder(StaleFiles staleFiles)
+{
+	std::error_code ec;
+
+	if (fs::exists(destination, ec) && !fs::is_directory(destination, ec))
+		fs::remove(destination, ec);
+
+	fs::create_directories(destination, ec);
+
+	if (!fs::is_directory(destination, ec))
+		throw std::runtime_error("Failed to create export folder");
+
+	// both are listed before anything is moved, the staged folder empties as files are moved out of it
+	std::vector<fs::path> stale;
+	std::vector<fs::directory_entry> staged;
+
+	if (staleFiles == StaleFiles::Remove)
+	{
+		for (const fs::directory_entry& entry : fs::recursive_directory_iterator(destination, ec))
+		{
+			if (!fs::exists(path / entry.path().lexically_relative(destination)))
+				stale.push_back(entry.path());
+		}
+	}
+
+	for (const fs::directory_entry& entry : fs::recursive_directory_iterator(path))
+		staged.push_back(entry);
+
+	// a file of a folder is replaced on its own, so a commit that fails halfway
+	// leaves a mix of both exports, the next export of the folder replaces it
+	for (const fs::directory_entry& entry : staged)
+	{
+		const fs::path target = destination / entry.path().lexically_relative(path);
+
+		if (entry.is_directory())
+		{
+			fs::create_directories(target, ec);
+			continue;
+		}
+
+		if (!sameContents(entry.path(), target))
+			moveFile(entry.path(), target);
+	}
+
+	for (const fs::path& entry : stale)
+		fs::remove_all(entry, ec);
+}
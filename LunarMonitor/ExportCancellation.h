@@ -0,0 +1,104 @@
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <Windows.h>
+
+#include "ProcessRunner.h"
+
+namespace fs = std::filesystem;
+
+// thrown out of an export that was cancelled, deliberately not a std::exception
+// so the exports' error handling, which restores the ROM's comment and logs a
+// failure, lets it through, a cancelled export didn't fail, a newer one of the
+// same resource replaces it
+class ExportCancelled
+{
+};
+
+// lets the scheduler stop an export once a newer export of the same resource
+// is queued, the export runs its child processes through runProcess so they can
+// be terminated and checks in with throwIfCancelled between steps
+class ExportCancellation
+{
+public:
+	ExportCancellation() = default;
+	ExportCancellation(const ExportCancellation&) = delete;
+	ExportCancellation& operator=(const ExportCancellation&) = delete;
+
+	bool isCancelled() const;
+	void throwIfCancelled() const;
+
+	// terminates the child processes the export is waiting on, if any
+	void cancel();
+
+	// lets cancel terminate a process that was started through ProcessRunner
+	// directly, it's terminated right away if the export was cancelled already,
+	// a process may be attached after it exited
+	void attach(ProcessRunner::ProcessId id);
+	void detach(ProcessRunner::ProcessId id);
+
+	// runs commandLine through ProcessRunner with the tool's policy and waits for
+	// it to exit, returns its exit code or nullopt if it couldn't be started or
+	// timed out, logs what it printed if it failed, throws ExportCancelled if the
+	// process was terminated by cancel or the export was cancelled before it started
+	std::optional<DWORD> runProcess(const std::wstring& commandLine, const ProcessOptions& options);
+
+private:
+	mutable std::mutex mutex{};
+	bool cancelled = false;
+	std::vector<ProcessRunner::ProcessId> processes{};
+};
+
+// an export's output, written to the project's staging folder first and only
+// moved into place by commit, so an export that's cancelled or fails halfway
+// never leaves a half written file or folder at the destination, and nothing
+// that's still being written sits where Lunar Helper or the build report pick
+// files up, whatever is left at the staged path is removed when this goes out
+// of scope
+enum class StaleFiles
+{
+	Remove,
+	// for exports that only write some of the folder's files
+	Keep
+};
+
+class StagedOutput
+{
+public:
+	explicit StagedOutput(const fs::path& destination);
+	~StagedOutput();
+
+	StagedOutput(const StagedOutput&) = delete;
+	StagedOutput& operator=(const StagedOutput&) = delete;
+
+	// where the export writes to
+	const fs::path& getPath() const;
+
+	// replaces the destination with what was written, file or folder, files
+	// whose contents didn't change are left alone so their file ids and write
+	// times, which the hash cache goes by, stay the same, throws
+	// std::runtime_error if something couldn't be moved into place
+	//
+	// staleFiles decides what happens to files of a destination folder that
+	// weren't written by this export
+	void commit(StaleFiles staleFiles = StaleFiles::Remove);
+
+	// staged outputs go under stagingDirectory, mirroring where their
+	// destination is within projectRoot
+	static void enable(const fs::path& projectRoot, const fs::path& stagingDirectory);
+
+private:
+	void commitFolder(StaleFiles staleFiles);
+
+	fs::path destination;
+	fs::path path;
+
+	static inline std::mutex rootMutex{};
+	static inline fs::path projectRoot{};
+	static inline fs::path stagingDirectory{};
+};
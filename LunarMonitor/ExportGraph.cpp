@@ -0,0 +1,321 @@
+#include "ExportGraph.h"
+
+#include "Logger.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+ExportGraph::ExportGraph(std::wstring name)
+	: state(std::make_shared<State>())
+{
+	state->name = std::move(name);
+}
+
+ExportGraph::TaskId ExportGraph::addTask(std::wstring name, Task task, std::vector<TaskId> dependencies)
+{
+	std::lock_guard<std::mutex> lock(state->mutex);
+
+	const TaskId id = state->tasks.size();
+
+	if (std::any_of(dependencies.begin(), dependencies.end(), [id](TaskId dependency) { return dependency >= id; }))
+		throw std::logic_error("Export task depends on a task that wasn't added before it");
+
+	GraphTask added;
+	added.name = std::move(name);
+	added.task = std::move(task);
+	added.dependencies = std::move(dependencies);
+
+	state->tasks.push_back(std::move(added));
+
+	return id;
+}
+
+void ExportGraph::onTaskEvent(EventCallback callback)
+{
+	std::lock_guard<std::mutex> lock(state->mutex);
+
+	state->onTaskEvent = std::move(callback);
+}
+
+void ExportGraph::onDone(DoneCallback callback)
+{
+	std::lock_guard<std::mutex> lock(state->mutex);
+
+	state->onDone = std::move(callback);
+}
+
+void ExportGraph::start(Executor executor)
+{
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+
+		state->executor = std::move(executor);
+		state->startedAt = std::chrono::steady_clock::now();
+
+		Logger::log_message(L"%s: starting %zu tasks", state->name.c_str(), state->tasks.size());
+
+		for (TaskId id = 0; id != state->tasks.size(); ++id)
+		{
+			// pending until one of them couldn't be queued, the rest are skipped then
+			if (state->tasks[id].dependencies.empty() && state->tasks[id].state == TaskState::Pending && !queue(state, id))
+				settle(*state, id, TaskState::Failed);
+		}
+
+		// an empty graph is done right away
+		complete(*state);
+	}
+
+	deliver(*state);
+}
+
+bool ExportGraph::waitFor(std::chrono::milliseconds timeout) const
+{
+	std::unique_lock<std::mutex> lock(state->mutex);
+
+	return state->done.wait_for(lock, timeout, [this] { return state->finished == state->tasks.size(); });
+}
+
+bool ExportGraph::succeeded() const
+{
+	std::lock_guard<std::mutex> lock(state->mutex);
+
+	return !state->failed && state->finished == state->tasks.size();
+}
+
+bool ExportGraph::queue(const std::shared_ptr<State>& state, TaskId id)
+{
+	state->tasks[id].state = TaskState::Queued;
+
+	if (!state->executor([state, id] { run(state, id); }))
+	{
+		Logger::log_error(L"%s: %s could not be queued", state->name.c_str(), state->tasks[id].name.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void ExportGraph::run(const std::shared_ptr<State>& state, TaskId id)
+{
+	GraphTask* task;
+	bool skipped;
+
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+
+		task = &state->tasks[id];
+
+		// another task failed while this one was queued
+		skipped = state->failed;
+
+		if (skipped)
+		{
+			finish(state, id, TaskState::Skipped);
+		}
+		else
+		{
+			task->state = TaskState::Running;
+			task->startedAt = std::chrono::steady_clock::now();
+
+			notify(*state, id, ExportTaskOutcome::Started);
+		}
+	}
+
+	deliver(*state);
+
+	if (skipped)
+		return;
+
+	// tasks aren't added once the graph started, so task stays valid
+	TaskState result = TaskState::Succeeded;
+
+	try
+	{
+		task->task(*task->cancellation);
+	}
+	catch (const ExportCancelled&)
+	{
+		result = TaskState::Cancelled;
+	}
+	catch (const std::exception& exc)
+	{
+		WhatWide what{ exc };
+		Logger::log_error(L"%s: %s failed with exception: \"%s\"", state->name.c_str(), task->name.c_str(), what.what());
+		result = TaskState::Failed;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+
+		finish(state, id, result);
+	}
+
+	deliver(*state);
+}
+
+void ExportGraph::finish(const std::shared_ptr<State>& state, TaskId id, TaskState result)
+{
+	settle(*state, id, result);
+
+	if (result == TaskState::Succeeded)
+	{
+		// dependencies are always added before their dependents
+		for (TaskId dependent = id + 1; dependent != state->tasks.size(); ++dependent)
+		{
+			GraphTask& candidate = state->tasks[dependent];
+
+			if (candidate.state != TaskState::Pending ||
+				std::find(candidate.dependencies.begin(), candidate.dependencies.end(), id) == candidate.dependencies.end())
+			{
+				continue;
+			}
+
+			const bool ready = std::all_of(candidate.dependencies.begin(), candidate.dependencies.end(), [&](TaskId dependency) {
+				return state->tasks[dependency].state == TaskState::Succeeded;
+			});
+
+			// a task that couldn't be queued fails the graph, which skips the
+			// dependents this loop didn't get to yet
+			if (ready && !state->failed && !queue(state, dependent))
+				settle(*state, dependent, TaskState::Failed);
+		}
+	}
+
+	complete(*state);
+}
+
+void ExportGraph::settle(State& state, TaskId id, TaskState result)
+{
+	GraphTask& task = state.tasks[id];
+
+	task.state = result;
+	task.finishedAt = std::chrono::steady_clock::now();
+	++state.finished;
+
+	notify(state, id, result == TaskState::Succeeded ? ExportTaskOutcome::Succeeded :
+		result == TaskState::Cancelled ? ExportTaskOutcome::Cancelled :
+		result == TaskState::Skipped ? ExportTaskOutcome::Skipped : ExportTaskOutcome::Failed);
+
+	if (result == TaskState::Failed || result == TaskState::Cancelled)
+		fail(state);
+}
+
+void ExportGraph::fail(State& state)
+{
+	if (state.failed)
+		return;
+
+	state.failed = true;
+
+	for (TaskId id = 0; id != state.tasks.size(); ++id)
+	{
+		GraphTask& task = state.tasks[id];
+
+		if (task.state == TaskState::Running)
+		{
+			task.cancellation->cancel();
+		}
+		else if (task.state == TaskState::Pending)
+		{
+			task.state = TaskState::Skipped;
+			task.finishedAt = std::chrono::steady_clock::now();
+			++state.finished;
+
+			notify(state, id, ExportTaskOutcome::Skipped);
+		}
+	}
+}
+
+void ExportGraph::complete(State& state)
+{
+	if (state.completed || state.finished != state.tasks.size())
+		return;
+
+	state.completed = true;
+
+	logTimings(state);
+
+	if (state.onDone)
+	{
+		const auto took = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - state.startedAt);
+
+		state.pending.push_back([onDone = state.onDone, succeeded = !state.failed, took] { onDone(succeeded, took); });
+	}
+
+	state.done.notify_all();
+}
+
+void ExportGraph::logTimings(const State& state)
+{
+	std::chrono::milliseconds combined{ 0 };
+
+	for (const GraphTask& task : state.tasks)
+	{
+		if (!task.startedAt.has_value())
+		{
+			Logger::log_message(L"%s: %s %s", state.name.c_str(), task.name.c_str(), outcomeName(task.state));
+			continue;
+		}
+
+		const auto took = std::chrono::duration_cast<std::chrono::milliseconds>(task.finishedAt.value() - task.startedAt.value());
+		combined += took;
+
+		Logger::log_message(L"%s: %s %s in %lld ms", state.name.c_str(), task.name.c_str(),
+			outcomeName(task.state), took.count());
+	}
+
+	const auto total = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - state.startedAt);
+
+	Logger::log_message(L"%s: %s in %lld ms, its tasks took %lld ms combined", state.name.c_str(),
+		state.failed ? L"failed" : L"done", total.count(), combined.count());
+}
+
+void ExportGraph::notify(State& state, TaskId id, ExportTaskOutcome outcome)
+{
+	if (!state.onTaskEvent)
+		return;
+
+	ExportTaskEvent event{ state.tasks[id].name, outcome, state.finished, state.tasks.size() };
+
+	state.pending.push_back([onTaskEvent = state.onTaskEvent, event = std::move(event)] { onTaskEvent(event); });
+}
+
+void ExportGraph::deliver(State& state)
+{
+	std::unique_lock<std::mutex> lock(state.mutex);
+
+	// whoever is delivering already picks up what was just queued, in order
+	if (state.delivering)
+		return;
+
+	state.delivering = true;
+
+	while (!state.pending.empty())
+	{
+		const std::function<void()> callback = std::move(state.pending.front());
+		state.pending.pop_front();
+
+		lock.unlock();
+		callback();
+		lock.lock();
+	}
+
+	state.delivering = false;
+}
+
+const wchar_t* ExportGraph::outcomeName(TaskState state)
+{
+	switch (state)
+	{
+	case TaskState::Succeeded:
+		return L"succeeded";
+	case TaskState::Failed:
+		return L"failed";
+	case TaskState::Cancelled:
+		return L"cancelled";
+	case TaskState::Skipped:
+		return L"skipped";
+	default:
+		return L"unfinished";
+	}
+}
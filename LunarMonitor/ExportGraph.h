@@ -0,0 +1,142 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ExportCancellation.h"
+
+enum class ExportTaskOutcome
+{
+	Started,
+	Succeeded,
+	Failed,
+	Cancelled,
+	Skipped
+};
+
+struct ExportTaskEvent
+{
+	std::wstring task;
+	ExportTaskOutcome outcome;
+	// tasks done or skipped so far, out of total
+	size_t finished;
+	size_t total;
+};
+
+// a set of export tasks and what each of them depends on, run by whatever
+// executor the graph is started with, in Lunar Magic the export scheduler's
+// workers as bulk jobs, so exports of what the user just saved still go first,
+// a task is queued as soon as every task it depends on succeeded, so tasks that
+// don't depend on each other run at the same time
+//
+// failures are shared, the first task to fail cancels the ones still running
+// and every task that didn't start yet is skipped, a task that depends on all
+// the others therefore only runs if every one of them succeeded, outputs are
+// staged so cancelled tasks leave the previous ones in place
+//
+// tasks that already succeeded aren't rolled back, each one's output is a
+// complete export of the ROM as it is, what a failed graph leaves behind is
+// outputs that are either current or as they were before it ran
+class ExportGraph
+{
+public:
+	using TaskId = size_t;
+	// throws to fail, ExportCancelled once cancelled
+	using Task = std::function<void(ExportCancellation&)>;
+	// called without the graph's lock held, one at a time and in the order the
+	// events happened, so they may call back into the graph
+	using EventCallback = std::function<void(const ExportTaskEvent&)>;
+	using DoneCallback = std::function<void(bool succeeded, std::chrono::milliseconds took)>;
+	// runs what it's handed later on some thread, false if it can't take it,
+	// which fails the task it was handed for
+	using Executor = std::function<bool(std::function<void()>)>;
+
+	// name is used in the logs
+	explicit ExportGraph(std::wstring name);
+
+	// dependencies have to be tasks added before this one
+	TaskId addTask(std::wstring name, Task task, std::vector<TaskId> dependencies = {});
+
+	// both have to be set before start, onTaskEvent is called as tasks start,
+	// finish or are skipped and onDone once every task is done or skipped, on
+	// whichever thread that happened on
+	void onTaskEvent(EventCallback callback);
+	void onDone(DoneCallback callback);
+
+	// queues the tasks that don't depend on anything on executor, may only be
+	// called once, whatever executor refers to has to outlive the graph's tasks
+	void start(Executor executor);
+
+	// waits up to timeout for every task to be done or skipped, true if they are
+	bool waitFor(std::chrono::milliseconds timeout) const;
+
+	// whether every task succeeded, only meaningful once waitFor returned true
+	bool succeeded() const;
+
+private:
+	enum class TaskState
+	{
+		Pending,
+		Queued,
+		Running,
+		Succeeded,
+		Failed,
+		Cancelled,
+		Skipped
+	};
+
+	struct GraphTask
+	{
+		std::wstring name;
+		Task task;
+		std::vector<TaskId> dependencies;
+		TaskState state = TaskState::Pending;
+		std::shared_ptr<ExportCancellation> cancellation = std::make_shared<ExportCancellation>();
+		std::optional<std::chrono::steady_clock::time_point> startedAt = std::nullopt;
+		std::optional<std::chrono::steady_clock::time_point> finishedAt = std::nullopt;
+	};
+
+	// shared with the executor's jobs so they never refer to a graph that's gone
+	struct State
+	{
+		std::wstring name;
+		Executor executor{};
+		std::mutex mutex{};
+		std::condition_variable done{};
+		std::vector<GraphTask> tasks{};
+		size_t finished = 0;
+		bool failed = false;
+		std::chrono::steady_clock::time_point startedAt{};
+		EventCallback onTaskEvent{};
+		DoneCallback onDone{};
+		// onDone was queued for delivery, it's only ever called once
+		bool completed = false;
+		// callbacks waiting to be called once the mutex is released
+		std::deque<std::function<void()>> pending{};
+		bool delivering = false;
+	};
+
+	// called with the state's mutex held, callbacks are only queued, deliver
+	// calls them once it's released
+	static bool queue(const std::shared_ptr<State>& state, TaskId id);
+	static void finish(const std::shared_ptr<State>& state, TaskId id, TaskState result);
+	static void settle(State& state, TaskId id, TaskState result);
+	static void fail(State& state);
+	static void complete(State& state);
+	static void logTimings(const State& state);
+	static void notify(State& state, TaskId id, ExportTaskOutcome outcome);
+	static const wchar_t* outcomeName(TaskState state);
+
+	// called without the state's mutex held
+	static void run(const std::shared_ptr<State>& state, TaskId id);
+	static void deliver(State& state);
+
+	std::shared_ptr<State> state;
+};
@@ -0,0 +1,92 @@
+#include "ExportJobRunner.h"
+
+#include "OnLevelSave.h"
+#include "OnMap16Save.h"
+#include "OnGlobalDataSave.h"
+#include "OnSharedPalettesSave.h"
+#include "Logger.h"
+
+std::vector<bool> ExportJobRunner::run(LM& lm, const std::vector<ExportJob>& jobs,
+	const std::vector<std::shared_ptr<ExportCancellation>>& cancellations)
+{
+	if (jobs.front().isLevelExport())
+		return runLevels(lm, jobs, cancellations);
+
+	return { runOne(lm, jobs.front(), *cancellations.front()) };
+}
+
+std::vector<bool> ExportJobRunner::runLevels(LM& lm, const std::vector<ExportJob>& jobs,
+	const std::vector<std::shared_ptr<ExportCancellation>>& cancellations)
+{
+	std::vector<SavedLevel> levels;
+
+	for (size_t i = 0; i != jobs.size(); ++i)
+		levels.push_back({ jobs[i].levelNumber, &jobs[i].config.value(), cancellations[i].get() });
+
+	if (jobs.size() > 1)
+		Logger::log_message(L"Exporting %zu saved levels at once", jobs.size());
+
+	std::vector<bool> finished(jobs.size(), true);
+
+	try
+	{
+		const std::vector<LevelExportOutcome> outcomes = OnLevelSave::onSuccessfulLevelSaves(lm, levels);
+
+		for (size_t i = 0; i != jobs.size(); ++i)
+		{
+			if (outcomes[i] == LevelExportOutcome::Cancelled)
+			{
+				Logger::log_message(L"Cancelled level export, a newer one replaces it");
+				finished[i] = false;
+			}
+		}
+	}
+	catch (const std::exception& exc)
+	{
+		WhatWide what{ exc };
+		Logger::log_error(L"Uncaught exception during level export, error was \"%s\"", what.what());
+	}
+
+	return finished;
+}
+
+bool ExportJobRunner::runOne(LM& lm, const ExportJob& job, ExportCancellation& cancellation)
+{
+	try
+	{
+		switch (job.type)
+		{
+		case ExportJobType::Level:
+			OnLevelSave::onLevelSave(job.succeeded, job.levelNumber, lm, job.config, cancellation);
+			break;
+
+		case ExportJobType::Map16:
+			OnMap16Save::onMap16Save(job.succeeded, lm, job.config, cancellation);
+			break;
+
+		case ExportJobType::GlobalData:
+			OnGlobalDataSave::onGlobalDataSave(job.succeeded, lm, job.config, cancellation);
+			break;
+
+		case ExportJobType::SharedPalettes:
+			OnSharedPalettesSave::onSharedPalettesSave(job.succeeded, lm, job.config, cancellation);
+			break;
+
+		case ExportJobType::Task:
+			job.task();
+			break;
+		}
+	}
+	catch (const ExportCancelled&)
+	{
+		Logger::log_message(L"Cancelled %s export, a newer one replaces it", job.name());
+		return false;
+	}
+	catch (const std::exception& exc)
+	{
+		WhatWide what{ exc };
+		Logger::log_error(L"Uncaught exception during %s export, error was \"%s\"", job.name(), what.what());
+	}
+
+	return true;
+}
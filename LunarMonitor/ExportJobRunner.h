@@ -0,0 +1,23 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "LM.h"
+#include "ExportScheduler.h"
+
+// the scheduler's runner in the monitor, runs the save hooks' exports against
+// the ROM lm has open, batches of level saves through the level exporter
+class ExportJobRunner
+{
+public:
+	// whether each job finished, false for the ones that were cancelled
+	static std::vector<bool> run(LM& lm, const std::vector<ExportJob>& jobs,
+		const std::vector<std::shared_ptr<ExportCancellation>>& cancellations);
+
+private:
+	// false if the job was cancelled
+	static bool runOne(LM& lm, const ExportJob& job, ExportCancellation& cancellation);
+	static std::vector<bool> runLevels(LM& lm, const std::vector<ExportJob>& jobs,
+		const std::vector<std::shared_ptr<ExportCancellation>>& cancellations);
+};
@@ -0,0 +1,413 @@
+#include "ExportScheduler.h"
+
+#include "Logger.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+	// exports mostly wait on Lunar Magic and FLIPS processes, running more of
+	// those at once than this only makes each of them slower
+	constexpr unsigned int MAX_WORKERS = 4;
+
+	// how long a ready bulk job waits behind interactive ones before it's
+	// treated as one of them
+	constexpr std::chrono::milliseconds BULK_AGING_DELAY{ 5000 };
+
+	// level exports the latency percentile is taken over
+	constexpr size_t LATENCY_SAMPLES = 200;
+
+	// queued level saves handed to the level exporter at once, the exporter
+	// decides how many of them actually run at the same time
+	constexpr size_t MAX_LEVEL_BATCH = 64;
+}
+
+bool ExportJobKey::operator==(const ExportJobKey& other) const
+{
+	return type == other.type && levelNumber == other.levelNumber && taskId == other.taskId;
+}
+
+ExportJobKey ExportJob::key() const
+{
+	return { type, type == ExportJobType::Level ? levelNumber : 0, type == ExportJobType::Task ? taskId : 0 };
+}
+
+ExportPriority ExportJob::priority() const
+{
+	switch (type)
+	{
+	case ExportJobType::Level:
+	case ExportJobType::SharedPalettes:
+		return ExportPriority::Interactive;
+
+	case ExportJobType::Task:
+		return taskPriority;
+
+	default:
+		return ExportPriority::Bulk;
+	}
+}
+
+const wchar_t* ExportJob::name() const
+{
+	switch (type)
+	{
+	case ExportJobType::Level:
+		return L"level";
+	case ExportJobType::Map16:
+		return L"map16";
+	case ExportJobType::GlobalData:
+		return L"global data";
+	case ExportJobType::SharedPalettes:
+		return L"shared palettes";
+	case ExportJobType::Task:
+		return L"task";
+	}
+
+	return L"unknown";
+}
+
+bool ExportJob::isLevelExport() const
+{
+	return type == ExportJobType::Level && succeeded && config.has_value();
+}
+
+void ExportScheduler::setRunner(Runner newRunner)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	runner = std::move(newRunner);
+}
+
+void ExportScheduler::setClock(Clock newClock)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	clock = std::move(newClock);
+}
+
+void ExportScheduler::setMaxWorkers(unsigned int workers)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	workerLimit = workers;
+}
+
+void ExportScheduler::clockChanged()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	jobQueued.notify_all();
+}
+
+bool ExportScheduler::enqueue(ExportJob job)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (stopping)
+	{
+		Logger::log_error(L"Dropped %s export, exports are shutting down", job.name());
+		return false;
+	}
+
+	if (!runner)
+	{
+		Logger::log_error(L"Dropped %s export, there's nothing to run it", job.name());
+		return false;
+	}
+
+	if (job.type == ExportJobType::Task)
+		job.taskId = nextTaskId++;
+
+	const auto now = clock();
+	const auto readyAt = now + (job.config.has_value() ? job.config.value().getExportDebounceDelay() : std::chrono::milliseconds::zero());
+
+	const auto pending = std::find_if(queue.begin(), queue.end(), [&](const QueuedJob& queued) {
+		return queued.job.key() == job.key();
+	});
+
+	// its output is about to be replaced anyway, unless this save failed and there won't be a new one
+	const auto running = std::find_if(runningJobs.begin(), runningJobs.end(), [&](const RunningJob& runningJob) {
+		return runningJob.key == job.key();
+	});
+
+	// a run that took over from a cancelled one is left to finish, so saving
+	// more often than an export takes can't keep its output from ever being written
+	if (running != runningJobs.end() && job.succeeded && running->mayCancel && !running->cancellation->isCancelled())
+	{
+		running->cancellation->cancel();
+		++counters.cancelled;
+
+		if (std::find(cancelledKeys.begin(), cancelledKeys.end(), job.key()) == cancelledKeys.end())
+			cancelledKeys.push_back(job.key());
+	}
+
+	if (pending != queue.end() && pending->job.succeeded && !job.succeeded)
+	{
+		// the ROM still holds what the earlier save wrote, so its export still
+		// has to run, there's nothing to export for the failed one
+		Logger::log_error(L"Saving %s to ROM failed, the export queued for the save before it is kept", job.name());
+		return true;
+	}
+
+	if (pending != queue.end())
+	{
+		// it keeps its place in the queue, the wait is counted from the newest save
+		*pending = { std::move(job), now, readyAt };
+		++counters.superseded;
+	}
+	else
+	{
+		queue.push_back({ std::move(job), now, readyAt });
+	}
+
+	counters.queued = queue.size();
+	counters.maxQueued = std::max(counters.maxQueued, counters.queued);
+
+	// one more worker for as long as there are fewer than jobs around
+	if (workerCount < maxWorkers() &&
+		workerCount < queue.size() + counters.running)
+	{
+		++workerCount;
+		std::thread(runWorker).detach();
+	}
+
+	jobQueued.notify_one();
+
+	return true;
+}
+
+bool ExportScheduler::drain(std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	if (!stopping)
+	{
+		stopping = true;
+		jobQueued.notify_all();
+	}
+
+	const bool drained = jobFinished.wait_for(lock, timeout, [] { return queue.empty() && counters.running == 0; });
+
+	if (!drained)
+	{
+		Logger::log_error(L"Exports still outstanding on shutdown, %zu queued and %zu running",
+			queue.size(), counters.running);
+	}
+
+	if (counters.completed != 0)
+	{
+		Logger::log_message(L"Ran %llu exports, skipped %llu superseded ones and cancelled %llu, average wait %lld ms, longest wait %lld ms, longest queue %zu, "
+			"level export p95 latency %lld ms",
+			counters.completed, counters.superseded, counters.cancelled, counters.totalWait.count() / static_cast<long long>(counters.completed),
+			counters.maxWait.count(), counters.maxQueued, counters.levelLatencyP95.count());
+	}
+
+	return drained;
+}
+
+bool ExportScheduler::waitForIdle(std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	return jobFinished.wait_for(lock, timeout, [] { return queue.empty() && counters.running == 0; });
+}
+
+bool ExportScheduler::hasPendingExports()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return std::any_of(queue.begin(), queue.end(), [](const QueuedJob& queued) { return queued.job.type != ExportJobType::Task; }) ||
+		std::any_of(runningJobs.begin(), runningJobs.end(), [](const RunningJob& running) { return running.key.type != ExportJobType::Task; });
+}
+
+ExportCounters ExportScheduler::getCounters()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return counters;
+}
+
+void ExportScheduler::runWorker()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		std::optional<std::chrono::steady_clock::time_point> nextCheckAt;
+		const auto now = clock();
+		const auto runnable = findRunnable(now, nextCheckAt);
+
+		if (runnable == queue.end())
+		{
+			// queued jobs are still run when stopping, drain waits for them
+			if (stopping && queue.empty())
+				break;
+
+			// waited for as long on the steady clock, a clock that's moved by hand
+			// calls clockChanged
+			if (nextCheckAt.has_value())
+				jobQueued.wait_for(lock, nextCheckAt.value() - now);
+			else
+				jobQueued.wait(lock);
+
+			continue;
+		}
+
+		std::vector<QueuedJob> batch;
+		batch.push_back(std::move(*runnable));
+		queue.erase(runnable);
+
+		// level saves that came in together are exported together, so the level
+		// exporter can run their Lunar Magic processes side by side
+		if (batch.front().job.isLevelExport())
+			takeLevelBatch(now, batch);
+
+		std::vector<ExportJob> jobs;
+		std::vector<std::shared_ptr<ExportCancellation>> cancellations;
+
+		for (QueuedJob& next : batch)
+		{
+			cancellations.push_back(std::make_shared<ExportCancellation>());
+			const bool mayCancel = std::find(cancelledKeys.begin(), cancelledKeys.end(), next.job.key()) == cancelledKeys.end();
+			runningJobs.push_back({ next.job.key(), next.job.priority(), cancellations.back(), mayCancel });
+
+			const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(now - next.queuedAt);
+
+			++counters.running;
+			counters.totalWait += wait;
+			counters.maxWait = std::max(counters.maxWait, wait);
+
+			jobs.push_back(std::move(next.job));
+		}
+
+		counters.queued = queue.size();
+
+		// the runner is only replaced before the first job
+		lock.unlock();
+		const std::vector<bool> finished = runner(jobs, cancellations);
+		lock.lock();
+
+		const auto finishedAt = clock();
+
+		for (size_t i = 0; i != jobs.size(); ++i)
+		{
+			if (finished[i] && jobs[i].type == ExportJobType::Level && jobs[i].succeeded)
+			{
+				// queuedAt is when the newest save it covers returned
+				recordLevelLatency(std::chrono::duration_cast<std::chrono::milliseconds>(finishedAt - batch[i].queuedAt));
+			}
+
+			if (finished[i])
+			{
+				const ExportJobKey key = jobs[i].key();
+				cancelledKeys.erase(std::remove(cancelledKeys.begin(), cancelledKeys.end(), key), cancelledKeys.end());
+			}
+
+			--counters.running;
+			++counters.completed;
+			runningJobs.erase(std::find_if(runningJobs.begin(), runningJobs.end(), [&](const RunningJob& runningJob) {
+				return runningJob.cancellation == cancellations[i];
+			}));
+		}
+
+		jobFinished.notify_all();
+		// a rerun with the same key may have been waiting for this one
+		jobQueued.notify_all();
+	}
+
+	--workerCount;
+}
+
+unsigned int ExportScheduler::maxWorkers()
+{
+	if (workerLimit != 0)
+		return workerLimit;
+
+	return std::clamp(std::thread::hardware_concurrency(), 1u, MAX_WORKERS);
+}
+
+std::deque<ExportScheduler::QueuedJob>::iterator ExportScheduler::findRunnable(std::chrono::steady_clock::time_point now,
+	std::optional<std::chrono::steady_clock::time_point>& nextCheckAt)
+{
+	const auto checkAt = [&](std::chrono::steady_clock::time_point at) {
+		if (!nextCheckAt.has_value() || at < nextCheckAt.value())
+			nextCheckAt = at;
+	};
+
+	const size_t runningBulk = std::count_if(runningJobs.begin(), runningJobs.end(), [](const RunningJob& runningJob) {
+		return runningJob.priority == ExportPriority::Bulk;
+	});
+
+	// with a single worker there's nothing to leave free
+	const bool bulkMayStart = runningBulk + 1 < std::max(maxWorkers(), 2u);
+
+	auto firstBulk = queue.end();
+
+	for (auto it = queue.begin(); it != queue.end(); ++it)
+	{
+		const bool keyRunning = std::any_of(runningJobs.begin(), runningJobs.end(), [&](const RunningJob& runningJob) {
+			return runningJob.key == it->job.key();
+		});
+
+		if (keyRunning)
+			continue;
+
+		// no point in waiting for further saves when shutting down
+		if (it->readyAt > now && !stopping)
+		{
+			checkAt(it->readyAt);
+			continue;
+		}
+
+		if (it->job.priority() == ExportPriority::Interactive || now - it->readyAt >= BULK_AGING_DELAY)
+			return it;
+
+		if (firstBulk == queue.end())
+			firstBulk = it;
+
+		checkAt(it->readyAt + BULK_AGING_DELAY);
+	}
+
+	if (firstBulk != queue.end() && (bulkMayStart || stopping))
+		return firstBulk;
+
+	return queue.end();
+}
+
+void ExportScheduler::takeLevelBatch(std::chrono::steady_clock::time_point now, std::vector<QueuedJob>& batch)
+{
+	for (auto it = queue.begin(); it != queue.end() && batch.size() < MAX_LEVEL_BATCH;)
+	{
+		const bool keyRunning = std::any_of(runningJobs.begin(), runningJobs.end(), [&](const RunningJob& runningJob) {
+			return runningJob.key == it->job.key();
+		});
+
+		if (!it->job.isLevelExport() || keyRunning || (it->readyAt > now && !stopping))
+		{
+			++it;
+			continue;
+		}
+
+		batch.push_back(std::move(*it));
+		it = queue.erase(it);
+	}
+}
+
+void ExportScheduler::recordLevelLatency(std::chrono::milliseconds latency)
+{
+	levelLatencies.push_back(latency);
+
+	if (levelLatencies.size() > LATENCY_SAMPLES)
+		levelLatencies.pop_front();
+
+	std::vector<std::chrono::milliseconds> sorted(levelLatencies.begin(), levelLatencies.end());
+	const auto p95 = sorted.begin() + (sorted.size() * 95) / 100;
+	std::nth_element(sorted.begin(), p95, sorted.end());
+
+	counters.levelLatencyP95 = *p95;
+
+	Logger::log_message(L"Level export done %lld ms after the save, p95 over the last %zu level exports is %lld ms",
+		latency.count(), levelLatencies.size(), counters.levelLatencyP95.count());
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "Config.h"
+#include "ExportCancellation.h"
+
+enum class ExportJobType
+{
+	Level,
+	Map16,
+	GlobalData,
+	SharedPalettes,
+	// runs task, used by ExportGraph
+	Task
+};
+
+// interactive jobs export what the user just saved in the editor and wait for
+// it, bulk jobs are the slow ones that export data shared by the whole ROM
+enum class ExportPriority
+{
+	Interactive,
+	Bulk
+};
+
+// the resource an export writes, two jobs with the same key produce the same
+// output so only the newer one has to run
+struct ExportJobKey
+{
+	ExportJobType type;
+	unsigned int levelNumber;
+	uint64_t taskId;
+
+	bool operator==(const ExportJobKey& other) const;
+};
+
+// everything an export needs from the moment Lunar Magic saved, taken by value
+// in the save hook so nothing refers to the hook's stack frame or to state
+// that may have changed by the time the job runs
+struct ExportJob
+{
+	ExportJobType type;
+	// whether Lunar Magic managed to save to the ROM
+	bool succeeded;
+	std::optional<Config> config;
+	// only used by level jobs
+	unsigned int levelNumber = 0;
+	// only used by task jobs, set by enqueue, tasks are never coalesced
+	uint64_t taskId = 0;
+	// only used by task jobs, handles its own errors
+	std::function<void()> task;
+	// only used by task jobs, the other types' priority follows from their type
+	ExportPriority taskPriority = ExportPriority::Interactive;
+
+	ExportJobKey key() const;
+	ExportPriority priority() const;
+	// for the log
+	const wchar_t* name() const;
+	// a successful level save, those are exported in batches
+	bool isLevelExport() const;
+};
+
+struct ExportCounters
+{
+	size_t queued = 0;
+	size_t running = 0;
+	size_t maxQueued = 0;
+	uint64_t completed = 0;
+	// jobs replaced by a newer one with the same key before they ran
+	uint64_t superseded = 0;
+	// running jobs cancelled because a newer one with the same key came in
+	uint64_t cancelled = 0;
+	// time jobs spent in the queue before a worker picked them up
+	std::chrono::milliseconds totalWait{ 0 };
+	std::chrono::milliseconds maxWait{ 0 };
+	// from a level save returning to its mwl and build report entry being
+	// written, over the most recent level exports
+	std::chrono::milliseconds levelLatencyP95{ 0 };
+};
+
+// runs exports on a fixed number of worker threads instead of a thread per
+// save, so a burst of saves never has more exports (and the Lunar Magic or
+// FLIPS processes they launch) going at once than there are workers
+//
+// interactive jobs are started before bulk ones and bulk jobs always leave
+// one worker free for them, jobs of the same priority run in the order they
+// were queued, a bulk job that's been ready for a while is treated as
+// interactive so a steady stream of level saves can't hold it back forever
+//
+// jobs are coalesced by key, a job queued while one with the same key is
+// still waiting replaces it, unless it's a failed save and the waiting one a
+// successful save whose export is still due, and a job only becomes ready once
+// no further job with its key came in for the config's export debounce delay,
+// a job whose key is already running waits for that run to finish, so every
+// key has at most one run going and one rerun after it, a successful save
+// cancels the run of its key that's going so the rerun gets to write sooner,
+// unless that run itself replaced a cancelled one
+//
+// a worker that picks up a level export takes every other level export that's
+// ready along with it and hands them to the runner together, the monitor's
+// runner gives them to the level exporter, which runs their Lunar Magic
+// processes side by side as far as its own limit allows
+class ExportScheduler
+{
+public:
+	using Clock = std::function<std::chrono::steady_clock::time_point()>;
+	// runs a job, or level exports taken together, and returns whether each one
+	// finished, false for the ones that were cancelled
+	using Runner = std::function<std::vector<bool>(const std::vector<ExportJob>& jobs,
+		const std::vector<std::shared_ptr<ExportCancellation>>& cancellations)>;
+
+	// what runs the jobs, set before the first one is queued
+	static void setRunner(Runner runner);
+
+	// the clock jobs become ready and age by and how many workers may be
+	// started, the steady clock and one per core up to a few by default, tests
+	// set them before the first job is queued to decide when things happen
+	static void setClock(Clock clock);
+	static void setMaxWorkers(unsigned int workers);
+
+	// has workers waiting for a job to become ready look at the clock again,
+	// for a clock that was moved instead of moving on its own
+	static void clockChanged();
+
+	// workers are started on first use, false if the job was dropped because
+	// the scheduler is draining or has no runner
+	static bool enqueue(ExportJob job);
+
+	// stops taking jobs and waits up to timeout for queued and running ones to
+	// finish, false if some didn't, those are logged
+	static bool drain(std::chrono::milliseconds timeout);
+
+	// waits up to timeout for the queue to be empty and nothing to run, unlike
+	// drain it keeps taking jobs, false if it timed out
+	static bool waitForIdle(std::chrono::milliseconds timeout);
+
+	// whether an export of a save is queued or running, task jobs don't count
+	static bool hasPendingExports();
+
+	static ExportCounters getCounters();
+
+private:
+	struct QueuedJob
+	{
+		ExportJob job;
+		std::chrono::steady_clock::time_point queuedAt;
+		std::chrono::steady_clock::time_point readyAt;
+	};
+
+	struct RunningJob
+	{
+		ExportJobKey key;
+		ExportPriority priority;
+		std::shared_ptr<ExportCancellation> cancellation;
+		// false if the previous run of its key was cancelled
+		bool mayCancel;
+	};
+
+	static unsigned int maxWorkers();
+
+	// job a worker should start next, queue.end() if there is none, otherwise
+	// nextCheckAt is set to when a job that's held back now may become runnable
+	static std::deque<QueuedJob>::iterator findRunnable(std::chrono::steady_clock::time_point now,
+		std::optional<std::chrono::steady_clock::time_point>& nextCheckAt);
+
+	static void runWorker();
+	// moves the level exports that may run now from the queue into batch
+	static void takeLevelBatch(std::chrono::steady_clock::time_point now, std::vector<QueuedJob>& batch);
+	static void recordLevelLatency(std::chrono::milliseconds latency);
+
+	static inline std::mutex mutex{};
+	static inline std::condition_variable jobQueued{};
+	static inline std::condition_variable jobFinished{};
+
+	static inline Runner runner{};
+	static inline Clock clock = [] { return std::chrono::steady_clock::now(); };
+	// zero picks it from the number of cores
+	static inline unsigned int workerLimit = 0;
+	static inline std::deque<QueuedJob> queue{};
+	static inline std::vector<RunningJob> runningJobs{};
+	// keys whose last run was cancelled and that haven't finished a run since
+	static inline std::vector<ExportJobKey> cancelledKeys{};
+	static inline size_t workerCount = 0;
+	static inline uint64_t nextTaskId = 1;
+	static inline bool stopping = false;
+	static inline ExportCounters counters{};
+	static inline std::deque<std::chrono::milliseconds> levelLatencies{};
+};
@@ -0,0 +1,431 @@
+#include "HashCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <Windows.h>
+
+constexpr char HASH_CACHE_MAGIC[4] = { 'L', 'M', 'H', 'C' };
+constexpr uint32_t HASH_CACHE_FORMAT_VERSION = 2;
+
+// the cache is dropped rather than grown past this, entries for deleted or
+// renamed files are never looked up again so this only bounds stale buildup
+constexpr size_t HASH_CACHE_MAX_ENTRIES = 1 << 16;
+
+bool FileFingerprint::operator==(const FileFingerprint& other) const
+{
+	return size == other.size && lastWriteTime == other.lastWriteTime &&
+		fileId == other.fileId && volumeSerial == other.volumeSerial;
+}
+
+bool FileFingerprint::operator!=(const FileFingerprint& other) const
+{
+	return !(*this == other);
+}
+
+namespace
+{
+	template <typename T>
+	void writeValue(std::ostream& out, T value)
+	{
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template <typename T>
+	bool readValue(std::istream& in, T& value)
+	{
+		return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	bool readString(std::istream& in, std::string& str)
+	{
+		uint16_t length;
+
+		if (!readValue(in, length))
+			return false;
+
+		str.assign(length, '\0');
+		return static_cast<bool>(in.read(str.data(), length));
+	}
+
+	void writeString(std::ostream& out, const std::string& str)
+	{
+		writeValue<uint16_t>(out, static_cast<uint16_t>(str.size()));
+		out.write(str.data(), str.size());
+	}
+
+	bool readFingerprint(std::istream& in, FileFingerprint& fingerprint)
+	{
+		return readValue(in, fingerprint.size) && readValue(in, fingerprint.lastWriteTime) &&
+			readValue(in, fingerprint.fileId) && readValue(in, fingerprint.volumeSerial);
+	}
+
+	void writeFingerprint(std::ostream& out, const FileFingerprint& fingerprint)
+	{
+		writeValue(out, fingerprint.size);
+		writeValue(out, fingerprint.lastWriteTime);
+		writeValue(out, fingerprint.fileId);
+		writeValue(out, fingerprint.volumeSerial);
+	}
+
+	// only the part of the md5 buffer that's in use is stored
+	bool readCheckpoint(std::istream& in, MD5::Checkpoint& checkpoint)
+	{
+		checkpoint = MD5::Checkpoint{};
+
+		if (!in.read(reinterpret_cast<char*>(checkpoint.state), sizeof(checkpoint.state)) ||
+			!readValue(in, checkpoint.count))
+		{
+			return false;
+		}
+
+		return static_cast<bool>(in.read(reinterpret_cast<char*>(checkpoint.buffer), checkpoint.bufferedLength()));
+	}
+
+	void writeCheckpoint(std::ostream& out, const MD5::Checkpoint& checkpoint)
+	{
+		out.write(reinterpret_cast<const char*>(checkpoint.state), sizeof(checkpoint.state));
+		writeValue(out, checkpoint.count);
+		out.write(reinterpret_cast<const char*>(checkpoint.buffer), checkpoint.bufferedLength());
+	}
+
+	bool hexToBytes(const std::string& hex, unsigned char out[16])
+	{
+		if (hex.size() != 32)
+			return false;
+
+		for (size_t i = 0; i != 16; ++i)
+		{
+			unsigned int byte;
+			if (sscanf(hex.c_str() + i * 2, "%2x", &byte) != 1)
+				return false;
+			out[i] = static_cast<unsigned char>(byte);
+		}
+
+		return true;
+	}
+
+	std::string bytesToHex(const unsigned char bytes[16])
+	{
+		char buf[33];
+		for (int i = 0; i < 16; i++)
+			sprintf(buf + i * 2, "%02x", bytes[i]);
+		buf[32] = 0;
+
+		return std::string(buf);
+	}
+}
+
+void HashCache::enable(const fs::path& path)
+{
+	std::lock_guard lock{ mutex };
+
+	if (cacheFilePath.has_value())
+	{
+		if (cacheFilePath.value() == path)
+			return;
+
+		save();
+	}
+
+	cacheFilePath = path;
+	load();
+}
+
+void HashCache::disable()
+{
+	std::lock_guard lock{ mutex };
+
+	if (cacheFilePath.has_value())
+		save();
+
+	cacheFilePath = std::nullopt;
+	entries.clear();
+	folders.clear();
+	dirty = false;
+}
+
+bool HashCache::isEnabled()
+{
+	std::lock_guard lock{ mutex };
+	return cacheFilePath.has_value();
+}
+
+std::optional<FileFingerprint> HashCache::getFingerprint(const fs::path& path)
+{
+	// no access rights requested, we only need the handle to query metadata,
+	// so this never touches file contents and works on files LM has open
+	HANDLE file = CreateFileW(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return std::nullopt;
+
+	BY_HANDLE_FILE_INFORMATION info;
+	const BOOL succeeded = GetFileInformationByHandle(file, &info);
+	CloseHandle(file);
+
+	if (!succeeded)
+		return std::nullopt;
+
+	FileFingerprint fingerprint;
+	fingerprint.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+	fingerprint.lastWriteTime = (static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) |
+		info.ftLastWriteTime.dwLowDateTime;
+	fingerprint.fileId = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+	fingerprint.volumeSerial = info.dwVolumeSerialNumber;
+
+	return fingerprint;
+}
+
+std::optional<std::string> HashCache::lookup(const fs::path& path, const FileFingerprint& fingerprint)
+{
+	const std::string key = normalize(path);
+
+	std::lock_guard lock{ mutex };
+
+	if (!cacheFilePath.has_value())
+		return std::nullopt;
+
+	const auto it = entries.find(key);
+
+	if (it == entries.end() || it->second.fingerprint != fingerprint)
+	{
+		++misses;
+		return std::nullopt;
+	}
+
+	++hits;
+	return bytesToHex(it->second.digest);
+}
+
+void HashCache::store(const fs::path& path, const FileFingerprint& fingerprint, const std::string& hexDigest)
+{
+	Entry entry;
+	entry.fingerprint = fingerprint;
+
+	if (!hexToBytes(hexDigest, entry.digest))
+		return;
+
+	const std::string key = normalize(path);
+
+	if (key.size() > UINT16_MAX)
+		return;
+
+	std::lock_guard lock{ mutex };
+
+	if (!cacheFilePath.has_value())
+		return;
+
+	if (entries.size() >= HASH_CACHE_MAX_ENTRIES && entries.find(key) == entries.end())
+		entries.clear();
+
+	entries[key] = entry;
+	dirty = true;
+}
+
+std::vector<FolderHashCheckpoint> HashCache::lookupFolder(const fs::path& rootPath)
+{
+	const std::string key = normalize(rootPath);
+
+	std::lock_guard lock{ mutex };
+
+	if (!cacheFilePath.has_value())
+		return {};
+
+	const auto it = folders.find(key);
+
+	if (it == folders.end())
+		return {};
+
+	return it->second;
+}
+
+void HashCache::storeFolder(const fs::path& rootPath, std::vector<FolderHashCheckpoint> checkpoints)
+{
+	const std::string key = normalize(rootPath);
+
+	if (key.size() > UINT16_MAX || checkpoints.size() > HASH_CACHE_MAX_ENTRIES)
+		return;
+
+	std::lock_guard lock{ mutex };
+
+	if (!cacheFilePath.has_value())
+		return;
+
+	folders[key] = std::move(checkpoints);
+	dirty = true;
+}
+
+bool HashCache::flush()
+{
+	std::lock_guard lock{ mutex };
+
+	if (!cacheFilePath.has_value())
+		return false;
+
+	return save();
+}
+
+uint64_t HashCache::getHitCount()
+{
+	return hits;
+}
+
+uint64_t HashCache::getMissCount()
+{
+	return misses;
+}
+
+std::string HashCache::normalize(const fs::path& path)
+{
+	std::error_code ec;
+	fs::path absolute = fs::absolute(path, ec);
+
+	if (ec)
+		absolute = path;
+
+	std::string normalized = absolute.lexically_normal().generic_u8string();
+
+	// windows paths are case insensitive
+	std::transform(normalized.begin(), normalized.end(), normalized.begin(),
+		[](unsigned char c) { return static_cast<char>(c < 0x80 ? ::tolower(c) : c); });
+
+	while (normalized.size() > 1 && normalized.back() == '/')
+		normalized.pop_back();
+
+	return normalized;
+}
+
+// format: magic, version, file entry count, then per file entry the length
+// prefixed utf-8 path followed by the fingerprint and the raw 16 byte digest,
+// then folder count and per folder its path, file count and per file the
+// relative path, fingerprint and md5 checkpoint taken after that file
+void HashCache::load()
+{
+	entries.clear();
+	folders.clear();
+	dirty = false;
+
+	std::ifstream in(cacheFilePath.value(), std::ios::binary);
+
+	if (!in)
+		return;
+
+	char magic[4];
+	uint32_t version, count;
+
+	if (!in.read(magic, sizeof(magic)) || memcmp(magic, HASH_CACHE_MAGIC, sizeof(magic)) != 0 ||
+		!readValue(in, version) || version != HASH_CACHE_FORMAT_VERSION || !readValue(in, count) ||
+		count > HASH_CACHE_MAX_ENTRIES)
+	{
+		return;
+	}
+
+	entries.reserve(count);
+
+	for (uint32_t i = 0; i != count; ++i)
+	{
+		std::string key;
+		Entry entry;
+
+		if (!readString(in, key) || !readFingerprint(in, entry.fingerprint) ||
+			!in.read(reinterpret_cast<char*>(entry.digest), sizeof(entry.digest)))
+		{
+			// truncated cache, whatever we can't trust gets rehashed
+			entries.clear();
+			return;
+		}
+
+		entries.emplace(std::move(key), entry);
+	}
+
+	uint32_t folderCount;
+
+	if (!readValue(in, folderCount))
+		return;
+
+	for (uint32_t i = 0; i != folderCount; ++i)
+	{
+		std::string key;
+		uint32_t fileCount;
+
+		if (!readString(in, key) || !readValue(in, fileCount) || fileCount > HASH_CACHE_MAX_ENTRIES)
+		{
+			folders.clear();
+			return;
+		}
+
+		std::vector<FolderHashCheckpoint> checkpoints(fileCount);
+
+		for (auto& checkpoint : checkpoints)
+		{
+			if (!readString(in, checkpoint.relativePath) || !readFingerprint(in, checkpoint.fingerprint) ||
+				!readCheckpoint(in, checkpoint.checkpoint))
+			{
+				folders.clear();
+				return;
+			}
+		}
+
+		folders.emplace(std::move(key), std::move(checkpoints));
+	}
+}
+
+bool HashCache::save()
+{
+	if (!dirty)
+		return true;
+
+	const fs::path& path = cacheFilePath.value();
+
+	if (!fs::exists(path.parent_path()))
+		return false;
+
+	fs::path tempPath = path;
+	tempPath += ".tmp";
+
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+
+		if (!out)
+			return false;
+
+		out.write(HASH_CACHE_MAGIC, sizeof(HASH_CACHE_MAGIC));
+		writeValue<uint32_t>(out, HASH_CACHE_FORMAT_VERSION);
+		writeValue<uint32_t>(out, static_cast<uint32_t>(entries.size()));
+
+		for (const auto& [key, entry] : entries)
+		{
+			writeString(out, key);
+			writeFingerprint(out, entry.fingerprint);
+			out.write(reinterpret_cast<const char*>(entry.digest), sizeof(entry.digest));
+		}
+
+		writeValue<uint32_t>(out, static_cast<uint32_t>(folders.size()));
+
+		for (const auto& [key, checkpoints] : folders)
+		{
+			writeString(out, key);
+			writeValue<uint32_t>(out, static_cast<uint32_t>(checkpoints.size()));
+
+			for (const auto& checkpoint : checkpoints)
+			{
+				writeString(out, checkpoint.relativePath);
+				writeFingerprint(out, checkpoint.fingerprint);
+				writeCheckpoint(out, checkpoint.checkpoint);
+			}
+		}
+
+		if (!out)
+			return false;
+	}
+
+	if (!MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+		return false;
+
+	dirty = false;
+	return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "md5.h"
+
+namespace fs = std::filesystem;
+
+// identifies one specific version of a file on disk without reading its contents
+struct FileFingerprint
+{
+	uint64_t size = 0;
+	uint64_t lastWriteTime = 0;
+	uint64_t fileId = 0;
+	uint32_t volumeSerial = 0;
+
+	bool operator==(const FileFingerprint& other) const;
+	bool operator!=(const FileFingerprint& other) const;
+};
+
+// md5 state of a folder hash right after one of its files was consumed, along
+// with everything needed to tell whether that file is still the same
+struct FolderHashCheckpoint
+{
+	std::string relativePath;
+	FileFingerprint fingerprint;
+	MD5::Checkpoint checkpoint;
+};
+
+// persistent cache of md5 digests keyed by normalized path and fingerprint, lets
+// md5File and md5Folder skip reading files that haven't changed since they were
+// last hashed, the cache stays disabled (and every lookup misses) until enable()
+// is called, so tools sharing md5.cpp don't write cache files anywhere
+class HashCache
+{
+public:
+	static void enable(const fs::path& cacheFilePath);
+	static void disable();
+	static bool isEnabled();
+
+	static std::optional<FileFingerprint> getFingerprint(const fs::path& path);
+
+	static std::optional<std::string> lookup(const fs::path& path, const FileFingerprint& fingerprint);
+	static void store(const fs::path& path, const FileFingerprint& fingerprint, const std::string& hexDigest);
+
+	// checkpoints of a folder hash in file order, one per file, so a rehash can
+	// resume from the last checkpoint before the first file that changed
+	static std::vector<FolderHashCheckpoint> lookupFolder(const fs::path& rootPath);
+	static void storeFolder(const fs::path& rootPath, std::vector<FolderHashCheckpoint> checkpoints);
+
+	// writes the cache to disk if it changed since it was loaded or last flushed
+	static bool flush();
+
+	static uint64_t getHitCount();
+	static uint64_t getMissCount();
+
+private:
+	struct Entry
+	{
+		FileFingerprint fingerprint;
+		unsigned char digest[16];
+	};
+
+	static std::string normalize(const fs::path& path);
+	static void load();
+	static bool save();
+
+	static inline std::mutex mutex{};
+	static inline std::optional<fs::path> cacheFilePath = std::nullopt;
+	static inline std::unordered_map<std::string, Entry> entries{};
+	static inline std::unordered_map<std::string, std::vector<FolderHashCheckpoint>> folders{};
+	static inline bool dirty = false;
+
+	static inline std::atomic<uint64_t> hits{ 0 };
+	static inline std::atomic<uint64_t> misses{ 0 };
+};
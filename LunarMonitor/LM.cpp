@@ -24,7 +24,9 @@ bool LM::WriteCommentToRom(const char* comment)
         rom.seekp(comment_pos);
         rom.write(comment, 0x20);
         rom.close();
-        return true;
+
+        // the stream doesn't throw, a ROM that couldn't be opened or written shows up here
+        return !rom.fail();
     }
     catch (std::exception)
     {
@@ -38,5 +40,12 @@ bool LM::WriteCommentToRom(const char* comment)
 
 bool LM::WriteOriginalCommentToRom()
 {
+    ++originalCommentWrites;
+
     return WriteCommentToRom(FISH);
 }
+
+uint64_t LM::getOriginalCommentWrites() const
+{
+    return originalCommentWrites;
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+
 #include "Paths.h"
 #include "LevelEditor.h"
 
@@ -8,10 +11,14 @@ class LM
 private:
 	const Paths paths{};
 	LevelEditor levelEditor{};
+	std::atomic<uint64_t> originalCommentWrites{ 0 };
 
 public:
 	const Paths& getPaths();
 	LevelEditor& getLevelEditor();
 	bool WriteCommentToRom(const char* comment);
+	// exports that fail mark the ROM as not fully exported through this
 	bool WriteOriginalCommentToRom();
+	// how often that happened, so Export All can tell an export failed while it ran
+	uint64_t getOriginalCommentWrites() const;
 };
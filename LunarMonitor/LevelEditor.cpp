@@ -1,7 +1,6 @@
 #include "LevelEditor.h"
 
 #include <sstream>
-#include <vector>
 #include <string>
 
 namespace fs = std::filesystem;
@@ -16,84 +15,36 @@ unsigned int LevelEditor::getLevelNumberBeingSaved()
 	return *reinterpret_cast<unsigned int*>(LM_CURR_LEVEL_NUMBER_BEING_SAVED);
 }
 
-bool LevelEditor::exportMwl(
-	const fs::path& lmExePath, const fs::path& romPath, 
-	const fs::path& mwlFilePath, unsigned int levelNumber
-)
+bool LevelEditor::exportAllMwls(const fs::path& lmExePath, const fs::path& romPath, const fs::path& mwlFilePath,
+	const ProcessOptions& lmPolicy, ExportCancellation& cancellation)
 {
-	std::wstringstream ws;
-
-	ws << '\"' << lmExePath.wstring() << "\" -ExportLevel \"" << romPath.wstring() <<
-		"\" \"" << mwlFilePath.wstring() << "\" " << std::hex << levelNumber;
-
-	std::wstring command = ws.str();
-	std::vector<wchar_t> buf(command.begin(), command.end());
-	buf.push_back(0);
-
-	STARTUPINFO si;
-	PROCESS_INFORMATION pi;
-
-	ZeroMemory(&si, sizeof(si));
-	si.cb = sizeof(si);
-	ZeroMemory(&pi, sizeof(pi));
-
-	if (!CreateProcess(NULL, buf.data(), NULL, NULL, false, 0, NULL, NULL, &si, &pi))
-	{
-		return false;
-	}
-
-	WaitForSingleObject(pi.hProcess, INFINITE);
-
-	DWORD exitCode;
-
-	GetExitCodeProcess(pi.hProcess, &exitCode);
+	const fs::path levelDirectoryPath = mwlFilePath.parent_path();
 
-	CloseHandle(pi.hProcess);
-	CloseHandle(pi.hThread);
+	// Lunar Magic writes straight into the folder it's given, a cancelled or
+	// failed export would leave some of the mwls half written
+	StagedOutput staged{ levelDirectoryPath };
+	fs::create_directories(staged.getPath());
 
-	return exitCode == 0;
-}
-
-bool LevelEditor::exportAllMwls(const fs::path& lmExePath, const fs::path& romPath, const fs::path& mwlFilePath)
-{
 	std::wstringstream ws;
 
 	ws << '\"' << lmExePath.wstring() << "\" -ExportMultLevels \"" << romPath.wstring() <<
-		"\" \"" << mwlFilePath.wstring() << "\" ";
+		"\" \"" << (staged.getPath() / mwlFilePath.filename()).wstring() << "\" ";
 
-	std::wstring command = ws.str();
-	std::vector<wchar_t> buf(command.begin(), command.end());
-	buf.push_back(0);
+	const std::optional<DWORD> exitCode = cancellation.runProcess(ws.str(), lmPolicy);
 
-	STARTUPINFO si;
-	PROCESS_INFORMATION pi;
-
-	ZeroMemory(&si, sizeof(si));
-	si.cb = sizeof(si);
-	ZeroMemory(&pi, sizeof(pi));
-
-	if (!CreateProcess(NULL, buf.data(), NULL, NULL, false, 0, NULL, NULL, &si, &pi))
+	if (!exitCode.has_value() || exitCode.value() != 0)
 	{
 		return false;
 	}
 
-	WaitForSingleObject(pi.hProcess, INFINITE);
-
-	DWORD exitCode;
+	cancellation.throwIfCancelled();
 
-	GetExitCodeProcess(pi.hProcess, &exitCode);
-
-	CloseHandle(pi.hProcess);
-	CloseHandle(pi.hThread);
-
-	if (exitCode != 0)
-	{
-		return false;
-	}
+	// the level folder may hold files that aren't Lunar Magic's
+	staged.commit(StaleFiles::Keep);
 
 	const fs::path rootPath = romPath.parent_path();
 
-	BuildResultUpdater::updateAllLevelEntries(rootPath, mwlFilePath.parent_path());
+	BuildResultUpdater::updateAllLevelEntries(rootPath, levelDirectoryPath);
 
 	return true;
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include "BuildResultUpdater.h"
 #include "Constants.h"
+#include "ExportCancellation.h"
 
 #include <filesystem>
 
@@ -11,12 +12,8 @@ class LevelEditor
 public:
 	static unsigned int getCurrLevelNumber();
 	static unsigned int getLevelNumberBeingSaved();
-	static bool exportMwl(
-		const fs::path& lmExePath, const fs::path& romPath,
-		const fs::path& mwlFilePath, unsigned int levelNumber
-	);
 	static bool exportAllMwls(const fs::path& lmExePath, const fs::path& romPath, 
-		const fs::path& mwlFilePath);
+		const fs::path& mwlFilePath, const ProcessOptions& lmPolicy, ExportCancellation& cancellation);
 	static bool exportMap16(const fs::path& map16Path);
 	static void reloadROM();
 };
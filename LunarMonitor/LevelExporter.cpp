@@ -0,0 +1,158 @@
+#include "LevelExporter.h"
+
+#include "Logger.h"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <sstream>
+
+namespace
+{
+	constexpr size_t MAX_LOGGED_OUTPUT = 1000;
+}
+
+std::vector<LevelExportOutcome> LevelExporter::exportLevels(const fs::path& lmExePath, const fs::path& romPath,
+	const std::vector<LevelExportRequest>& requests, const ProcessOptions& lmPolicy)
+{
+	std::vector<LevelExportOutcome> outcomes(requests.size(), LevelExportOutcome::Failed);
+	std::vector<std::optional<ProcessResult>> results(requests.size());
+	std::vector<ProcessRunner::ProcessId> processes(requests.size(), 0);
+	std::vector<std::unique_ptr<StagedOutput>> staged;
+
+	for (const LevelExportRequest& request : requests)
+		staged.push_back(std::make_unique<StagedOutput>(request.mwlPath));
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	controller.setMaxLimit(lmPolicy.maxInstances != 0 ? lmPolicy.maxInstances : MAX_CONCURRENT_EXPORTS);
+
+	size_t next = 0;
+	size_t finished = 0;
+
+	while (finished != requests.size())
+	{
+		while (next != requests.size() && running < controller.getLimit())
+		{
+			const size_t index = next++;
+			const LevelExportRequest& request = requests[index];
+
+			if (request.cancellation->isCancelled())
+			{
+				outcomes[index] = LevelExportOutcome::Cancelled;
+				++finished;
+				continue;
+			}
+
+			std::wstringstream ws;
+
+			ws << '\"' << lmExePath.wstring() << "\" -ExportLevel \"" << romPath.wstring() <<
+				"\" \"" << staged[index]->getPath().wstring() << "\" " << std::hex << request.levelNumber;
+
+			const auto startedAt = AimdController::Clock::now();
+
+			++running;
+			controller.onStarted(startedAt);
+
+			lock.unlock();
+
+			// called right away if it can't be started, so not with the lock held
+			const ProcessRunner::ProcessId id = ProcessRunner::start(ws.str(), lmPolicy,
+				[&, index, startedAt](ProcessResult result) {
+					const auto now = AimdController::Clock::now();
+					const bool exported = result.status == ProcessStatus::Exited && result.exitCode == 0;
+
+					std::error_code ec;
+					const uintmax_t written = exported ? fs::file_size(staged[index]->getPath(), ec) : 0;
+
+					std::lock_guard<std::mutex> exitLock(mutex);
+
+					--running;
+					controller.onFinished(now);
+
+					if (exported && !ec)
+						controller.addSample(now, std::chrono::duration_cast<std::chrono::milliseconds>(now - startedAt), written);
+
+					results[index] = std::move(result);
+					++finished;
+
+					// wakes exports waiting for a slot as well
+					levelExported.notify_all();
+				});
+
+			request.cancellation->attach(id);
+
+			lock.lock();
+			processes[index] = id;
+		}
+
+		if (finished != requests.size())
+			levelExported.wait(lock);
+	}
+
+	lock.unlock();
+
+	for (size_t i = 0; i != requests.size(); ++i)
+	{
+		const LevelExportRequest& request = requests[i];
+
+		request.cancellation->detach(processes[i]);
+
+		if (!results[i].has_value())
+			continue;
+
+		// it may have exited on its own right before it would have been terminated,
+		// its output is about to be replaced either way
+		if (request.cancellation->isCancelled())
+		{
+			outcomes[i] = LevelExportOutcome::Cancelled;
+			continue;
+		}
+
+		const ProcessResult& result = results[i].value();
+
+		if (result.status == ProcessStatus::TimedOut)
+		{
+			Logger::log_error(L"Lunar Magic timed out exporting level %X after %u ms", request.levelNumber,
+				static_cast<unsigned int>(lmPolicy.timeout.value().count()));
+			continue;
+		}
+
+		if (result.status != ProcessStatus::Exited)
+		{
+			Logger::log_error(L"Lunar Magic could not be started to export level %X", request.levelNumber);
+			continue;
+		}
+
+		if (result.exitCode != 0)
+		{
+			// Lunar Magic prints why it failed, the exit code alone rarely says
+			const std::string& output = result.errorOutput.empty() ? result.output : result.errorOutput;
+			const std::wstring reason(output.begin(), output.begin() + std::min(output.size(), MAX_LOGGED_OUTPUT));
+
+			Logger::log_error(L"Lunar Magic exited with code %u exporting level %X: \"%s\"", result.exitCode,
+				request.levelNumber, reason.c_str());
+			continue;
+		}
+
+		try
+		{
+			staged[i]->commit();
+			outcomes[i] = LevelExportOutcome::Exported;
+		}
+		catch (const std::runtime_error& err)
+		{
+			WhatWide what{ err };
+			Logger::log_error(L"Failed to export level %X: \"%s\"", request.levelNumber, what.what());
+		}
+	}
+
+	return outcomes;
+}
+
+size_t LevelExporter::getConcurrencyLimit()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return controller.getLimit();
+}
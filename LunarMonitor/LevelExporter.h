@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+#include "AimdController.h"
+#include "ExportCancellation.h"
+#include "ProcessRunner.h"
+
+namespace fs = std::filesystem;
+
+struct LevelExportRequest
+{
+	unsigned int levelNumber;
+	// the level's mwl file, replaced only once the export succeeded
+	fs::path mwlPath;
+	// cancels just this level
+	ExportCancellation* cancellation;
+};
+
+enum class LevelExportOutcome
+{
+	Exported,
+	Failed,
+	Cancelled
+};
+
+// exports levels through Lunar Magic's -ExportLevel, one process per level
+// and as many at once as an AIMD controller allows, which feels out how many
+// Lunar Magic processes the machine's disk and CPU can take before each of
+// them gets slower, every level export goes through here, the single ones
+// from level saves included, so the controller sees all of them and a level
+// set shares the slots with whatever else is being exported
+//
+// the processes are waited on by the process runner's reactor, a level set of
+// any size only occupies the thread that called exportLevels
+class LevelExporter
+{
+public:
+	// exports the levels and waits for all of them, outcomes are in the order
+	// of requests, lmPolicy's max_instances caps the controller, failures are
+	// logged
+	static std::vector<LevelExportOutcome> exportLevels(const fs::path& lmExePath, const fs::path& romPath,
+		const std::vector<LevelExportRequest>& requests, const ProcessOptions& lmPolicy);
+
+	static size_t getConcurrencyLimit();
+
+private:
+	// without a max_instances in the policy
+	static constexpr size_t MAX_CONCURRENT_EXPORTS = 8;
+
+	static inline std::mutex mutex{};
+	static inline std::condition_variable levelExported{};
+	static inline size_t running = 0;
+	static inline AimdController controller{ 1, MAX_CONCURRENT_EXPORTS };
+};
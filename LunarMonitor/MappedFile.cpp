@@ -0,0 +1,102 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+MappedFile::MappedFile(const fs::path& path)
+{
+	file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to open \"" + path.string() + "\"");
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || static_cast<unsigned long long>(fileSize.QuadPart) > SIZE_MAX)
+	{
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get size of \"" + path.string() + "\"");
+	}
+
+	viewSize = static_cast<size_t>(fileSize.QuadPart);
+
+	// empty files can't be mapped, they're just an empty span
+	if (viewSize == 0)
+		return;
+
+	mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (mapping != NULL)
+		view = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, viewSize));
+
+	if (view == nullptr)
+	{
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map \"" + path.string() + "\" into memory");
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (view != nullptr)
+		UnmapViewOfFile(view);
+	if (mapping != NULL)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+}
+
+const unsigned char* MappedFile::data() const
+{
+	return view;
+}
+
+size_t MappedFile::size() const
+{
+	return viewSize;
+}
+
+ByteSpan MappedFile::span() const
+{
+	return { view, viewSize };
+}
+
+std::vector<unsigned char> readFileSnapshot(const fs::path& path)
+{
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to open \"" + path.string() + "\"");
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || static_cast<unsigned long long>(fileSize.QuadPart) > SIZE_MAX)
+	{
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get size of \"" + path.string() + "\"");
+	}
+
+	std::vector<unsigned char> contents(static_cast<size_t>(fileSize.QuadPart));
+
+	size_t total = 0;
+	DWORD read = 0;
+
+	while (total != contents.size() &&
+		ReadFile(file, contents.data() + total, static_cast<DWORD>(contents.size() - total), &read, NULL) &&
+		read != 0)
+	{
+		total += read;
+	}
+
+	// a byte more would mean the file grew while it was read
+	unsigned char extra;
+	const bool grew = ReadFile(file, &extra, 1, &read, NULL) && read != 0;
+
+	CloseHandle(file);
+
+	if (total != contents.size() || grew)
+		throw std::runtime_error("\"" + path.string() + "\" changed while it was read");
+
+	return contents;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+#include <Windows.h>
+
+#include "Bps.h"
+
+namespace fs = std::filesystem;
+
+// read-only view of a whole file mapped into memory, the file stays open and
+// mapped for the lifetime of the object
+class MappedFile
+{
+public:
+	explicit MappedFile(const fs::path& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const unsigned char* data() const;
+	size_t size() const;
+	ByteSpan span() const;
+
+private:
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+	const unsigned char* view = nullptr;
+	size_t viewSize = 0;
+};
+
+// reads a whole file into memory, for files another process may write or resize
+// while we look at them, Lunar Magic can't resize a file we have a view of and
+// a view of a file that's truncated underneath us faults on access, throws
+// std::runtime_error if the file can't be read or changed size while it was
+std::vector<unsigned char> readFileSnapshot(const fs::path& path);
@@ -1,12 +1,15 @@
 #include "OnGlobalDataSave.h"
+#include "BpsEncoder.h"
+#include "BpsDecoder.h"
+#include "ExportScheduler.h"
 
 #include <sstream>
 
-void OnGlobalDataSave::onGlobalDataSave(bool succeeded, LM& lm, const std::optional<const Config>& config)
+void OnGlobalDataSave::onGlobalDataSave(bool succeeded, LM& lm, const std::optional<const Config>& config, ExportCancellation& cancellation)
 {
 	if (succeeded && config.has_value())
 	{
-		onSuccessfulGlobalDataSave(lm, config.value());
+		onSuccessfulGlobalDataSave(lm, config.value(), cancellation);
 	}
 	else
 	{
@@ -14,10 +17,10 @@ void OnGlobalDataSave::onGlobalDataSave(bool succeeded, LM& lm, const std::optio
 	}
 }
 
-void OnGlobalDataSave::onSuccessfulGlobalDataSave(LM& lm, const Config& config)
+void OnGlobalDataSave::onSuccessfulGlobalDataSave(LM& lm, const Config& config, ExportCancellation& cancellation)
 {
 	try {
-		exportBps(lm, config);
+		exportBps(lm, config, cancellation);
 	}
 	catch (const std::exception& exc)
 	{
@@ -27,25 +30,76 @@ void OnGlobalDataSave::onSuccessfulGlobalDataSave(LM& lm, const Config& config)
 	}
 }
 
-void OnGlobalDataSave::exportBps(LM& lm, const Config& config)
+void OnGlobalDataSave::exportBps(LM& lm, const Config& config, ExportCancellation& cancellation)
 {
 	fs::path romPath = lm.getPaths().getRomPath();
 
-	createBpsPatch(romPath, config.getCleanRomPath(), config.getGlobalDataPath(), config.getFlipsPath());
+	{
+		// a verification still reading the previous patch has to be done before it's replaced
+		std::lock_guard<std::mutex> lock(patchMutex);
+
+		cancellation.throwIfCancelled();
+
+		StagedOutput staged{ config.getGlobalDataPath() };
+
+		if (config.getGlobalDataEncoder() == GlobalDataEncoder::Flips)
+		{
+			createBpsPatch(romPath, config.getCleanRomPath(), staged.getPath(), config.getFlipsPath(),
+				config.getToolPolicy(Tool::Flips), cancellation);
+			staged.commit();
+		}
+		// builds on the current patch, nothing is written if the ROM didn't change since
+		else if (BpsEncoder::createPatchFile(config.getCleanRomPath(), romPath, config.getGlobalDataPath(), staged.getPath(),
+			[&cancellation] { cancellation.throwIfCancelled(); }))
+		{
+			staged.commit();
+		}
+	}
+
 	Logger::log_message(L"Successfully exported global data to \"%s\"", config.getGlobalDataPath().c_str());
 
+	verifyBpsInBackground(config.getCleanRomPath(), config.getGlobalDataPath());
+
 	if (BuildResultUpdater::updateResourceEntry("global_data", config.getGlobalDataPath()))
 	{
 		Logger::log_message(L"Successfully updated build report entry for global data");
 	}
 }
 
+void OnGlobalDataSave::verifyBpsInBackground(const fs::path& cleanRomPath, const fs::path& patchPath)
+{
+	ExportJob job{ ExportJobType::Task, true, std::nullopt };
+	// nobody waits on it, exports of saves go first
+	job.taskPriority = ExportPriority::Bulk;
+
+	// the ROM may have been saved again by the time this runs, so the patch is
+	// only checked against what it states about the ROM it was created from
+	job.task = [=]() {
+		std::lock_guard<std::mutex> lock(patchMutex);
+
+		try
+		{
+			BpsDecoder::verifyFile(cleanRomPath, patchPath);
+			Logger::log_message(L"Verified global data patch \"%s\"", patchPath.c_str());
+		}
+		catch (const std::exception& exc)
+		{
+			WhatWide what{ exc };
+			Logger::log_error(L"Global data patch \"%s\" failed verification: \"%s\"", patchPath.c_str(), what.what());
+		}
+	};
+
+	// dropped along with the other exports when shutting down
+	ExportScheduler::enqueue(std::move(job));
+}
+
 void OnGlobalDataSave::onFailedGlobalDataSave(LM& lm)
 {
 	Logger::log_error(L"Saving global data to ROM failed");
 }
 
-void OnGlobalDataSave::createBpsPatch(const fs::path& sourceRom, const fs::path& cleanRomPath, const fs::path& destinationPath, const fs::path& flipsExePath)
+void OnGlobalDataSave::createBpsPatch(const fs::path& sourceRom, const fs::path& cleanRomPath, const fs::path& destinationPath, const fs::path& flipsExePath,
+	const ProcessOptions& flipsPolicy, ExportCancellation& cancellation)
 {
 	std::wstringstream ws;
 
@@ -53,32 +107,14 @@ void OnGlobalDataSave::createBpsPatch(const fs::path& sourceRom, const fs::path&
 		cleanRomPath.wstring() << "\" \"" << sourceRom.wstring() << "\" \"" <<
 		destinationPath.wstring() << "\"";
 
-	std::wstring command = ws.str();
-	std::vector<wchar_t> buf(command.begin(), command.end());
-	buf.push_back(0);
+	const std::optional<DWORD> exitCode = cancellation.runProcess(ws.str(), flipsPolicy);
 
-	STARTUPINFO si;
-	PROCESS_INFORMATION pi;
-
-	ZeroMemory(&si, sizeof(si));
-	si.cb = sizeof(si);
-	ZeroMemory(&pi, sizeof(pi));
-
-	if (!CreateProcess(NULL, buf.data(), NULL, NULL, false, 0, NULL, NULL, &si, &pi))
+	if (!exitCode.has_value())
 	{
 		throw std::runtime_error("Failed to create FLIPS process");
 	}
 
-	WaitForSingleObject(pi.hProcess, INFINITE);
-
-	DWORD exitCode;
-
-	GetExitCodeProcess(pi.hProcess, &exitCode);
-
-	CloseHandle(pi.hProcess);
-	CloseHandle(pi.hThread);
-
-	if (exitCode != 0)
+	if (exitCode.value() != 0)
 	{
 		throw std::runtime_error("FLIPS failed to create bps patch");
 	}
@@ -3,8 +3,10 @@
 #include "LM.h"
 #include "Config.h"
 #include "BuildResultUpdater.h"
+#include "ExportCancellation.h"
 
 #include <filesystem>
+#include <mutex>
 #include <optional>
 
 namespace fs = std::filesystem;
@@ -12,10 +14,18 @@ namespace fs = std::filesystem;
 class OnGlobalDataSave
 {
 public:
-	static void onGlobalDataSave(bool succeeded, LM& lm, const std::optional<const Config>& config);
-	static void onSuccessfulGlobalDataSave(LM& lm, const Config& config);
+	static void onGlobalDataSave(bool succeeded, LM& lm, const std::optional<const Config>& config, ExportCancellation& cancellation);
+	static void onSuccessfulGlobalDataSave(LM& lm, const Config& config, ExportCancellation& cancellation);
 	static void onFailedGlobalDataSave(LM& lm);
-	static void exportBps(LM& lm, const Config& config);
+	static void exportBps(LM& lm, const Config& config, ExportCancellation& cancellation);
 private:
-	static void createBpsPatch(const fs::path& sourceRom, const fs::path& cleanRomPath, const fs::path& destinationPath, const fs::path& flipsExePath);
+	// queues a bulk export job that applies the freshly written patch to the
+	// clean ROM and logs an error if the patch is damaged or doesn't produce the
+	// target size and checksum it states, the ROM itself isn't opened
+	static void verifyBpsInBackground(const fs::path& cleanRomPath, const fs::path& patchPath);
+	static void createBpsPatch(const fs::path& sourceRom, const fs::path& cleanRomPath, const fs::path& destinationPath, const fs::path& flipsExePath,
+		const ProcessOptions& flipsPolicy, ExportCancellation& cancellation);
+
+	// held while the global data patch is written or verified
+	static inline std::mutex patchMutex{};
 };
@@ -3,11 +3,12 @@
 #include <sstream>
 #include <algorithm>
 
-void OnLevelSave::onLevelSave(bool succeeded, unsigned int savedLevelNumber, LM& lm, const std::optional<const Config>& config)
+void OnLevelSave::onLevelSave(bool succeeded, unsigned int savedLevelNumber, LM& lm, const std::optional<const Config>& config,
+    ExportCancellation& cancellation)
 {
     if (succeeded && config.has_value()) 
     {
-        onSuccessfulLevelSave(savedLevelNumber, lm, config.value());
+        onSuccessfulLevelSave(savedLevelNumber, lm, config.value(), cancellation);
     }
     else
     {
@@ -15,7 +16,64 @@ void OnLevelSave::onLevelSave(bool succeeded, unsigned int savedLevelNumber, LM&
     }
 }
 
-void OnLevelSave::onSuccessfulLevelSave(unsigned int savedLevelNumber, LM& lm, const Config& config)
+void OnLevelSave::onSuccessfulLevelSave(unsigned int savedLevelNumber, LM& lm, const Config& config, ExportCancellation& cancellation)
+{
+    const std::vector<LevelExportOutcome> outcomes = onSuccessfulLevelSaves(lm, { { savedLevelNumber, &config, &cancellation } });
+
+    if (outcomes.front() == LevelExportOutcome::Cancelled)
+        throw ExportCancelled();
+}
+
+std::vector<LevelExportOutcome> OnLevelSave::onSuccessfulLevelSaves(LM& lm, const std::vector<SavedLevel>& levels)
+{
+    fs::path romPath = lm.getPaths().getRomDir();
+    romPath += lm.getPaths().getRomName();
+
+    std::vector<LevelExportRequest> requests;
+
+    for (const SavedLevel& level : levels)
+        requests.push_back({ level.levelNumber, getMwlPath(*level.config, level.levelNumber), level.cancellation });
+
+    // the newest config's policy, they hardly ever differ within a batch
+    const std::vector<LevelExportOutcome> outcomes = LevelExporter::exportLevels(lm.getPaths().getLmExePath(), romPath,
+        requests, levels.back().config->getToolPolicy(Tool::LunarMagic));
+
+    const fs::path rootPath = lm.getPaths().getRomDir();
+
+    for (size_t i = 0; i != levels.size(); ++i)
+    {
+        const fs::path& mwlPath = requests[i].mwlPath;
+
+        switch (outcomes[i])
+        {
+        case LevelExportOutcome::Exported:
+        {
+            Logger::log_message(L"Successfully exported level to \"%s\"", mwlPath.c_str());
+
+            std::string mwlSubPath = mwlPath.string().substr(rootPath.string().length(), std::string::npos);
+            std::replace(mwlSubPath.begin(), mwlSubPath.end(), '\\', '/');
+
+            if (BuildResultUpdater::updateLevelEntry(mwlSubPath, mwlPath))
+            {
+                Logger::log_message(L"Successfully updated build report entry for level \"%s\"", mwlPath.c_str());
+            }
+            break;
+        }
+
+        case LevelExportOutcome::Failed:
+            lm.WriteOriginalCommentToRom();
+            Logger::log_error(L"Failed to export level");
+            break;
+
+        case LevelExportOutcome::Cancelled:
+            break;
+        }
+    }
+
+    return outcomes;
+}
+
+fs::path OnLevelSave::getMwlPath(const Config& config, unsigned int levelNumber)
 {
     fs::path mwlPath = config.getLevelDirectory();
     std::string mwlFileName = "level #.mwl";
@@ -25,7 +83,7 @@ void OnLevelSave::onSuccessfulLevelSave(unsigned int savedLevelNumber, LM& lm, c
     if (indexToInsertLvlNum != std::string::npos)
     {
         std::stringstream sstream;
-        sstream << std::hex << std::uppercase << lm.getLevelEditor().getLevelNumberBeingSaved() << std::nouppercase << std::dec;
+        sstream << std::hex << std::uppercase << levelNumber << std::nouppercase << std::dec;
         std::string lvlNumString = sstream.str();
 
         while (lvlNumString.size() != 3)
@@ -36,27 +94,7 @@ void OnLevelSave::onSuccessfulLevelSave(unsigned int savedLevelNumber, LM& lm, c
 
     mwlPath /= mwlFileName;
 
-    fs::path romPath = lm.getPaths().getRomDir();
-    romPath += lm.getPaths().getRomName();
-
-    if (lm.getLevelEditor().exportMwl(lm.getPaths().getLmExePath(), romPath, mwlPath, savedLevelNumber))
-    {
-        Logger::log_message(L"Successfully exported level to \"%s\"", mwlPath.c_str());
-
-        const fs::path rootPath = lm.getPaths().getRomDir();
-        std::string mwlSubPath = mwlPath.string().substr(rootPath.string().length(), std::string::npos);
-        std::replace(mwlSubPath.begin(), mwlSubPath.end(), '\\', '/');
-
-        if (BuildResultUpdater::updateLevelEntry(mwlSubPath, mwlPath))
-        {
-            Logger::log_message(L"Successfully updated build report entry for level \"%s\"", mwlPath.c_str());
-        }
-    }
-    else
-    {
-        lm.WriteOriginalCommentToRom();
-        Logger::log_error(L"Failed to export level");
-    }
+    return mwlPath;
 }
 
 void OnLevelSave::onFailedLevelSave(unsigned int savedLevelNumber, LM& lm)
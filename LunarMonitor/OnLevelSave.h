@@ -4,16 +4,34 @@
 #include "BuildResultUpdater.h"
 
 #include "Config.h"
+#include "ExportCancellation.h"
+#include "LevelExporter.h"
 #include <filesystem>
 #include <optional>
+#include <vector>
 
 namespace fs = std::filesystem;
 
+// a level Lunar Magic saved successfully, config and cancellation have to
+// outlive the export
+struct SavedLevel
+{
+	unsigned int levelNumber;
+	const Config* config;
+	ExportCancellation* cancellation;
+};
+
 class OnLevelSave
 {
 public:
-	static void onLevelSave(bool succeeded, unsigned int savedLevelNumber, LM& lm, const std::optional<const Config>& config);
+	static void onLevelSave(bool succeeded, unsigned int savedLevelNumber, LM& lm, const std::optional<const Config>& config,
+		ExportCancellation& cancellation);
+	// exports several saved levels at once, outcomes are in the order of levels,
+	// a cancelled level is left alone, its rerun exports it
+	static std::vector<LevelExportOutcome> onSuccessfulLevelSaves(LM& lm, const std::vector<SavedLevel>& levels);
+
+	static fs::path getMwlPath(const Config& config, unsigned int levelNumber);
 private:
-	static void onSuccessfulLevelSave(unsigned int savedLevelNumber, LM& lm, const Config& config);
+	static void onSuccessfulLevelSave(unsigned int savedLevelNumber, LM& lm, const Config& config, ExportCancellation& cancellation);
 	static void onFailedLevelSave(unsigned int savedLevelNumber, LM& lm);
 };
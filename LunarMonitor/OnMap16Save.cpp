@@ -1,10 +1,10 @@
 #include "OnMap16Save.h"
 
-void OnMap16Save::onMap16Save(bool succeeded, LM& lm, const std::optional<const Config>& config)
+void OnMap16Save::onMap16Save(bool succeeded, LM& lm, const std::optional<const Config>& config, ExportCancellation& cancellation)
 {
     if (succeeded && config.has_value()) 
     {
-		if (!onSuccessfulMap16Save(lm, config.value()))
+		if (!onSuccessfulMap16Save(lm, config.value(), cancellation))
 		{
 			lm.WriteOriginalCommentToRom();
 		}
@@ -15,13 +15,17 @@ void OnMap16Save::onMap16Save(bool succeeded, LM& lm, const std::optional<const
     }
 }
 
-bool OnMap16Save::onSuccessfulMap16Save(LM& lm, const Config& config)
+bool OnMap16Save::onSuccessfulMap16Save(LM& lm, const Config& config, ExportCancellation& cancellation)
 {
     fs::path romPath = lm.getPaths().getRomDir();
     romPath += lm.getPaths().getRomName();
 
-    if (lm.getLevelEditor().exportMap16(config.getMap16Path()))
+	StagedOutput stagedMap16{ config.getMap16Path() };
+
+    if (lm.getLevelEditor().exportMap16(stagedMap16.getPath()))
     {
+		cancellation.throwIfCancelled();
+
 		fs::path export_path;
         if (config.getHumanReadableMap16ExecutablePath().has_value()) 
 		{
@@ -32,38 +36,30 @@ bool OnMap16Save::onSuccessfulMap16Save(LM& lm, const Config& config)
 				export_path = config.getMap16Path().string().substr(0, extension);
 			}
 
+			StagedOutput stagedExport{ export_path };
+
 			std::wstringstream ws;
 			ws << config.getHumanReadableMap16ExecutablePath().value() << " --from-map16 " << 
-				config.getMap16Path() << " " << export_path;
-
-			std::wstring command = ws.str();
-			std::vector<wchar_t> buf(command.begin(), command.end());
-			buf.push_back(0);
+				stagedMap16.getPath() << " " << stagedExport.getPath();
 
-			STARTUPINFO si;
-			PROCESS_INFORMATION pi;
+			ProcessOptions policy = config.getToolPolicy(Tool::HumanReadableMap16);
+			policy.creationFlags |= CREATE_NO_WINDOW;
 
-			ZeroMemory(&si, sizeof(si));
-			si.cb = sizeof(si);
-			ZeroMemory(&pi, sizeof(pi));
+			const std::optional<DWORD> exitCode = cancellation.runProcess(ws.str(), policy);
 
-			if (!CreateProcess(NULL, buf.data(), NULL, NULL, false, CREATE_NO_WINDOW, NULL, NULL, &si, &pi))
+			if (!exitCode.has_value())
 			{
 				Logger::log_error(L"Failed to create human readable map16 executable process");
 				return false;
 			}
+			
+			if (exitCode.value() == 0) {
+				cancellation.throwIfCancelled();
 
-			WaitForSingleObject(pi.hProcess, INFINITE);
-
-			DWORD exitCode;
-
-			GetExitCodeProcess(pi.hProcess, &exitCode);
+				if (!commit(stagedMap16) || !commit(stagedExport))
+					return false;
 
-			CloseHandle(pi.hProcess);
-			CloseHandle(pi.hThread);
-			
-			if (exitCode == 0) {
-				Logger::log_message(L"Successfully exported and converted map16 to \"%s\"", export_path);
+				Logger::log_message(L"Successfully exported and converted map16 to \"%s\"", export_path.c_str());
 
 				if (BuildResultUpdater::updateResourceEntry("map16", export_path))
 				{
@@ -77,6 +73,9 @@ bool OnMap16Save::onSuccessfulMap16Save(LM& lm, const Config& config)
 			return false;
 		}
 
+		if (!commit(stagedMap16))
+			return false;
+
 		Logger::log_message(L"Successfully exported map16 to \"%s\"", config.getMap16Path().c_str());
 
 		if (BuildResultUpdater::updateResourceEntry("map16", config.getMap16Path()))
@@ -91,6 +90,21 @@ bool OnMap16Save::onSuccessfulMap16Save(LM& lm, const Config& config)
 	return false;
 }
 
+bool OnMap16Save::commit(StagedOutput& staged)
+{
+	try
+	{
+		staged.commit();
+		return true;
+	}
+	catch (const std::runtime_error& err)
+	{
+		WhatWide what{ err };
+		Logger::log_error(L"Failed to export map16: \"%s\"", what.what());
+		return false;
+	}
+}
+
 void OnMap16Save::onFailedMap16Save(LM& lm)
 {
     Logger::log_error(L"Saving map16 to ROM failed");
@@ -3,6 +3,7 @@
 #include "LM.h"
 #include "Config.h"
 #include "BuildResultUpdater.h"
+#include "ExportCancellation.h"
 
 #include <filesystem>
 #include <optional>
@@ -14,8 +15,10 @@ namespace fs = std::filesystem;
 class OnMap16Save
 {
 public:
-	static void onMap16Save(bool succeeded, LM& lm, const std::optional<const Config>& config);
-	static bool onSuccessfulMap16Save(LM& lm, const Config& config);
+	static void onMap16Save(bool succeeded, LM& lm, const std::optional<const Config>& config, ExportCancellation& cancellation);
+	static bool onSuccessfulMap16Save(LM& lm, const Config& config, ExportCancellation& cancellation);
 private:
 	static void onFailedMap16Save(LM& lm);
+	// logs why if the staged output couldn't be moved into place
+	static bool commit(StagedOutput& staged);
 };
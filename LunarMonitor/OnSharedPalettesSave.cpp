@@ -2,11 +2,11 @@
 
 #include <sstream>
 
-void OnSharedPalettesSave::onSharedPalettesSave(bool succeeded, LM& lm, const std::optional<const Config>& config)
+void OnSharedPalettesSave::onSharedPalettesSave(bool succeeded, LM& lm, const std::optional<const Config>& config, ExportCancellation& cancellation)
 {
 	if (succeeded && config.has_value())
 	{
-		onSuccessfulSharedPalettesSave(lm, config.value());
+		onSuccessfulSharedPalettesSave(lm, config.value(), cancellation);
 	}
 	else
 	{
@@ -14,13 +14,14 @@ void OnSharedPalettesSave::onSharedPalettesSave(bool succeeded, LM& lm, const st
 	}
 }
 
-void OnSharedPalettesSave::onSuccessfulSharedPalettesSave(LM& lm, const Config& config)
+void OnSharedPalettesSave::onSuccessfulSharedPalettesSave(LM& lm, const Config& config, ExportCancellation& cancellation)
 {
 	try {
 		fs::path romPath = lm.getPaths().getRomDir();
 		romPath += lm.getPaths().getRomName();
 
-		exportSharedPalettes(romPath, config.getSharedPalettesPath(), lm.getPaths().getLmExePath());
+		exportSharedPalettes(romPath, config.getSharedPalettesPath(), lm.getPaths().getLmExePath(),
+			config.getToolPolicy(Tool::LunarMagic), cancellation);
 		Logger::log_message(L"Successfully exported shared palettes to \"%s\"", config.getSharedPalettesPath().c_str());
 
 		if (BuildResultUpdater::updateResourceEntry("shared_palettes", config.getSharedPalettesPath()))
@@ -41,40 +42,27 @@ void OnSharedPalettesSave::onFailedSharedPalettesSave(LM& lm)
 	Logger::log_error(L"Saving shared palettes to ROM failed");
 }
 
-void OnSharedPalettesSave::exportSharedPalettes(const fs::path& sourceRom, const fs::path& sharedPalettesPath, const fs::path& lmExePath)
+void OnSharedPalettesSave::exportSharedPalettes(const fs::path& sourceRom, const fs::path& sharedPalettesPath, const fs::path& lmExePath,
+	const ProcessOptions& lmPolicy, ExportCancellation& cancellation)
 {
-	std::wstringstream ws;
-
-	ws << '\"' << lmExePath.wstring() << "\" -ExportSharedPalette \"" << sourceRom.wstring() << "\" \"" << sharedPalettesPath.wstring() << "\"";
+	StagedOutput staged{ sharedPalettesPath };
 
-	std::wstring command = ws.str();
-	std::vector<wchar_t> buf(command.begin(), command.end());
-	buf.push_back(0);
+	std::wstringstream ws;
 
-	STARTUPINFO si;
-	PROCESS_INFORMATION pi;
+	ws << '\"' << lmExePath.wstring() << "\" -ExportSharedPalette \"" << sourceRom.wstring() << "\" \"" << staged.getPath().wstring() << "\"";
 
-	ZeroMemory(&si, sizeof(si));
-	si.cb = sizeof(si);
-	ZeroMemory(&pi, sizeof(pi));
+	const std::optional<DWORD> exitCode = cancellation.runProcess(ws.str(), lmPolicy);
 
-	if (!CreateProcess(NULL, buf.data(), NULL, NULL, false, 0, NULL, NULL, &si, &pi))
+	if (!exitCode.has_value())
 	{
 		throw std::runtime_error("Failed to create Lunar Magic process to export shared palettes");
 	}
 
-	WaitForSingleObject(pi.hProcess, INFINITE);
-
-	DWORD exitCode;
-
-	GetExitCodeProcess(pi.hProcess, &exitCode);
-
-	CloseHandle(pi.hProcess);
-	CloseHandle(pi.hThread);
-
-	if (exitCode != 0)
+	if (exitCode.value() != 0)
 	{
 		throw std::runtime_error("Lunar Magic failed to export shared palettes");
 	}
+
+	staged.commit();
 }
 
@@ -6,15 +6,17 @@
 #include <optional>
 
 #include "BuildResultUpdater.h"
+#include "ExportCancellation.h"
 
 namespace fs = std::filesystem;
 
 class OnSharedPalettesSave
 {
 public:
-	static void onSharedPalettesSave(bool succeeded, LM& lm, const std::optional<const Config>& config);
-	static void exportSharedPalettes(const fs::path& sourceRom, const fs::path& sharedPalettesPath, const fs::path& lmExePath);
+	static void onSharedPalettesSave(bool succeeded, LM& lm, const std::optional<const Config>& config, ExportCancellation& cancellation);
+	static void exportSharedPalettes(const fs::path& sourceRom, const fs::path& sharedPalettesPath, const fs::path& lmExePath,
+		const ProcessOptions& lmPolicy, ExportCancellation& cancellation);
 private:
-	static void onSuccessfulSharedPalettesSave(LM& lm, const Config& config);
+	static void onSuccessfulSharedPalettesSave(LM& lm, const Config& config, ExportCancellation& cancellation);
 	static void onFailedSharedPalettesSave(LM& lm);
 };
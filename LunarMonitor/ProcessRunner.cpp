@@ -0,0 +1,902 @@
+#include "ProcessRunner.h"
+
+#include <algorithm>
+#include <array>
+#include <future>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace
+{
+	// a child's output isn't needed past this, the rest is read and dropped
+	constexpr size_t MAX_CAPTURED_OUTPUT = 1024 * 1024;
+
+	// a process that handed its pipes down to a process of its own won't close
+	// them on exit, its output is only waited for this long after it exited
+	constexpr std::chrono::milliseconds OUTPUT_GRACE_PERIOD{ 500 };
+
+	constexpr size_t PIPE_BUFFER_SIZE = 4096;
+
+	void appendOutput(std::string& target, const char* data, size_t size)
+	{
+		target.append(data, std::min(size, MAX_CAPTURED_OUTPUT - std::min(target.size(), MAX_CAPTURED_OUTPUT)));
+	}
+
+#ifdef _WIN32
+	// the reactor waits on one handle to be woken up and three per child
+	constexpr size_t MAX_CHILDREN = (MAXIMUM_WAIT_OBJECTS - 1) / 3;
+
+	HANDLE wakeEvent = NULL;
+	uint64_t pipeCounter = 0;
+
+	// children that are to be killed once the monitor's process is gone are
+	// assigned to this, the handle is never closed, the system closes it when
+	// the process ends, however it ends, and that kills the job's processes
+	HANDLE killOnExitJob = NULL;
+
+	// NtSetInformationProcess's ProcessIoPriority class, not in the SDK headers
+	constexpr ULONG PROCESS_IO_PRIORITY_CLASS = 33;
+	using NtSetInformationProcessFunction = LONG(NTAPI*)(HANDLE, ULONG, PVOID, ULONG);
+
+	struct OutputPipe
+	{
+		HANDLE handle = INVALID_HANDLE_VALUE;
+		OVERLAPPED overlapped{};
+		std::array<char, PIPE_BUFFER_SIZE> buffer{};
+		bool open = false;
+	};
+
+	struct PlatformProcess
+	{
+		HANDLE handle = NULL;
+	};
+#else
+	constexpr size_t MAX_CHILDREN = 256;
+
+	int wakePipe[2] = { -1, -1 };
+
+	struct OutputPipe
+	{
+		int fd = -1;
+		bool open = false;
+	};
+
+	struct PlatformProcess
+	{
+		pid_t pid = -1;
+		int pidfd = -1;
+	};
+#endif
+}
+
+struct ProcessRunner::Child
+{
+	ProcessId id = 0;
+	std::wstring commandLine;
+	ProcessOptions options;
+	Callback onExit;
+	ProcessResult result;
+	// false while held back
+	bool started = false;
+	PlatformProcess process;
+	// stdout and stderr
+	std::array<OutputPipe, 2> pipes;
+	std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt;
+	std::optional<std::chrono::steady_clock::time_point> exitedAt = std::nullopt;
+	// terminated or timed out, result.status already says which
+	bool killed = false;
+
+	std::string& outputOf(size_t pipe)
+	{
+		return pipe == 0 ? result.output : result.errorOutput;
+	}
+};
+
+ProcessRunner::ProcessId ProcessRunner::start(const std::wstring& commandLine, const ProcessOptions& options, Callback onExit)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	if (!reactorRunning)
+	{
+		if (!initializeBackend())
+		{
+			lock.unlock();
+			onExit(ProcessResult{});
+			return 0;
+		}
+
+		reactorRunning = true;
+		std::thread(runReactor).detach();
+	}
+
+	auto child = std::make_shared<Child>();
+	child->id = nextId++;
+	child->commandLine = commandLine;
+	child->options = options;
+	child->onExit = std::move(onExit);
+
+	if (canStart(*child) && !startChild(*child))
+	{
+		lock.unlock();
+		child->onExit(ProcessResult{});
+		return 0;
+	}
+
+	children.emplace(child->id, child);
+	wakeReactor();
+
+	return child->id;
+}
+
+void ProcessRunner::terminate(ProcessId id)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const auto it = children.find(id);
+
+	if (it == children.end())
+		return;
+
+	Child& child = *it->second;
+
+	if (child.exitedAt.has_value() || child.killed)
+		return;
+
+	child.killed = true;
+	child.result.status = ProcessStatus::Terminated;
+
+	if (child.started)
+	{
+		kill(child);
+		return;
+	}
+
+	// never started, it's done as it is
+	child.exitedAt = std::chrono::steady_clock::now();
+	wakeReactor();
+}
+
+ProcessResult ProcessRunner::run(const std::wstring& commandLine, const ProcessOptions& options)
+{
+	std::promise<ProcessResult> exited;
+	std::future<ProcessResult> result = exited.get_future();
+
+	start(commandLine, options, [&exited](ProcessResult processResult) { exited.set_value(std::move(processResult)); });
+
+	return result.get();
+}
+
+size_t ProcessRunner::getLiveCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return children.size();
+}
+
+bool ProcessRunner::canStart(const Child& child)
+{
+	size_t started = 0;
+	size_t startedInGroup = 0;
+
+	for (const auto& [id, other] : children)
+	{
+		if (!other->started)
+			continue;
+
+		++started;
+
+		if (other->options.group == child.options.group)
+			++startedInGroup;
+	}
+
+	if (started >= MAX_CHILDREN)
+		return false;
+
+	return child.options.maxInstances == 0 || startedInGroup < child.options.maxInstances;
+}
+
+bool ProcessRunner::startChild(Child& child)
+{
+	if (!spawn(child, child.commandLine, child.options))
+		return false;
+
+	child.started = true;
+
+	if (child.options.timeout.has_value())
+		child.deadline = std::chrono::steady_clock::now() + child.options.timeout.value();
+
+	return true;
+}
+
+void ProcessRunner::startHeldBack()
+{
+	// in the order they were started in
+	for (auto& [id, child] : children)
+	{
+		if (child->started || child->exitedAt.has_value() || !canStart(*child))
+			continue;
+
+		if (!startChild(*child))
+		{
+			// reported as done by the reactor
+			child->result.status = ProcessStatus::FailedToStart;
+			child->exitedAt = std::chrono::steady_clock::now();
+		}
+	}
+}
+
+bool ProcessRunner::isDone(const Child& child, std::chrono::steady_clock::time_point now)
+{
+	if (!child.exitedAt.has_value())
+		return false;
+
+	const bool outputClosed = std::none_of(child.pipes.begin(), child.pipes.end(), [](const OutputPipe& pipe) { return pipe.open; });
+
+	return outputClosed || now - child.exitedAt.value() >= OUTPUT_GRACE_PERIOD;
+}
+
+void ProcessRunner::runReactor()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		const auto now = std::chrono::steady_clock::now();
+
+		std::vector<std::shared_ptr<Child>> done;
+		std::optional<std::chrono::steady_clock::time_point> until;
+
+		const auto waitUntil = [&](std::chrono::steady_clock::time_point at) {
+			if (!until.has_value() || at < until.value())
+				until = at;
+		};
+
+		for (auto it = children.begin(); it != children.end();)
+		{
+			Child& child = *it->second;
+
+			if (!child.exitedAt.has_value() && !child.killed && child.deadline.has_value())
+			{
+				if (now >= child.deadline.value())
+				{
+					child.killed = true;
+					child.result.status = ProcessStatus::TimedOut;
+					kill(child);
+				}
+				else
+				{
+					waitUntil(child.deadline.value());
+				}
+			}
+
+			if (isDone(child, now))
+			{
+				close(child);
+				done.push_back(it->second);
+				it = children.erase(it);
+				continue;
+			}
+
+			if (child.exitedAt.has_value())
+				waitUntil(child.exitedAt.value() + OUTPUT_GRACE_PERIOD);
+
+			++it;
+		}
+
+		if (!done.empty())
+		{
+			startHeldBack();
+
+			lock.unlock();
+
+			for (const auto& child : done)
+				child->onExit(std::move(child->result));
+
+			lock.lock();
+			continue;
+		}
+
+		waitForEvents(lock, until);
+	}
+}
+
+#ifdef _WIN32
+
+namespace
+{
+	bool createOutputPipe(OutputPipe& pipe, HANDLE& writeEnd)
+	{
+		const std::wstring name = L"\\\\.\\pipe\\LunarMonitor." + std::to_wstring(GetCurrentProcessId()) + L"." + std::to_wstring(++pipeCounter);
+
+		// the read end is overlapped so the reactor can wait on it, anonymous pipes can't be
+		pipe.handle = CreateNamedPipeW(name.c_str(), PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+			PIPE_TYPE_BYTE | PIPE_WAIT, 1, PIPE_BUFFER_SIZE, PIPE_BUFFER_SIZE, 0, NULL);
+
+		if (pipe.handle == INVALID_HANDLE_VALUE)
+			return false;
+
+		SECURITY_ATTRIBUTES attributes{ sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+		writeEnd = CreateFileW(name.c_str(), GENERIC_WRITE, 0, &attributes, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		pipe.overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+		if (writeEnd == INVALID_HANDLE_VALUE || pipe.overlapped.hEvent == NULL)
+		{
+			if (writeEnd != INVALID_HANDLE_VALUE)
+				CloseHandle(writeEnd);
+
+			return false;
+		}
+
+		pipe.open = true;
+
+		return true;
+	}
+
+	void closeOutputPipe(OutputPipe& pipe)
+	{
+		if (pipe.open)
+		{
+			// the read may still be going, the buffer has to stay around until it's cancelled
+			DWORD transferred;
+			CancelIoEx(pipe.handle, &pipe.overlapped);
+			GetOverlappedResult(pipe.handle, &pipe.overlapped, &transferred, TRUE);
+			pipe.open = false;
+		}
+
+		if (pipe.handle != INVALID_HANDLE_VALUE)
+			CloseHandle(pipe.handle);
+		if (pipe.overlapped.hEvent != NULL)
+			CloseHandle(pipe.overlapped.hEvent);
+
+		pipe.handle = INVALID_HANDLE_VALUE;
+		pipe.overlapped.hEvent = NULL;
+	}
+
+	// the event is signaled once the read completes, even if it does right away
+	void readOutput(OutputPipe& pipe)
+	{
+		if (!ReadFile(pipe.handle, pipe.buffer.data(), static_cast<DWORD>(pipe.buffer.size()), NULL, &pipe.overlapped) &&
+			GetLastError() != ERROR_IO_PENDING)
+		{
+			pipe.open = false;
+		}
+	}
+
+	DWORD priorityClassOf(ProcessPriority priority)
+	{
+		switch (priority)
+		{
+		case ProcessPriority::Idle:
+			return IDLE_PRIORITY_CLASS;
+		case ProcessPriority::BelowNormal:
+			return BELOW_NORMAL_PRIORITY_CLASS;
+		case ProcessPriority::AboveNormal:
+			return ABOVE_NORMAL_PRIORITY_CLASS;
+		default:
+			return NORMAL_PRIORITY_CLASS;
+		}
+	}
+
+	void setIoPriority(HANDLE process, IoPriority priority)
+	{
+		if (priority == IoPriority::Normal)
+			return;
+
+		static const auto setInformationProcess = reinterpret_cast<NtSetInformationProcessFunction>(
+			GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtSetInformationProcess"));
+
+		if (setInformationProcess == nullptr)
+			return;
+
+		// very low and low, a failure leaves the child at normal which is fine
+		ULONG ioPriority = priority == IoPriority::VeryLow ? 0 : 1;
+		setInformationProcess(process, PROCESS_IO_PRIORITY_CLASS, &ioPriority, sizeof(ioPriority));
+	}
+}
+
+bool ProcessRunner::initializeBackend()
+{
+	wakeEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+
+	if (wakeEvent == NULL)
+		return false;
+
+	killOnExitJob = CreateJobObjectW(NULL, NULL);
+
+	if (killOnExitJob != NULL)
+	{
+		JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits{};
+		limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+
+		if (!SetInformationJobObject(killOnExitJob, JobObjectExtendedLimitInformation, &limits, sizeof(limits)))
+		{
+			CloseHandle(killOnExitJob);
+			killOnExitJob = NULL;
+		}
+	}
+
+	// children are still run without it, they just outlive the monitor if it's killed
+	return true;
+}
+
+bool ProcessRunner::spawn(Child& child, const std::wstring& commandLine, const ProcessOptions& options)
+{
+	std::array<HANDLE, 2> writeEnds{ INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE };
+
+	const auto fail = [&]() {
+		for (size_t i = 0; i != child.pipes.size(); ++i)
+		{
+			child.pipes[i].open = false;
+			closeOutputPipe(child.pipes[i]);
+
+			if (writeEnds[i] != INVALID_HANDLE_VALUE)
+				CloseHandle(writeEnds[i]);
+		}
+
+		return false;
+	};
+
+	for (size_t i = 0; i != child.pipes.size(); ++i)
+	{
+		if (!createOutputPipe(child.pipes[i], writeEnds[i]))
+			return fail();
+	}
+
+	// only the write ends are inherited, not whatever else happens to be
+	// inheritable at the time, like pipes of other children being started
+	SIZE_T attributeListSize = 0;
+	InitializeProcThreadAttributeList(NULL, 1, 0, &attributeListSize);
+	std::vector<char> attributeListBuffer(attributeListSize);
+	auto attributeList = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributeListBuffer.data());
+
+	if (!InitializeProcThreadAttributeList(attributeList, 1, 0, &attributeListSize))
+		return fail();
+
+	if (!UpdateProcThreadAttribute(attributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, writeEnds.data(), sizeof(HANDLE) * writeEnds.size(), NULL, NULL))
+	{
+		DeleteProcThreadAttributeList(attributeList);
+		return fail();
+	}
+
+	STARTUPINFOEXW si;
+	PROCESS_INFORMATION pi;
+
+	ZeroMemory(&si, sizeof(si));
+	si.StartupInfo.cb = sizeof(si);
+	si.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+	si.StartupInfo.hStdOutput = writeEnds[0];
+	si.StartupInfo.hStdError = writeEnds[1];
+	si.lpAttributeList = attributeList;
+	ZeroMemory(&pi, sizeof(pi));
+
+	std::vector<wchar_t> buf(commandLine.begin(), commandLine.end());
+	buf.push_back(0);
+
+	// suspended until it's in the job and has its I/O priority, so neither it
+	// nor anything it starts gets to run without them
+	const DWORD creationFlags = options.creationFlags | EXTENDED_STARTUPINFO_PRESENT | CREATE_SUSPENDED | priorityClassOf(options.priority);
+
+	const BOOL created = CreateProcessW(NULL, buf.data(), NULL, NULL, TRUE, creationFlags,
+		NULL, NULL, &si.StartupInfo, &pi);
+
+	DeleteProcThreadAttributeList(attributeList);
+
+	if (!created)
+		return fail();
+
+	// the child has its own copies, the pipes only report end of file once those are gone
+	for (HANDLE& writeEnd : writeEnds)
+	{
+		CloseHandle(writeEnd);
+		writeEnd = INVALID_HANDLE_VALUE;
+	}
+
+	if (options.killOnExit && killOnExitJob != NULL)
+		AssignProcessToJobObject(killOnExitJob, pi.hProcess);
+
+	setIoPriority(pi.hProcess, options.ioPriority);
+
+	ResumeThread(pi.hThread);
+	CloseHandle(pi.hThread);
+	child.process.handle = pi.hProcess;
+
+	for (OutputPipe& pipe : child.pipes)
+		readOutput(pipe);
+
+	return true;
+}
+
+void ProcessRunner::kill(Child& child)
+{
+	TerminateProcess(child.process.handle, 1);
+}
+
+void ProcessRunner::close(Child& child)
+{
+	for (OutputPipe& pipe : child.pipes)
+		closeOutputPipe(pipe);
+
+	// a child that never started has no process
+	if (child.process.handle != NULL)
+		CloseHandle(child.process.handle);
+
+	child.process.handle = NULL;
+}
+
+void ProcessRunner::wakeReactor()
+{
+	SetEvent(wakeEvent);
+}
+
+void ProcessRunner::waitForEvents(std::unique_lock<std::mutex>& lock, std::optional<std::chrono::steady_clock::time_point> until)
+{
+	struct Waited
+	{
+		Child* child;
+		// which pipe, or the process itself
+		std::optional<size_t> pipe;
+	};
+
+	std::vector<HANDLE> handles{ wakeEvent };
+	std::vector<Waited> waited{ { nullptr, std::nullopt } };
+
+	for (const auto& [id, child] : children)
+	{
+		if (child->started && !child->exitedAt.has_value())
+		{
+			handles.push_back(child->process.handle);
+			waited.push_back({ child.get(), std::nullopt });
+		}
+
+		for (size_t i = 0; i != child->pipes.size(); ++i)
+		{
+			if (child->pipes[i].open)
+			{
+				handles.push_back(child->pipes[i].overlapped.hEvent);
+				waited.push_back({ child.get(), i });
+			}
+		}
+	}
+
+	DWORD timeout = INFINITE;
+
+	if (until.has_value())
+	{
+		const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(until.value() - std::chrono::steady_clock::now());
+		timeout = static_cast<DWORD>(std::max<long long>(remaining.count(), 0));
+	}
+
+	lock.unlock();
+	const DWORD waitResult = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, timeout);
+	lock.lock();
+
+	if (waitResult == WAIT_TIMEOUT || waitResult == WAIT_FAILED)
+		return;
+
+	// only the first signaled handle is reported, checking all of them keeps
+	// children early in the list from starving the others
+	for (size_t i = 1; i != handles.size(); ++i)
+	{
+		if (WaitForSingleObject(handles[i], 0) != WAIT_OBJECT_0)
+			continue;
+
+		Child& child = *waited[i].child;
+
+		if (!waited[i].pipe.has_value())
+		{
+			DWORD exitCode = 0;
+			GetExitCodeProcess(child.process.handle, &exitCode);
+
+			child.result.exitCode = exitCode;
+			if (!child.killed)
+				child.result.status = ProcessStatus::Exited;
+			child.exitedAt = std::chrono::steady_clock::now();
+
+			continue;
+		}
+
+		OutputPipe& pipe = child.pipes[waited[i].pipe.value()];
+		DWORD transferred = 0;
+
+		if (!GetOverlappedResult(pipe.handle, &pipe.overlapped, &transferred, FALSE))
+		{
+			// the write end was closed
+			pipe.open = false;
+			continue;
+		}
+
+		appendOutput(child.outputOf(waited[i].pipe.value()), pipe.buffer.data(), transferred);
+		readOutput(pipe);
+	}
+}
+
+#else
+
+namespace
+{
+	std::string toUtf8(const std::wstring& text)
+	{
+		std::string utf8;
+
+		for (const wchar_t ch : text)
+		{
+			const uint32_t c = static_cast<uint32_t>(ch);
+
+			if (c < 0x80)
+			{
+				utf8 += static_cast<char>(c);
+			}
+			else if (c < 0x800)
+			{
+				utf8 += static_cast<char>(0xC0 | (c >> 6));
+				utf8 += static_cast<char>(0x80 | (c & 0x3F));
+			}
+			else if (c < 0x10000)
+			{
+				utf8 += static_cast<char>(0xE0 | (c >> 12));
+				utf8 += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+				utf8 += static_cast<char>(0x80 | (c & 0x3F));
+			}
+			else
+			{
+				utf8 += static_cast<char>(0xF0 | (c >> 18));
+				utf8 += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+				utf8 += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+				utf8 += static_cast<char>(0x80 | (c & 0x3F));
+			}
+		}
+
+		return utf8;
+	}
+
+	void closeFd(int& fd)
+	{
+		if (fd != -1)
+			::close(fd);
+
+		fd = -1;
+	}
+
+	int niceOf(ProcessPriority priority)
+	{
+		switch (priority)
+		{
+		case ProcessPriority::Idle:
+			return 19;
+		case ProcessPriority::BelowNormal:
+			return 10;
+		case ProcessPriority::AboveNormal:
+			return -5;
+		default:
+			return 0;
+		}
+	}
+
+	// the whole group, so whatever the shell started already gets it too, the
+	// rest inherits it, failures leave the child as it is which is fine
+	void setPriorities(pid_t group, const ProcessOptions& options)
+	{
+		if (options.priority != ProcessPriority::Normal)
+			setpriority(PRIO_PGRP, static_cast<id_t>(group), niceOf(options.priority));
+
+		if (options.ioPriority == IoPriority::Normal)
+			return;
+
+		// linux/ioprio.h, idle class or the lowest best effort level
+		constexpr int IOPRIO_WHO_PGRP = 2;
+		constexpr int IOPRIO_CLASS_SHIFT = 13;
+		const int ioPriority = options.ioPriority == IoPriority::VeryLow ? 3 << IOPRIO_CLASS_SHIFT : (2 << IOPRIO_CLASS_SHIFT) | 7;
+
+		syscall(SYS_ioprio_set, IOPRIO_WHO_PGRP, group, ioPriority);
+	}
+}
+
+bool ProcessRunner::initializeBackend()
+{
+	return pipe2(wakePipe, O_CLOEXEC | O_NONBLOCK) == 0;
+}
+
+bool ProcessRunner::spawn(Child& child, const std::wstring& commandLine, const ProcessOptions& options)
+{
+	std::array<int, 2> writeEnds{ -1, -1 };
+
+	const auto fail = [&]() {
+		for (size_t i = 0; i != child.pipes.size(); ++i)
+		{
+			child.pipes[i].open = false;
+			closeFd(child.pipes[i].fd);
+			closeFd(writeEnds[i]);
+		}
+
+		return false;
+	};
+
+	for (size_t i = 0; i != child.pipes.size(); ++i)
+	{
+		int fds[2];
+
+		if (pipe2(fds, O_CLOEXEC) != 0)
+			return fail();
+
+		child.pipes[i].fd = fds[0];
+		child.pipes[i].open = true;
+		writeEnds[i] = fds[1];
+
+		fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	}
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, writeEnds[0], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, writeEnds[1], STDERR_FILENO);
+
+	// a group of its own so kill reaches whatever the shell started as well
+	posix_spawnattr_t attributes;
+	posix_spawnattr_init(&attributes);
+	posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+	posix_spawnattr_setpgroup(&attributes, 0);
+
+	std::string command = toUtf8(commandLine);
+	char shell[] = "/bin/sh";
+	char flag[] = "-c";
+	char* argv[] = { shell, flag, command.data(), nullptr };
+
+	pid_t pid;
+	const int spawned = posix_spawn(&pid, shell, &actions, &attributes, argv, environ);
+
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&attributes);
+
+	if (spawned != 0)
+		return fail();
+
+	for (int& writeEnd : writeEnds)
+		closeFd(writeEnd);
+
+	child.process.pid = pid;
+	child.process.pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+
+	if (child.process.pidfd == -1)
+	{
+		::kill(-pid, SIGKILL);
+		waitpid(pid, nullptr, 0);
+		return fail();
+	}
+
+	setPriorities(pid, options);
+
+	return true;
+}
+
+void ProcessRunner::kill(Child& child)
+{
+	::kill(-child.process.pid, SIGKILL);
+}
+
+void ProcessRunner::close(Child& child)
+{
+	for (OutputPipe& pipe : child.pipes)
+	{
+		pipe.open = false;
+		closeFd(pipe.fd);
+	}
+
+	closeFd(child.process.pidfd);
+}
+
+void ProcessRunner::wakeReactor()
+{
+	const char wake = 1;
+	[[maybe_unused]] const ssize_t written = write(wakePipe[1], &wake, 1);
+}
+
+void ProcessRunner::waitForEvents(std::unique_lock<std::mutex>& lock, std::optional<std::chrono::steady_clock::time_point> until)
+{
+	struct Waited
+	{
+		Child* child;
+		// which pipe, or the process itself
+		std::optional<size_t> pipe;
+	};
+
+	std::vector<pollfd> fds{ { wakePipe[0], POLLIN, 0 } };
+	std::vector<Waited> waited{ { nullptr, std::nullopt } };
+
+	for (const auto& [id, child] : children)
+	{
+		if (child->started && !child->exitedAt.has_value())
+		{
+			fds.push_back({ child->process.pidfd, POLLIN, 0 });
+			waited.push_back({ child.get(), std::nullopt });
+		}
+
+		for (size_t i = 0; i != child->pipes.size(); ++i)
+		{
+			if (child->pipes[i].open)
+			{
+				fds.push_back({ child->pipes[i].fd, POLLIN, 0 });
+				waited.push_back({ child.get(), i });
+			}
+		}
+	}
+
+	int timeout = -1;
+
+	if (until.has_value())
+	{
+		const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(until.value() - std::chrono::steady_clock::now());
+		timeout = static_cast<int>(std::max<long long>(remaining.count(), 0));
+	}
+
+	lock.unlock();
+	const int ready = poll(fds.data(), fds.size(), timeout);
+	lock.lock();
+
+	if (ready <= 0)
+		return;
+
+	if (fds[0].revents != 0)
+	{
+		char drained[64];
+		while (read(wakePipe[0], drained, sizeof(drained)) > 0);
+	}
+
+	for (size_t i = 1; i != fds.size(); ++i)
+	{
+		if (fds[i].revents == 0)
+			continue;
+
+		Child& child = *waited[i].child;
+
+		if (!waited[i].pipe.has_value())
+		{
+			int status = 0;
+			waitpid(child.process.pid, &status, 0);
+
+			child.result.exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+			if (!child.killed)
+				child.result.status = ProcessStatus::Exited;
+			child.exitedAt = std::chrono::steady_clock::now();
+
+			continue;
+		}
+
+		OutputPipe& pipe = child.pipes[waited[i].pipe.value()];
+		std::array<char, PIPE_BUFFER_SIZE> buffer;
+
+		while (true)
+		{
+			const ssize_t received = read(pipe.fd, buffer.data(), buffer.size());
+
+			if (received > 0)
+			{
+				appendOutput(child.outputOf(waited[i].pipe.value()), buffer.data(), static_cast<size_t>(received));
+				continue;
+			}
+
+			// end of file, anything but there being nothing left to read for now counts as one
+			if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+				pipe.open = false;
+
+			break;
+		}
+	}
+}
+
+#endif
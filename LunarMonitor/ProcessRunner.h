@@ -0,0 +1,120 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+enum class ProcessStatus
+{
+	Exited,
+	FailedToStart,
+	TimedOut,
+	Terminated
+};
+
+struct ProcessResult
+{
+	ProcessStatus status = ProcessStatus::FailedToStart;
+	// only meaningful if the process exited by itself
+	uint32_t exitCode = 0;
+	std::string output;
+	std::string errorOutput;
+};
+
+enum class ProcessPriority
+{
+	Idle,
+	BelowNormal,
+	Normal,
+	AboveNormal
+};
+
+enum class IoPriority
+{
+	VeryLow,
+	Low,
+	Normal
+};
+
+struct ProcessOptions
+{
+	// CreateProcess creation flags, the POSIX backend ignores them
+	uint32_t creationFlags = 0;
+	// the process is terminated once it ran for this long
+	std::optional<std::chrono::milliseconds> timeout = std::nullopt;
+	ProcessPriority priority = ProcessPriority::Normal;
+	// a hint, the system may not honor it
+	IoPriority ioPriority = IoPriority::Normal;
+	// the process and whatever it starts are killed once the monitor's process
+	// is gone, even if that's killed itself, the POSIX backend ignores it
+	bool killOnExit = false;
+	// processes of the same group share maxInstances, the ones started past it
+	// wait for one to exit before they are, 0 means no limit
+	std::string group;
+	size_t maxInstances = 0;
+};
+
+// runs child processes and reports their exit through a callback, a single
+// reactor thread waits on every live child at once instead of each caller
+// blocking a thread of its own until its child exits, the children's stdout
+// and stderr are captured and a child that runs past its timeout is terminated
+//
+// processes past their group's maxInstances, or past the number of children the
+// reactor can wait on, are held back and started by the reactor once a slot is
+// free, so start never blocks and a held back process can be terminated too
+//
+// the Windows backend waits on process handles and overlapped pipe reads, the
+// POSIX backend waits on pidfds and pipes and runs command lines through
+// /bin/sh, so what's built on the runner can be tried out on Linux with stand
+// in executables
+class ProcessRunner
+{
+public:
+	using ProcessId = uint64_t;
+	using Callback = std::function<void(ProcessResult)>;
+
+	// starts commandLine, onExit is called on the reactor thread once the
+	// process exited and its output was read, so it should be quick, if the
+	// process can't be started onExit is called with FailedToStart, right away
+	// and with 0 returned if it was to be started right away
+	static ProcessId start(const std::wstring& commandLine, const ProcessOptions& options, Callback onExit);
+
+	// terminates the process, its callback is still called, with Terminated,
+	// does nothing if it already exited
+	static void terminate(ProcessId id);
+
+	// starts commandLine and waits for it to exit
+	static ProcessResult run(const std::wstring& commandLine, const ProcessOptions& options);
+
+	static size_t getLiveCount();
+
+private:
+	struct Child;
+
+	// backend specific, called with mutex held
+	static bool initializeBackend();
+	static bool spawn(Child& child, const std::wstring& commandLine, const ProcessOptions& options);
+	static void kill(Child& child);
+	static void close(Child& child);
+	static void wakeReactor();
+	// waits for a child to exit or output until the deadline and handles what
+	// happened, unlocks while waiting
+	static void waitForEvents(std::unique_lock<std::mutex>& lock, std::optional<std::chrono::steady_clock::time_point> until);
+
+	static void runReactor();
+	static bool isDone(const Child& child, std::chrono::steady_clock::time_point now);
+	static bool canStart(const Child& child);
+	// spawns held back children that have a slot now, called with mutex held
+	static void startHeldBack();
+	static bool startChild(Child& child);
+
+	static inline std::mutex mutex{};
+	static inline std::map<ProcessId, std::shared_ptr<Child>> children{};
+	static inline ProcessId nextId = 1;
+	static inline bool reactorRunning = false;
+};
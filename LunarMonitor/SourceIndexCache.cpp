@@ -0,0 +1,54 @@
+#include "SourceIndexCache.h"
+#include "md5.h"
+
+void SourceIndexCache::enable(const fs::path& path)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (indexFilePath.has_value() && indexFilePath.value() == path)
+		return;
+
+	indexFilePath = path;
+	current.reset();
+	currentDigest.clear();
+}
+
+void SourceIndexCache::disable()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	indexFilePath = std::nullopt;
+	current.reset();
+	currentDigest.clear();
+}
+
+std::shared_ptr<const BpsSourceIndex> SourceIndexCache::get(const fs::path& sourcePath, ByteSpan source)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!indexFilePath.has_value())
+		return std::make_shared<const BpsSourceIndex>(BpsSourceIndex::build(source));
+
+	// answered from the hash cache as long as the clean ROM is untouched
+	const std::string digest = md5File(sourcePath);
+
+	if (current != nullptr && digest == currentDigest)
+		return current;
+
+	// the old index may still be mapped from the file that's about to be replaced
+	current.reset();
+
+	if (auto loaded = BpsSourceIndex::load(indexFilePath.value(), digest, source.size))
+	{
+		current = std::make_shared<const BpsSourceIndex>(std::move(loaded.value()));
+	}
+	else
+	{
+		BpsSourceIndex built = BpsSourceIndex::build(source);
+		built.save(indexFilePath.value(), digest);
+		current = std::make_shared<const BpsSourceIndex>(std::move(built));
+	}
+
+	currentDigest = digest;
+	return current;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include "BpsSourceIndex.h"
+
+namespace fs = std::filesystem;
+
+// keeps the match index of the clean ROM around between global data exports,
+// in memory for the session and on disk across sessions, keyed by the md5 of
+// the clean ROM so a replaced clean ROM is reindexed automatically
+//
+// while disabled every call builds a fresh index and nothing is written
+class SourceIndexCache
+{
+public:
+	static void enable(const fs::path& indexFilePath);
+	static void disable();
+
+	static std::shared_ptr<const BpsSourceIndex> get(const fs::path& sourcePath, ByteSpan source);
+
+private:
+	static inline std::mutex mutex{};
+	static inline std::optional<fs::path> indexFilePath = std::nullopt;
+	static inline std::shared_ptr<const BpsSourceIndex> current{};
+	static inline std::string currentDigest{};
+};
@@ -1,7 +1,6 @@
 #include <Windows.h>
 #include <detours.h>
 #include <CommCtrl.h>
-#include <thread>
 #pragma comment (lib, "comctl32")
 
 #include <iostream>
@@ -18,6 +17,12 @@
 #include "Config.h"
 
 #include "BuildResultUpdater.h"
+#include "HashCache.h"
+#include "SourceIndexCache.h"
+#include "BuildReportStore.h"
+#include "ExportJobRunner.h"
+#include "ExportScheduler.h"
+#include "ExportAllPipeline.h"
 
 LPWSTR commandline_args;
 int command_line_amount;
@@ -26,10 +31,23 @@ __declspec(dllexport) void __cdecl dummy(void);
 
 constexpr const WORD IDM_EXPORT_ALL_BTN = 0x5BF9;
 
+// posted to the main editor window by export all, progress carries a heap
+// allocated ExportTaskEvent in lParam, done whether it succeeded in wParam
+constexpr const UINT WM_EXPORT_ALL_PROGRESS = WM_APP + 0x5BF;
+constexpr const UINT WM_EXPORT_ALL_DONE = WM_APP + 0x5C0;
+
 constexpr const size_t MAIN_EDITOR_STATUS_BAR_PARTS = 2;
 constexpr const size_t SECOND_STATUSBAR_FIELD_WIDTH = 800;
 
 constexpr const char* CONFIG_FILE_PATH = "lunar-monitor-config.txt";
+constexpr const char* HASH_CACHE_PATH = ".lunar_helper/hash_cache.bin";
+constexpr const char* CLEAN_ROM_INDEX_PATH = ".lunar_helper/clean_rom_index.bin";
+constexpr const char* STAGING_PATH = ".lunar_helper/staging";
+
+// how long closing Lunar Magic waits for exports that are still queued or running
+constexpr const std::chrono::milliseconds EXPORT_DRAIN_TIMEOUT{ 10000 };
+// how often the editor's thread checks on the exports while it waits for them
+constexpr const std::chrono::milliseconds EXPORT_WAIT_INTERVAL{ 20 };
 
 std::optional<Config> config = std::nullopt;
 LM lm{};
@@ -38,6 +56,10 @@ HMODULE g_hModule;
 
 bool show_prompts, is_running;
 
+// only touched on the editor's thread
+bool commentFieldAlteredBeforeExportAll = false;
+uint64_t failedExportsBeforeExportAll = 0;
+
 std::optional<std::string> lastRomBuildTime = std::nullopt;
 
 HANDLE lunarHelperDirChangeWaiter;
@@ -83,7 +105,7 @@ HWND mainEditorProc;
 static BOOL(WINAPI* TrueShowWindow)(HWND hWnd, int nCmdShow) = ShowWindow;
 
 void DllAttach(HMODULE hModule);
-void DllDetach(HMODULE hModule);
+void DllDetach(HMODULE hModule, bool processTerminating);
 
 void SetConfig(const fs::path& basePath);
 
@@ -96,7 +118,11 @@ void CALLBACK OnLunarHelperDirChange(_In_  PVOID unused, _In_  BOOLEAN TimerOrWa
 
 bool CommentFieldIsAltered();
 
-bool ExportAll(bool confirm_prompt);
+// starts export all in the background, false if the user declined
+bool StartExportAll(bool confirm_prompt);
+void ShowExportAllProgress(const ExportTaskEvent& event);
+void OnExportAllDone(bool succeeded);
+void WaitForExports(std::chrono::milliseconds timeout);
 
 LRESULT CALLBACK MainEditorReplacementWndProc(
     HWND hwnd,        // handle to window
@@ -114,7 +140,7 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReser
         case DLL_THREAD_ATTACH:
             break;
         case DLL_PROCESS_DETACH:
-            DllDetach(hModule);
+            DllDetach(hModule, lpReserved != nullptr);
             break;
         case DLL_THREAD_DETACH:
             break;
@@ -155,6 +181,11 @@ void DllAttach(HMODULE hModule)
         }
         CloseHandle(pipe);
 
+        // exports of saves run against the ROM the editor has open
+        ExportScheduler::setRunner([](const std::vector<ExportJob>& jobs, const std::vector<std::shared_ptr<ExportCancellation>>& cancellations) {
+            return ExportJobRunner::run(lm, jobs, cancellations);
+        });
+
         DisableThreadLibraryCalls(hModule);
         DetourTransactionBegin();
         DetourUpdateThread(GetCurrentThread());
@@ -203,7 +234,7 @@ void DllAttach(HMODULE hModule)
     }
 }
 
-void DllDetach(HMODULE hModule)
+void DllDetach(HMODULE hModule, bool processTerminating)
 {
     if (command_line_amount < 3)
     {
@@ -223,6 +254,16 @@ void DllDetach(HMODULE hModule)
             UnregisterWait(lunarHelperDirChangeWaiter);
         if (lunarHelperDirChange != nullptr)
             FindCloseChangeNotification(lunarHelperDirChange);
+
+        // this runs under the loader lock, so nothing is waited for here, the workers
+        // are gone already if the process is exiting and WM_DESTROY let exports finish
+        // otherwise, a worker still running would deadlock on the lock if waited for
+        ExportScheduler::drain(std::chrono::milliseconds::zero());
+
+        // with the workers stopped nothing else writes the report anymore, while the
+        // dll is only being unloaded they may still be writing it themselves
+        if (processTerminating)
+            BuildReportStore::shutdown();
     }
     else
     {
@@ -356,24 +397,63 @@ LRESULT CALLBACK MainEditorReplacementWndProc(
     LPARAM lParam)    // second message parameter
 {
     if (uMsg == WM_COMMAND && wParam == IDM_EXPORT_ALL_BTN) {
-        // export all button pressed, export all and then mark the ROM as having last been 
-        // edited by a lunar monitor injected lunar magic, meaning there should now be no resources
-        // in the ROM that are not exported
-        bool res = ExportAll(true);
-        if (res)
-        {
-            lm.WriteCommentToRom(FISH_REPLACEMENT);
-        }
-        else
+        // export all button pressed, export all in the background, which marks the ROM as having last been 
+        // edited by a lunar monitor injected lunar magic once everything was exported
+        bool res = StartExportAll(true);
+        if (!res)
         {
             if (!CommentFieldIsAltered())
                 ShowVolatileResourceExportError();
         }
     }
+    else if (uMsg == WM_EXPORT_ALL_PROGRESS)
+    {
+        std::unique_ptr<ExportTaskEvent> event{ reinterpret_cast<ExportTaskEvent*>(lParam) };
+        ShowExportAllProgress(*event);
+        return 0;
+    }
+    else if (uMsg == WM_EXPORT_ALL_DONE)
+    {
+        OnExportAllDone(wParam != FALSE);
+        return 0;
+    }
+    else if (uMsg == WM_DESTROY)
+    {
+        // Lunar Magic is closing, let exports of its last saves finish while the process is still intact
+        WaitForExports(EXPORT_DRAIN_TIMEOUT);
+        BuildReportStore::flush();
+    }
 
     return CallWindowProc((WNDPROC)mainEditorProc, *lm.getPaths().getMainEditorWindowHandle(), uMsg, wParam, lParam);
 }
 
+void WaitForExports(std::chrono::milliseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    while (!ExportScheduler::waitForIdle(std::chrono::milliseconds::zero()))
+    {
+        const auto now = std::chrono::steady_clock::now();
+
+        if (now >= deadline)
+        {
+            Logger::log_error(L"Exports still running after %lld ms, closing anyway", timeout.count());
+            return;
+        }
+
+        const auto wait = std::min(EXPORT_WAIT_INTERVAL, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now));
+
+        // Lunar Magic's own exports, like the map16 one, send messages to this thread
+        // from the workers and only return once they are handled, so they are handled
+        // while waiting, messages posted to the editor are left alone
+        if (MsgWaitForMultipleObjects(0, nullptr, FALSE, static_cast<DWORD>(wait.count()), QS_SENDMESSAGE) == WAIT_OBJECT_0)
+        {
+            MSG msg;
+            PeekMessage(&msg, nullptr, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
+        }
+    }
+}
+
 void ShowVolatileResourceExportError()
 {
     Logger::log_error(L"Failed to export at least one potentially volatile resource, notifying user");
@@ -387,7 +467,7 @@ void ShowVolatileResourceExportError()
     );
 }
 
-bool ExportAll(bool confirm_prompt = false)
+bool StartExportAll(bool confirm_prompt = false)
 {
     if (confirm_prompt)
     {
@@ -409,60 +489,139 @@ bool ExportAll(bool confirm_prompt = false)
 
     Logger::log_message(L"Export all button pressed, attempting to export all now");
 
-    try {
-        OnGlobalDataSave::exportBps(lm, config.value());
-    }
-    catch (const std::exception& exc)
-    {
-        WhatWide what{ exc };
-        Logger::log_error(L"Full export failed: Global data export failed with exception: \"%s\"", what.what());
+    // decides which message to show once done, the ROM is marked as exported at the end
+    commentFieldAlteredBeforeExportAll = CommentFieldIsAltered();
+    failedExportsBeforeExportAll = lm.getOriginalCommentWrites();
 
-        return false;
-    }
+    fs::path romPath = lm.getPaths().getRomDir();
+    romPath += lm.getPaths().getRomName();
 
-    try {
-        fs::path mwlPath = config.value().getLevelDirectory();
-        const fs::path origPath = fs::path(mwlPath);
+    // the stages may outlive a config reload
+    const auto conf = std::make_shared<const Config>(config.value());
+
+    std::vector<ExportAllStage> stages;
+
+    stages.push_back({ L"global data", [conf](ExportCancellation& cancellation) {
+        OnGlobalDataSave::exportBps(lm, *conf, cancellation);
+    } });
+
+    stages.push_back({ L"levels", [conf, romPath](ExportCancellation& cancellation) {
+        fs::path mwlPath = conf->getLevelDirectory();
         mwlPath /= "level";
-        fs::path romPath = lm.getPaths().getRomDir();
-        romPath += lm.getPaths().getRomName();
-        lm.getLevelEditor().exportAllMwls(lm.getPaths().getLmExePath(), romPath, mwlPath);
+
+        if (!lm.getLevelEditor().exportAllMwls(lm.getPaths().getLmExePath(), romPath, mwlPath, conf->getToolPolicy(Tool::LunarMagic), cancellation))
+            throw std::runtime_error("Lunar Magic failed to export all levels");
 
         Logger::log_message(L"Successfully exported all mwls to \"%s\"", mwlPath.c_str());
-    }
-    catch (const std::exception& exc)
+    } });
+
+    stages.push_back({ L"map16", [conf](ExportCancellation& cancellation) {
+        if (!OnMap16Save::onSuccessfulMap16Save(lm, *conf, cancellation))
+            throw std::runtime_error("Map16 export failed, check log for details");
+    } });
+
+    stages.push_back({ L"shared palettes", [conf, romPath](ExportCancellation& cancellation) {
+        OnSharedPalettesSave::exportSharedPalettes(romPath, conf->getSharedPalettesPath(), lm.getPaths().getLmExePath(),
+            conf->getToolPolicy(Tool::LunarMagic), cancellation);
+
+        Logger::log_message(L"Successfully exported shared palettes to \"%s\"", conf->getSharedPalettesPath().c_str());
+    } });
+
+    // progress and the result are handed to the editor's thread, which never waits on export
+    // all, and marks the ROM once it succeeded since the editor writes the ROM on that thread
+    // export all exports everything at once, saves the user makes while it runs go first
+    const auto runOnExportWorker = [](std::function<void()> task) {
+        ExportJob job{ ExportJobType::Task, true, std::nullopt };
+        job.task = std::move(task);
+        job.taskPriority = ExportPriority::Bulk;
+
+        return ExportScheduler::enqueue(std::move(job));
+    };
+
+    const bool started = ExportAllPipeline::start(runOnExportWorker, std::move(stages),
+        [](const ExportTaskEvent& event) {
+            auto posted = std::make_unique<ExportTaskEvent>(event);
+
+            if (PostMessage(*lm.getPaths().getMainEditorWindowHandle(), WM_EXPORT_ALL_PROGRESS, 0, reinterpret_cast<LPARAM>(posted.get())))
+                posted.release();
+        },
+        [](bool succeeded, std::chrono::milliseconds) {
+            PostMessage(*lm.getPaths().getMainEditorWindowHandle(), WM_EXPORT_ALL_DONE, succeeded, 0);
+        });
+
+    if (!started)
     {
-        WhatWide what{ exc };
-        Logger::log_error(L"Full export failed: Export of all mwls failed with exception: \"%s\"", what.what());
-
-        return false;
+        // the button is disabled while it runs, this is only a safeguard
+        Logger::log_message(L"Export all is still running, ignoring button press");
+        return true;
     }
 
-    if (!OnMap16Save::onSuccessfulMap16Save(lm, config.value()))
+    UpdateExportAllButton();
+
+    return true;
+}
+
+void ShowExportAllProgress(const ExportTaskEvent& event)
+{
+    const wchar_t* outcome = L"";
+
+    switch (event.outcome)
     {
-        Logger::log_error(L"Full export failed: Map16 export failed, check log for details");
-        return false;
-    }
+    case ExportTaskOutcome::Started:
+        outcome = L"started";
+        break;
+    case ExportTaskOutcome::Succeeded:
+        outcome = L"done";
+        break;
+    case ExportTaskOutcome::Failed:
+        outcome = L"failed";
+        break;
+    case ExportTaskOutcome::Cancelled:
+        outcome = L"cancelled";
+        break;
+    case ExportTaskOutcome::Skipped:
+        outcome = L"skipped";
+        break;
+    }
+
+    const std::wstring text = L"Export all: " + event.task + L" " + outcome + L" (" +
+        std::to_wstring(event.finished) + L"/" + std::to_wstring(event.total) + L" steps finished)";
+
+    SendMessage(*lm.getPaths().getMainEditorStatusbarHandle(), SB_SETTEXT, MAKEWORD(2, 0), (LPARAM)text.c_str());
+}
 
-    try {
-        fs::path romPath = lm.getPaths().getRomDir();
-        romPath += lm.getPaths().getRomName();
+void OnExportAllDone(bool succeeded)
+{
+    UpdateExportAllButton();
 
-        OnSharedPalettesSave::exportSharedPalettes(romPath, config.value().getSharedPalettesPath(), lm.getPaths().getLmExePath());
+    // saves made while export all ran are exported on their own, the ROM is only fully exported once
+    // those are done too, and marking it would hide that one of them failed
+    if (succeeded && (ExportScheduler::hasPendingExports() || lm.getOriginalCommentWrites() != failedExportsBeforeExportAll))
+    {
+        Logger::log_error(L"Exports of saves made during export all are still running or failed, not marking ROM as fully exported");
+        succeeded = false;
+    }
 
-        Logger::log_message(L"Successfully exported shared palettes to \"%s\"", config.value().getSharedPalettesPath().c_str());
+    // there should now be no resources in the ROM that are not exported
+    if (succeeded && !lm.WriteCommentToRom(FISH_REPLACEMENT))
+    {
+        Logger::log_error(L"Failed to mark ROM as fully exported");
+        succeeded = false;
     }
-    catch (const std::runtime_error& err)
+
+    if (!succeeded)
     {
-        WhatWide what{ err };
-        Logger::log_error(L"Full export failed: Shared palettes export failed with exception: \"%s\"", what.what());
+        Logger::log_error(L"Full export failed, check log for details");
+
+        if (!CommentFieldIsAltered())
+            ShowVolatileResourceExportError();
 
-        return false;
+        return;
     }
 
     Logger::log_message(L"Successfully exported all!");
 
-    if (CommentFieldIsAltered())
+    if (commentFieldAlteredBeforeExportAll)
     {
         MessageBox(
             *lm.getPaths().getMainEditorWindowHandle(),
@@ -485,8 +644,6 @@ bool ExportAll(bool confirm_prompt = false)
             MB_ICONINFORMATION
         );
     }
-
-    return true;
 }
 
 void AddStatusBarField()
@@ -572,7 +729,9 @@ void WriteCommentFieldFunction(uint32_t write_location, const char* comment, uin
 void UpdateExportAllButton()
 {
     SendMessage(*(lm.getPaths().getToolbarHandle()), TB_INDETERMINATE, IDM_EXPORT_ALL_BTN, (LPARAM) MAKELONG(!config.has_value(), 0));
-    SendMessage(*(lm.getPaths().getToolbarHandle()), TB_ENABLEBUTTON, IDM_EXPORT_ALL_BTN, (LPARAM)MAKELONG(config.has_value(), 0));
+    // disabled while export all runs, it's enabled again once that's done
+    SendMessage(*(lm.getPaths().getToolbarHandle()), TB_ENABLEBUTTON, IDM_EXPORT_ALL_BTN,
+        (LPARAM)MAKELONG(config.has_value() && !ExportAllPipeline::isRunning(), 0));
 }
 
 void WatchLunarHelperDirectory()
@@ -595,23 +754,8 @@ void WatchLunarHelperDirectory()
     }
     else
     {
-        std::optional<json> buildReport = BuildResultUpdater::readInJson();
-
-        if (buildReport.has_value())
-        {
-            try
-            {
-                lastRomBuildTime = buildReport.value()["build_time"].dump();
-            }
-            catch (const json::exception&)
-            {
-                lastRomBuildTime = std::nullopt;
-            }
-        }
-        else
-        {
-            lastRomBuildTime = std::nullopt;
-        }
+        const std::optional<BuildIdentity> build = BuildResultUpdater::readBuildIdentity();
+        lastRomBuildTime = build.has_value() ? std::optional(build.value().buildTime) : std::nullopt;
     }
 
     lunarHelperDirChange = FindFirstChangeNotification(lunarHelperDir.c_str(), false, FILE_NOTIFY_CHANGE_LAST_WRITE);
@@ -624,30 +768,24 @@ void WatchLunarHelperDirectory()
 
 void CALLBACK OnLunarHelperDirChange(_In_  PVOID unused, _In_  BOOLEAN TimerOrWaitFired)
 {
-    std::optional<json> buildReport = BuildResultUpdater::readInJson();
+    // the report is only looked at again if it wasn't the monitor that wrote it
+    std::optional<BuildIdentity> build = BuildReportStore::checkForExternalWrite() ?
+        BuildResultUpdater::readBuildIdentity() : std::nullopt;
+    std::optional<std::string> newHash = build.has_value() ? std::optional(build.value().buildTime) : std::nullopt;
 
     UnregisterWait(lunarHelperDirChangeWaiter);
     lunarHelperDirChangeWaiter = nullptr;
 
-    if (buildReport.has_value())
+    if (newHash.has_value())
     {
-        try
-        {
-            std::string newHash = buildReport.value()["build_time"].dump();
-
-            if (!lastRomBuildTime.has_value() || newHash != lastRomBuildTime.value())
-            {
-                FindCloseChangeNotification(lunarHelperDirChange);
-                lunarHelperDirChange = nullptr;
-                lastRomBuildTime = newHash;
-                Logger::log_message(L"Change in Lunar Helper directory detected, reloading ROM...");
-                lm.getLevelEditor().reloadROM();
-                return;
-            }
-        }
-        catch (const json::exception&)
+        if (!lastRomBuildTime.has_value() || newHash.value() != lastRomBuildTime.value())
         {
-            // pass
+            FindCloseChangeNotification(lunarHelperDirChange);
+            lunarHelperDirChange = nullptr;
+            lastRomBuildTime = newHash;
+            Logger::log_message(L"Change in Lunar Helper directory detected, reloading ROM...");
+            lm.getLevelEditor().reloadROM();
+            return;
         }
     }
 
@@ -705,10 +843,27 @@ void SetConfig(const fs::path& basePath)
     fs::path configPath = basePath;
     configPath += CONFIG_FILE_PATH;
 
+    fs::path buildReportPath = basePath;
+    buildReportPath += jsonPath;
+
     try
     {
         config = Config(configPath);
 
+        fs::path hashCachePath = basePath;
+        hashCachePath += HASH_CACHE_PATH;
+        HashCache::enable(hashCachePath);
+
+        fs::path cleanRomIndexPath = basePath;
+        cleanRomIndexPath += CLEAN_ROM_INDEX_PATH;
+        SourceIndexCache::enable(cleanRomIndexPath);
+
+        fs::path stagingPath = basePath;
+        stagingPath += STAGING_PATH;
+        StagedOutput::enable(basePath, stagingPath);
+
+        BuildReportStore::enable(buildReportPath, config.value().getBuildReportFlushDelay());
+
         Logger::log_message(L"------- START OF LOG -------");
         Logger::log_message(L"Successfully loaded config file from \"%s\"", configPath.wstring().c_str());
     }
@@ -729,6 +884,10 @@ void SetConfig(const fs::path& basePath)
         Logger::log_message(L"------- START OF LOG -------");
         Logger::log_error(L"Failed to setup configuration file, error was \"%s\"", what.what());
         config = std::nullopt;
+        HashCache::disable();
+        SourceIndexCache::disable();
+        // still read when LunarHelper rebuilds the ROM, nothing updates it without a config though
+        BuildReportStore::enable(buildReportPath, std::chrono::milliseconds::zero());
     }
     catch (const std::exception& exc) 
     {
@@ -747,6 +906,10 @@ void SetConfig(const fs::path& basePath)
         Logger::log_message(L"------- START OF LOG -------");
         Logger::log_error(L"Uncaught exception while reading config file, error was \"%s\"", what.what());
         config = std::nullopt;
+        HashCache::disable();
+        SourceIndexCache::disable();
+        // still read when LunarHelper rebuilds the ROM, nothing updates it without a config though
+        BuildReportStore::enable(buildReportPath, std::chrono::milliseconds::zero());
     }
 }
 #if LM_VERSION >= 331
@@ -761,7 +924,7 @@ BOOL SaveLevelFunction(DWORD x)
     BOOL succeeded = LMSaveLevelFunction(x);
 #endif
 
-    std::thread([&]() { OnLevelSave::onLevelSave(succeeded, lm.getLevelEditor().getLevelNumberBeingSaved(), lm, config); }).detach();
+    ExportScheduler::enqueue({ ExportJobType::Level, succeeded != FALSE, config, lm.getLevelEditor().getLevelNumberBeingSaved() });
 
     return succeeded;
 }
@@ -788,7 +951,7 @@ BOOL SaveMap16Function()
     }
 #endif
 
-    std::thread([&]() { OnMap16Save::onMap16Save(succeeded, lm, config); }).detach();
+    ExportScheduler::enqueue({ ExportJobType::Map16, succeeded != FALSE, config });
 
     return succeeded;
 }
@@ -802,7 +965,7 @@ BOOL SaveOWFunction()
 #endif
     BOOL succeeded = LMSaveOWFunction();
 
-    std::thread([&]() { OnGlobalDataSave::onGlobalDataSave(succeeded, lm, config); }).detach();
+    ExportScheduler::enqueue({ ExportJobType::GlobalData, succeeded != FALSE, config });
 
     return succeeded;
 }
@@ -820,7 +983,7 @@ BOOL SaveTitlescreenFunction()
 #endif
     BOOL succeeded = LMSaveTitlescreenFunction();
 
-    std::thread([&]() { OnGlobalDataSave::onGlobalDataSave(succeeded, lm, config); }).detach();
+    ExportScheduler::enqueue({ ExportJobType::GlobalData, succeeded != FALSE, config });
 
     return succeeded;
 }
@@ -829,7 +992,7 @@ BOOL SaveCreditsFunction()
 {
     BOOL succeeded = LMSaveCreditsFunction();
 
-    std::thread([&]() { OnGlobalDataSave::onGlobalDataSave(succeeded, lm, config); }).detach();
+    ExportScheduler::enqueue({ ExportJobType::GlobalData, succeeded != FALSE, config });
 
     return succeeded;
 }
@@ -854,7 +1017,7 @@ BOOL SaveSharedPalettesFunction(BOOL x)
     }
 #endif
 
-    std::thread([&]() { OnSharedPalettesSave::onSharedPalettesSave(succeeded, lm, config); }).detach();
+    ExportScheduler::enqueue({ ExportJobType::SharedPalettes, succeeded != FALSE, config });
 
     return succeeded;
 }
@@ -32,71 +32,96 @@ documentation and/or software.
 
 /* interface header */
 #include "md5.h"
+#include "HashCache.h"
+#include "md5_multibuffer.h"
+#include "md5_tables.h"
 
 /* system implementation headers */
 #include <cstdio>
 
 #include <algorithm>
+#include <condition_variable>
 #include <fstream>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
-// Constants for MD5Transform routine.
-#define S11 7
-#define S12 12
-#define S13 17
-#define S14 22
-#define S21 5
-#define S22 9
-#define S23 14
-#define S24 20
-#define S31 4
-#define S32 11
-#define S33 16
-#define S34 23
-#define S41 6
-#define S42 10
-#define S43 15
-#define S44 21
+#include <Windows.h>
 
-///////////////////////////////////////////////
+// size of the reusable buffer files are streamed through while hashing
+constexpr DWORD FILE_READ_BLOCK_SIZE = 256 * 1024;
 
-// F, G, H and I are basic MD5 functions.
-inline MD5::uint4 MD5::F(uint4 x, uint4 y, uint4 z) {
-    return x & y | ~x & z;
-}
+// size of a single view when hashing memory mapped files, must be a multiple
+// of the system allocation granularity (64 KB)
+constexpr size_t FILE_MAP_VIEW_SIZE = 4 * 1024 * 1024;
 
-inline MD5::uint4 MD5::G(uint4 x, uint4 y, uint4 z) {
-    return x & z | y & ~z;
-}
+// folder hashing reads up to this many files ahead of the md5 chain on at most
+// this many worker threads, files larger than the size limit are not read ahead
+// and get streamed by the hashing thread instead, bounding memory use
+constexpr size_t READ_AHEAD_WINDOW = 32;
+constexpr size_t READ_AHEAD_MAX_WORKERS = 4;
+constexpr unsigned long long READ_AHEAD_MAX_FILE_SIZE = 1024 * 1024;
 
-inline MD5::uint4 MD5::H(uint4 x, uint4 y, uint4 z) {
-    return x ^ y ^ z;
-}
+// below this many files to hash, threads cost more than they save
+constexpr size_t READ_AHEAD_MIN_FILES = 8;
 
-inline MD5::uint4 MD5::I(uint4 x, uint4 y, uint4 z) {
-    return y ^ (x | ~z);
-}
+// how many bytes of small files md5Files holds in memory per multi-buffer batch
+constexpr size_t MULTI_BUFFER_BATCH_SIZE = 8 * 1024 * 1024;
 
-// rotate_left rotates x left n bits.
-inline MD5::uint4 MD5::rotate_left(uint4 x, int n) {
-    return (x << n) | (x >> (32 - n));
-}
+///////////////////////////////////////////////
 
-// FF, GG, HH, and II transformations for rounds 1, 2, 3, and 4.
-// Rotation is separate from addition to prevent recomputation.
-inline void MD5::FF(uint4& a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac) {
-    a = rotate_left(a + F(b, c, d) + x + ac, s) + b;
-}
+namespace
+{
+    inline uint32_t rotate_left(uint32_t x, int n)
+    {
+        return (x << n) | (x >> (32 - n));
+    }
 
-inline void MD5::GG(uint4& a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac) {
-    a = rotate_left(a + G(b, c, d) + x + ac, s) + b;
-}
+    // message words are read straight out of the block, which only works
+    // because x86 is little-endian, same as md5's byte order
+    inline uint32_t load_word(const unsigned char* block, int index)
+    {
+        uint32_t word;
+        memcpy(&word, block + index * 4, sizeof(word));
+        return word;
+    }
 
-inline void MD5::HH(uint4& a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac) {
-    a = rotate_left(a + H(b, c, d) + x + ac, s) + b;
-}
+    // round function of step I, F, G, H and I from the RFC
+    template <size_t I>
+    inline uint32_t round_function(uint32_t b, uint32_t c, uint32_t d)
+    {
+        if constexpr (I < 16)
+            return d ^ (b & (c ^ d));
+        else if constexpr (I < 32)
+            return c ^ (d & (b ^ c));
+        else if constexpr (I < 48)
+            return b ^ c ^ d;
+        else
+            return c ^ (b | ~d);
+    }
+
+    // step I of the 64, the roles of a, b, c and d rotate through v every step
+    // so no values have to be shuffled around between steps
+    template <size_t I>
+    inline void step(uint32_t (&v)[4], const unsigned char* block)
+    {
+        uint32_t& a = v[(64 - I) % 4];
+        const uint32_t b = v[(65 - I) % 4];
+        const uint32_t c = v[(66 - I) % 4];
+        const uint32_t d = v[(67 - I) % 4];
+
+        a = b + rotate_left(a + round_function<I>(b, c, d) + load_word(block, md5_tables::W[I]) + md5_tables::K[I],
+            md5_tables::S[I]);
+    }
 
-inline void MD5::II(uint4& a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac) {
-    a = rotate_left(a + I(b, c, d) + x + ac, s) + b;
+    // all 64 steps, expanded at compile time
+    template <size_t... I>
+    inline void all_steps(uint32_t (&v)[4], const unsigned char* block, std::index_sequence<I...>)
+    {
+        (step<I>(v, block), ...);
+    }
 }
 
 //////////////////////////////////////////////
@@ -119,28 +144,47 @@ MD5::MD5(const std::string& text)
 
 //////////////////////////////
 
-void MD5::init()
+// resume a hash from a checkpoint taken with checkpoint()
+MD5::MD5(const Checkpoint& checkpoint)
 {
-    finalized = false;
+    init();
 
-    count[0] = 0;
-    count[1] = 0;
+    memcpy(state, checkpoint.state, sizeof state);
+    count = checkpoint.count;
+    memcpy(buffer, checkpoint.buffer, static_cast<size_t>(checkpoint.bufferedLength()));
+}
 
-    // load magic initialization constants.
-    state[0] = 0x67452301;
-    state[1] = 0xefcdab89;
-    state[2] = 0x98badcfe;
-    state[3] = 0x10325476;
+//////////////////////////////
+
+MD5::size_type MD5::Checkpoint::bufferedLength() const
+{
+    return count / 8 % blocksize;
 }
 
 //////////////////////////////
 
-// decodes input (unsigned char) into output (uint4). Assumes len is a multiple of 4.
-void MD5::decode(uint4 output[], const uint1 input[], size_type len)
+// capture the intermediate state so hashing can later resume from this point
+MD5::Checkpoint MD5::checkpoint() const
 {
-    for (unsigned int i = 0, j = 0; j < len; i++, j += 4)
-        output[i] = ((uint4)input[j]) | (((uint4)input[j + 1]) << 8) |
-        (((uint4)input[j + 2]) << 16) | (((uint4)input[j + 3]) << 24);
+    Checkpoint checkpoint{};
+
+    memcpy(checkpoint.state, state, sizeof state);
+    checkpoint.count = count;
+    memcpy(checkpoint.buffer, buffer, static_cast<size_t>(checkpoint.bufferedLength()));
+
+    return checkpoint;
+}
+
+//////////////////////////////
+
+void MD5::init()
+{
+    finalized = false;
+
+    count = 0;
+
+    // load magic initialization constants.
+    memcpy(state, md5_tables::INITIAL_STATE, sizeof state);
 }
 
 //////////////////////////////
@@ -162,88 +206,14 @@ void MD5::encode(uint1 output[], const uint4 input[], size_type len)
 // apply MD5 algo on a block
 void MD5::transform(const uint1 block[blocksize])
 {
-    uint4 a = state[0], b = state[1], c = state[2], d = state[3], x[16];
-    decode(x, block, blocksize);
-
-    /* Round 1 */
-    FF(a, b, c, d, x[0], S11, 0xd76aa478); /* 1 */
-    FF(d, a, b, c, x[1], S12, 0xe8c7b756); /* 2 */
-    FF(c, d, a, b, x[2], S13, 0x242070db); /* 3 */
-    FF(b, c, d, a, x[3], S14, 0xc1bdceee); /* 4 */
-    FF(a, b, c, d, x[4], S11, 0xf57c0faf); /* 5 */
-    FF(d, a, b, c, x[5], S12, 0x4787c62a); /* 6 */
-    FF(c, d, a, b, x[6], S13, 0xa8304613); /* 7 */
-    FF(b, c, d, a, x[7], S14, 0xfd469501); /* 8 */
-    FF(a, b, c, d, x[8], S11, 0x698098d8); /* 9 */
-    FF(d, a, b, c, x[9], S12, 0x8b44f7af); /* 10 */
-    FF(c, d, a, b, x[10], S13, 0xffff5bb1); /* 11 */
-    FF(b, c, d, a, x[11], S14, 0x895cd7be); /* 12 */
-    FF(a, b, c, d, x[12], S11, 0x6b901122); /* 13 */
-    FF(d, a, b, c, x[13], S12, 0xfd987193); /* 14 */
-    FF(c, d, a, b, x[14], S13, 0xa679438e); /* 15 */
-    FF(b, c, d, a, x[15], S14, 0x49b40821); /* 16 */
-
-    /* Round 2 */
-    GG(a, b, c, d, x[1], S21, 0xf61e2562); /* 17 */
-    GG(d, a, b, c, x[6], S22, 0xc040b340); /* 18 */
-    GG(c, d, a, b, x[11], S23, 0x265e5a51); /* 19 */
-    GG(b, c, d, a, x[0], S24, 0xe9b6c7aa); /* 20 */
-    GG(a, b, c, d, x[5], S21, 0xd62f105d); /* 21 */
-    GG(d, a, b, c, x[10], S22, 0x2441453); /* 22 */
-    GG(c, d, a, b, x[15], S23, 0xd8a1e681); /* 23 */
-    GG(b, c, d, a, x[4], S24, 0xe7d3fbc8); /* 24 */
-    GG(a, b, c, d, x[9], S21, 0x21e1cde6); /* 25 */
-    GG(d, a, b, c, x[14], S22, 0xc33707d6); /* 26 */
-    GG(c, d, a, b, x[3], S23, 0xf4d50d87); /* 27 */
-    GG(b, c, d, a, x[8], S24, 0x455a14ed); /* 28 */
-    GG(a, b, c, d, x[13], S21, 0xa9e3e905); /* 29 */
-    GG(d, a, b, c, x[2], S22, 0xfcefa3f8); /* 30 */
-    GG(c, d, a, b, x[7], S23, 0x676f02d9); /* 31 */
-    GG(b, c, d, a, x[12], S24, 0x8d2a4c8a); /* 32 */
-
-    /* Round 3 */
-    HH(a, b, c, d, x[5], S31, 0xfffa3942); /* 33 */
-    HH(d, a, b, c, x[8], S32, 0x8771f681); /* 34 */
-    HH(c, d, a, b, x[11], S33, 0x6d9d6122); /* 35 */
-    HH(b, c, d, a, x[14], S34, 0xfde5380c); /* 36 */
-    HH(a, b, c, d, x[1], S31, 0xa4beea44); /* 37 */
-    HH(d, a, b, c, x[4], S32, 0x4bdecfa9); /* 38 */
-    HH(c, d, a, b, x[7], S33, 0xf6bb4b60); /* 39 */
-    HH(b, c, d, a, x[10], S34, 0xbebfbc70); /* 40 */
-    HH(a, b, c, d, x[13], S31, 0x289b7ec6); /* 41 */
-    HH(d, a, b, c, x[0], S32, 0xeaa127fa); /* 42 */
-    HH(c, d, a, b, x[3], S33, 0xd4ef3085); /* 43 */
-    HH(b, c, d, a, x[6], S34, 0x4881d05); /* 44 */
-    HH(a, b, c, d, x[9], S31, 0xd9d4d039); /* 45 */
-    HH(d, a, b, c, x[12], S32, 0xe6db99e5); /* 46 */
-    HH(c, d, a, b, x[15], S33, 0x1fa27cf8); /* 47 */
-    HH(b, c, d, a, x[2], S34, 0xc4ac5665); /* 48 */
-
-    /* Round 4 */
-    II(a, b, c, d, x[0], S41, 0xf4292244); /* 49 */
-    II(d, a, b, c, x[7], S42, 0x432aff97); /* 50 */
-    II(c, d, a, b, x[14], S43, 0xab9423a7); /* 51 */
-    II(b, c, d, a, x[5], S44, 0xfc93a039); /* 52 */
-    II(a, b, c, d, x[12], S41, 0x655b59c3); /* 53 */
-    II(d, a, b, c, x[3], S42, 0x8f0ccc92); /* 54 */
-    II(c, d, a, b, x[10], S43, 0xffeff47d); /* 55 */
-    II(b, c, d, a, x[1], S44, 0x85845dd1); /* 56 */
-    II(a, b, c, d, x[8], S41, 0x6fa87e4f); /* 57 */
-    II(d, a, b, c, x[15], S42, 0xfe2ce6e0); /* 58 */
-    II(c, d, a, b, x[6], S43, 0xa3014314); /* 59 */
-    II(b, c, d, a, x[13], S44, 0x4e0811a1); /* 60 */
-    II(a, b, c, d, x[4], S41, 0xf7537e82); /* 61 */
-    II(d, a, b, c, x[11], S42, 0xbd3af235); /* 62 */
-    II(c, d, a, b, x[2], S43, 0x2ad7d2bb); /* 63 */
-    II(b, c, d, a, x[9], S44, 0xeb86d391); /* 64 */
-
-    state[0] += a;
-    state[1] += b;
-    state[2] += c;
-    state[3] += d;
-
-    // Zeroize sensitive information.
-    memset(x, 0, sizeof x);
+    uint4 v[4] = { state[0], state[1], state[2], state[3] };
+
+    all_steps(v, block, std::make_index_sequence<64>{});
+
+    state[0] += v[0];
+    state[1] += v[1];
+    state[2] += v[2];
+    state[3] += v[3];
 }
 
 //////////////////////////////
@@ -253,12 +223,10 @@ void MD5::transform(const uint1 block[blocksize])
 void MD5::update(const unsigned char input[], size_type length)
 {
     // compute number of bytes mod 64
-    size_type index = count[0] / 8 % blocksize;
+    size_type index = count / 8 % blocksize;
 
     // Update number of bits
-    if ((count[0] += (length << 3)) < (length << 3))
-        count[1]++;
-    count[1] += (length >> 29);
+    count += length << 3;
 
     // number of bytes we need to fill in buffer
     size_type firstpart = 64 - index;
@@ -269,7 +237,7 @@ void MD5::update(const unsigned char input[], size_type length)
     if (length >= firstpart)
     {
         // fill buffer first, transform
-        memcpy(&buffer[index], input, firstpart);
+        memcpy(&buffer[index], input, static_cast<size_t>(firstpart));
         transform(buffer);
 
         // transform chunks of blocksize (64 bytes)
@@ -282,7 +250,7 @@ void MD5::update(const unsigned char input[], size_type length)
         i = 0;
 
     // buffer remaining input
-    memcpy(&buffer[index], &input[i], length - i);
+    memcpy(&buffer[index], &input[i], static_cast<size_t>(length - i));
 }
 
 //////////////////////////////
@@ -308,10 +276,11 @@ MD5& MD5::finalize()
     if (!finalized) {
         // Save number of bits
         unsigned char bits[8];
-        encode(bits, count, 8);
+        const uint4 countWords[2] = { static_cast<uint4>(count), static_cast<uint4>(count >> 32) };
+        encode(bits, countWords, 8);
 
         // pad out to 56 mod 64.
-        size_type index = count[0] / 8 % 64;
+        size_type index = count / 8 % 64;
         size_type padLen = (index < 56) ? (56 - index) : (120 - index);
         update(padding, padLen);
 
@@ -323,7 +292,7 @@ MD5& MD5::finalize()
 
         // Zeroize sensitive information.
         memset(buffer, 0, sizeof buffer);
-        memset(count, 0, sizeof count);
+        count = 0;
 
         finalized = true;
     }
@@ -357,63 +326,488 @@ std::ostream& operator<<(std::ostream& out, MD5 md5)
 
 //////////////////////////////
 
-std::string md5File(const fs::path path)
+namespace
 {
-    std::ifstream input(path, std::ios::binary);
-    std::string bytes(
-        (std::istreambuf_iterator<char>(input)),
-        (std::istreambuf_iterator<char>())
-    );
-    input.close();
+    // closes a win32 handle when it goes out of scope
+    class ScopedHandle
+    {
+    public:
+        explicit ScopedHandle(HANDLE handle) : handle(handle) {}
+        ScopedHandle(const ScopedHandle&) = delete;
+        ScopedHandle& operator=(const ScopedHandle&) = delete;
+        ~ScopedHandle()
+        {
+            if (isValid())
+                CloseHandle(handle);
+        }
 
-    MD5 md5 = MD5(bytes);
+        bool isValid() const { return handle != NULL && handle != INVALID_HANDLE_VALUE; }
+        HANDLE get() const { return handle; }
 
-    return md5.hexdigest();
+    private:
+        HANDLE handle;
+    };
+
+    HANDLE openForSequentialRead(const fs::path& path)
+    {
+        return CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    }
+
+    // one block buffer per thread, reused for every file that thread hashes
+    std::vector<char>& getReadBuffer()
+    {
+        thread_local std::vector<char> buffer(FILE_READ_BLOCK_SIZE);
+        return buffer;
+    }
+
+    // feeds the contents of a file into md5 in large sequential reads,
+    // a missing or unreadable file contributes no bytes
+    void updateFromFileBuffered(MD5& md5, const fs::path& path)
+    {
+        ScopedHandle file(openForSequentialRead(path));
+
+        if (!file.isValid())
+            return;
+
+        std::vector<char>& buffer = getReadBuffer();
+        DWORD read;
+
+        while (ReadFile(file.get(), buffer.data(), FILE_READ_BLOCK_SIZE, &read, NULL) && read != 0)
+        {
+            md5.update(buffer.data(), read);
+        }
+    }
+
+    // feeds the contents of a file into md5 through a series of bounded
+    // read-only views, returns false if the file couldn't be mapped, in which
+    // case md5 may already have consumed part of the file and must be discarded
+    bool updateFromFileMapped(MD5& md5, const fs::path& path)
+    {
+        ScopedHandle file(openForSequentialRead(path));
+
+        if (!file.isValid())
+            return true;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file.get(), &fileSize) || fileSize.QuadPart == 0)
+            return true;
+
+        ScopedHandle mapping(CreateFileMappingW(file.get(), NULL, PAGE_READONLY, 0, 0, NULL));
+
+        if (!mapping.isValid())
+            return false;
+
+        const unsigned long long totalSize = static_cast<unsigned long long>(fileSize.QuadPart);
+
+        for (unsigned long long offset = 0; offset < totalSize; offset += FILE_MAP_VIEW_SIZE)
+        {
+            const size_t viewSize = static_cast<size_t>((std::min)(
+                static_cast<unsigned long long>(FILE_MAP_VIEW_SIZE), totalSize - offset));
+
+            const void* view = MapViewOfFile(mapping.get(), FILE_MAP_READ,
+                static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset & 0xFFFFFFFF), viewSize);
+
+            if (view == NULL)
+                return false;
+
+            md5.update(static_cast<const unsigned char*>(view), static_cast<MD5::size_type>(viewSize));
+            UnmapViewOfFile(view);
+        }
+
+        return true;
+    }
+
+    // reads whole (small) files into memory, returns false if the file is too
+    // large to be read ahead, a missing or unreadable file reads as empty
+    bool readWholeFile(const fs::path& path, std::vector<char>& contents)
+    {
+        contents.clear();
+
+        ScopedHandle file(openForSequentialRead(path));
+
+        if (!file.isValid())
+            return true;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file.get(), &fileSize))
+            return true;
+
+        if (static_cast<unsigned long long>(fileSize.QuadPart) > READ_AHEAD_MAX_FILE_SIZE)
+            return false;
+
+        contents.resize(static_cast<size_t>(fileSize.QuadPart));
+
+        size_t total = 0;
+        DWORD read;
+
+        while (total != contents.size() &&
+            ReadFile(file.get(), contents.data() + total, static_cast<DWORD>(contents.size() - total), &read, NULL) &&
+            read != 0)
+        {
+            total += read;
+        }
+
+        contents.resize(total);
+        return true;
+    }
+
+    // reads files on worker threads ahead of a single consumer that needs them
+    // strictly in order, at most READ_AHEAD_WINDOW files past the one being
+    // consumed are ever held in memory
+    class ReadAheadQueue
+    {
+    public:
+        ReadAheadQueue(const std::vector<fs::path>& paths, size_t first) :
+            paths(paths), slots(paths.size()), nextToRead(first), nextToConsume(first)
+        {
+            const size_t workerCount = (std::min)(READ_AHEAD_MAX_WORKERS,
+                static_cast<size_t>((std::max)(std::thread::hardware_concurrency(), 1u)));
+
+            for (size_t i = 0; i != workerCount; ++i)
+            {
+                workers.emplace_back(&ReadAheadQueue::work, this);
+            }
+        }
+
+        ReadAheadQueue(const ReadAheadQueue&) = delete;
+        ReadAheadQueue& operator=(const ReadAheadQueue&) = delete;
+
+        ~ReadAheadQueue()
+        {
+            {
+                std::lock_guard lock{ mutex };
+                stopping = true;
+            }
+            slotFreed.notify_all();
+
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+        }
+
+        // feeds file index into md5, indices must be consumed in ascending order
+        void consume(size_t index, MD5& md5)
+        {
+            std::unique_lock lock{ mutex };
+            slotFilled.wait(lock, [&] { return slots[index].state != Slot::State::Pending; });
+
+            Slot slot = std::move(slots[index]);
+            slots[index] = Slot();
+            nextToConsume = index + 1;
+
+            lock.unlock();
+            slotFreed.notify_all();
+
+            if (slot.state == Slot::State::TooLarge)
+                updateFromFileBuffered(md5, paths[index]);
+            else
+                md5.update(slot.contents.data(), static_cast<MD5::size_type>(slot.contents.size()));
+        }
+
+    private:
+        struct Slot
+        {
+            enum class State { Pending, Read, TooLarge };
+
+            State state = State::Pending;
+            std::vector<char> contents;
+        };
+
+        void work()
+        {
+            while (true)
+            {
+                std::unique_lock lock{ mutex };
+                slotFreed.wait(lock, [&] {
+                    return stopping || nextToRead == paths.size() || nextToRead < nextToConsume + READ_AHEAD_WINDOW;
+                });
+
+                if (stopping || nextToRead == paths.size())
+                    return;
+
+                const size_t index = nextToRead++;
+                lock.unlock();
+
+                Slot slot;
+                slot.state = readWholeFile(paths[index], slot.contents) ? Slot::State::Read : Slot::State::TooLarge;
+
+                lock.lock();
+                slots[index] = std::move(slot);
+                lock.unlock();
+
+                slotFilled.notify_all();
+            }
+        }
+
+        const std::vector<fs::path>& paths;
+        std::vector<Slot> slots;
+        size_t nextToRead;
+        size_t nextToConsume;
+        bool stopping = false;
+
+        std::mutex mutex;
+        std::condition_variable slotFilled;
+        std::condition_variable slotFreed;
+        std::vector<std::thread> workers;
+    };
+
+    void collectFiles(const fs::path& directory, std::vector<fs::path>& files)
+    {
+        for (auto entry = fs::recursive_directory_iterator(directory);
+            entry != fs::recursive_directory_iterator();
+            ++entry
+            )
+        {
+            if (!entry->is_directory())
+            {
+                files.push_back(entry->path());
+            }
+        }
+    }
+
+    // lists every file below rootPath, each top level subdirectory is walked on
+    // its own thread since directory enumeration is mostly waiting on the disk
+    std::vector<fs::path> enumerateFiles(const fs::path& rootPath)
+    {
+        std::vector<fs::path> files;
+        std::vector<std::future<std::vector<fs::path>>> subdirectories;
+
+        for (const auto& entry : fs::directory_iterator(rootPath))
+        {
+            if (entry.is_directory())
+            {
+                subdirectories.push_back(std::async(std::launch::async, [path = entry.path()]() {
+                    std::vector<fs::path> subdirectoryFiles;
+                    collectFiles(path, subdirectoryFiles);
+                    return subdirectoryFiles;
+                }));
+            }
+            else
+            {
+                files.push_back(entry.path());
+            }
+        }
+
+        for (auto& subdirectory : subdirectories)
+        {
+            std::vector<fs::path> subdirectoryFiles = subdirectory.get();
+            files.insert(files.end(), std::make_move_iterator(subdirectoryFiles.begin()),
+                std::make_move_iterator(subdirectoryFiles.end()));
+        }
+
+        return files;
+    }
 }
 
-std::string md5Folder(const fs::path rootPath)
+// fingerprints are always taken before any bytes are read, so if a file changes
+// while it's being hashed, the cached entry is already stale and will just miss
+
+std::string md5File(const fs::path path, FileReadMode mode)
 {
-    std::vector<fs::path> paths = std::vector<fs::path>();
+    std::optional<FileFingerprint> fingerprint = std::nullopt;
 
-    for (auto entry = fs::recursive_directory_iterator(rootPath);
-        entry != fs::recursive_directory_iterator();
-        ++entry
-        )
+    if (HashCache::isEnabled())
     {
-        if (!entry->is_directory())
+        fingerprint = HashCache::getFingerprint(path);
+
+        if (fingerprint.has_value())
         {
-            paths.push_back(entry->path());
+            const std::optional<std::string> cached = HashCache::lookup(path, fingerprint.value());
+
+            if (cached.has_value())
+                return cached.value();
         }
     }
 
-    std::sort(paths.begin(), paths.end(), [=](const fs::path& a, const fs::path& b) -> bool
+    MD5 md5 = MD5();
+
+    if (mode != FileReadMode::MemoryMapped || !updateFromFileMapped(md5, path))
+    {
+        md5 = MD5();
+        updateFromFileBuffered(md5, path);
+    }
+
+    md5.finalize();
+
+    if (fingerprint.has_value())
+        HashCache::store(path, fingerprint.value(), md5.hexdigest());
+
+    return md5.hexdigest();
+}
+
+std::vector<std::string> md5Files(const std::vector<fs::path>& paths)
+{
+    std::vector<std::string> digests(paths.size());
+
+    const bool useCache = HashCache::isEnabled();
+    std::vector<std::optional<FileFingerprint>> fingerprints(paths.size());
+
+    std::vector<size_t> batchIndices;
+    std::vector<std::vector<char>> batchContents;
+    size_t batchSize = 0;
+
+    const auto hashBatch = [&]() {
+        std::vector<MultiBufferMD5::Message> messages;
+        messages.reserve(batchContents.size());
+
+        for (const auto& contents : batchContents)
         {
-            std::string strA = a.string();
-            std::string strB = b.string();
+            messages.push_back({ reinterpret_cast<const unsigned char*>(contents.data()), contents.size() });
+        }
 
-            std::transform(strA.begin(), strA.end(), strA.begin(), ::tolower);
-            std::transform(strB.begin(), strB.end(), strB.begin(), ::tolower);
+        const std::vector<MultiBufferMD5::Digest> batchDigests = MultiBufferMD5::hash(messages);
 
-            return strA < strB;
+        for (size_t i = 0; i != batchIndices.size(); ++i)
+        {
+            char buf[33];
+            for (int j = 0; j < 16; j++)
+                sprintf(buf + j * 2, "%02x", batchDigests[i][j]);
+            buf[32] = 0;
+
+            const size_t index = batchIndices[i];
+            digests[index] = buf;
+
+            if (fingerprints[index].has_value())
+                HashCache::store(paths[index], fingerprints[index].value(), digests[index]);
+        }
+
+        batchIndices.clear();
+        batchContents.clear();
+        batchSize = 0;
+    };
+
+    for (size_t i = 0; i != paths.size(); ++i)
+    {
+        if (useCache)
+        {
+            fingerprints[i] = HashCache::getFingerprint(paths[i]);
+
+            if (fingerprints[i].has_value())
+            {
+                const std::optional<std::string> cached = HashCache::lookup(paths[i], fingerprints[i].value());
+
+                if (cached.has_value())
+                {
+                    digests[i] = cached.value();
+                    continue;
+                }
+            }
+        }
+
+        std::vector<char> contents;
+
+        if (!readWholeFile(paths[i], contents))
+        {
+            digests[i] = md5File(paths[i]);
+            continue;
+        }
+
+        batchSize += contents.size();
+        batchIndices.push_back(i);
+        batchContents.push_back(std::move(contents));
+
+        if (batchSize >= MULTI_BUFFER_BATCH_SIZE)
+            hashBatch();
+    }
+
+    if (!batchIndices.empty())
+        hashBatch();
+
+    return digests;
+}
+
+std::string md5Folder(const fs::path rootPath)
+{
+    // sort keys are lowercased once up front instead of inside the comparator
+    struct FolderFile
+    {
+        std::string sortKey;
+        fs::path path;
+    };
+
+    std::vector<FolderFile> files;
+
+    for (auto& path : enumerateFiles(rootPath))
+    {
+        std::string sortKey = path.string();
+        std::transform(sortKey.begin(), sortKey.end(), sortKey.begin(), ::tolower);
+        files.push_back({ std::move(sortKey), std::move(path) });
+    }
+
+    std::sort(files.begin(), files.end(), [](const FolderFile& a, const FolderFile& b) -> bool
+        {
+            return a.sortKey < b.sortKey;
         });
 
-    MD5 md5 = MD5();
+    std::vector<fs::path> paths;
+    std::vector<std::string> relativePaths;
+    paths.reserve(files.size());
+    relativePaths.reserve(files.size());
+
+    for (auto& file : files)
+    {
+        relativePaths.push_back(file.sortKey.substr(rootPath.string().length() + 1, std::string::npos));
+        paths.push_back(std::move(file.path));
+    }
+
+    // the whole folder is a single md5 chain, so with checkpoints from a previous run
+    // we can skip straight past every leading file that is still the same
+    const bool useCache = HashCache::isEnabled();
+    std::vector<FolderHashCheckpoint> checkpoints;
+    std::vector<std::optional<FileFingerprint>> fingerprints(paths.size());
+    size_t resumeIndex = 0;
+    size_t storedCount = 0;
+
+    if (useCache)
+    {
+        checkpoints = HashCache::lookupFolder(rootPath);
+        storedCount = checkpoints.size();
+
+        for (size_t i = 0; i != paths.size(); ++i)
+        {
+            fingerprints[i] = HashCache::getFingerprint(paths[i]);
+        }
+
+        while (resumeIndex != paths.size() && resumeIndex != checkpoints.size() &&
+            fingerprints[resumeIndex].has_value() &&
+            checkpoints[resumeIndex].relativePath == relativePaths[resumeIndex] &&
+            checkpoints[resumeIndex].fingerprint == fingerprints[resumeIndex].value())
+        {
+            ++resumeIndex;
+        }
+
+        checkpoints.resize(resumeIndex);
+    }
+
+    MD5 md5 = resumeIndex == 0 ? MD5() : MD5(checkpoints.back().checkpoint);
 
-    for (const auto& path : paths)
+    std::optional<ReadAheadQueue> readAhead = std::nullopt;
+
+    if (paths.size() - resumeIndex >= READ_AHEAD_MIN_FILES)
+        readAhead.emplace(paths, resumeIndex);
+
+    for (size_t i = resumeIndex; i != paths.size(); ++i)
     {
-        std::string relativePath = path.string().substr(rootPath.string().length() + 1, std::string::npos);
-        std::transform(relativePath.begin(), relativePath.end(), relativePath.begin(), ::tolower);
+        md5.update(relativePaths[i].c_str(), relativePaths[i].length());
 
-        md5.update(relativePath.c_str(), relativePath.length());
+        if (readAhead.has_value())
+            readAhead->consume(i, md5);
+        else
+            updateFromFileBuffered(md5, paths[i]);
 
-        std::ifstream input(path, std::ios::binary);
-        std::string bytes(
-            (std::istreambuf_iterator<char>(input)),
-            (std::istreambuf_iterator<char>())
-        );
-        input.close();
+        // a file we couldn't fingerprint can't be validated later, so nothing
+        // after it is worth checkpointing either
+        if (useCache && checkpoints.size() == i && fingerprints[i].has_value())
+        {
+            checkpoints.push_back({ relativePaths[i], fingerprints[i].value(), md5.checkpoint() });
+        }
+    }
 
-        md5.update(bytes.c_str(), bytes.length());
+    if (useCache && (resumeIndex != paths.size() || storedCount != paths.size()))
+    {
+        HashCache::storeFolder(rootPath, std::move(checkpoints));
     }
 
     md5.finalize();
@@ -39,10 +39,11 @@ documentation and/or software.
 namespace fs = std::filesystem;
 #include <iostream>
 #include <optional>
+#include <vector>
 
 
 // a small class for calculating MD5 hashes of strings or byte arrays
-// it is not meant to be fast or secure
+// it is not meant to be secure
 //
 // usage: 1) feed it blocks of uchars with update()
 //      2) finalize()
@@ -50,50 +51,65 @@ namespace fs = std::filesystem;
 //      or
 //      MD5(std::string).hexdigest()
 //
-// assumes that char is 8 bit and int is 32 bit
+// assumes that char is 8 bit, int is 32 bit and the target is little-endian
 class MD5
 {
 public:
-	typedef unsigned int size_type; // must be 32bit
+	typedef unsigned long long size_type; // 64bit, inputs aren't capped at 4 GB
+
+	// intermediate state of an unfinalized hash, a hash restored from it
+	// continues exactly where the original left off
+	struct Checkpoint
+	{
+		unsigned int state[4];
+		unsigned long long count;
+		unsigned char buffer[64];
+
+		// number of bytes in buffer that are actually in use
+		size_type bufferedLength() const;
+	};
 
 	MD5();
 	MD5(const std::string& text);
+	MD5(const Checkpoint& checkpoint);
 	void update(const unsigned char* buf, size_type length);
 	void update(const char* buf, size_type length);
+	Checkpoint checkpoint() const;
 	MD5& finalize();
 	std::string hexdigest() const;
 	friend std::ostream& operator<<(std::ostream&, MD5 md5);
 
 private:
 	void init();
-	typedef unsigned char uint1; //  8bit
-	typedef unsigned int uint4;  // 32bit
+	typedef unsigned char uint1;      //  8bit
+	typedef unsigned int uint4;       // 32bit
+	typedef unsigned long long uint8; // 64bit
 	enum { blocksize = 64 }; // VC6 won't eat a const static int here
 
 	void transform(const uint1 block[blocksize]);
-	static void decode(uint4 output[], const uint1 input[], size_type len);
 	static void encode(uint1 output[], const uint4 input[], size_type len);
 
 	bool finalized;
 	uint1 buffer[blocksize]; // bytes that didn't fit in last 64 byte chunk
-	uint4 count[2];   // 64bit counter for number of bits (lo, hi)
+	uint8 count;      // number of bits hashed so far
 	uint4 state[4];   // digest so far
 	uint1 digest[16]; // the result
+};
 
-	// low level logic operations
-	static inline uint4 F(uint4 x, uint4 y, uint4 z);
-	static inline uint4 G(uint4 x, uint4 y, uint4 z);
-	static inline uint4 H(uint4 x, uint4 y, uint4 z);
-	static inline uint4 I(uint4 x, uint4 y, uint4 z);
-	static inline uint4 rotate_left(uint4 x, int n);
-	static inline void FF(uint4& a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac);
-	static inline void GG(uint4& a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac);
-	static inline void HH(uint4& a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac);
-	static inline void II(uint4& a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac);
+// how file contents are fed into the hash, buffered reads go through a reusable
+// fixed size block buffer, memory mapped reads map the file in bounded views so
+// large ROMs don't have to fit into the address space all at once
+enum class FileReadMode
+{
+	Buffered,
+	MemoryMapped
 };
 
 std::string md5Folder(const fs::path rootPath);
-std::string md5File(const fs::path path);
+std::string md5File(const fs::path path, FileReadMode mode = FileReadMode::Buffered);
+// hashes many independent files, small ones several at a time on simd lanes,
+// digests are returned in the same order as the paths
+std::vector<std::string> md5Files(const std::vector<fs::path>& paths);
 std::optional<std::string> md5IfExists(const fs::path path);
 
 #endif
@@ -0,0 +1,302 @@
+#include "md5_multibuffer.h"
+#include "md5_tables.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	using md5_tables::K;
+	using md5_tables::S;
+	using md5_tables::W;
+	using md5_tables::INITIAL_STATE;
+
+	constexpr size_t BLOCK_SIZE = 64;
+
+	// lane operations, each backend provides the same set over its vector type
+
+	struct ScalarLanes
+	{
+		static constexpr size_t count = 1;
+		using Vec = uint32_t;
+
+		static Vec load(const uint32_t* p) { return *p; }
+		static void store(uint32_t* p, Vec v) { *p = v; }
+		static Vec set(uint32_t x) { return x; }
+		static Vec add(Vec a, Vec b) { return a + b; }
+		static Vec bitAnd(Vec a, Vec b) { return a & b; }
+		static Vec bitOr(Vec a, Vec b) { return a | b; }
+		static Vec bitXor(Vec a, Vec b) { return a ^ b; }
+		static Vec bitNot(Vec a) { return ~a; }
+		static Vec rotateLeft(Vec x, int n) { return (x << n) | (x >> (32 - n)); }
+		static void finish() {}
+	};
+
+	struct Sse2Lanes
+	{
+		static constexpr size_t count = 4;
+		using Vec = __m128i;
+
+		static Vec load(const uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+		static void store(uint32_t* p, Vec v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+		static Vec set(uint32_t x) { return _mm_set1_epi32(static_cast<int>(x)); }
+		static Vec add(Vec a, Vec b) { return _mm_add_epi32(a, b); }
+		static Vec bitAnd(Vec a, Vec b) { return _mm_and_si128(a, b); }
+		static Vec bitOr(Vec a, Vec b) { return _mm_or_si128(a, b); }
+		static Vec bitXor(Vec a, Vec b) { return _mm_xor_si128(a, b); }
+		static Vec bitNot(Vec a) { return _mm_xor_si128(a, _mm_set1_epi32(-1)); }
+		static Vec rotateLeft(Vec x, int n)
+		{
+			return _mm_or_si128(_mm_sll_epi32(x, _mm_cvtsi32_si128(n)), _mm_srl_epi32(x, _mm_cvtsi32_si128(32 - n)));
+		}
+		static void finish() {}
+	};
+
+	struct Avx2Lanes
+	{
+		static constexpr size_t count = 8;
+		using Vec = __m256i;
+
+		static Vec load(const uint32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+		static void store(uint32_t* p, Vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+		static Vec set(uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+		static Vec add(Vec a, Vec b) { return _mm256_add_epi32(a, b); }
+		static Vec bitAnd(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+		static Vec bitOr(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+		static Vec bitXor(Vec a, Vec b) { return _mm256_xor_si256(a, b); }
+		static Vec bitNot(Vec a) { return _mm256_xor_si256(a, _mm256_set1_epi32(-1)); }
+		static Vec rotateLeft(Vec x, int n)
+		{
+			return _mm256_or_si256(_mm256_sll_epi32(x, _mm_cvtsi32_si128(n)), _mm256_srl_epi32(x, _mm_cvtsi32_si128(32 - n)));
+		}
+		// avoid sse/avx transition penalties in whatever runs after us
+		static void finish() { _mm256_zeroupper(); }
+	};
+
+	uint32_t loadLittleEndian(const unsigned char* p)
+	{
+		return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+			(static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+	}
+
+	// one md5 block for every lane at once, words holds the 16 message words
+	// of each lane's current block, transposed so one row is one vector
+	template <typename L>
+	void transform(uint32_t (&state)[4][L::count], const uint32_t (&words)[16][L::count])
+	{
+		using Vec = typename L::Vec;
+
+		const Vec a0 = L::load(state[0]), b0 = L::load(state[1]), c0 = L::load(state[2]), d0 = L::load(state[3]);
+		Vec a = a0, b = b0, c = c0, d = d0;
+
+		for (int i = 0; i != 64; ++i)
+		{
+			Vec f;
+
+			switch (i / 16)
+			{
+			case 0:
+				f = L::bitXor(d, L::bitAnd(b, L::bitXor(c, d)));
+				break;
+			case 1:
+				f = L::bitXor(c, L::bitAnd(d, L::bitXor(b, c)));
+				break;
+			case 2:
+				f = L::bitXor(L::bitXor(b, c), d);
+				break;
+			default:
+				f = L::bitXor(c, L::bitOr(b, L::bitNot(d)));
+				break;
+			}
+
+			f = L::add(L::add(f, a), L::add(L::set(K[i]), L::load(words[W[i]])));
+
+			a = d;
+			d = c;
+			c = b;
+			b = L::add(b, L::rotateLeft(f, S[i]));
+		}
+
+		L::store(state[0], L::add(a0, a));
+		L::store(state[1], L::add(b0, b));
+		L::store(state[2], L::add(c0, c));
+		L::store(state[3], L::add(d0, d));
+	}
+
+	// a message as a sequence of 64 byte blocks, full blocks are read straight
+	// from the message, the last one or two come from a padded copy of the tail
+	struct LaneStream
+	{
+		const unsigned char* data = nullptr;
+		size_t fullBlocks = 0;
+		size_t blockCount = 0;
+		size_t nextBlock = 0;
+		unsigned char tail[2 * BLOCK_SIZE];
+
+		void reset(const MultiBufferMD5::Message& message)
+		{
+			data = message.data;
+			fullBlocks = message.length / BLOCK_SIZE;
+			nextBlock = 0;
+
+			const size_t remaining = message.length % BLOCK_SIZE;
+			const size_t tailBlocks = remaining < 56 ? 1 : 2;
+			blockCount = fullBlocks + tailBlocks;
+
+			memset(tail, 0, sizeof(tail));
+			if (remaining != 0)
+				memcpy(tail, data + fullBlocks * BLOCK_SIZE, remaining);
+			tail[remaining] = 0x80;
+
+			const uint64_t bitLength = static_cast<uint64_t>(message.length) * 8;
+			unsigned char* lengthPosition = tail + tailBlocks * BLOCK_SIZE - 8;
+			for (int i = 0; i != 8; ++i)
+				lengthPosition[i] = static_cast<unsigned char>(bitLength >> (8 * i));
+		}
+
+		const unsigned char* currentBlock() const
+		{
+			return nextBlock < fullBlocks ? data + nextBlock * BLOCK_SIZE : tail + (nextBlock - fullBlocks) * BLOCK_SIZE;
+		}
+	};
+
+	template <typename L>
+	void hashLanes(const std::vector<MultiBufferMD5::Message>& messages, std::vector<MultiBufferMD5::Digest>& digests)
+	{
+		constexpr size_t LANES = L::count;
+		constexpr size_t IDLE = SIZE_MAX;
+
+		static const unsigned char idleBlock[BLOCK_SIZE] = {};
+
+		LaneStream streams[LANES];
+		size_t laneMessage[LANES];
+		uint32_t state[4][LANES];
+		uint32_t words[16][LANES];
+
+		size_t nextMessage = 0;
+		size_t activeLanes = 0;
+
+		const auto assign = [&](size_t lane) {
+			if (nextMessage == messages.size())
+			{
+				laneMessage[lane] = IDLE;
+				return;
+			}
+
+			laneMessage[lane] = nextMessage;
+			streams[lane].reset(messages[nextMessage++]);
+
+			for (int i = 0; i != 4; ++i)
+				state[i][lane] = INITIAL_STATE[i];
+
+			++activeLanes;
+		};
+
+		for (size_t lane = 0; lane != LANES; ++lane)
+		{
+			assign(lane);
+		}
+
+		while (activeLanes != 0)
+		{
+			for (size_t lane = 0; lane != LANES; ++lane)
+			{
+				const unsigned char* block = laneMessage[lane] == IDLE ? idleBlock : streams[lane].currentBlock();
+
+				for (size_t w = 0; w != 16; ++w)
+					words[w][lane] = loadLittleEndian(block + w * 4);
+			}
+
+			transform<L>(state, words);
+
+			for (size_t lane = 0; lane != LANES; ++lane)
+			{
+				if (laneMessage[lane] == IDLE || ++streams[lane].nextBlock != streams[lane].blockCount)
+					continue;
+
+				MultiBufferMD5::Digest& digest = digests[laneMessage[lane]];
+
+				for (size_t i = 0; i != 16; ++i)
+					digest[i] = static_cast<unsigned char>(state[i / 4][lane] >> (8 * (i % 4)));
+
+				--activeLanes;
+				assign(lane);
+			}
+		}
+
+		L::finish();
+	}
+
+	bool cpuSupportsAvx2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		__cpuid(info, 1);
+		const bool osUsesXsave = (info[2] & (1 << 27)) != 0;
+		const bool hasAvx = (info[2] & (1 << 28)) != 0;
+
+		// the os also has to save the upper halves of the ymm registers for us
+		if (!osUsesXsave || !hasAvx || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	bool cpuSupportsSse2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return (info[3] & (1 << 26)) != 0;
+#else
+		return __builtin_cpu_supports("sse2");
+#endif
+	}
+}
+
+MultiBufferMD5::Backend MultiBufferMD5::getBestBackend()
+{
+	static const Backend backend = cpuSupportsAvx2() ? Backend::AVX2 : cpuSupportsSse2() ? Backend::SSE2 : Backend::Scalar;
+	return backend;
+}
+
+std::vector<MultiBufferMD5::Digest> MultiBufferMD5::hash(const std::vector<Message>& messages)
+{
+	return hash(messages, getBestBackend());
+}
+
+std::vector<MultiBufferMD5::Digest> MultiBufferMD5::hash(const std::vector<Message>& messages, Backend backend)
+{
+	std::vector<Digest> digests(messages.size());
+
+	switch (backend)
+	{
+	case Backend::AVX2:
+		hashLanes<Avx2Lanes>(messages, digests);
+		break;
+	case Backend::SSE2:
+		hashLanes<Sse2Lanes>(messages, digests);
+		break;
+	default:
+		hashLanes<ScalarLanes>(messages, digests);
+		break;
+	}
+
+	return digests;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// computes many independent md5 digests at once by running one message per simd
+// lane (4 lanes with SSE2, 8 with AVX2), meant for batches of small files where
+// a single scalar md5 chain leaves most of the cpu idle
+//
+// the backend is picked at runtime based on what the cpu supports, the scalar
+// backend runs the same lane logic one message at a time
+class MultiBufferMD5
+{
+public:
+	enum class Backend
+	{
+		Scalar,
+		SSE2,
+		AVX2
+	};
+
+	struct Message
+	{
+		const unsigned char* data;
+		size_t length;
+	};
+
+	using Digest = std::array<unsigned char, 16>;
+
+	static Backend getBestBackend();
+
+	// digests are returned in the same order as the messages
+	static std::vector<Digest> hash(const std::vector<Message>& messages);
+	static std::vector<Digest> hash(const std::vector<Message>& messages, Backend backend);
+};
@@ -182,19 +182,26 @@ std::optional<std::tuple<const fs::path, size_t>> get_lunar_magic()
 	GetModuleFileNameW(NULL, szPath, MAX_PATH);
 	const auto our_path{ fs::path{ szPath }.parent_path() / "" };
 
+	std::vector<fs::path> candidates{};
+
 	for (const auto entry : fs::directory_iterator(our_path))
 	{
 		if (!entry.is_regular_file())
 			continue;
 
-		const auto hash = md5File(entry);
+		candidates.push_back(entry);
+	}
+
+	const auto hashes = md5Files(candidates);
 
+	for (size_t i = 0; i != candidates.size(); ++i)
+	{
 		for (const auto& tup : LUNAR_MAGIC_HASHES)
 		{
-			if (std::get<const char*>(tup) == hash && std::get<size_t>(tup) > curr_version)
+			if (std::get<const char*>(tup) == hashes[i] && std::get<size_t>(tup) > curr_version)
 			{
 				curr_version = std::get<size_t>(tup);
-				curr_path = entry;
+				curr_path = candidates[i];
 			}
 		}
 	}
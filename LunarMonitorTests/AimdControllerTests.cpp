@@ -0,0 +1,166 @@
+#include "TestSupport.h"
+
+#include "AimdController.h"
+
+// the controller is handed the time instead of reading the clock, so every
+// window here is made up of jobs with the latency and busy time the test picks
+
+namespace
+{
+	using namespace std::chrono_literals;
+
+	// a window of as many jobs as the limit allows, all started together and
+	// finished busy later, each took took and wrote bytes, returns the limit
+	// the window left behind
+	size_t runWindow(AimdController& controller, AimdController::Clock::time_point& now,
+		std::chrono::milliseconds took, std::chrono::milliseconds busy, uint64_t bytes = 1000)
+	{
+		const size_t jobs = controller.getLimit();
+
+		for (size_t i = 0; i != jobs; ++i)
+			controller.onStarted(now);
+
+		now += busy;
+
+		for (size_t i = 0; i != jobs; ++i)
+		{
+			controller.onFinished(now);
+			controller.addSample(now, took, bytes);
+		}
+
+		// idle time between windows isn't busy time
+		now += 1s;
+
+		return controller.getLimit();
+	}
+
+	void testStartingLimit()
+	{
+		CHECK_EQUAL(AimdController(1, 8).getLimit(), size_t{ 2 });
+		CHECK_EQUAL(AimdController(3, 8).getLimit(), size_t{ 3 });
+		CHECK_EQUAL(AimdController(1, 1).getLimit(), size_t{ 1 });
+
+		// a ceiling below the floor is raised to it
+		CHECK_EQUAL(AimdController(4, 2).getLimit(), size_t{ 4 });
+	}
+
+	void testAdditiveIncrease()
+	{
+		AimdController controller(1, 16);
+		AimdController::Clock::time_point now{};
+
+		// steady latency, and as many more bytes per second as jobs were added
+		for (size_t expected = 3; expected != 8; ++expected)
+			CHECK_EQUAL(runWindow(controller, now, 100ms, 100ms), expected);
+
+		// a window is as many jobs as the limit was when it started, one short
+		// of it changes nothing, these run one after another so they write more
+		// each to keep up with the window before
+		const size_t limit = controller.getLimit();
+
+		for (size_t i = 0; i + 1 != limit; ++i)
+		{
+			controller.onStarted(now);
+			now += 100ms;
+			controller.onFinished(now);
+			controller.addSample(now, 100ms, 10000);
+		}
+
+		CHECK_EQUAL(controller.getLimit(), limit);
+
+		// jobs that failed or were cancelled don't count towards it
+		controller.onStarted(now);
+		now += 100ms;
+		controller.onFinished(now);
+		CHECK_EQUAL(controller.getLimit(), limit);
+
+		controller.addSample(now, 100ms, 10000);
+		CHECK_EQUAL(controller.getLimit(), limit + 1);
+	}
+
+	void testLatencyHalves()
+	{
+		AimdController controller(1, 16);
+		AimdController::Clock::time_point now{};
+
+		// the first window sets the baseline
+		CHECK_EQUAL(runWindow(controller, now, 100ms, 100ms), size_t{ 3 });
+		CHECK_EQUAL(runWindow(controller, now, 100ms, 100ms), size_t{ 4 });
+		CHECK_EQUAL(runWindow(controller, now, 100ms, 100ms), size_t{ 5 });
+		CHECK_EQUAL(runWindow(controller, now, 100ms, 100ms), size_t{ 6 });
+
+		// up to half again as slow is tolerated
+		CHECK_EQUAL(runWindow(controller, now, 150ms, 100ms), size_t{ 7 });
+
+		// the baseline only moved an eighth of the way towards 150 ms
+		CHECK_EQUAL(runWindow(controller, now, 160ms, 100ms), size_t{ 3 });
+
+		// and an eighth towards 160 ms, so 170 ms is still too slow
+		CHECK_EQUAL(runWindow(controller, now, 170ms, 100ms), size_t{ 1 });
+
+		// a faster window becomes the baseline right away
+		CHECK_EQUAL(runWindow(controller, now, 50ms, 100ms), size_t{ 2 });
+		CHECK_EQUAL(runWindow(controller, now, 80ms, 100ms), size_t{ 1 });
+	}
+
+	void testThroughputHalves()
+	{
+		AimdController controller(1, 16);
+		AimdController::Clock::time_point now{};
+
+		CHECK_EQUAL(runWindow(controller, now, 100ms, 100ms), size_t{ 3 });
+		CHECK_EQUAL(runWindow(controller, now, 100ms, 100ms), size_t{ 4 });
+
+		// four jobs busy for 130 ms write 30769 bytes a second, more than 0.9 of
+		// the 30000 three jobs wrote in 100 ms
+		CHECK_EQUAL(runWindow(controller, now, 100ms, 130ms), size_t{ 5 });
+
+		// five jobs in 190 ms write 26316, less than 0.9 of 30769, the latency
+		// jobs report didn't change but more of them got less done
+		CHECK_EQUAL(runWindow(controller, now, 100ms, 190ms), size_t{ 2 });
+
+		// with a lower limit than before less being written is expected
+		CHECK_EQUAL(runWindow(controller, now, 100ms, 1000ms), size_t{ 3 });
+	}
+
+	void testFloorAndCeiling()
+	{
+		// halving never goes below the floor
+		AimdController floored(2, 16);
+		AimdController::Clock::time_point now{};
+
+		CHECK_EQUAL(runWindow(floored, now, 100ms, 100ms), size_t{ 3 });
+		CHECK_EQUAL(runWindow(floored, now, 200ms, 100ms), size_t{ 2 });
+		CHECK_EQUAL(runWindow(floored, now, 400ms, 100ms), size_t{ 2 });
+
+		// and growing never above the ceiling
+		AimdController ceiled(1, 4);
+
+		CHECK_EQUAL(runWindow(ceiled, now, 100ms, 100ms), size_t{ 3 });
+		CHECK_EQUAL(runWindow(ceiled, now, 100ms, 100ms), size_t{ 4 });
+		CHECK_EQUAL(runWindow(ceiled, now, 100ms, 100ms), size_t{ 4 });
+
+		// at the ceiling the limit didn't go up, so less written isn't held
+		// against it
+		CHECK_EQUAL(runWindow(ceiled, now, 100ms, 400ms), size_t{ 4 });
+
+		// a lower ceiling applies right away, but not below the floor
+		ceiled.setMaxLimit(3);
+		CHECK_EQUAL(ceiled.getLimit(), size_t{ 3 });
+
+		floored.setMaxLimit(1);
+		CHECK_EQUAL(floored.getLimit(), size_t{ 2 });
+		CHECK_EQUAL(runWindow(floored, now, 100ms, 100ms), size_t{ 2 });
+	}
+}
+
+int main()
+{
+	testStartingLimit();
+	testAdditiveIncrease();
+	testLatencyHalves();
+	testThroughputHalves();
+	testFloorAndCeiling();
+
+	return test::finish();
+}
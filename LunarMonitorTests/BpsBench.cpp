@@ -0,0 +1,136 @@
+#include "BpsFuzz.h"
+#include "TestSupport.h"
+
+#include <cstdlib>
+#include <functional>
+#include <optional>
+
+#include "BpsDecoder.h"
+#include "BpsEncoder.h"
+#include "SourceIndexCache.h"
+
+// wall time and patch size for a global data save of a ROM sized target, the
+// in-process encoder from scratch and on top of the previous patch, against
+// flips --create --bps-delta if flips was found
+//
+//   BpsBench [rom size in KB] [edit count]
+
+namespace
+{
+	ByteSpan spanOf(const std::vector<unsigned char>& bytes)
+	{
+		return { bytes.data(), bytes.size() };
+	}
+
+	// what the global data export does, the patch is written to a staged path
+	// and moved over the previous one unless nothing changed
+	bool exportPatch(const fs::path& sourcePath, const fs::path& targetPath, const fs::path& patchPath,
+		const std::function<void()>& checkCancelled = {})
+	{
+		const fs::path stagedPath = fs::path(patchPath).concat(".staged");
+
+		if (!BpsEncoder::createPatchFile(sourcePath, targetPath, patchPath, stagedPath, checkCancelled))
+			return false;
+
+		fs::rename(stagedPath, patchPath);
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const size_t romSize = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4096) * 1024;
+	const size_t editCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+
+	std::mt19937 random(1);
+	test::TemporaryDirectory directory;
+
+	const std::vector<unsigned char> source = test::makeRom(random, romSize);
+	const std::vector<unsigned char> target = test::mutate(random, source, editCount);
+	// the next save, for updating the previous patch
+	const std::vector<unsigned char> nextTarget = test::mutate(random, target, 10);
+
+	const fs::path sourcePath = directory / "clean.smc";
+	const fs::path targetPath = directory / "rom.smc";
+	const fs::path nextTargetPath = directory / "rom2.smc";
+	const fs::path patchPath = directory / "global_data.bps";
+
+	test::writeFile(sourcePath, source);
+	test::writeFile(targetPath, target);
+	test::writeFile(nextTargetPath, nextTarget);
+
+	printf("%zu KB ROM, %zu edits\n\n", romSize / 1024, editCount);
+	printf("%-36s %10s %12s\n", "", "ms", "patch bytes");
+
+	const auto report = [](const char* name, double seconds, std::optional<size_t> patchSize) {
+		if (patchSize.has_value())
+			printf("%-36s %10.1f %12zu\n", name, seconds * 1000, patchSize.value());
+		else
+			printf("%-36s %10.1f %12s\n", name, seconds * 1000, "-");
+	};
+
+	const std::vector<unsigned char> patch = BpsEncoder::createPatch(spanOf(source), spanOf(target));
+
+	if (BpsDecoder::apply(spanOf(source), spanOf(patch)) != target)
+	{
+		fprintf(stderr, "patch doesn't reproduce the target\n");
+		return 1;
+	}
+
+	report("createPatch, in memory", test::secondsPerRun([&] {
+		BpsEncoder::createPatch(spanOf(source), spanOf(target));
+	}), patch.size());
+
+	const BpsSourceIndex index = BpsSourceIndex::build(spanOf(source));
+
+	report("  source index build", test::secondsPerRun([&] { BpsSourceIndex::build(spanOf(source)); }), std::nullopt);
+	report("  diff with a built index", test::secondsPerRun([&] {
+		BpsEncoder::diff(spanOf(source), spanOf(target), index);
+	}), patch.size());
+
+	// sizes are taken after timing, the patch file only exists once it ran
+	const double fullSeconds = test::secondsPerRun([&] {
+		fs::remove(patchPath);
+		exportPatch(sourcePath, targetPath, patchPath);
+	});
+	report("createPatchFile, no previous patch", fullSeconds, static_cast<size_t>(fs::file_size(patchPath)));
+
+	// every run updates the patch written by the one before, alternating between
+	// two saves, with the source index kept like it is between saves in LM
+	SourceIndexCache::enable(directory / "clean.index");
+	exportPatch(sourcePath, targetPath, patchPath);
+
+	bool next = true;
+	const double incrementalSeconds = test::secondsPerRun([&] {
+		exportPatch(sourcePath, next ? nextTargetPath : targetPath, patchPath);
+		next = !next;
+	});
+	report("createPatchFile, previous patch", incrementalSeconds, static_cast<size_t>(fs::file_size(patchPath)));
+
+	SourceIndexCache::disable();
+
+	const fs::path appliedPath = directory / "applied.smc";
+	const double applySeconds = test::secondsPerRun([&] { BpsDecoder::applyFile(sourcePath, patchPath, appliedPath); });
+	report("applyFile", applySeconds, static_cast<size_t>(fs::file_size(patchPath)));
+
+#ifdef FLIPS_PATH
+	const fs::path flipsPatchPath = directory / "flips.bps";
+	const std::string command = std::string("\"") + FLIPS_PATH + "\" --create --bps-delta \"" + sourcePath.string() +
+		"\" \"" + targetPath.string() + "\" \"" + flipsPatchPath.string() + "\" > /dev/null";
+
+	int status = 0;
+	const double flipsSeconds = test::secondsPerRun([&] { status |= std::system(command.c_str()); });
+
+	if (status != 0)
+	{
+		fprintf(stderr, "flips failed\n");
+		return 1;
+	}
+
+	report("flips --create --bps-delta", flipsSeconds, static_cast<size_t>(fs::file_size(flipsPatchPath)));
+#else
+	printf("\nflips wasn't found, set FLIPS_EXECUTABLE to compare against it\n");
+#endif
+
+	return 0;
+}
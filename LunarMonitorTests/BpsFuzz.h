@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "TestSupport.h"
+
+namespace test
+{
+	// random bytes with the kind of redundancy a ROM has, runs of one value and
+	// blocks that repeat elsewhere
+	inline std::vector<unsigned char> makeRom(std::mt19937& random, size_t size)
+	{
+		std::vector<unsigned char> rom = randomBytes(random, size);
+
+		if (size < 64)
+			return rom;
+
+		std::uniform_int_distribution<size_t> position(0, size - 1);
+		std::uniform_int_distribution<size_t> length(16, std::min<size_t>(4096, size / 4));
+
+		for (size_t i = 0; i != size / 8192 + 1; ++i)
+		{
+			const size_t from = position(random), to = position(random);
+			const size_t n = std::min({ length(random), size - from, size - to });
+
+			if (i % 2 == 0)
+				std::fill_n(rom.begin() + to, n, static_cast<unsigned char>(from));
+			else
+				std::copy_n(rom.begin() + from, n, rom.begin() + to);
+		}
+
+		return rom;
+	}
+
+	// source with editCount random edits, overwrites, fills, blocks moved from
+	// elsewhere, insertions, deletions and the odd resize
+	inline std::vector<unsigned char> mutate(std::mt19937& random, const std::vector<unsigned char>& source, size_t editCount)
+	{
+		std::vector<unsigned char> target = source;
+		std::uniform_int_distribution<int> kind(0, 9);
+		std::uniform_int_distribution<size_t> shortLength(1, 300);
+		std::uniform_int_distribution<size_t> longLength(8, 5000);
+
+		const auto position = [&](const std::vector<unsigned char>& bytes) {
+			return std::uniform_int_distribution<size_t>(0, bytes.size())(random);
+		};
+
+		for (size_t edit = 0; edit != editCount; ++edit)
+		{
+			const size_t at = position(target);
+			const size_t room = target.size() - at;
+
+			switch (kind(random))
+			{
+			case 0:
+			case 1:
+			case 2:
+			{
+				const std::vector<unsigned char> bytes = randomBytes(random, std::min(shortLength(random), room));
+				std::copy(bytes.begin(), bytes.end(), target.begin() + at);
+				break;
+			}
+			case 3:
+				std::fill_n(target.begin() + at, std::min(longLength(random), room), static_cast<unsigned char>(at));
+				break;
+			case 4:
+			case 5:
+			{
+				const size_t from = position(source);
+				const size_t n = std::min({ longLength(random), source.size() - from, room });
+				std::copy_n(source.begin() + from, n, target.begin() + at);
+				break;
+			}
+			case 6:
+			{
+				const std::vector<unsigned char> bytes = randomBytes(random, shortLength(random));
+				target.insert(target.begin() + at, bytes.begin(), bytes.end());
+				break;
+			}
+			case 7:
+				target.erase(target.begin() + at, target.begin() + at + std::min(shortLength(random), room));
+				break;
+			case 8:
+			{
+				const size_t from = position(target);
+				const size_t n = std::min(longLength(random), target.size() - from);
+				const std::vector<unsigned char> block(target.begin() + from, target.begin() + from + n);
+				target.insert(target.begin() + at, block.begin(), block.end());
+				break;
+			}
+			case 9:
+				// rare, a truncation throws away most of the other edits
+				if (kind(random) == 0)
+					target.resize(at + (kind(random) < 5 ? 0 : longLength(random)), 0xff);
+				break;
+			}
+		}
+
+		return target;
+	}
+}
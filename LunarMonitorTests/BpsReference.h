@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdexcept>
+#include <vector>
+
+#include "Crc32Reference.h"
+
+namespace test
+{
+	// applies a bps patch straight from byuu's specification, independent of
+	// BpsDecoder so patches from BpsEncoder aren't only ever read back by the
+	// code that shares its assumptions, throws std::runtime_error on anything
+	// malformed or a checksum mismatch
+	inline std::vector<unsigned char> applyBpsReference(const std::vector<unsigned char>& source,
+		const std::vector<unsigned char>& patch)
+	{
+		constexpr size_t FOOTER_SIZE = 12;
+
+		if (patch.size() < 4 + FOOTER_SIZE || patch[0] != 'B' || patch[1] != 'P' || patch[2] != 'S' || patch[3] != '1')
+			throw std::runtime_error("not a bps patch");
+
+		const size_t end = patch.size() - FOOTER_SIZE;
+		size_t position = 4;
+
+		const auto read = [&]() -> unsigned char {
+			if (position >= end)
+				throw std::runtime_error("patch ends early");
+			return patch[position++];
+		};
+
+		const auto decode = [&]() -> uint64_t {
+			uint64_t data = 0, shift = 1;
+
+			while (true)
+			{
+				const unsigned char x = read();
+				data += (x & 0x7f) * shift;
+				if (x & 0x80)
+					break;
+				shift <<= 7;
+				data += shift;
+			}
+
+			return data;
+		};
+
+		const uint64_t sourceSize = decode();
+		const uint64_t targetSize = decode();
+		const uint64_t metadataSize = decode();
+
+		if (sourceSize != source.size())
+			throw std::runtime_error("source size mismatch");
+
+		for (uint64_t i = 0; i != metadataSize; ++i)
+			read();
+
+		std::vector<unsigned char> target(static_cast<size_t>(targetSize));
+		uint64_t outputOffset = 0, sourceRelativeOffset = 0, targetRelativeOffset = 0;
+
+		while (position < end)
+		{
+			const uint64_t data = decode();
+			const uint64_t command = data & 3;
+			const uint64_t length = (data >> 2) + 1;
+
+			if (outputOffset + length > targetSize)
+				throw std::runtime_error("action writes past the target");
+
+			if (command == 0)
+			{
+				if (outputOffset + length > sourceSize)
+					throw std::runtime_error("source read past the source");
+
+				for (uint64_t i = 0; i != length; ++i, ++outputOffset)
+					target[outputOffset] = source[outputOffset];
+			}
+			else if (command == 1)
+			{
+				for (uint64_t i = 0; i != length; ++i)
+					target[outputOffset++] = read();
+			}
+			else
+			{
+				const uint64_t offset = decode();
+				uint64_t& relativeOffset = command == 2 ? sourceRelativeOffset : targetRelativeOffset;
+				relativeOffset += (offset & 1 ? -1 : 1) * static_cast<int64_t>(offset >> 1);
+
+				for (uint64_t i = 0; i != length; ++i)
+				{
+					if (command == 2 ? relativeOffset >= sourceSize : relativeOffset >= outputOffset)
+						throw std::runtime_error("copy from outside of what can be copied");
+
+					target[outputOffset++] = command == 2 ? source[relativeOffset++] : target[relativeOffset++];
+				}
+			}
+		}
+
+		if (outputOffset != targetSize)
+			throw std::runtime_error("actions don't produce the whole target");
+
+		const auto footer = [&](size_t index) {
+			const unsigned char* p = patch.data() + end + index * 4;
+			return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+				(static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+		};
+
+		if (footer(0) != crc32Bitwise(source.data(), source.size()))
+			throw std::runtime_error("source checksum mismatch");
+		if (footer(1) != crc32Bitwise(target.data(), target.size()))
+			throw std::runtime_error("target checksum mismatch");
+		if (footer(2) != crc32Bitwise(patch.data(), patch.size() - 4))
+			throw std::runtime_error("patch checksum mismatch");
+
+		return target;
+	}
+}
@@ -0,0 +1,304 @@
+#include "BpsFuzz.h"
+#include "BpsReference.h"
+#include "TestSupport.h"
+
+#include <cstdlib>
+#include <functional>
+
+#include "BpsDecoder.h"
+#include "BpsEncoder.h"
+#include "Crc32.h"
+#include "MappedFile.h"
+#include "SourceIndexCache.h"
+
+namespace
+{
+	ByteSpan spanOf(const std::vector<unsigned char>& bytes)
+	{
+		return { bytes.data(), bytes.size() };
+	}
+
+	// what the global data export does, the patch is written to a staged path
+	// and moved over the previous one unless nothing changed
+	bool exportPatch(const fs::path& sourcePath, const fs::path& targetPath, const fs::path& patchPath,
+		const std::function<void()>& checkCancelled = {})
+	{
+		const fs::path stagedPath = fs::path(patchPath).concat(".staged");
+
+		if (!BpsEncoder::createPatchFile(sourcePath, targetPath, patchPath, stagedPath, checkCancelled))
+			return false;
+
+		fs::rename(stagedPath, patchPath);
+		return true;
+	}
+
+	// the patch turns source into target when read back by BpsDecoder and by the
+	// reference applier, and carries the right checksums
+	void checkPatch(const std::vector<unsigned char>& source, const std::vector<unsigned char>& target,
+		const std::vector<unsigned char>& patch)
+	{
+		try
+		{
+			CHECK(BpsDecoder::apply(spanOf(source), spanOf(patch)) == target);
+			BpsDecoder::verify(spanOf(source), spanOf(patch), spanOf(target));
+
+			const BpsDecoder::Patch parsed = BpsDecoder::parse(spanOf(patch));
+			CHECK_EQUAL(parsed.sourceSize, source.size());
+			CHECK_EQUAL(parsed.targetSize, target.size());
+			CHECK_EQUAL(parsed.sourceCrc, Crc32::compute(source.data(), source.size()));
+			CHECK_EQUAL(parsed.targetCrc, Crc32::compute(target.data(), target.size()));
+		}
+		catch (const std::runtime_error& e)
+		{
+			CHECK(!"BpsDecoder rejected the patch");
+			std::cerr << "  " << e.what() << std::endl;
+		}
+
+		try
+		{
+			CHECK(test::applyBpsReference(source, patch) == target);
+		}
+		catch (const std::runtime_error& e)
+		{
+			CHECK(!"the reference applier rejected the patch");
+			std::cerr << "  " << e.what() << std::endl;
+		}
+	}
+
+	void testEdgeCases(std::mt19937& random)
+	{
+		const std::vector<unsigned char> empty;
+		const std::vector<unsigned char> rom = test::makeRom(random, 70000);
+
+		for (const auto& [source, target] : std::vector<std::pair<std::vector<unsigned char>, std::vector<unsigned char>>>{
+			{ empty, empty },
+			{ empty, rom },
+			{ rom, empty },
+			{ rom, rom },
+			{ { 1 }, { 2 } },
+			{ rom, std::vector<unsigned char>(rom.begin(), rom.begin() + 7) },
+			{ rom, std::vector<unsigned char>(100000, 0) }
+			})
+		{
+			checkPatch(source, target, BpsEncoder::createPatch(spanOf(source), spanOf(target)));
+		}
+	}
+
+	// encodes random edits of random ROMs, then keeps editing the target and
+	// updating the previous patch through rediff like successive saves do
+	void testRoundTrips(std::mt19937& random)
+	{
+		std::uniform_int_distribution<size_t> size(0, 300000);
+		std::uniform_int_distribution<size_t> editCount(0, 60);
+
+		for (int round = 0; round != 40; ++round)
+		{
+			const std::vector<unsigned char> source = test::makeRom(random, round % 10 == 0 ? 1024 * 1024 : size(random));
+			std::vector<unsigned char> target = test::mutate(random, source, editCount(random));
+
+			const BpsSourceIndex index = BpsSourceIndex::build(spanOf(source));
+			std::vector<unsigned char> patch = BpsEncoder::serialize(spanOf(source), spanOf(target),
+				BpsEncoder::diff(spanOf(source), spanOf(target), index));
+
+			checkPatch(source, target, patch);
+
+			for (int save = 0; save != 3; ++save)
+			{
+				target = test::mutate(random, target, editCount(random) / 4);
+
+				const BpsDecoder::Patch previous = BpsDecoder::parse(spanOf(patch));
+				patch = BpsEncoder::serialize(spanOf(source), spanOf(target),
+					BpsEncoder::rediff(spanOf(source), spanOf(target), index, spanOf(patch), previous.actions));
+
+				checkPatch(source, target, patch);
+			}
+		}
+	}
+
+	// the ROM is read rather than mapped
+	void testFileSnapshots(std::mt19937& random)
+	{
+		test::TemporaryDirectory directory;
+
+		for (size_t size : { size_t(0), size_t(1), size_t(3 * 1024 * 1024 + 7) })
+		{
+			const std::vector<unsigned char> contents = test::randomBytes(random, size);
+			test::writeFile(directory / "rom.smc", contents);
+			CHECK(readFileSnapshot(directory / "rom.smc") == contents);
+		}
+
+		bool threw = false;
+		try
+		{
+			readFileSnapshot(directory / "missing.smc");
+		}
+		catch (const std::runtime_error&)
+		{
+			threw = true;
+		}
+
+		CHECK(threw);
+	}
+
+	// createPatchFile on disk, the second save goes through the previous patch,
+	// a save that changed nothing leaves the patch alone
+	void testPatchFiles(std::mt19937& random)
+	{
+		test::TemporaryDirectory directory;
+		SourceIndexCache::enable(directory / "clean.index");
+
+		const fs::path sourcePath = directory / "clean.smc";
+		const fs::path targetPath = directory / "rom.smc";
+		const fs::path patchPath = directory / "global_data.bps";
+		const fs::path appliedPath = directory / "applied.smc";
+
+		const std::vector<unsigned char> source = test::makeRom(random, 512 * 1024);
+		test::writeFile(sourcePath, source);
+
+		std::vector<unsigned char> target = source;
+
+		for (int save = 0; save != 4; ++save)
+		{
+			if (save != 2)
+				target = test::mutate(random, target, 20);
+
+			test::writeFile(targetPath, target);
+
+			const std::vector<unsigned char> before = fs::exists(patchPath) ? test::readFile(patchPath) : std::vector<unsigned char>();
+			const bool written = exportPatch(sourcePath, targetPath, patchPath);
+			const std::vector<unsigned char> patch = test::readFile(patchPath);
+
+			CHECK_EQUAL(written, save != 2);
+			if (save == 2)
+				CHECK(patch == before);
+
+			checkPatch(source, target, patch);
+
+			BpsDecoder::applyFile(sourcePath, patchPath, appliedPath);
+			CHECK(test::readFile(appliedPath) == target);
+			BpsDecoder::verifyFile(sourcePath, patchPath);
+		}
+
+		CHECK(fs::exists(directory / "clean.index"));
+		SourceIndexCache::disable();
+
+		// a checkpoint that throws leaves the previous patch as it was
+		const std::vector<unsigned char> before = test::readFile(patchPath);
+		test::writeFile(targetPath, test::mutate(random, target, 20));
+
+		bool cancelled = false;
+		try
+		{
+			exportPatch(sourcePath, targetPath, patchPath, [] { throw std::logic_error("cancelled"); });
+		}
+		catch (const std::logic_error&)
+		{
+			cancelled = true;
+		}
+
+		CHECK(cancelled);
+		CHECK(test::readFile(patchPath) == before);
+
+		// verification doesn't look at the ROM, which was saved again above, only
+		// at whether the patch holds up on its own
+		const auto verifies = [&](const std::vector<unsigned char>& patch, const std::vector<unsigned char>& clean) {
+			test::writeFile(directory / "check.bps", patch);
+			test::writeFile(directory / "check.smc", clean);
+
+			try
+			{
+				BpsDecoder::verifyFile(directory / "check.smc", directory / "check.bps");
+				return true;
+			}
+			catch (const std::runtime_error&)
+			{
+				return false;
+			}
+		};
+
+		CHECK(verifies(before, source));
+
+		std::vector<unsigned char> corrupted = before;
+		corrupted[corrupted.size() / 2] ^= 0x40;
+		CHECK(!verifies(corrupted, source));
+		CHECK(!verifies(std::vector<unsigned char>(before.begin(), before.end() - 5), source));
+
+		std::vector<unsigned char> otherClean = source;
+		otherClean[100] ^= 1;
+		CHECK(!verifies(before, otherClean));
+	}
+
+	void testMalformedPatches(std::mt19937& random)
+	{
+		const std::vector<unsigned char> source = test::makeRom(random, 50000);
+		const std::vector<unsigned char> target = test::mutate(random, source, 20);
+		const std::vector<unsigned char> patch = BpsEncoder::createPatch(spanOf(source), spanOf(target));
+
+		const auto rejects = [&](const std::vector<unsigned char>& bytes, const std::vector<unsigned char>& from) {
+			try
+			{
+				BpsDecoder::apply(spanOf(from), spanOf(bytes));
+				return false;
+			}
+			catch (const std::runtime_error&)
+			{
+				return true;
+			}
+		};
+
+		std::uniform_int_distribution<size_t> position(0, patch.size() - 1);
+
+		for (int i = 0; i != 50; ++i)
+		{
+			std::vector<unsigned char> corrupted = patch;
+			corrupted[position(random)] ^= 1 + i % 255;
+			CHECK(rejects(corrupted, source));
+
+			CHECK(rejects(std::vector<unsigned char>(patch.begin(), patch.begin() + position(random)), source));
+		}
+
+		CHECK(rejects(patch, target));
+	}
+
+#ifdef FLIPS_PATH
+	// patches have to be accepted by flips since that's what users apply them with
+	void testAcceptedByFlips(std::mt19937& random)
+	{
+		test::TemporaryDirectory directory;
+
+		for (int round = 0; round != 5; ++round)
+		{
+			const std::vector<unsigned char> source = test::makeRom(random, 512 * 1024);
+			const std::vector<unsigned char> target = test::mutate(random, source, 40);
+
+			test::writeFile(directory / "clean.smc", source);
+			test::writeFile(directory / "patch.bps", BpsEncoder::createPatch(spanOf(source), spanOf(target)));
+
+			const std::string command = std::string("\"") + FLIPS_PATH + "\" --apply \"" + (directory / "patch.bps").string() +
+				"\" \"" + (directory / "clean.smc").string() + "\" \"" + (directory / "applied.smc").string() + "\" > /dev/null";
+
+			CHECK_EQUAL(std::system(command.c_str()), 0);
+			CHECK(test::readFile(directory / "applied.smc") == target);
+		}
+	}
+#endif
+}
+
+int main()
+{
+	std::mt19937 random(8);
+
+	testEdgeCases(random);
+	testRoundTrips(random);
+	testFileSnapshots(random);
+	testPatchFiles(random);
+	testMalformedPatches(random);
+
+#ifdef FLIPS_PATH
+	testAcceptedByFlips(random);
+#else
+	std::cout << "flips wasn't found, patches weren't checked against it" << std::endl;
+#endif
+
+	return test::finish();
+}
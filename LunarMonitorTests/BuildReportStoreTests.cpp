@@ -0,0 +1,250 @@
+#include "TestSupport.h"
+
+#include <cstdlib>
+#include <sys/stat.h>
+#include <thread>
+
+#include "BuildReportStore.h"
+#include "LunarHelperReport.h"
+
+// the store against a report on disk, each test serves a report of its own
+// since the store keeps serving whatever it was last enabled with
+
+namespace
+{
+	using namespace std::chrono_literals;
+	using namespace test;
+
+	// long enough that nothing is written behind a test's back
+	constexpr std::chrono::milliseconds NEVER{ std::chrono::hours(1) };
+
+	std::string readText(const fs::path& path)
+	{
+		const std::vector<unsigned char> bytes = readFile(path);
+		return std::string(bytes.begin(), bytes.end());
+	}
+
+	void writeText(const fs::path& path, const std::string& text)
+	{
+		writeFile(path, std::vector<unsigned char>(text.begin(), text.end()));
+	}
+
+	// a report written in place keeps its inode, one that was rewritten was
+	// moved into place from a new file
+	ino_t inodeOf(const fs::path& path)
+	{
+		struct stat info;
+		return stat(path.c_str(), &info) == 0 ? info.st_ino : 0;
+	}
+
+	std::string withValue(std::string report, const std::string& from, const std::string& to)
+	{
+		const size_t at = report.find(from);
+		CHECK(at != std::string::npos);
+
+		if (at != std::string::npos)
+			report.replace(at, from.size(), to);
+
+		return report;
+	}
+
+	// the store's value of object / key
+	std::string storedValue(const std::string& object, const std::string& key)
+	{
+		std::string value;
+
+		BuildReportStore::read([&](const json& report) {
+			const json& parent = object.empty() ? report : report.at(object);
+			value = parent.value(key, "");
+		});
+
+		return value;
+	}
+
+	void testHashesWrittenInPlace()
+	{
+		TemporaryDirectory directory;
+		const fs::path reportPath = directory / "build_report.json";
+		writeText(reportPath, LUNAR_HELPER_REPORT);
+
+		BuildReportStore::enable(reportPath, 0ms);
+		const ino_t inode = inodeOf(reportPath);
+
+		CHECK(BuildReportStore::updateHash("", "global_data", NEW_HASH));
+		CHECK(BuildReportStore::updateHash("levels", "levels/level 105.mwl", NEW_HASH));
+
+		std::string expected = withValue(LUNAR_HELPER_REPORT, GLOBAL_DATA_HASH, NEW_HASH);
+		expected = withValue(expected, LEVEL_105_HASH, NEW_HASH);
+
+		CHECK_EQUAL(readText(reportPath), expected);
+		CHECK_EQUAL(inodeOf(reportPath), inode);
+		CHECK_EQUAL(storedValue("", "global_data"), NEW_HASH);
+		CHECK(!fs::exists(BuildReportLock::lockPathFor(reportPath)));
+	}
+
+	void testWholeWrites()
+	{
+		TemporaryDirectory directory;
+		const fs::path reportPath = directory / "build_report.json";
+		writeText(reportPath, LUNAR_HELPER_REPORT);
+
+		BuildReportStore::enable(reportPath, 0ms);
+
+		// a value that isn't there yet can't be written in place
+		CHECK(BuildReportStore::updateHash("levels", "levels/level 200.mwl", NEW_HASH));
+		CHECK(BuildReportStore::update([](json& report) { report["shared_palettes"] = GRAPHICS_HASH; }));
+
+		const std::string written = readText(reportPath);
+		const json parsed = json::parse(written);
+
+		CHECK_EQUAL(parsed["levels"]["levels/level 200.mwl"].get<std::string>(), NEW_HASH);
+		CHECK_EQUAL(parsed["shared_palettes"].get<std::string>(), GRAPHICS_HASH);
+
+		// LunarHelper's members and layout are left alone
+		CHECK(written.find(DEPENDENCY_GRAPH) != std::string::npos);
+		CHECK(written.find("\"levels/level 200.mwl\": \"" + NEW_HASH + "\"\r\n  },\r\n") != std::string::npos);
+		CHECK(written.find("\"shared_palettes\": \"" + GRAPHICS_HASH + "\"\r\n}") != std::string::npos);
+
+		// and now that it's there it is
+		const ino_t inode = inodeOf(reportPath);
+		CHECK(BuildReportStore::updateHash("levels", "levels/level 200.mwl", ROM_HASH));
+		CHECK_EQUAL(readText(reportPath), withValue(written, "\"levels/level 200.mwl\": \"" + NEW_HASH, "\"levels/level 200.mwl\": \"" + ROM_HASH));
+		CHECK_EQUAL(inodeOf(reportPath), inode);
+
+		// a change that throws is dropped
+		CHECK(!BuildReportStore::update([](json& report) { report.at("missing") = 1; }));
+	}
+
+	void testDebouncedWrites()
+	{
+		TemporaryDirectory directory;
+		const fs::path reportPath = directory / "build_report.json";
+		writeText(reportPath, LUNAR_HELPER_REPORT);
+
+		BuildReportStore::enable(reportPath, 500ms);
+
+		CHECK(BuildReportStore::updateHash("", "graphics", NEW_HASH));
+		CHECK(BuildReportStore::updateHash("", "rom_hash", NEW_HASH));
+
+		// served from memory until it's written
+		CHECK_EQUAL(storedValue("", "graphics"), NEW_HASH);
+		CHECK_EQUAL(readText(reportPath), LUNAR_HELPER_REPORT);
+
+		const std::string expected = withValue(withValue(LUNAR_HELPER_REPORT, GRAPHICS_HASH, NEW_HASH), ROM_HASH, NEW_HASH);
+
+		for (int i = 0; i != 100 && readText(reportPath) != expected; ++i)
+			std::this_thread::sleep_for(50ms);
+
+		CHECK_EQUAL(readText(reportPath), expected);
+
+		// flush doesn't wait for the delay
+		BuildReportStore::enable(reportPath, NEVER);
+
+		CHECK(BuildReportStore::updateHash("", "global_data", NEW_HASH));
+		CHECK_EQUAL(readText(reportPath), expected);
+		CHECK(BuildReportStore::flush());
+		CHECK_EQUAL(readText(reportPath), withValue(expected, GLOBAL_DATA_HASH, NEW_HASH));
+
+		// neither does shutdown
+		CHECK(BuildReportStore::updateHash("", "global_data", GRAPHICS_HASH));
+		BuildReportStore::shutdown();
+		CHECK_EQUAL(readText(reportPath), withValue(expected, GLOBAL_DATA_HASH, GRAPHICS_HASH));
+	}
+
+	void testExternalWrites()
+	{
+		TemporaryDirectory directory;
+		const fs::path reportPath = directory / "build_report.json";
+		writeText(reportPath, LUNAR_HELPER_REPORT);
+
+		BuildReportStore::enable(reportPath, NEVER);
+		CHECK(BuildReportStore::isAvailable());
+		CHECK(!BuildReportStore::checkForExternalWrite());
+
+		CHECK(BuildReportStore::updateHash("", "global_data", NEW_HASH));
+
+		// LunarHelper finished a build, its report is a new file
+		const std::string rebuilt = withValue(withValue(LUNAR_HELPER_REPORT, ROM_HASH, LEVEL_106_HASH),
+			"\"tag\": \"incsrc\"", "\"tag\": \"incbin\", \"extra\": 1");
+		writeText(directory / "rebuilt.json", rebuilt);
+		fs::rename(directory / "rebuilt.json", reportPath);
+
+		CHECK(BuildReportStore::checkForExternalWrite());
+
+		// the new report with what's pending on top of it
+		CHECK_EQUAL(storedValue("", "rom_hash"), LEVEL_106_HASH);
+		CHECK_EQUAL(storedValue("", "global_data"), NEW_HASH);
+
+		CHECK(BuildReportStore::flush());
+		CHECK_EQUAL(readText(reportPath), withValue(rebuilt, GLOBAL_DATA_HASH, NEW_HASH));
+		CHECK(!BuildReportStore::checkForExternalWrite());
+
+		// replaced while changes were pending and nobody checked, the save notices
+		CHECK(BuildReportStore::updateHash("", "graphics", NEW_HASH));
+		writeText(directory / "rebuilt.json", LUNAR_HELPER_REPORT);
+		fs::rename(directory / "rebuilt.json", reportPath);
+
+		CHECK(BuildReportStore::flush());
+
+		// what was already written is LunarHelper's to replace
+		CHECK_EQUAL(readText(reportPath), withValue(LUNAR_HELPER_REPORT, GRAPHICS_HASH, NEW_HASH));
+	}
+
+	void testLockedReport()
+	{
+		TemporaryDirectory directory;
+		const fs::path reportPath = directory / "build_report.json";
+		writeText(reportPath, LUNAR_HELPER_REPORT);
+
+		BuildReportStore::enable(reportPath, 0ms);
+
+		{
+			// LunarHelper replacing the report
+			const BuildReportLock held(BuildReportLock::lockPathFor(reportPath), 0ms);
+			CHECK(held.isHeld());
+			CHECK(!BuildReportLock(BuildReportLock::lockPathFor(reportPath), 0ms).isHeld());
+
+			// left to be retried later
+			CHECK(BuildReportStore::updateHash("", "graphics", NEW_HASH));
+			CHECK_EQUAL(readText(reportPath), LUNAR_HELPER_REPORT);
+			CHECK(!BuildReportStore::flush());
+		}
+
+		CHECK(BuildReportStore::flush());
+		CHECK_EQUAL(readText(reportPath), withValue(LUNAR_HELPER_REPORT, GRAPHICS_HASH, NEW_HASH));
+	}
+
+	void testUnreadableReports()
+	{
+		TemporaryDirectory directory;
+		const fs::path reportPath = directory / "build_report.json";
+
+		BuildReportStore::enable(reportPath, 0ms);
+		CHECK(!BuildReportStore::isAvailable());
+		CHECK(!BuildReportStore::updateHash("", "graphics", NEW_HASH));
+		CHECK(!fs::exists(reportPath));
+
+		writeText(reportPath, LUNAR_HELPER_REPORT.substr(0, LUNAR_HELPER_REPORT.size() / 2));
+		CHECK(!BuildReportStore::isAvailable());
+		CHECK(!BuildReportStore::read([](const json&) {}));
+
+		// readable once it's written in full
+		writeText(reportPath, LUNAR_HELPER_REPORT);
+		CHECK(BuildReportStore::isAvailable());
+	}
+}
+
+int main()
+{
+	testHashesWrittenInPlace();
+	testWholeWrites();
+	testDebouncedWrites();
+	testExternalWrites();
+	testLockedReport();
+	testUnreadableReports();
+
+	// the store's flusher never stops, it waits on a condition variable whose
+	// destructor would wait for it forever, in Lunar Magic the thread is simply
+	// ended with the process
+	std::_Exit(test::finish());
+}
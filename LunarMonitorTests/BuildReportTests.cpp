@@ -0,0 +1,298 @@
+#include "TestSupport.h"
+
+#include <sstream>
+
+#include "BuildReportHashIndex.h"
+#include "BuildReportRewriter.h"
+#include "LunarHelperReport.h"
+
+// the reader, rewriter and hash index against LunarHelper's report and the
+// corners of json its layout doesn't show
+
+namespace
+{
+	using namespace test;
+
+	// escapes in keys, in values and in the strings of a subtree that's skipped
+	const std::string ESCAPED_REPORT =
+		"{\"we\\\"ird\\\\key\":\"a\\\"}b\","
+		"\"levels\":{\"lev\\u00e9l\":\"66666666666666666666666666666666\",\"plain\":\"77777777777777777777777777777777\"},"
+		"\"skipped\":[\"]\\\"[\",{\"}\":\"\\\\\"}]}";
+
+	std::string replaced(std::string text, const std::string& from, const std::string& to)
+	{
+		const size_t at = text.find(from);
+		CHECK(at != std::string::npos);
+
+		if (at != std::string::npos)
+			text.replace(at, from.size(), to);
+
+		return text;
+	}
+
+	std::optional<BuildReportHashIndex> rewrite(const std::string& report, const json& members, std::string& output)
+	{
+		std::istringstream in(report);
+		std::ostringstream out;
+
+		std::optional<BuildReportHashIndex> index = BuildReportRewriter::rewrite(in, out, members);
+		output = out.str();
+
+		return index;
+	}
+
+	std::optional<BuildReportRewriter::OwnedMembers> read(const std::string& report)
+	{
+		test::TemporaryDirectory directory;
+		test::writeFile(directory / "build_report.json", std::vector<unsigned char>(report.begin(), report.end()));
+
+		return BuildReportRewriter::read(directory / "build_report.json");
+	}
+
+	std::optional<json> readTopLevel(const std::string& report, const std::vector<std::string>& keys)
+	{
+		test::TemporaryDirectory directory;
+		test::writeFile(directory / "build_report.json", std::vector<unsigned char>(report.begin(), report.end()));
+
+		return BuildReportRewriter::readTopLevel(directory / "build_report.json", keys);
+	}
+
+	// the value index has for object / key sits at its offset in text
+	bool indexedAt(const BuildReportHashIndex& index, const std::string& text, const std::string& object,
+		const std::string& key, const std::string& hash)
+	{
+		const std::optional<uint64_t> offset = index.find(object, key);
+
+		return offset.has_value() && text.compare(offset.value(), hash.size(), hash) == 0;
+	}
+
+	void testHashIndex()
+	{
+		const BuildReportHashIndex index = BuildReportHashIndex::build(LUNAR_HELPER_REPORT);
+
+		CHECK(indexedAt(index, LUNAR_HELPER_REPORT, "", "rom_hash", ROM_HASH));
+		CHECK(indexedAt(index, LUNAR_HELPER_REPORT, "", "graphics", GRAPHICS_HASH));
+		CHECK(indexedAt(index, LUNAR_HELPER_REPORT, "", "global_data", GLOBAL_DATA_HASH));
+		CHECK(indexedAt(index, LUNAR_HELPER_REPORT, "levels", "levels/level 105.mwl", LEVEL_105_HASH));
+		CHECK(indexedAt(index, LUNAR_HELPER_REPORT, "levels", "levels/level 106.mwl", LEVEL_106_HASH));
+
+		// values that aren't hashes, and hashes deeper than one object down
+		CHECK(!index.find("", "build_time").has_value());
+		CHECK(!index.find("", "map16").has_value());
+		CHECK(!index.find("", "id").has_value());
+		CHECK(!index.find("dependency_graph", "id").has_value());
+
+		// patched in place, the report still parses and only that value changed
+		std::string patched = LUNAR_HELPER_REPORT;
+		patched.replace(index.find("levels", "levels/level 105.mwl").value(), BuildReportHashIndex::HASH_LENGTH, NEW_HASH);
+		patched.replace(index.find("", "global_data").value(), BuildReportHashIndex::HASH_LENGTH, NEW_HASH);
+
+		json expected = json::parse(LUNAR_HELPER_REPORT);
+		expected["levels"]["levels/level 105.mwl"] = NEW_HASH;
+		expected["global_data"] = NEW_HASH;
+
+		CHECK(json::parse(patched) == expected);
+		CHECK_EQUAL(patched.size(), LUNAR_HELPER_REPORT.size());
+
+		// keys with escapes aren't indexed, the rest of their object still is
+		const BuildReportHashIndex escaped = BuildReportHashIndex::build(ESCAPED_REPORT);
+		CHECK(indexedAt(escaped, ESCAPED_REPORT, "levels", "plain", "77777777777777777777777777777777"));
+		CHECK(!escaped.find("levels", "lev\xc3\xa9l").has_value());
+		CHECK(!escaped.find("levels", "lev\\u00e9l").has_value());
+
+		// malformed json has an empty index
+		for (const std::string& malformed : { LUNAR_HELPER_REPORT.substr(0, LUNAR_HELPER_REPORT.size() - 1),
+			"{\"rom_hash\": \"" + ROM_HASH + "\"}}", "{\"rom_hash\": \"" + ROM_HASH })
+		{
+			CHECK(!BuildReportHashIndex::build(malformed).find("", "rom_hash").has_value());
+		}
+
+		CHECK(BuildReportHashIndex::isHash(ROM_HASH));
+		CHECK(!BuildReportHashIndex::isHash("0123456789ABCDEF0123456789ABCDEF"));
+		CHECK(!BuildReportHashIndex::isHash(ROM_HASH.substr(1)));
+		CHECK(!BuildReportHashIndex::isHash(ROM_HASH + "0"));
+	}
+
+	void testRead()
+	{
+		const std::optional<BuildReportRewriter::OwnedMembers> owned = read(LUNAR_HELPER_REPORT);
+		CHECK(owned.has_value());
+
+		if (!owned.has_value())
+			return;
+
+		// everything but the dependency graph, levels as a whole
+		json expected = json::parse(LUNAR_HELPER_REPORT);
+		expected.erase("dependency_graph");
+
+		CHECK(owned->members == expected);
+
+		// offsets into the file as it was read
+		CHECK(indexedAt(owned->hashIndex, LUNAR_HELPER_REPORT, "", "rom_hash", ROM_HASH));
+		CHECK(indexedAt(owned->hashIndex, LUNAR_HELPER_REPORT, "", "global_data", GLOBAL_DATA_HASH));
+		CHECK(indexedAt(owned->hashIndex, LUNAR_HELPER_REPORT, "levels", "levels/level 106.mwl", LEVEL_106_HASH));
+		CHECK(!owned->hashIndex.find("", "id").has_value());
+
+		for (const std::string& unreadable : { std::string("[]"), std::string("{\"a\": 1"), std::string("{\"a\" 1}"),
+			LUNAR_HELPER_REPORT.substr(0, LUNAR_HELPER_REPORT.find("\"graphics\"")) })
+		{
+			CHECK(!read(unreadable).has_value());
+		}
+
+		CHECK(read("{}").has_value());
+		CHECK(read(" \r\n{ }\r\n").has_value());
+	}
+
+	void testRewriteCopiesUnknownMembers()
+	{
+		const json owned = read(LUNAR_HELPER_REPORT).value().members;
+		std::string output;
+
+		// what's owned written back as it was read leaves the report as it was
+		CHECK(rewrite(LUNAR_HELPER_REPORT, owned, output).has_value());
+		CHECK_EQUAL(output, LUNAR_HELPER_REPORT);
+
+		CHECK(rewrite(LUNAR_HELPER_REPORT, json::object(), output).has_value());
+		CHECK_EQUAL(output, LUNAR_HELPER_REPORT);
+
+		// replaced and added members are written in LunarHelper's layout
+		json members = owned;
+		members["global_data"] = NEW_HASH;
+		members["levels"]["levels/level 105.mwl"] = NEW_HASH;
+		members["levels"]["levels/level 200.mwl"] = NEW_HASH;
+		members["shared_palettes"] = NEW_HASH;
+		members["map16"] = GRAPHICS_HASH;
+
+		const std::optional<BuildReportHashIndex> index = rewrite(LUNAR_HELPER_REPORT, members, output);
+		CHECK(index.has_value());
+
+		std::string expected = LUNAR_HELPER_REPORT;
+		expected = replaced(expected, "\"global_data\": \"" + GLOBAL_DATA_HASH, "\"global_data\": \"" + NEW_HASH);
+		expected = replaced(expected, "\"levels/level 105.mwl\": \"" + LEVEL_105_HASH, "\"levels/level 105.mwl\": \"" + NEW_HASH);
+		expected = replaced(expected, LEVEL_106_HASH + "\"\r\n",
+			LEVEL_106_HASH + "\",\r\n    \"levels/level 200.mwl\": \"" + NEW_HASH + "\"\r\n");
+		expected = replaced(expected, "\"map16\": null\r\n}",
+			"\"map16\": \"" + GRAPHICS_HASH + "\",\r\n  \"shared_palettes\": \"" + NEW_HASH + "\"\r\n}");
+
+		CHECK_EQUAL(output, expected);
+
+		// every line break is still a windows one
+		for (size_t at = output.find('\n'); at != std::string::npos; at = output.find('\n', at + 1))
+			CHECK(at > 0 && output[at - 1] == '\r');
+
+		// the returned index is of what was written, patching it in place works
+		if (index.has_value())
+		{
+			CHECK(indexedAt(index.value(), output, "", "global_data", NEW_HASH));
+			CHECK(indexedAt(index.value(), output, "", "shared_palettes", NEW_HASH));
+			CHECK(indexedAt(index.value(), output, "", "map16", GRAPHICS_HASH));
+			CHECK(indexedAt(index.value(), output, "levels", "levels/level 105.mwl", NEW_HASH));
+			CHECK(indexedAt(index.value(), output, "levels", "levels/level 200.mwl", NEW_HASH));
+
+			std::string patched = output;
+			patched.replace(index->find("levels", "levels/level 200.mwl").value(), BuildReportHashIndex::HASH_LENGTH, ROM_HASH);
+
+			CHECK_EQUAL(json::parse(patched)["levels"]["levels/level 200.mwl"].get<std::string>(), ROM_HASH);
+		}
+	}
+
+	void testRewriteLayouts()
+	{
+		std::string output;
+
+		// compact reports stay compact
+		CHECK(rewrite("{\"a\":1,\"b\":[1,2]}", { { "a", 2 }, { "c", { { "d", true } } } }, output).has_value());
+		CHECK_EQUAL(output, "{\"a\":2,\"b\":[1,2],\"c\":{\"d\":true}}");
+
+		// json::dump's layout, like the monitor writes a report from scratch
+		CHECK(rewrite("{\n    \"a\": 1\n}\n", { { "b", { { "c", 1 } } } }, output).has_value());
+		CHECK_EQUAL(output, "{\n    \"a\": 1,\n    \"b\": {\n        \"c\": 1\n    }\n}\n");
+
+		// an empty report gets the default layout
+		CHECK(rewrite("{}", { { "a", 1 } }, output).has_value());
+		CHECK_EQUAL(output, "{\n  \"a\": 1\n}");
+
+		for (const std::string& unreadable : { "", "[]", "{\"a\":1", "{\"a\" 1}", "{\"a\":\"1}" })
+			CHECK(!rewrite(unreadable, { { "a", 2 } }, output).has_value());
+	}
+
+	void testEscapes()
+	{
+		const std::optional<BuildReportRewriter::OwnedMembers> owned = read(ESCAPED_REPORT);
+		CHECK(owned.has_value());
+
+		if (!owned.has_value())
+			return;
+
+		// keys are unescaped, the skipped array's brackets and quotes inside strings don't end it early
+		CHECK_EQUAL(owned->members.size(), size_t{ 2 });
+		CHECK_EQUAL(owned->members.value("we\"ird\\key", ""), "a\"}b");
+		CHECK_EQUAL(owned->members["levels"].value("lev\xc3\xa9l", ""), "66666666666666666666666666666666");
+
+		std::string output;
+		json members = owned->members;
+		members["we\"ird\\key"] = "new \"value\"";
+		members["levels"]["plain"] = NEW_HASH;
+
+		const std::optional<BuildReportHashIndex> index = rewrite(ESCAPED_REPORT, members, output);
+
+		// the skipped array is copied as it was, escapes and all
+		CHECK(index.has_value());
+		CHECK(output.find("\"skipped\":[\"]\\\"[\",{\"}\":\"\\\\\"}]") != std::string::npos);
+		CHECK(output.rfind("{\"we\\\"ird\\\\key\":\"new \\\"value\\\"\",", 0) == 0);
+
+		json expected = json::parse(ESCAPED_REPORT);
+		expected["we\"ird\\key"] = "new \"value\"";
+		expected["levels"]["plain"] = NEW_HASH;
+
+		CHECK(json::parse(output) == expected);
+
+		if (index.has_value())
+			CHECK(indexedAt(index.value(), output, "levels", "plain", NEW_HASH));
+	}
+
+	void testReadTopLevel()
+	{
+		const json buildIdentity = { { "build_time", "2024-05-01T12:34:56.789+02:00" }, { "rom_hash", ROM_HASH } };
+
+		CHECK(readTopLevel(LUNAR_HELPER_REPORT, { "rom_hash", "build_time" }) == buildIdentity);
+
+		// past the dependency graph, which is skipped without being parsed
+		CHECK(readTopLevel(LUNAR_HELPER_REPORT, { "map16", "global_data" }) ==
+			json({ { "map16", nullptr }, { "global_data", GLOBAL_DATA_HASH } }));
+
+		// values that are objects too
+		CHECK(readTopLevel(LUNAR_HELPER_REPORT, { "levels" }).value()["levels"] == json::parse(LUNAR_HELPER_REPORT)["levels"]);
+
+		// members the report doesn't have are missing from the result
+		CHECK(readTopLevel(LUNAR_HELPER_REPORT, { "rom_hash", "missing" }) == json({ { "rom_hash", ROM_HASH } }));
+		CHECK(readTopLevel("{}", { "rom_hash" }) == json::object());
+
+		// the scan stops once every key was found, whatever follows isn't read
+		const std::string cutOff = LUNAR_HELPER_REPORT.substr(0, LUNAR_HELPER_REPORT.find(DEPENDENCY_GRAPH) + 30);
+
+		CHECK(readTopLevel(cutOff, { "build_time", "rom_hash" }) == buildIdentity);
+		CHECK(!readTopLevel(cutOff, { "build_time", "graphics" }).has_value());
+
+		const std::string garbageAfter = "{\"rom_hash\": \"" + ROM_HASH + "\", \"dependency_graph\": [{ not json";
+		CHECK(readTopLevel(garbageAfter, { "rom_hash" }) == json({ { "rom_hash", ROM_HASH } }));
+
+		CHECK(!readTopLevel("[]", { "rom_hash" }).has_value());
+		CHECK(!readTopLevel("{\"rom_hash\" \"" + ROM_HASH + "\"}", { "rom_hash" }).has_value());
+
+		// escaped keys are compared unescaped
+		CHECK(readTopLevel(ESCAPED_REPORT, { "we\"ird\\key" }) == json({ { "we\"ird\\key", "a\"}b" } }));
+	}
+}
+
+int main()
+{
+	testHashIndex();
+	testRead();
+	testRewriteCopiesUnknownMembers();
+	testRewriteLayouts();
+	testEscapes();
+	testReadTopLevel();
+
+	return test::finish();
+}
@@ -0,0 +1,62 @@
+#include "TestSupport.h"
+
+#include "Crc32.h"
+#include "Crc32Reference.h"
+
+// crc32 throughput on patch and ROM sized buffers for each backend, the
+// parallel path and zlib if it was found, the bitwise reference only shows
+// where the tables come from and is timed on the smallest buffer
+
+namespace
+{
+	// the inline reference would be optimized away if its result went unused
+	volatile uint32_t sink = 0;
+}
+
+int main()
+{
+	const std::vector<std::pair<const char*, size_t>> sizes{
+		{ "64 KB", 64 * 1024 },
+		{ "4 MB", 4 * 1024 * 1024 },
+		{ "8 MB", 8 * 1024 * 1024 }
+	};
+
+	std::mt19937 random(1);
+
+	printf("%-8s %-12s %10s\n", "size", "", "MB/s");
+
+	for (const auto& [name, size] : sizes)
+	{
+		const std::vector<unsigned char> bytes = test::randomBytes(random, size);
+		const uint32_t expected = test::crc32Bitwise(bytes.data(), bytes.size());
+
+		const auto report = [&, name = name, size = size](const char* implementation, uint32_t crc, double seconds) {
+			printf("%-8s %-12s %10.1f%s\n", name, implementation, test::megabytesPerSecond(size, seconds),
+				crc == expected ? "" : "  WRONG CRC");
+		};
+
+		if (size == sizes.front().second)
+		{
+			report("bitwise", expected, test::secondsPerRun([&] { sink = test::crc32Bitwise(bytes.data(), bytes.size()); }));
+		}
+
+#ifdef HAVE_ZLIB
+		report("zlib", test::crc32Zlib(bytes.data(), bytes.size()),
+			test::secondsPerRun([&] { test::crc32Zlib(bytes.data(), bytes.size()); }));
+#endif
+
+		report("portable", Crc32::compute(bytes.data(), bytes.size(), 0, Crc32::Backend::Portable),
+			test::secondsPerRun([&] { Crc32::compute(bytes.data(), bytes.size(), 0, Crc32::Backend::Portable); }));
+
+		if (Crc32::getBestBackend() == Crc32::Backend::Pclmul)
+		{
+			report("pclmul", Crc32::compute(bytes.data(), bytes.size(), 0, Crc32::Backend::Pclmul),
+				test::secondsPerRun([&] { Crc32::compute(bytes.data(), bytes.size(), 0, Crc32::Backend::Pclmul); }));
+		}
+
+		report("parallel", Crc32::computeParallel(bytes.data(), bytes.size()),
+			test::secondsPerRun([&] { Crc32::computeParallel(bytes.data(), bytes.size()); }));
+	}
+
+	return 0;
+}
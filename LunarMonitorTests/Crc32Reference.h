@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace test
+{
+	// one bit at a time straight from the definition, slow but obviously right
+	inline uint32_t crc32Bitwise(const unsigned char* data, size_t length, uint32_t crc = 0)
+	{
+		crc = ~crc;
+
+		for (size_t i = 0; i != length; ++i)
+		{
+			crc ^= data[i];
+			for (int bit = 0; bit != 8; ++bit)
+				crc = (crc & 1) != 0 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+		}
+
+		return ~crc;
+	}
+
+#ifdef HAVE_ZLIB
+	inline uint32_t crc32Zlib(const unsigned char* data, size_t length, uint32_t crc = 0)
+	{
+		// zlib takes at most a uInt at a time
+		while (length != 0)
+		{
+			const uInt chunk = length > 0x40000000 ? 0x40000000 : static_cast<uInt>(length);
+			crc = static_cast<uint32_t>(crc32(crc, data, chunk));
+			data += chunk;
+			length -= chunk;
+		}
+
+		return crc;
+	}
+#endif
+}
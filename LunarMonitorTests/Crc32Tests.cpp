@@ -0,0 +1,97 @@
+#include "TestSupport.h"
+
+#include "Crc32.h"
+#include "Crc32Reference.h"
+
+namespace
+{
+	std::vector<Crc32::Backend> getSupportedBackends()
+	{
+		std::vector<Crc32::Backend> backends{ Crc32::Backend::Portable };
+
+		if (Crc32::getBestBackend() == Crc32::Backend::Pclmul)
+			backends.push_back(Crc32::Backend::Pclmul);
+
+		return backends;
+	}
+
+	void testCheckValue()
+	{
+		const char* text = "123456789";
+
+		CHECK_EQUAL(Crc32::compute(text, 9), 0xcbf43926u);
+		CHECK_EQUAL(Crc32::compute(text, 0), 0u);
+
+		for (Crc32::Backend backend : getSupportedBackends())
+			CHECK_EQUAL(Crc32::compute(text, 9, 0, backend), 0xcbf43926u);
+	}
+
+	// every length up to a few folding blocks and random longer ones, starting
+	// at unaligned offsets and continuing from a previous crc
+	void testMatchesReference(Crc32::Backend backend, std::mt19937& random)
+	{
+		const std::vector<unsigned char> bytes = test::randomBytes(random, 300000);
+		std::uniform_int_distribution<size_t> offset(0, 15);
+		std::uniform_int_distribution<size_t> longLength(0, 250000);
+		std::uniform_int_distribution<uint32_t> initialCrc;
+
+		for (size_t i = 0; i != 1500; ++i)
+		{
+			const unsigned char* data = bytes.data() + offset(random);
+			const size_t length = i < 1000 ? i : longLength(random);
+			const uint32_t crc = i % 2 == 0 ? 0 : initialCrc(random);
+
+			const uint32_t expected = test::crc32Bitwise(data, length, crc);
+			CHECK_EQUAL(Crc32::compute(data, length, crc, backend), expected);
+
+#ifdef HAVE_ZLIB
+			CHECK_EQUAL(test::crc32Zlib(data, length, crc), expected);
+#endif
+		}
+	}
+
+	void testCombine(std::mt19937& random)
+	{
+		const std::vector<unsigned char> bytes = test::randomBytes(random, 100000);
+		std::uniform_int_distribution<size_t> split(0, bytes.size());
+
+		for (int i = 0; i != 200; ++i)
+		{
+			const size_t length = split(random);
+			const size_t middle = i < 20 ? (i < 10 ? 0 : length) : std::uniform_int_distribution<size_t>(0, length)(random);
+
+			const uint32_t first = Crc32::compute(bytes.data(), middle);
+			const uint32_t second = Crc32::compute(bytes.data() + middle, length - middle);
+
+			CHECK_EQUAL(Crc32::combine(first, second, length - middle), Crc32::compute(bytes.data(), length));
+		}
+	}
+
+	// ROM sized buffers are split across threads, odd lengths leave a short
+	// last chunk
+	void testParallel(std::mt19937& random)
+	{
+		const std::vector<unsigned char> bytes = test::randomBytes(random, 8 * 1024 * 1024 + 13);
+
+		for (size_t length : { size_t(0), size_t(1), size_t(100000), size_t(512 * 1024 + 1), size_t(4 * 1024 * 1024),
+			bytes.size() })
+		{
+			CHECK_EQUAL(Crc32::computeParallel(bytes.data(), length), test::crc32Bitwise(bytes.data(), length));
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937 random(7);
+
+	testCheckValue();
+
+	for (Crc32::Backend backend : getSupportedBackends())
+		testMatchesReference(backend, random);
+
+	testCombine(random);
+	testParallel(random);
+
+	return test::finish();
+}
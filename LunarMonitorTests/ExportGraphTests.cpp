@@ -0,0 +1,437 @@
+#include "TestSupport.h"
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+#include "ExportAllPipeline.h"
+#include "ExportGraph.h"
+
+// runs export graphs and Export All on stand in stages, either one job at a time
+// on the test's thread, so what's queued when is deterministic, or on a thread
+// of their own where tasks have to overlap
+
+// found through ADL by the checks
+std::ostream& operator<<(std::ostream& out, ExportTaskOutcome outcome)
+{
+	switch (outcome)
+	{
+	case ExportTaskOutcome::Started:
+		return out << "Started";
+	case ExportTaskOutcome::Succeeded:
+		return out << "Succeeded";
+	case ExportTaskOutcome::Failed:
+		return out << "Failed";
+	case ExportTaskOutcome::Cancelled:
+		return out << "Cancelled";
+	case ExportTaskOutcome::Skipped:
+		return out << "Skipped";
+	}
+
+	return out;
+}
+
+namespace
+{
+	using namespace std::chrono_literals;
+
+	// holds on to what it's handed until the test runs it, refuses everything
+	// past the first accepted jobs
+	class ManualExecutor
+	{
+	public:
+		explicit ManualExecutor(size_t accepted = SIZE_MAX)
+			: accepted(accepted)
+		{
+		}
+
+		ExportGraph::Executor get()
+		{
+			return [this](std::function<void()> job) {
+				if (accepted == 0)
+					return false;
+
+				--accepted;
+				jobs.push_back(std::move(job));
+				return true;
+			};
+		}
+
+		size_t queued() const { return jobs.size(); }
+
+		void runNext()
+		{
+			std::function<void()> job = std::move(jobs.front());
+			jobs.pop_front();
+			job();
+		}
+
+		void runAll()
+		{
+			while (!jobs.empty())
+				runNext();
+		}
+
+	private:
+		size_t accepted;
+		std::deque<std::function<void()>> jobs{};
+	};
+
+	// a thread per job, for tasks that have to run at the same time
+	ExportGraph::Executor threadExecutor()
+	{
+		return [](std::function<void()> job) {
+			std::thread(std::move(job)).detach();
+			return true;
+		};
+	}
+
+	// what a graph told its callbacks, in the order it did
+	struct Recorded
+	{
+		std::mutex mutex{};
+		std::vector<ExportTaskEvent> events{};
+		int doneCalls = 0;
+		bool succeeded = false;
+
+		void attach(ExportGraph& graph)
+		{
+			graph.onTaskEvent([this](const ExportTaskEvent& event) {
+				std::lock_guard<std::mutex> lock(mutex);
+				events.push_back(event);
+			});
+
+			graph.onDone([this](bool graphSucceeded, std::chrono::milliseconds) {
+				std::lock_guard<std::mutex> lock(mutex);
+				++doneCalls;
+				succeeded = graphSucceeded;
+			});
+		}
+
+		// onDone is delivered once waitFor was released, by the thread that
+		// finished the last task
+		bool waitForDone()
+		{
+			for (int i = 0; i != 1000; ++i)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+
+					if (doneCalls != 0)
+						return true;
+				}
+
+				std::this_thread::sleep_for(10ms);
+			}
+
+			return false;
+		}
+
+		// the last outcome of task, Started if it only started
+		std::optional<ExportTaskOutcome> outcomeOf(const std::wstring& task)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			std::optional<ExportTaskOutcome> outcome;
+
+			for (const ExportTaskEvent& event : events)
+			{
+				if (event.task == task)
+					outcome = event.outcome;
+			}
+
+			return outcome;
+		}
+	};
+
+	ExportGraph::Task recordRun(std::vector<std::wstring>& ran, std::wstring name)
+	{
+		return [&ran, name](ExportCancellation&) { ran.push_back(name); };
+	}
+
+	void testDependencyOrder()
+	{
+		ManualExecutor executor;
+		ExportGraph graph{ L"order" };
+		Recorded recorded;
+		std::vector<std::wstring> ran;
+
+		const auto a = graph.addTask(L"a", recordRun(ran, L"a"));
+		const auto b = graph.addTask(L"b", recordRun(ran, L"b"));
+		const auto c = graph.addTask(L"c", recordRun(ran, L"c"), { a, b });
+		graph.addTask(L"d", recordRun(ran, L"d"), { c });
+		recorded.attach(graph);
+
+		graph.start(executor.get());
+
+		// only what doesn't depend on anything is queued at first
+		CHECK_EQUAL(executor.queued(), size_t{ 2 });
+
+		executor.runNext();
+
+		// c still waits for b
+		CHECK_EQUAL(executor.queued(), size_t{ 1 });
+		CHECK(!graph.waitFor(0ms));
+
+		executor.runNext();
+		CHECK_EQUAL(executor.queued(), size_t{ 1 });
+
+		executor.runAll();
+
+		CHECK(graph.waitFor(0ms));
+		CHECK(graph.succeeded());
+		CHECK(ran == std::vector<std::wstring>({ L"a", L"b", L"c", L"d" }));
+		CHECK_EQUAL(recorded.doneCalls, 1);
+		CHECK(recorded.succeeded);
+	}
+
+	void testFailureSkipsDependents()
+	{
+		ManualExecutor executor;
+		ExportGraph graph{ L"failure" };
+		Recorded recorded;
+		std::vector<std::wstring> ran;
+
+		const auto a = graph.addTask(L"a", [](ExportCancellation&) { throw std::runtime_error("a failed"); });
+		const auto b = graph.addTask(L"b", recordRun(ran, L"b"));
+		graph.addTask(L"c", recordRun(ran, L"c"), { a, b });
+		recorded.attach(graph);
+
+		graph.start(executor.get());
+		executor.runAll();
+
+		CHECK(graph.waitFor(0ms));
+		CHECK(!graph.succeeded());
+
+		// b was queued before a failed, it's skipped once it gets to run
+		CHECK(ran.empty());
+		CHECK(recorded.outcomeOf(L"a") == ExportTaskOutcome::Failed);
+		CHECK(recorded.outcomeOf(L"b") == ExportTaskOutcome::Skipped);
+		CHECK(recorded.outcomeOf(L"c") == ExportTaskOutcome::Skipped);
+		CHECK_EQUAL(recorded.doneCalls, 1);
+		CHECK(!recorded.succeeded);
+	}
+
+	void testFailureCancelsRunningTasks()
+	{
+		ExportGraph graph{ L"cancel" };
+		Recorded recorded;
+		std::promise<void> started;
+		std::atomic<bool> dependentRan{ false };
+
+		const auto slow = graph.addTask(L"slow", [&started](ExportCancellation& cancellation) {
+			started.set_value();
+
+			while (true)
+			{
+				cancellation.throwIfCancelled();
+				std::this_thread::sleep_for(1ms);
+			}
+		});
+
+		std::shared_future<void> slowStarted = started.get_future().share();
+
+		const auto failing = graph.addTask(L"failing", [slowStarted](ExportCancellation&) {
+			slowStarted.wait();
+			throw std::runtime_error("failing failed");
+		});
+
+		graph.addTask(L"dependent", [&dependentRan](ExportCancellation&) { dependentRan = true; }, { slow, failing });
+		recorded.attach(graph);
+
+		graph.start(threadExecutor());
+
+		CHECK(graph.waitFor(10s));
+		CHECK(!graph.succeeded());
+
+		// every event was delivered before onDone
+		CHECK(recorded.waitForDone());
+		CHECK(!dependentRan);
+		CHECK(recorded.outcomeOf(L"slow") == ExportTaskOutcome::Cancelled);
+		CHECK(recorded.outcomeOf(L"failing") == ExportTaskOutcome::Failed);
+		CHECK(recorded.outcomeOf(L"dependent") == ExportTaskOutcome::Skipped);
+
+		std::lock_guard<std::mutex> lock(recorded.mutex);
+		CHECK_EQUAL(recorded.doneCalls, 1);
+	}
+
+	void testRefusedTasksFailOnce()
+	{
+		// the first task is taken, its dependents are refused once it succeeds
+		ManualExecutor executor{ 1 };
+		ExportGraph graph{ L"refused" };
+		Recorded recorded;
+		std::vector<std::wstring> ran;
+
+		const auto a = graph.addTask(L"a", recordRun(ran, L"a"));
+		graph.addTask(L"b", recordRun(ran, L"b"), { a });
+		graph.addTask(L"c", recordRun(ran, L"c"), { a });
+		recorded.attach(graph);
+
+		graph.start(executor.get());
+		executor.runAll();
+
+		CHECK(graph.waitFor(0ms));
+		CHECK(!graph.succeeded());
+		CHECK(ran == std::vector<std::wstring>({ L"a" }));
+		CHECK(recorded.outcomeOf(L"b") == ExportTaskOutcome::Failed);
+		CHECK(recorded.outcomeOf(L"c") == ExportTaskOutcome::Skipped);
+		CHECK_EQUAL(recorded.doneCalls, 1);
+
+		// refused right away
+		ManualExecutor refusing{ 0 };
+		ExportGraph refused{ L"refused at start" };
+		Recorded refusedRecorded;
+
+		refused.addTask(L"a", recordRun(ran, L"a"));
+		refused.addTask(L"b", recordRun(ran, L"b"));
+		refusedRecorded.attach(refused);
+
+		refused.start(refusing.get());
+
+		CHECK(refused.waitFor(0ms));
+		CHECK(refusedRecorded.outcomeOf(L"a") == ExportTaskOutcome::Failed);
+		CHECK(refusedRecorded.outcomeOf(L"b") == ExportTaskOutcome::Skipped);
+		CHECK_EQUAL(refusedRecorded.doneCalls, 1);
+	}
+
+	void testEmptyGraph()
+	{
+		ManualExecutor executor;
+		ExportGraph graph{ L"empty" };
+		Recorded recorded;
+		recorded.attach(graph);
+
+		graph.start(executor.get());
+
+		CHECK(graph.waitFor(0ms));
+		CHECK(graph.succeeded());
+		CHECK_EQUAL(recorded.doneCalls, 1);
+		CHECK(recorded.succeeded);
+	}
+
+	void testProgressCounts()
+	{
+		ManualExecutor executor;
+		ExportGraph graph{ L"progress" };
+		Recorded recorded;
+		std::vector<std::wstring> ran;
+
+		const auto a = graph.addTask(L"a", recordRun(ran, L"a"));
+		const auto b = graph.addTask(L"b", recordRun(ran, L"b"), { a });
+		graph.addTask(L"c", recordRun(ran, L"c"), { b });
+		recorded.attach(graph);
+
+		graph.start(executor.get());
+		executor.runAll();
+
+		// started and finished for each task
+		CHECK_EQUAL(recorded.events.size(), size_t{ 6 });
+
+		size_t finished = 0;
+
+		for (const ExportTaskEvent& event : recorded.events)
+		{
+			CHECK_EQUAL(event.total, size_t{ 3 });
+
+			if (event.outcome != ExportTaskOutcome::Started)
+				++finished;
+
+			CHECK_EQUAL(event.finished, finished);
+		}
+
+		CHECK_EQUAL(finished, size_t{ 3 });
+	}
+
+	void testCallbacksMayUseTheGraph()
+	{
+		ManualExecutor executor;
+		ExportGraph graph{ L"reentrant" };
+		std::vector<std::wstring> ran;
+		bool succeededInOnDone = false;
+
+		graph.addTask(L"a", recordRun(ran, L"a"));
+
+		// would deadlock if called with the graph's lock held
+		graph.onTaskEvent([&graph](const ExportTaskEvent&) { graph.waitFor(0ms); });
+		graph.onDone([&graph, &succeededInOnDone](bool, std::chrono::milliseconds) { succeededInOnDone = graph.succeeded(); });
+
+		graph.start(executor.get());
+		executor.runAll();
+
+		CHECK(succeededInOnDone);
+	}
+
+	void testExportAllPipeline()
+	{
+		ManualExecutor executor;
+		std::vector<std::wstring> ran;
+		std::vector<ExportTaskEvent> progress;
+		int finishedCalls = 0;
+		bool succeeded = false;
+
+		std::vector<ExportAllStage> stages;
+		stages.push_back({ L"first", recordRun(ran, L"first") });
+		stages.push_back({ L"second", recordRun(ran, L"second") });
+
+		const bool started = ExportAllPipeline::start(executor.get(), std::move(stages),
+			[&progress](const ExportTaskEvent& event) { progress.push_back(event); },
+			[&](bool pipelineSucceeded, std::chrono::milliseconds) {
+				++finishedCalls;
+				succeeded = pipelineSucceeded;
+
+				// already false once onFinished is called
+				CHECK(!ExportAllPipeline::isRunning());
+			});
+
+		CHECK(started);
+		CHECK(ExportAllPipeline::isRunning());
+
+		// stages don't depend on each other, they're all queued at once
+		CHECK_EQUAL(executor.queued(), size_t{ 2 });
+
+		// a second Export All isn't started while one is running
+		CHECK(!ExportAllPipeline::start(executor.get(), {}, [](const ExportTaskEvent&) {}, [](bool, std::chrono::milliseconds) {}));
+		CHECK_EQUAL(executor.queued(), size_t{ 2 });
+
+		executor.runAll();
+
+		CHECK(!ExportAllPipeline::isRunning());
+		CHECK_EQUAL(finishedCalls, 1);
+		CHECK(succeeded);
+		CHECK_EQUAL(ran.size(), size_t{ 2 });
+		CHECK_EQUAL(progress.size(), size_t{ 4 });
+		CHECK_EQUAL(progress.back().finished, size_t{ 2 });
+
+		// a failing stage fails Export All
+		std::vector<ExportAllStage> failing;
+		failing.push_back({ L"failing", [](ExportCancellation&) { throw std::runtime_error("stage failed"); } });
+
+		CHECK(ExportAllPipeline::start(executor.get(), std::move(failing), [](const ExportTaskEvent&) {},
+			[&](bool pipelineSucceeded, std::chrono::milliseconds) {
+				++finishedCalls;
+				succeeded = pipelineSucceeded;
+			}));
+
+		executor.runAll();
+
+		CHECK_EQUAL(finishedCalls, 2);
+		CHECK(!succeeded);
+		CHECK(!ExportAllPipeline::isRunning());
+	}
+}
+
+int main()
+{
+	testDependencyOrder();
+	testFailureSkipsDependents();
+	testFailureCancelsRunningTasks();
+	testRefusedTasksFailOnce();
+	testEmptyGraph();
+	testProgressCounts();
+	testCallbacksMayUseTheGraph();
+	testExportAllPipeline();
+
+	return test::finish();
+}
@@ -0,0 +1,340 @@
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#include "ExportScheduler.h"
+
+// the scheduler with a clock that only moves when a test moves it, two workers
+// and a runner that holds every job it's handed until the test lets it finish,
+// so what runs when follows from the rules and not from how fast the machine is
+//
+// the scheduler is shared by the tests, each uses levels of its own and waits
+// for the scheduler to be idle before it returns
+
+namespace
+{
+	using namespace std::chrono_literals;
+
+	constexpr std::chrono::milliseconds DEBOUNCE_DELAY{ 100 };
+	constexpr std::chrono::milliseconds BULK_AGING_DELAY{ 5000 };
+
+	// how long a worker gets to start a job it shouldn't, there's no event for
+	// a job that correctly doesn't run
+	constexpr std::chrono::milliseconds SETTLE_TIME{ 50 };
+
+	class ManualClock
+	{
+	public:
+		ExportScheduler::Clock get()
+		{
+			return [this] { return std::chrono::steady_clock::time_point(std::chrono::milliseconds(elapsed.load())); };
+		}
+
+		void advance(std::chrono::milliseconds by)
+		{
+			elapsed += by.count();
+			ExportScheduler::clockChanged();
+		}
+
+	private:
+		// far enough from the clock's epoch that nothing is ready before it
+		std::atomic<long long> elapsed{ 3600000 };
+	};
+
+	// what the runner was handed in one call, a single job or a level batch
+	struct Run
+	{
+		std::vector<ExportJob> jobs;
+		std::vector<std::shared_ptr<ExportCancellation>> cancellations;
+		bool released;
+	};
+
+	// holds each run until it's released or all of its jobs are cancelled, like
+	// an export that checks in with its cancellation
+	class HeldRunner
+	{
+	public:
+		ExportScheduler::Runner get()
+		{
+			return [this](const std::vector<ExportJob>& jobs, const std::vector<std::shared_ptr<ExportCancellation>>& cancellations) {
+				std::unique_lock<std::mutex> lock(mutex);
+
+				const size_t index = runs.size();
+				runs.push_back({ jobs, cancellations, false });
+				changed.notify_all();
+
+				const auto allCancelled = [&] {
+					return std::all_of(cancellations.begin(), cancellations.end(),
+						[](const std::shared_ptr<ExportCancellation>& cancellation) { return cancellation->isCancelled(); });
+				};
+
+				// cancel doesn't signal anything the runner could wait on
+				while (!runs[index].released && !allCancelled())
+					changed.wait_for(lock, 1ms);
+
+				std::vector<bool> finished;
+
+				for (const std::shared_ptr<ExportCancellation>& cancellation : cancellations)
+					finished.push_back(!cancellation->isCancelled());
+
+				return finished;
+			};
+		}
+
+		// false if fewer than count runs started in time
+		bool waitForRuns(size_t count)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			return changed.wait_for(lock, 5s, [&] { return runs.size() >= count; });
+		}
+
+		size_t runCount()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			return runs.size();
+		}
+
+		Run run(size_t index)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			return runs.at(index);
+		}
+
+		void release(size_t index)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			runs.at(index).released = true;
+			changed.notify_all();
+		}
+
+	private:
+		std::mutex mutex{};
+		std::condition_variable changed{};
+		std::vector<Run> runs{};
+	};
+
+	ManualClock manualClock;
+	HeldRunner runner;
+	std::optional<Config> debouncedConfig;
+
+	// a save of type whose export waits for the debounce delay if debounced,
+	// otherwise it's ready right away
+	ExportJob save(ExportJobType type, bool succeeded, unsigned int levelNumber, bool debounced)
+	{
+		return { type, succeeded, debounced ? debouncedConfig : std::nullopt, levelNumber };
+	}
+
+	// runs started so far, after giving the workers time to start one that
+	// shouldn't be
+	size_t settledRunCount()
+	{
+		std::this_thread::sleep_for(SETTLE_TIME);
+
+		return runner.runCount();
+	}
+
+	void testDebounce()
+	{
+		const size_t runs = runner.runCount();
+		const ExportCounters before = ExportScheduler::getCounters();
+
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, true, 1, true)));
+		CHECK_EQUAL(settledRunCount(), runs);
+
+		manualClock.advance(60ms);
+		CHECK_EQUAL(settledRunCount(), runs);
+
+		// a further save restarts the delay
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, true, 1, true)));
+		CHECK_EQUAL(ExportScheduler::getCounters().superseded, before.superseded + 1);
+
+		manualClock.advance(60ms);
+		CHECK_EQUAL(settledRunCount(), runs);
+
+		manualClock.advance(40ms);
+		CHECK(runner.waitForRuns(runs + 1));
+		CHECK_EQUAL(runner.run(runs).jobs.size(), size_t{ 1 });
+
+		// a save that doesn't say when to run is ready right away
+		runner.release(runs);
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, true, 1, false)));
+		CHECK(runner.waitForRuns(runs + 2));
+		runner.release(runs + 1);
+
+		CHECK(ExportScheduler::waitForIdle(5s));
+	}
+
+	void testCoalescing()
+	{
+		const size_t runs = runner.runCount();
+		const ExportCounters before = ExportScheduler::getCounters();
+
+		for (int i = 0; i != 3; ++i)
+			CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, true, 10, true)));
+
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, true, 11, true)));
+
+		const ExportCounters queued = ExportScheduler::getCounters();
+		CHECK_EQUAL(queued.queued, size_t{ 2 });
+		CHECK_EQUAL(queued.superseded, before.superseded + 2);
+
+		// one export per level, and the levels are exported together
+		manualClock.advance(DEBOUNCE_DELAY);
+		CHECK(runner.waitForRuns(runs + 1));
+
+		const Run batch = runner.run(runs);
+		CHECK_EQUAL(batch.jobs.size(), size_t{ 2 });
+
+		if (batch.jobs.size() == 2)
+		{
+			CHECK_EQUAL(batch.jobs[0].levelNumber, 10u);
+			CHECK_EQUAL(batch.jobs[1].levelNumber, 11u);
+		}
+
+		// a save of a level that's being exported waits for that export, later
+		// ones replace it
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, false, 10, false)));
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, false, 10, false)));
+		CHECK_EQUAL(settledRunCount(), runs + 1);
+		CHECK_EQUAL(ExportScheduler::getCounters().superseded, before.superseded + 3);
+
+		runner.release(runs);
+		CHECK(runner.waitForRuns(runs + 2));
+		runner.release(runs + 1);
+
+		CHECK(ExportScheduler::waitForIdle(5s));
+		CHECK_EQUAL(runner.runCount(), runs + 2);
+	}
+
+	void testFailedSaves()
+	{
+		const size_t runs = runner.runCount();
+		const ExportCounters before = ExportScheduler::getCounters();
+
+		// the ROM still holds what the successful save wrote, so its export stays
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, true, 20, true)));
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, false, 20, true)));
+		CHECK_EQUAL(ExportScheduler::getCounters().superseded, before.superseded);
+
+		// a failed save is replaced by a successful one like any other
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, false, 21, true)));
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, true, 21, true)));
+		CHECK_EQUAL(ExportScheduler::getCounters().superseded, before.superseded + 1);
+
+		manualClock.advance(DEBOUNCE_DELAY);
+		CHECK(runner.waitForRuns(runs + 1));
+
+		const Run batch = runner.run(runs);
+		CHECK_EQUAL(batch.jobs.size(), size_t{ 2 });
+
+		for (const ExportJob& job : batch.jobs)
+			CHECK(job.succeeded);
+
+		runner.release(runs);
+		CHECK(ExportScheduler::waitForIdle(5s));
+	}
+
+	void testCancellation()
+	{
+		const size_t runs = runner.runCount();
+		const ExportCounters before = ExportScheduler::getCounters();
+
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, true, 30, false)));
+		CHECK(runner.waitForRuns(runs + 1));
+
+		// a failed save doesn't cancel, the export still has the only good output
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, false, 30, false)));
+		CHECK(!runner.run(runs).cancellations.front()->isCancelled());
+
+		// a successful one does, and replaces the failed one
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, true, 30, false)));
+		CHECK(runner.run(runs).cancellations.front()->isCancelled());
+		CHECK_EQUAL(ExportScheduler::getCounters().cancelled, before.cancelled + 1);
+
+		// the rerun took over from a cancelled run, it's left to finish
+		CHECK(runner.waitForRuns(runs + 2));
+		CHECK(runner.run(runs + 1).jobs.front().succeeded);
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, true, 30, false)));
+		CHECK(!runner.run(runs + 1).cancellations.front()->isCancelled());
+		CHECK_EQUAL(settledRunCount(), runs + 2);
+
+		// once a run finished, the next may be cancelled again
+		runner.release(runs + 1);
+		CHECK(runner.waitForRuns(runs + 3));
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, true, 30, false)));
+		CHECK(runner.run(runs + 2).cancellations.front()->isCancelled());
+		CHECK_EQUAL(ExportScheduler::getCounters().cancelled, before.cancelled + 2);
+
+		CHECK(runner.waitForRuns(runs + 4));
+		runner.release(runs + 3);
+
+		CHECK(ExportScheduler::waitForIdle(5s));
+		CHECK_EQUAL(runner.runCount(), runs + 4);
+	}
+
+	void testBulkJobs()
+	{
+		const size_t runs = runner.runCount();
+
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::GlobalData, true, 0, false)));
+		CHECK(runner.waitForRuns(runs + 1));
+
+		// the other worker is kept for saves the user waits on
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Map16, true, 0, false)));
+		CHECK_EQUAL(settledRunCount(), runs + 1);
+
+		CHECK(ExportScheduler::enqueue(save(ExportJobType::Level, true, 40, false)));
+		CHECK(runner.waitForRuns(runs + 2));
+		CHECK(runner.run(runs + 1).jobs.front().type == ExportJobType::Level);
+		runner.release(runs + 1);
+
+		CHECK_EQUAL(settledRunCount(), runs + 2);
+
+		// until the bulk job waited long enough to count as interactive
+		manualClock.advance(BULK_AGING_DELAY - 1ms);
+		CHECK_EQUAL(settledRunCount(), runs + 2);
+
+		manualClock.advance(1ms);
+		CHECK(runner.waitForRuns(runs + 3));
+		CHECK(runner.run(runs + 2).jobs.front().type == ExportJobType::Map16);
+
+		runner.release(runs);
+		runner.release(runs + 2);
+
+		CHECK(ExportScheduler::waitForIdle(5s));
+	}
+}
+
+int main()
+{
+	test::TemporaryDirectory directory;
+	const fs::path configPath = directory / "lunar-monitor-config.txt";
+	const std::string configText = "export_debounce_delay: " + std::to_string(DEBOUNCE_DELAY.count()) + "\n";
+	test::writeFile(configPath, std::vector<unsigned char>(configText.begin(), configText.end()));
+	debouncedConfig.emplace(configPath);
+
+	ExportScheduler::setRunner(runner.get());
+	ExportScheduler::setClock(manualClock.get());
+	ExportScheduler::setMaxWorkers(2);
+
+	testDebounce();
+	testCoalescing();
+	testFailedSaves();
+	testCancellation();
+	testBulkJobs();
+
+	const int result = test::finish();
+
+	// the workers only stop once drained, and wait on condition variables whose
+	// destructors would wait for them
+	std::_Exit(result);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+
+#include "TestSupport.h"
+#include "md5.h"
+
+namespace test
+{
+	// md5Folder as it was before it was pipelined, every file read one after
+	// another in sorted order, the digest it produces is what md5Folder has to
+	// keep producing
+	inline std::string md5FolderSequential(const fs::path& rootPath)
+	{
+		std::vector<fs::path> paths;
+
+		for (auto entry = fs::recursive_directory_iterator(rootPath); entry != fs::recursive_directory_iterator(); ++entry)
+		{
+			if (!entry->is_directory())
+				paths.push_back(entry->path());
+		}
+
+		std::sort(paths.begin(), paths.end(), [](const fs::path& a, const fs::path& b) -> bool
+			{
+				std::string strA = a.string();
+				std::string strB = b.string();
+
+				std::transform(strA.begin(), strA.end(), strA.begin(), ::tolower);
+				std::transform(strB.begin(), strB.end(), strB.begin(), ::tolower);
+
+				return strA < strB;
+			});
+
+		MD5 md5;
+
+		for (const auto& path : paths)
+		{
+			std::string relativePath = path.string().substr(rootPath.string().length() + 1, std::string::npos);
+			std::transform(relativePath.begin(), relativePath.end(), relativePath.begin(), ::tolower);
+
+			md5.update(relativePath.c_str(), relativePath.length());
+
+			std::ifstream input(path, std::ios::binary);
+			std::string bytes((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+			md5.update(bytes.c_str(), bytes.length());
+		}
+
+		md5.finalize();
+		return md5.hexdigest();
+	}
+}
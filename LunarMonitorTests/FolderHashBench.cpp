@@ -0,0 +1,123 @@
+#include "FolderHash.h"
+
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// md5Folder against the sequential folder hash it replaced, on trees shaped
+// like Graphics and ExGraphics, 4 KB files spread over a few subdirectories
+//
+// warm runs read from the page cache, cold runs drop the tree's files from it
+// first, which only works on Linux, elsewhere cold runs are skipped
+//
+//   FolderHashBench [file count...]
+
+namespace
+{
+	void createTree(const fs::path& root, size_t fileCount)
+	{
+		std::mt19937 random(1);
+
+		for (size_t i = 0; i != fileCount; ++i)
+		{
+			const fs::path directory = root / ("ExGraphics" + std::to_string(i % 8));
+			test::writeFile(directory / ("ExGFX" + std::to_string(i) + ".bin"), test::randomBytes(random, 4096));
+		}
+	}
+
+	bool dropFromPageCache(const fs::path& root)
+	{
+#ifdef _WIN32
+		return false;
+#else
+		sync();
+
+		for (const auto& entry : fs::recursive_directory_iterator(root))
+		{
+			if (entry.is_directory())
+				continue;
+
+			const int fd = open(entry.path().c_str(), O_RDONLY);
+			if (fd < 0)
+				return false;
+
+			const int result = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+
+			if (result != 0)
+				return false;
+		}
+
+		return true;
+#endif
+	}
+
+	template <typename F>
+	double secondsPerColdRun(const fs::path& root, F&& f)
+	{
+		constexpr int RUNS = 3;
+		double total = 0;
+
+		for (int i = 0; i != RUNS; ++i)
+		{
+			if (!dropFromPageCache(root))
+				return -1;
+
+			total += test::secondsPerRun(f, 0);
+		}
+
+		return total / RUNS;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<size_t> fileCounts{ 1000, 5000, 20000 };
+
+	if (argc > 1)
+	{
+		fileCounts.clear();
+		for (int i = 1; i != argc; ++i)
+			fileCounts.push_back(static_cast<size_t>(std::strtoul(argv[i], nullptr, 10)));
+	}
+
+	printf("%-8s %-5s %16s %16s %8s\n", "files", "cache", "sequential ms", "pipelined ms", "speedup");
+
+	for (size_t fileCount : fileCounts)
+	{
+		test::TemporaryDirectory directory;
+		createTree(directory.get(), fileCount);
+
+		if (md5Folder(directory.get()) != test::md5FolderSequential(directory.get()))
+		{
+			fprintf(stderr, "digests differ for %zu files\n", fileCount);
+			return 1;
+		}
+
+		const auto sequential = [&] { test::md5FolderSequential(directory.get()); };
+		const auto pipelined = [&] { md5Folder(directory.get()); };
+
+		const double warmSequential = test::secondsPerRun(sequential);
+		const double warmPipelined = test::secondsPerRun(pipelined);
+
+		printf("%-8zu %-5s %16.1f %16.1f %7.2fx\n", fileCount, "warm",
+			warmSequential * 1000, warmPipelined * 1000, warmSequential / warmPipelined);
+
+		const double coldSequential = secondsPerColdRun(directory.get(), sequential);
+		const double coldPipelined = secondsPerColdRun(directory.get(), pipelined);
+
+		if (coldSequential < 0 || coldPipelined < 0)
+		{
+			printf("%-8zu %-5s %16s %16s\n", fileCount, "cold", "n/a", "n/a");
+			continue;
+		}
+
+		printf("%-8zu %-5s %16.1f %16.1f %7.2fx\n", fileCount, "cold",
+			coldSequential * 1000, coldPipelined * 1000, coldSequential / coldPipelined);
+	}
+
+	return 0;
+}
@@ -0,0 +1,93 @@
+#include "FolderHash.h"
+
+namespace
+{
+	// names mix case so sorting has to go by the lowercased path, and top level
+	// files sort between subdirectories so the order enumeration finishes in
+	// can't leak into the digest
+	void createTree(const fs::path& root, std::mt19937& random, size_t fileCount)
+	{
+		const std::vector<std::string> directories{ "", "ExGraphics", "graphics", "Graphics/Sub", "levels", "Z" };
+		std::uniform_int_distribution<size_t> directory(0, directories.size() - 1);
+		std::uniform_int_distribution<size_t> size(0, 6000);
+
+		for (size_t i = 0; i != fileCount; ++i)
+		{
+			const std::string name = (i % 3 == 0 ? "File" : "file") + std::to_string(i) + (i % 2 == 0 ? ".BIN" : ".bin");
+			const size_t length = i % 17 == 0 ? 0 : size(random);
+
+			test::writeFile(root / directories[directory(random)] / name, test::randomBytes(random, length));
+		}
+	}
+
+	void testMatchesSequential(size_t fileCount, std::mt19937& random)
+	{
+		test::TemporaryDirectory directory;
+		createTree(directory.get(), random, fileCount);
+
+		CHECK_EQUAL(md5Folder(directory.get()), test::md5FolderSequential(directory.get()));
+	}
+
+	// files too large to be read ahead are streamed by the hashing thread in
+	// between files that were
+	void testLargeFiles(std::mt19937& random)
+	{
+		test::TemporaryDirectory directory;
+		createTree(directory.get(), random, 40);
+
+		test::writeFile(directory / "graphics" / "large.bin", test::randomBytes(random, 1024 * 1024 + 1));
+		test::writeFile(directory / "levels" / "huge.bin", test::randomBytes(random, 5 * 1024 * 1024));
+		test::writeFile(directory / "exactly.bin", test::randomBytes(random, 1024 * 1024));
+
+		CHECK_EQUAL(md5Folder(directory.get()), test::md5FolderSequential(directory.get()));
+	}
+
+	void testEmptyFolders()
+	{
+		test::TemporaryDirectory directory;
+		CHECK_EQUAL(md5Folder(directory.get()), MD5("").hexdigest());
+
+		fs::create_directories(directory / "a" / "b");
+		fs::create_directories(directory / "c");
+		CHECK_EQUAL(md5Folder(directory.get()), MD5("").hexdigest());
+	}
+
+	// the digest only depends on names and contents
+	void testChanges(std::mt19937& random)
+	{
+		test::TemporaryDirectory directory;
+		createTree(directory.get(), random, 100);
+
+		const std::string before = md5Folder(directory.get());
+		CHECK_EQUAL(md5Folder(directory.get()), before);
+
+		const fs::path path = directory / "levels" / "changed.bin";
+		test::writeFile(path, { 1, 2, 3 });
+		const std::string added = md5Folder(directory.get());
+		CHECK(added != before);
+		CHECK_EQUAL(added, test::md5FolderSequential(directory.get()));
+
+		test::writeFile(path, { 1, 2, 4 });
+		CHECK(md5Folder(directory.get()) != added);
+		CHECK_EQUAL(md5Folder(directory.get()), test::md5FolderSequential(directory.get()));
+
+		fs::remove(path);
+		CHECK_EQUAL(md5Folder(directory.get()), before);
+	}
+}
+
+int main()
+{
+	std::mt19937 random(4);
+
+	// below and above the number of files read ahead is used for, and past
+	// the read ahead window
+	for (size_t fileCount : { 1, 7, 8, 9, 33, 500 })
+		testMatchesSequential(fileCount, random);
+
+	testLargeFiles(random);
+	testEmptyFolders();
+	testChanges(random);
+
+	return test::finish();
+}
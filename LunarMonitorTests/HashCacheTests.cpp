@@ -0,0 +1,353 @@
+#include "FolderHash.h"
+
+#include "HashCache.h"
+
+// the hash cache trusts a file's fingerprint, its size, write time and file id,
+// so these tests set write times explicitly instead of relying on the file
+// system's timestamp granularity to tell two writes apart
+
+namespace
+{
+	using namespace std::chrono_literals;
+
+	struct CacheCounts
+	{
+		uint64_t hits;
+		uint64_t misses;
+	};
+
+	CacheCounts counts()
+	{
+		return { HashCache::getHitCount(), HashCache::getMissCount() };
+	}
+
+	// rewrites path in place, so it keeps its file id, and moves its write time
+	// by shift, zero keeps the one it had
+	void rewrite(const fs::path& path, const std::vector<unsigned char>& contents, fs::file_time_type::duration shift)
+	{
+		const fs::file_time_type writeTime = fs::last_write_time(path);
+
+		test::writeFile(path, contents);
+		fs::last_write_time(path, writeTime + shift);
+	}
+
+	size_t countFiles(const fs::path& folder)
+	{
+		size_t files = 0;
+
+		for (auto entry = fs::recursive_directory_iterator(folder); entry != fs::recursive_directory_iterator(); ++entry)
+			files += !entry->is_directory();
+
+		return files;
+	}
+
+	bool sameCheckpoints(const std::vector<FolderHashCheckpoint>& a, const std::vector<FolderHashCheckpoint>& b)
+	{
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const FolderHashCheckpoint& x, const FolderHashCheckpoint& y) {
+			return x.relativePath == y.relativePath && x.fingerprint == y.fingerprint &&
+				std::equal(std::begin(x.checkpoint.state), std::end(x.checkpoint.state), std::begin(y.checkpoint.state)) &&
+				x.checkpoint.count == y.checkpoint.count &&
+				std::equal(x.checkpoint.buffer, x.checkpoint.buffer + x.checkpoint.bufferedLength(), y.checkpoint.buffer);
+		});
+	}
+
+	void testFileHitsAndMisses(std::mt19937& random)
+	{
+		test::TemporaryDirectory directory;
+		HashCache::enable(directory / "cache.lmhc");
+
+		const fs::path path = directory / "file.bin";
+		test::writeFile(path, test::randomBytes(random, 5000));
+
+		const auto expected = [&] {
+			const std::vector<unsigned char> contents = test::readFile(path);
+			return MD5(std::string(contents.begin(), contents.end())).hexdigest();
+		};
+
+		CacheCounts before = counts();
+		CHECK_EQUAL(md5File(path), expected());
+		CHECK_EQUAL(HashCache::getMissCount(), before.misses + 1);
+
+		before = counts();
+		CHECK_EQUAL(md5File(path), expected());
+		CHECK_EQUAL(HashCache::getHitCount(), before.hits + 1);
+		CHECK_EQUAL(HashCache::getMissCount(), before.misses);
+
+		// same size, new contents and write time
+		rewrite(path, test::randomBytes(random, 5000), 2s);
+		before = counts();
+		CHECK_EQUAL(md5File(path), expected());
+		CHECK_EQUAL(HashCache::getMissCount(), before.misses + 1);
+
+		// only the size tells this one apart
+		rewrite(path, test::randomBytes(random, 4999), 0s);
+		before = counts();
+		CHECK_EQUAL(md5File(path), expected());
+		CHECK_EQUAL(HashCache::getMissCount(), before.misses + 1);
+
+		// touched without changing, still rehashed
+		const std::string touched = expected();
+		fs::last_write_time(path, fs::last_write_time(path) + 2s);
+		before = counts();
+		CHECK_EQUAL(md5File(path), touched);
+		CHECK_EQUAL(HashCache::getMissCount(), before.misses + 1);
+
+		before = counts();
+		CHECK_EQUAL(md5File(path), touched);
+		CHECK_EQUAL(HashCache::getHitCount(), before.hits + 1);
+
+		// the fingerprint is trusted, a change it doesn't show isn't seen
+		rewrite(path, std::vector<unsigned char>(4999, 0), 0s);
+		CHECK_EQUAL(md5File(path), touched);
+
+		// every field of the fingerprint counts
+		const FileFingerprint fingerprint{ 10, 20, 30, 40 };
+		const std::string digest = MD5("stored").hexdigest();
+		HashCache::store(directory / "stored", fingerprint, digest);
+		CHECK(HashCache::lookup(directory / "stored", fingerprint) == digest);
+
+		for (int field = 0; field != 4; ++field)
+		{
+			FileFingerprint changed = fingerprint;
+
+			if (field == 0)
+				++changed.size;
+			else if (field == 1)
+				++changed.lastWriteTime;
+			else if (field == 2)
+				++changed.fileId;
+			else
+				++changed.volumeSerial;
+
+			CHECK(!HashCache::lookup(directory / "stored", changed).has_value());
+		}
+
+		// paths are case insensitive
+		CHECK(HashCache::lookup(directory / "STORED", fingerprint) == digest);
+
+		HashCache::disable();
+	}
+
+	// what the round trip and corruption tests write and expect back
+	struct Stored
+	{
+		fs::path path;
+		FileFingerprint fingerprint;
+		std::string digest;
+	};
+
+	std::vector<Stored> storeEntries(const fs::path& directory, std::mt19937& random, size_t count)
+	{
+		std::vector<Stored> stored;
+
+		for (size_t i = 0; i != count; ++i)
+		{
+			const std::vector<unsigned char> bytes = test::randomBytes(random, 64);
+			Stored entry{ directory / ("entry" + std::to_string(i)), { i, i * 3, i * 7, static_cast<uint32_t>(i) },
+				MD5(std::string(bytes.begin(), bytes.end())).hexdigest() };
+
+			HashCache::store(entry.path, entry.fingerprint, entry.digest);
+			stored.push_back(std::move(entry));
+		}
+
+		return stored;
+	}
+
+	void testRoundTrip(std::mt19937& random)
+	{
+		test::TemporaryDirectory directory;
+		const fs::path cachePath = directory / "cache.lmhc";
+		const fs::path folder = directory / "folder";
+
+		for (size_t i = 0; i != 20; ++i)
+			test::writeFile(folder / ("file" + std::to_string(i) + ".bin"), test::randomBytes(random, i * 37));
+
+		HashCache::enable(cachePath);
+
+		const std::vector<Stored> stored = storeEntries(directory.get(), random, 50);
+		const std::string folderDigest = md5Folder(folder);
+		const std::vector<FolderHashCheckpoint> checkpoints = HashCache::lookupFolder(folder);
+
+		CHECK_EQUAL(checkpoints.size(), size_t{ 20 });
+		CHECK(HashCache::flush());
+		CHECK(fs::exists(cachePath));
+
+		HashCache::disable();
+
+		// nothing is looked up while disabled
+		CHECK(!HashCache::lookup(stored.front().path, stored.front().fingerprint).has_value());
+		CHECK(HashCache::lookupFolder(folder).empty());
+
+		HashCache::enable(cachePath);
+
+		for (const Stored& entry : stored)
+			CHECK(HashCache::lookup(entry.path, entry.fingerprint) == entry.digest);
+
+		CHECK(sameCheckpoints(HashCache::lookupFolder(folder), checkpoints));
+
+		// resumed past every file
+		CHECK_EQUAL(md5Folder(folder), folderDigest);
+
+		HashCache::disable();
+	}
+
+	// a cache file that can't be trusted loses what can't be, it never yields a
+	// wrong digest
+	void testCorruptFiles(std::mt19937& random)
+	{
+		test::TemporaryDirectory directory;
+		const fs::path cachePath = directory / "cache.lmhc";
+		const fs::path folder = directory / "folder";
+
+		for (size_t i = 0; i != 5; ++i)
+			test::writeFile(folder / ("file" + std::to_string(i) + ".bin"), test::randomBytes(random, 100));
+
+		HashCache::enable(cachePath);
+		const std::vector<Stored> stored = storeEntries(directory.get(), random, 10);
+		md5Folder(folder);
+		HashCache::disable();
+
+		const std::vector<unsigned char> intact = test::readFile(cachePath);
+		CHECK(intact.size() > 12);
+
+		const auto entriesFound = [&] {
+			size_t found = 0;
+
+			for (const Stored& entry : stored)
+			{
+				const std::optional<std::string> digest = HashCache::lookup(entry.path, entry.fingerprint);
+
+				CHECK(!digest.has_value() || digest.value() == entry.digest);
+				found += digest.has_value();
+			}
+
+			return found;
+		};
+
+		const auto load = [&](const std::vector<unsigned char>& contents) {
+			test::writeFile(cachePath, contents);
+			HashCache::enable(cachePath);
+		};
+
+		load(intact);
+		CHECK_EQUAL(entriesFound(), stored.size());
+		CHECK_EQUAL(HashCache::lookupFolder(folder).size(), size_t{ 5 });
+		HashCache::disable();
+
+		// wrong magic, then an unknown version
+		for (size_t offset : { 0, 4 })
+		{
+			std::vector<unsigned char> corrupt = intact;
+			corrupt[offset] ^= 0xff;
+
+			load(corrupt);
+			CHECK_EQUAL(entriesFound(), size_t{ 0 });
+			CHECK(HashCache::lookupFolder(folder).empty());
+			HashCache::disable();
+		}
+
+		// more entries than the cache ever holds
+		std::vector<unsigned char> oversized = intact;
+		oversized[8] = oversized[9] = oversized[10] = oversized[11] = 0xff;
+		load(oversized);
+		CHECK_EQUAL(entriesFound(), size_t{ 0 });
+		HashCache::disable();
+
+		// cut off anywhere, the entries are all there or all gone, and so are the
+		// folder's checkpoints
+		for (size_t length = 0; length != intact.size(); ++length)
+		{
+			load(std::vector<unsigned char>(intact.begin(), intact.begin() + length));
+
+			const size_t found = entriesFound();
+			const size_t folderCheckpoints = HashCache::lookupFolder(folder).size();
+
+			CHECK(found == 0 || found == stored.size());
+			CHECK(folderCheckpoints == 0 || folderCheckpoints == 5);
+
+			HashCache::disable();
+		}
+
+		// a folder hash that resumes from a cache whose checkpoints were cut off
+		// still comes out right
+		load(std::vector<unsigned char>(intact.begin(), intact.end() - 1));
+		CHECK_EQUAL(md5Folder(folder), test::md5FolderSequential(folder));
+		HashCache::disable();
+	}
+
+	// every change is compared against hashing the folder from scratch, since a
+	// folder hash that resumed from the wrong checkpoint still looks like a digest
+	void testFolderResume(std::mt19937& random, size_t fileCount)
+	{
+		test::TemporaryDirectory directory;
+		const fs::path folder = directory / "folder";
+
+		for (size_t i = 0; i != fileCount; ++i)
+			test::writeFile(folder / (i % 2 == 0 ? "a" : "b") / ("file" + std::to_string(i) + ".bin"), test::randomBytes(random, 3000));
+
+		HashCache::enable(directory / "cache.lmhc");
+
+		// a checkpoint per file is kept for the next run
+		const auto check = [&] {
+			CHECK_EQUAL(md5Folder(folder), test::md5FolderSequential(folder));
+			CHECK_EQUAL(HashCache::lookupFolder(folder).size(), countFiles(folder));
+		};
+
+		check();
+		const std::string initial = md5Folder(folder);
+
+		// sorts after everything else
+		const fs::path tail = folder / "zz_tail.bin";
+
+		test::writeFile(tail, test::randomBytes(random, 1000));
+		check();
+
+		rewrite(tail, test::randomBytes(random, 1000), 2s);
+		check();
+
+		rewrite(tail, test::randomBytes(random, 999), 0s);
+		check();
+
+		fs::remove(tail);
+		check();
+		CHECK_EQUAL(md5Folder(folder), initial);
+
+		// in the middle and at the front
+		const fs::path middle = folder / "b" / "file1.bin";
+		const fs::path first = folder / "a" / "file0.bin";
+
+		rewrite(middle, test::randomBytes(random, 3000), 2s);
+		check();
+
+		rewrite(first, test::randomBytes(random, 3000), 2s);
+		check();
+
+		test::writeFile(folder / "a" / "added.bin", test::randomBytes(random, 10));
+		check();
+
+		fs::remove(middle);
+		check();
+
+		// a change the fingerprint doesn't show proves the hash resumed past the file
+		const std::string resumed = md5Folder(folder);
+		rewrite(first, test::randomBytes(random, 3000), 0s);
+		CHECK_EQUAL(md5Folder(folder), resumed);
+
+		HashCache::disable();
+	}
+}
+
+int main()
+{
+	std::mt19937 random(8);
+
+	testFileHitsAndMisses(random);
+	testRoundTrip(random);
+	testCorruptFiles(random);
+
+	// below and above the number of files read ahead is used for
+	for (size_t fileCount : { 3, 40 })
+		testFolderResume(random, fileCount);
+
+	return test::finish();
+}
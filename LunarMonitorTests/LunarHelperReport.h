@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+
+// the build report as LunarHelper writes it, Newtonsoft's indented layout with
+// the line breaks of Windows and the type names TypeNameHandling adds, with a
+// dependency graph the monitor never parses in between the members it owns
+
+namespace test
+{
+	inline const std::string ROM_HASH = "0123456789abcdef0123456789abcdef";
+	inline const std::string LEVEL_105_HASH = "11111111111111111111111111111111";
+	inline const std::string LEVEL_106_HASH = "22222222222222222222222222222222";
+	inline const std::string GRAPHICS_HASH = "44444444444444444444444444444444";
+	inline const std::string GLOBAL_DATA_HASH = "55555555555555555555555555555555";
+	inline const std::string NEW_HASH = "abcdefabcdefabcdefabcdefabcdefab";
+
+	inline const std::string DEPENDENCY_GRAPH =
+		"\"dependency_graph\": [\r\n"
+		"    {\r\n"
+		"      \"$type\": \"LunarHelper.DependencyGraphSerializer+JsonVertex, LunarHelper\",\r\n"
+		"      \"id\": \"patch \\\"uberasm\\\" {weird} [path]\",\r\n"
+		"      \"path\": \"C:\\\\hack\\\\asm\\\\main.asm\",\r\n"
+		"      \"dependencies\": [\r\n"
+		"        {\r\n"
+		"          \"$type\": \"LunarHelper.DependencyGraphSerializer+JsonDependency, LunarHelper\",\r\n"
+		"          \"tag\": \"incsrc\",\r\n"
+		"          \"id\": \"33333333333333333333333333333333\"\r\n"
+		"        }\r\n"
+		"      ]\r\n"
+		"    }\r\n"
+		"  ]";
+
+	inline const std::string LUNAR_HELPER_REPORT =
+		"{\r\n"
+		"  \"$type\": \"LunarHelper.Report, LunarHelper\",\r\n"
+		"  \"lunar_helper_version\": \"3.4.0\",\r\n"
+		"  \"report_format_version\": 2,\r\n"
+		"  \"build_time\": \"2024-05-01T12:34:56.789+02:00\",\r\n"
+		"  \"rom_hash\": \"" + ROM_HASH + "\",\r\n"
+		"  \"levels\": {\r\n"
+		"    \"$type\": \"System.Collections.Generic.Dictionary`2[[System.String, System.Private.CoreLib],[System.String, System.Private.CoreLib]], System.Private.CoreLib\",\r\n"
+		"    \"levels/level 105.mwl\": \"" + LEVEL_105_HASH + "\",\r\n"
+		"    \"levels/level 106.mwl\": \"" + LEVEL_106_HASH + "\"\r\n"
+		"  },\r\n"
+		"  " + DEPENDENCY_GRAPH + ",\r\n"
+		"  \"graphics\": \"" + GRAPHICS_HASH + "\",\r\n"
+		"  \"global_data\": \"" + GLOBAL_DATA_HASH + "\",\r\n"
+		"  \"map16\": null\r\n"
+		"}";
+}
@@ -0,0 +1,54 @@
+#include "TestSupport.h"
+
+#include "ReferenceMd5.h"
+#include "md5.h"
+
+// throughput of the MD5 kernel on its own, in memory, against the reference
+// kernel it replaced, digests of both are compared before anything is timed
+
+int main()
+{
+	const std::vector<std::pair<const char*, size_t>> sizes{
+		{ "64 B", 64 },
+		{ "4 KB", 4 * 1024 },
+		{ "1 MB", 1024 * 1024 },
+		{ "8 MB", 8 * 1024 * 1024 }
+	};
+
+	std::mt19937 random(1);
+
+	printf("%-8s %16s %16s %8s\n", "size", "reference MB/s", "MD5 MB/s", "speedup");
+
+	for (const auto& [name, size] : sizes)
+	{
+		const std::vector<unsigned char> bytes = test::randomBytes(random, size);
+
+		const auto reference = [&] {
+			test::ReferenceMD5 md5;
+			md5.update(bytes.data(), bytes.size());
+			return md5.hexdigest();
+		};
+
+		const auto current = [&] {
+			MD5 md5;
+			md5.update(bytes.data(), bytes.size());
+			return md5.finalize().hexdigest();
+		};
+
+		if (reference() != current())
+		{
+			fprintf(stderr, "digests differ for %s\n", name);
+			return 1;
+		}
+
+		const double referenceSeconds = test::secondsPerRun(reference);
+		const double currentSeconds = test::secondsPerRun(current);
+
+		printf("%-8s %16.1f %16.1f %7.2fx\n", name,
+			test::megabytesPerSecond(size, referenceSeconds),
+			test::megabytesPerSecond(size, currentSeconds),
+			referenceSeconds / currentSeconds);
+	}
+
+	return 0;
+}
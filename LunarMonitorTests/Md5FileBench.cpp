@@ -0,0 +1,59 @@
+#include "TestSupport.h"
+
+#include "md5.h"
+
+// md5File throughput for file sizes from single mwls to full ROMs, streamed
+// through the block buffer or mapped, against reading the whole file into a
+// string first, which is what md5File used to do
+//
+// files are read from the page cache, each one was just written
+
+namespace
+{
+	std::string md5WholeFile(const fs::path& path)
+	{
+		std::ifstream input(path, std::ios::binary);
+		std::string bytes((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+		return MD5(bytes).hexdigest();
+	}
+}
+
+int main()
+{
+	const std::vector<std::pair<const char*, size_t>> sizes{
+		{ "1 KB", 1024 },
+		{ "64 KB", 64 * 1024 },
+		{ "1 MB", 1024 * 1024 },
+		{ "8 MB", 8 * 1024 * 1024 }
+	};
+
+	std::mt19937 random(1);
+	test::TemporaryDirectory directory;
+
+	printf("%-8s %16s %16s %16s\n", "size", "whole file MB/s", "buffered MB/s", "mapped MB/s");
+
+	for (const auto& [name, size] : sizes)
+	{
+		const fs::path path = directory / "file.bin";
+		test::writeFile(path, test::randomBytes(random, size));
+
+		const std::string expected = md5WholeFile(path);
+
+		if (md5File(path, FileReadMode::Buffered) != expected || md5File(path, FileReadMode::MemoryMapped) != expected)
+		{
+			fprintf(stderr, "digests differ for %s\n", name);
+			return 1;
+		}
+
+		const double wholeFile = test::secondsPerRun([&] { md5WholeFile(path); });
+		const double buffered = test::secondsPerRun([&] { md5File(path, FileReadMode::Buffered); });
+		const double mapped = test::secondsPerRun([&] { md5File(path, FileReadMode::MemoryMapped); });
+
+		printf("%-8s %16.1f %16.1f %16.1f\n", name,
+			test::megabytesPerSecond(size, wholeFile),
+			test::megabytesPerSecond(size, buffered),
+			test::megabytesPerSecond(size, mapped));
+	}
+
+	return 0;
+}
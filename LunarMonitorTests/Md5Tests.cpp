@@ -0,0 +1,120 @@
+#include "TestSupport.h"
+
+#include "ReferenceMd5.h"
+#include "md5.h"
+
+namespace
+{
+	std::string md5Of(const std::vector<unsigned char>& bytes)
+	{
+		MD5 md5;
+		md5.update(bytes.data(), bytes.size());
+		return md5.finalize().hexdigest();
+	}
+
+	void testRfcVectors()
+	{
+		CHECK_EQUAL(MD5("").hexdigest(), "d41d8cd98f00b204e9800998ecf8427e");
+		CHECK_EQUAL(MD5("a").hexdigest(), "0cc175b9c0f1b6a831c399e269772661");
+		CHECK_EQUAL(MD5("abc").hexdigest(), "900150983cd24fb0d6963f7d28e17f72");
+		CHECK_EQUAL(MD5("message digest").hexdigest(), "f96b697d7cb7938d525a2f31aaf161d0");
+		CHECK_EQUAL(MD5("abcdefghijklmnopqrstuvwxyz").hexdigest(), "c3fcd3d76192e4007dfb496cca67e13b");
+		CHECK_EQUAL(MD5("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789").hexdigest(),
+			"d174ab98d277d9f5a5611c2c9f419d9f");
+		CHECK_EQUAL(MD5("12345678901234567890123456789012345678901234567890123456789012345678901234567890").hexdigest(),
+			"57edf4a22be3c955ac49da2e2107b67a");
+	}
+
+	// feeding the same bytes in arbitrary pieces gives the same digest
+	void testChunkedUpdates(std::mt19937& random)
+	{
+		const std::vector<unsigned char> bytes = test::randomBytes(random, 100000);
+		const std::string expected = md5Of(bytes);
+
+		for (int round = 0; round != 20; ++round)
+		{
+			std::uniform_int_distribution<size_t> pieceLength(0, round < 10 ? 130 : 9000);
+
+			MD5 md5;
+			size_t offset = 0;
+
+			while (offset != bytes.size())
+			{
+				const size_t length = (std::min)(pieceLength(random), bytes.size() - offset);
+				md5.update(bytes.data() + offset, length);
+				offset += length;
+			}
+
+			CHECK_EQUAL(md5.finalize().hexdigest(), expected);
+		}
+	}
+
+	// the rewritten kernel agrees with the one it replaced on every length up
+	// to a few blocks and on random longer ones
+	void testMatchesReference(std::mt19937& random)
+	{
+		std::uniform_int_distribution<size_t> longLength(0, 200000);
+
+		for (size_t i = 0; i != 1000; ++i)
+		{
+			const size_t length = i < 700 ? i : longLength(random);
+			const std::vector<unsigned char> bytes = test::randomBytes(random, length);
+
+			test::ReferenceMD5 reference;
+			reference.update(bytes.data(), bytes.size());
+
+			CHECK_EQUAL(md5Of(bytes), reference.hexdigest());
+		}
+	}
+
+	// streamed files hash exactly like their contents in memory, sizes are picked
+	// around the md5 block, the read buffer (256 KB) and the mapped view (4 MB)
+	void testStreamedFiles(std::mt19937& random)
+	{
+		const std::vector<size_t> sizes{
+			0, 1, 55, 56, 63, 64, 65, 1000,
+			256 * 1024 - 1, 256 * 1024, 256 * 1024 + 1,
+			4 * 1024 * 1024 - 1, 4 * 1024 * 1024, 4 * 1024 * 1024 + 17,
+			9 * 1024 * 1024 + 3
+		};
+
+		test::TemporaryDirectory directory;
+
+		for (size_t size : sizes)
+		{
+			const fs::path path = directory / ("file" + std::to_string(size) + ".bin");
+			const std::vector<unsigned char> contents = test::randomBytes(random, size);
+			test::writeFile(path, contents);
+
+			const std::string expected = md5Of(contents);
+
+			CHECK_EQUAL(md5File(path, FileReadMode::Buffered), expected);
+			CHECK_EQUAL(md5File(path, FileReadMode::MemoryMapped), expected);
+			CHECK(md5IfExists(path) == expected);
+		}
+	}
+
+	// a missing file contributes no bytes in either mode
+	void testMissingFiles()
+	{
+		test::TemporaryDirectory directory;
+		const fs::path path = directory / "missing.bin";
+
+		CHECK_EQUAL(md5File(path, FileReadMode::Buffered), MD5("").hexdigest());
+		CHECK_EQUAL(md5File(path, FileReadMode::MemoryMapped), MD5("").hexdigest());
+		CHECK(!md5IfExists(path).has_value());
+	}
+}
+
+int main()
+{
+	std::mt19937 random(1);
+
+	testRfcVectors();
+	testChunkedUpdates(random);
+	testMatchesReference(random);
+	testStreamedFiles(random);
+	testMissingFiles();
+
+	return test::finish();
+}
@@ -0,0 +1,81 @@
+#include "TestSupport.h"
+
+#include "md5.h"
+#include "md5_multibuffer.h"
+
+// hashing a level directory of 1,000 mwls, one md5File per file against a
+// single md5Files batch, and the multi-buffer engine on its own per backend
+// with the files already in memory
+
+int main()
+{
+	constexpr size_t LEVEL_COUNT = 1000;
+
+	std::mt19937 random(1);
+	std::uniform_int_distribution<size_t> length(2 * 1024, 16 * 1024);
+
+	test::TemporaryDirectory directory;
+	std::vector<fs::path> paths;
+	std::vector<std::vector<unsigned char>> contents;
+	uint64_t totalSize = 0;
+
+	for (size_t i = 0; i != LEVEL_COUNT; ++i)
+	{
+		paths.push_back(directory / ("level " + std::to_string(i) + ".mwl"));
+		contents.push_back(test::randomBytes(random, length(random)));
+		test::writeFile(paths.back(), contents.back());
+		totalSize += contents.back().size();
+	}
+
+	std::vector<std::string> expected;
+	for (const auto& path : paths)
+		expected.push_back(md5File(path));
+
+	if (md5Files(paths) != expected)
+	{
+		fprintf(stderr, "md5Files and md5File disagree\n");
+		return 1;
+	}
+
+	printf("%-28s %10s %10s\n", "", "ms", "MB/s");
+
+	const auto report = [&](const char* name, double seconds) {
+		printf("%-28s %10.2f %10.1f\n", name, seconds * 1000, test::megabytesPerSecond(totalSize, seconds));
+	};
+
+	report("md5File per file", test::secondsPerRun([&] {
+		for (const auto& path : paths)
+			md5File(path);
+	}));
+
+	report("md5Files", test::secondsPerRun([&] { md5Files(paths); }));
+
+	std::vector<MultiBufferMD5::Message> messages;
+	for (const auto& bytes : contents)
+		messages.push_back({ bytes.data(), bytes.size() });
+
+	report("in memory, MD5 per file", test::secondsPerRun([&] {
+		for (const auto& bytes : contents)
+		{
+			MD5 md5;
+			md5.update(bytes.data(), bytes.size());
+			md5.finalize();
+		}
+	}));
+
+	const std::vector<std::pair<const char*, MultiBufferMD5::Backend>> backends{
+		{ "in memory, scalar lanes", MultiBufferMD5::Backend::Scalar },
+		{ "in memory, SSE2 lanes", MultiBufferMD5::Backend::SSE2 },
+		{ "in memory, AVX2 lanes", MultiBufferMD5::Backend::AVX2 }
+	};
+
+	for (const auto& [name, backend] : backends)
+	{
+		if (static_cast<int>(backend) > static_cast<int>(MultiBufferMD5::getBestBackend()))
+			continue;
+
+		report(name, test::secondsPerRun([&] { MultiBufferMD5::hash(messages, backend); }));
+	}
+
+	return 0;
+}
@@ -0,0 +1,113 @@
+#include "TestSupport.h"
+
+#include "md5.h"
+#include "md5_multibuffer.h"
+
+namespace
+{
+	std::string hex(const MultiBufferMD5::Digest& digest)
+	{
+		char buf[33];
+		for (int i = 0; i < 16; i++)
+			snprintf(buf + i * 2, 3, "%02x", digest[i]);
+		return std::string(buf, 32);
+	}
+
+	std::string md5Of(const std::vector<unsigned char>& bytes)
+	{
+		MD5 md5;
+		md5.update(bytes.data(), bytes.size());
+		return md5.finalize().hexdigest();
+	}
+
+	// every backend the cpu can run, the scalar one always
+	std::vector<MultiBufferMD5::Backend> getSupportedBackends()
+	{
+		using Backend = MultiBufferMD5::Backend;
+
+		std::vector<Backend> backends{ Backend::Scalar };
+		const Backend best = MultiBufferMD5::getBestBackend();
+
+		if (best == Backend::SSE2 || best == Backend::AVX2)
+			backends.push_back(Backend::SSE2);
+		if (best == Backend::AVX2)
+			backends.push_back(Backend::AVX2);
+
+		return backends;
+	}
+
+	// message lengths cluster around the 55/56/64 byte padding edges, lanes run
+	// out of blocks at different times and batches aren't multiples of the lane
+	// count
+	void testRandomBatches(MultiBufferMD5::Backend backend, std::mt19937& random)
+	{
+		std::uniform_int_distribution<size_t> batchSize(0, 37);
+		std::uniform_int_distribution<int> kind(0, 9);
+		std::uniform_int_distribution<size_t> shortLength(0, 200);
+		std::uniform_int_distribution<size_t> blocks(0, 8);
+		std::uniform_int_distribution<size_t> edge(52, 66);
+		std::uniform_int_distribution<size_t> longLength(0, 70000);
+
+		for (int round = 0; round != 200; ++round)
+		{
+			std::vector<std::vector<unsigned char>> contents(batchSize(random));
+
+			for (auto& bytes : contents)
+			{
+				const int k = kind(random);
+				const size_t length = k < 6 ? shortLength(random) : k < 9 ? 64 * blocks(random) + edge(random) : longLength(random);
+				bytes = test::randomBytes(random, length);
+			}
+
+			std::vector<MultiBufferMD5::Message> messages;
+			for (const auto& bytes : contents)
+				messages.push_back({ bytes.data(), bytes.size() });
+
+			const std::vector<MultiBufferMD5::Digest> digests = MultiBufferMD5::hash(messages, backend);
+			CHECK_EQUAL(digests.size(), contents.size());
+
+			for (size_t i = 0; i != contents.size() && i != digests.size(); ++i)
+				CHECK_EQUAL(hex(digests[i]), md5Of(contents[i]));
+		}
+	}
+
+	void testMd5Files(std::mt19937& random)
+	{
+		test::TemporaryDirectory directory;
+		std::uniform_int_distribution<size_t> length(0, 20000);
+
+		std::vector<fs::path> paths;
+
+		for (int i = 0; i != 300; ++i)
+		{
+			paths.push_back(directory / ("level " + std::to_string(i) + ".mwl"));
+			test::writeFile(paths.back(), test::randomBytes(random, length(random)));
+		}
+
+		// too large to be batched, and missing, both hashed like md5File does
+		paths.insert(paths.begin() + 10, directory / "rom.smc");
+		test::writeFile(paths[10], test::randomBytes(random, 2 * 1024 * 1024 + 5));
+		paths.insert(paths.begin() + 20, directory / "missing.mwl");
+		paths.push_back(paths[5]);
+
+		const std::vector<std::string> digests = md5Files(paths);
+		CHECK_EQUAL(digests.size(), paths.size());
+
+		for (size_t i = 0; i != paths.size() && i != digests.size(); ++i)
+			CHECK_EQUAL(digests[i], md5File(paths[i]));
+
+		CHECK(md5Files({}).empty());
+	}
+}
+
+int main()
+{
+	std::mt19937 random(5);
+
+	for (MultiBufferMD5::Backend backend : getSupportedBackends())
+		testRandomBatches(backend, random);
+
+	testMd5Files(random);
+
+	return test::finish();
+}
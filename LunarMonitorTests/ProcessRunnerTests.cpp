@@ -0,0 +1,245 @@
+#include "TestSupport.h"
+
+#include <future>
+#include <thread>
+
+#include "ProcessRunner.h"
+
+// runs the POSIX backend against /bin/sh command lines, the scheduling on top of
+// it is the same code the Windows backend runs
+
+// found through ADL by the checks
+std::ostream& operator<<(std::ostream& out, ProcessStatus status)
+{
+	switch (status)
+	{
+	case ProcessStatus::Exited:
+		return out << "Exited";
+	case ProcessStatus::FailedToStart:
+		return out << "FailedToStart";
+	case ProcessStatus::TimedOut:
+		return out << "TimedOut";
+	case ProcessStatus::Terminated:
+		return out << "Terminated";
+	}
+
+	return out;
+}
+
+namespace
+{
+	using namespace std::chrono_literals;
+	using clock = std::chrono::steady_clock;
+
+	// a started process whose result can be waited for
+	struct Started
+	{
+		ProcessRunner::ProcessId id;
+		std::future<ProcessResult> result;
+	};
+
+	Started start(const std::wstring& commandLine, const ProcessOptions& options = {})
+	{
+		auto exited = std::make_shared<std::promise<ProcessResult>>();
+		std::future<ProcessResult> result = exited->get_future();
+
+		const ProcessRunner::ProcessId id = ProcessRunner::start(commandLine, options,
+			[exited](ProcessResult processResult) { exited->set_value(std::move(processResult)); });
+
+		return { id, std::move(result) };
+	}
+
+	double secondsSince(clock::time_point start)
+	{
+		return std::chrono::duration<double>(clock::now() - start).count();
+	}
+
+	// threads of this process, the reactor is the only one the runner adds
+	size_t getThreadCount()
+	{
+		std::ifstream status("/proc/self/status");
+
+		for (std::string line; std::getline(status, line);)
+		{
+			if (line.rfind("Threads:", 0) == 0)
+				return std::stoul(line.substr(8));
+		}
+
+		return 0;
+	}
+
+	void testExitCodes()
+	{
+		for (uint32_t code : { 0u, 1u, 3u, 255u })
+		{
+			const ProcessResult result = ProcessRunner::run(L"exit " + std::to_wstring(code), {});
+			CHECK_EQUAL(result.status, ProcessStatus::Exited);
+			CHECK_EQUAL(result.exitCode, code);
+		}
+
+		// the shell reports a missing executable like it would any other failure
+		const ProcessResult missing = ProcessRunner::run(L"/nonexistent/lunar-magic.exe", {});
+		CHECK_EQUAL(missing.status, ProcessStatus::Exited);
+		CHECK_EQUAL(missing.exitCode, 127u);
+		CHECK(!missing.errorOutput.empty());
+	}
+
+	void testOutputCapture()
+	{
+		const ProcessResult result = ProcessRunner::run(L"printf 'exported'; printf 'failed' >&2; printf ' level'", {});
+		CHECK_EQUAL(result.status, ProcessStatus::Exited);
+		CHECK_EQUAL(result.output, "exported level");
+		CHECK_EQUAL(result.errorOutput, "failed");
+
+		// far more than a pipe holds, so the child only finishes if it's read while it runs
+		const ProcessResult large = ProcessRunner::run(L"head -c 300000 /dev/zero; head -c 200000 /dev/zero >&2", {});
+		CHECK_EQUAL(large.status, ProcessStatus::Exited);
+		CHECK_EQUAL(large.output.size(), 300000u);
+		CHECK_EQUAL(large.errorOutput.size(), 200000u);
+
+		// output past the limit is read and dropped
+		const ProcessResult tooLarge = ProcessRunner::run(L"head -c 3000000 /dev/zero", {});
+		CHECK_EQUAL(tooLarge.status, ProcessStatus::Exited);
+		CHECK_EQUAL(tooLarge.output.size(), 1024u * 1024u);
+
+		const ProcessResult unicode = ProcessRunner::run(L"printf 'é世'", {});
+		CHECK_EQUAL(unicode.output, "\xc3\xa9\xe4\xb8\x96");
+
+		// a background process holding on to the pipes doesn't hold up the result
+		// past the grace period
+		const auto started = clock::now();
+		const ProcessResult background = ProcessRunner::run(L"sleep 3 & printf done", {});
+		CHECK_EQUAL(background.status, ProcessStatus::Exited);
+		CHECK_EQUAL(background.output, "done");
+		CHECK(secondsSince(started) < 2);
+	}
+
+	void testTimeout()
+	{
+		ProcessOptions options;
+		options.timeout = 200ms;
+
+		const auto started = clock::now();
+		const ProcessResult result = ProcessRunner::run(L"printf before; sleep 10", options);
+		const double seconds = secondsSince(started);
+
+		CHECK_EQUAL(result.status, ProcessStatus::TimedOut);
+		CHECK_EQUAL(result.output, "before");
+		CHECK(seconds >= 0.15);
+		CHECK(seconds < 2);
+
+		// whatever the command started is killed along with it, or its pipes
+		// would keep the result waiting
+		const auto groupStarted = clock::now();
+		const ProcessResult group = ProcessRunner::run(L"sleep 10 & sleep 10", options);
+		CHECK_EQUAL(group.status, ProcessStatus::TimedOut);
+		CHECK(secondsSince(groupStarted) < 2);
+
+		const ProcessResult inTime = ProcessRunner::run(L"exit 4", options);
+		CHECK_EQUAL(inTime.status, ProcessStatus::Exited);
+		CHECK_EQUAL(inTime.exitCode, 4u);
+	}
+
+	void testTerminate()
+	{
+		const auto started = clock::now();
+		Started running = start(L"printf before; sleep 10");
+
+		std::this_thread::sleep_for(100ms);
+		ProcessRunner::terminate(running.id);
+
+		const ProcessResult result = running.result.get();
+		CHECK_EQUAL(result.status, ProcessStatus::Terminated);
+		CHECK_EQUAL(result.output, "before");
+		CHECK(secondsSince(started) < 2);
+
+		// already gone, nothing happens
+		ProcessRunner::terminate(running.id);
+
+		Started finished = start(L"exit 2");
+		const ProcessResult finishedResult = finished.result.get();
+		ProcessRunner::terminate(finished.id);
+		CHECK_EQUAL(finishedResult.status, ProcessStatus::Exited);
+		CHECK_EQUAL(finishedResult.exitCode, 2u);
+	}
+
+	// processes past maxInstances wait for a slot, and can be terminated before
+	// they ever started
+	void testMaxInstances()
+	{
+		ProcessOptions options;
+		options.group = "levels";
+		options.maxInstances = 2;
+
+		const auto started = clock::now();
+		std::vector<Started> running;
+
+		for (int i = 0; i != 4; ++i)
+			running.push_back(start(L"sleep 0.3; printf " + std::to_wstring(i), options));
+
+		for (int i = 0; i != 4; ++i)
+		{
+			const ProcessResult result = running[i].result.get();
+			CHECK_EQUAL(result.status, ProcessStatus::Exited);
+			CHECK_EQUAL(result.output, std::to_string(i));
+		}
+
+		// two rounds of two
+		const double seconds = secondsSince(started);
+		CHECK(seconds >= 0.55);
+		CHECK(seconds < 3);
+
+		options.maxInstances = 1;
+
+		Started first = start(L"sleep 10", options);
+		Started heldBack = start(L"printf ran", options);
+		// another group isn't held back by it
+		Started otherGroup = start(L"printf other");
+
+		CHECK_EQUAL(otherGroup.result.get().output, "other");
+
+		ProcessRunner::terminate(heldBack.id);
+		const ProcessResult heldBackResult = heldBack.result.get();
+		CHECK_EQUAL(heldBackResult.status, ProcessStatus::Terminated);
+		CHECK_EQUAL(heldBackResult.output, "");
+
+		ProcessRunner::terminate(first.id);
+		CHECK_EQUAL(first.result.get().status, ProcessStatus::Terminated);
+	}
+
+	// many children at once are waited on by the one reactor thread
+	void testManyChildren()
+	{
+		const size_t threadsBefore = getThreadCount();
+		const auto started = clock::now();
+
+		std::vector<Started> running;
+		for (int i = 0; i != 64; ++i)
+			running.push_back(start(L"sleep 0.5; exit " + std::to_wstring(i)));
+
+		CHECK_EQUAL(ProcessRunner::getLiveCount(), 64u);
+		CHECK_EQUAL(getThreadCount(), threadsBefore);
+
+		for (int i = 0; i != 64; ++i)
+		{
+			const ProcessResult result = running[i].result.get();
+			CHECK_EQUAL(result.status, ProcessStatus::Exited);
+			CHECK_EQUAL(result.exitCode, static_cast<uint32_t>(i));
+		}
+
+		CHECK(secondsSince(started) < 3);
+		CHECK_EQUAL(ProcessRunner::getLiveCount(), 0u);
+	}
+}
+
+int main()
+{
+	testExitCodes();
+	testOutputCapture();
+	testTimeout();
+	testTerminate();
+	testMaxInstances();
+	testManyChildren();
+
+	return test::finish();
+}
@@ -0,0 +1,150 @@
+#include "Logger.h"
+
+#include <cstdarg>
+#include <cstring>
+#include <cwchar>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+
+// stand-in for the monitor's logger, which writes to Lunar Magic's status bar
+// and a log file next to the project, the code under test only logs through
+// it, here everything goes to stderr so failing tests show what was logged
+
+namespace
+{
+	constexpr size_t MAX_MESSAGE_LENGTH = 4096;
+
+	std::mutex outputMutex{};
+	LogLevel level = LogLevel::Log;
+	fs::path logPath{};
+
+	// MSVC reads %s in wide formats as a wide string, everywhere else it's %ls
+	std::wstring portableFormat(const wchar_t* fmt)
+	{
+		std::wstring format;
+
+		for (const wchar_t* c = fmt; *c != L'\0'; ++c)
+		{
+			format += *c;
+
+			if (*c == L'%' && c[1] == L'%')
+				format += *++c;
+			else if (*c == L'%' && c[1] == L's')
+				format += L'l';
+		}
+
+		return format;
+	}
+
+	void write(LogSeverity severity, const wchar_t* fmt, va_list args)
+	{
+		wchar_t message[MAX_MESSAGE_LENGTH];
+
+		if (vswprintf(message, MAX_MESSAGE_LENGTH, portableFormat(fmt).c_str(), args) < 0)
+			message[0] = L'\0';
+
+		// only ever ascii in the tests
+		std::string narrow;
+
+		for (const wchar_t* c = message; *c != L'\0'; ++c)
+			narrow += *c < 0x80 ? static_cast<char>(*c) : '?';
+
+		const char* prefix = severity == LogSeverity::Error ? "error: " : severity == LogSeverity::Warning ? "warning: " : "";
+
+		std::lock_guard<std::mutex> lock(outputMutex);
+		std::cerr << prefix << narrow << std::endl;
+	}
+}
+
+WhatWide::WhatWide(const std::exception& exc) noexcept
+{
+	const char* what = exc.what();
+	const size_t length = std::strlen(what);
+
+	m_what = new (std::nothrow) wchar_t[length + 1];
+
+	if (m_what == nullptr)
+		return;
+
+	for (size_t i = 0; i != length; ++i)
+		m_what[i] = static_cast<unsigned char>(what[i]);
+
+	m_what[length] = L'\0';
+}
+
+const wchar_t* WhatWide::what() noexcept
+{
+	return m_what != nullptr ? m_what : L"";
+}
+
+WhatWide::~WhatWide() noexcept
+{
+	delete[] m_what;
+}
+
+namespace Logger
+{
+	LogLevel getLogLevel() noexcept
+	{
+		return level;
+	}
+
+	void setLogLevel(LogLevel logLevel) noexcept
+	{
+		level = logLevel;
+	}
+
+	void setDefaultLogLevel() noexcept
+	{
+		level = LogLevel::Log;
+	}
+
+	void setLogPath(fs::path path) noexcept
+	{
+		logPath = std::move(path);
+	}
+
+	void setDefaultLogPath(const fs::path& prefix) noexcept
+	{
+		logPath = prefix;
+	}
+
+	const fs::path& getLogPath() noexcept
+	{
+		return logPath;
+	}
+
+	void log(LogSeverity severity, const wchar_t* fmt, ...) noexcept
+	{
+		va_list args;
+		va_start(args, fmt);
+		write(severity, fmt, args);
+		va_end(args);
+	}
+
+	void log_message(const wchar_t* fmt, ...) noexcept
+	{
+		va_list args;
+		va_start(args, fmt);
+		write(LogSeverity::Message, fmt, args);
+		va_end(args);
+	}
+
+	void log_warning(const wchar_t* fmt, ...) noexcept
+	{
+		va_list args;
+		va_start(args, fmt);
+		write(LogSeverity::Warning, fmt, args);
+		va_end(args);
+	}
+
+	void log_error(const wchar_t* fmt, ...) noexcept
+	{
+		va_list args;
+		va_start(args, fmt);
+		write(LogSeverity::Error, fmt, args);
+		va_end(args);
+	}
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// checks, scratch files and timing shared by the tests and benchmarks, every
+// test is an executable of its own that fails if any of its checks did
+
+namespace test
+{
+	inline int failures = 0;
+
+	inline void check(bool passed, const char* expression, const char* file, int line)
+	{
+		if (passed)
+			return;
+
+		++failures;
+		std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+	}
+
+	template <typename A, typename B>
+	void checkEqual(const A& actual, const B& expected, const char* expression, const char* file, int line)
+	{
+		if (actual == expected)
+			return;
+
+		++failures;
+		std::cerr << file << ":" << line << ": check failed: " << expression << std::endl
+			<< "  actual:   " << actual << std::endl
+			<< "  expected: " << expected << std::endl;
+	}
+
+	// exit code for main
+	inline int finish()
+	{
+		if (failures != 0)
+			std::cerr << failures << " check(s) failed" << std::endl;
+
+		return failures == 0 ? 0 : 1;
+	}
+
+	// unique directory below the system's temp directory, removed with everything
+	// in it once out of scope
+	class TemporaryDirectory
+	{
+	public:
+		TemporaryDirectory()
+		{
+			static const unsigned run = std::random_device{}();
+			static int counter = 0;
+
+			path = fs::temp_directory_path() /
+				("lunar-monitor-tests-" + std::to_string(run) + "-" + std::to_string(counter++));
+
+			fs::remove_all(path);
+			fs::create_directories(path);
+		}
+
+		TemporaryDirectory(const TemporaryDirectory&) = delete;
+		TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+		~TemporaryDirectory()
+		{
+			std::error_code error;
+			fs::remove_all(path, error);
+		}
+
+		const fs::path& get() const { return path; }
+		fs::path operator/(const fs::path& relativePath) const { return path / relativePath; }
+
+	private:
+		fs::path path;
+	};
+
+	inline std::vector<unsigned char> randomBytes(std::mt19937& random, size_t length)
+	{
+		std::vector<unsigned char> bytes(length);
+		std::uniform_int_distribution<int> byte(0, 255);
+
+		for (auto& b : bytes)
+			b = static_cast<unsigned char>(byte(random));
+
+		return bytes;
+	}
+
+	inline void writeFile(const fs::path& path, const std::vector<unsigned char>& contents)
+	{
+		fs::create_directories(path.parent_path());
+
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+	}
+
+	inline std::vector<unsigned char> readFile(const fs::path& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		return std::vector<unsigned char>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	}
+
+	// average wall time of f, which is run at least once and then repeatedly
+	// until minimumSeconds passed
+	template <typename F>
+	double secondsPerRun(F&& f, double minimumSeconds = 0.5)
+	{
+		using clock = std::chrono::steady_clock;
+
+		const auto start = clock::now();
+		size_t runs = 0;
+		std::chrono::duration<double> elapsed{};
+
+		do
+		{
+			f();
+			++runs;
+			elapsed = clock::now() - start;
+		} while (elapsed.count() < minimumSeconds);
+
+		return elapsed.count() / static_cast<double>(runs);
+	}
+
+	inline double megabytesPerSecond(uint64_t bytes, double seconds)
+	{
+		return static_cast<double>(bytes) / (1024.0 * 1024.0) / seconds;
+	}
+}
+
+#define CHECK(condition) test::check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(actual, expected) test::checkEqual((actual), (expected), #actual " == " #expected, __FILE__, __LINE__)
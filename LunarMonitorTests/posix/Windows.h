@@ -0,0 +1,234 @@
+#pragma once
+
+// stand-in for the few Win32 file calls the monitor's hashing, patching and build
+// report code makes, so that code can be built and tested on Linux, only ever on
+// the include path of the test target, never of the monitor itself
+//
+// paths are whatever fs::path::c_str() returns, so narrow strings here
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef void* HANDLE;
+typedef uint32_t DWORD;
+typedef int BOOL;
+typedef long LONG;
+
+typedef union
+{
+	struct
+	{
+		DWORD LowPart;
+		LONG HighPart;
+	};
+	long long QuadPart;
+} LARGE_INTEGER;
+
+typedef struct
+{
+	DWORD dwLowDateTime;
+	DWORD dwHighDateTime;
+} FILETIME;
+
+typedef struct
+{
+	DWORD dwFileAttributes;
+	FILETIME ftCreationTime;
+	FILETIME ftLastAccessTime;
+	FILETIME ftLastWriteTime;
+	DWORD dwVolumeSerialNumber;
+	DWORD nFileSizeHigh;
+	DWORD nFileSizeLow;
+	DWORD nNumberOfLinks;
+	DWORD nFileIndexHigh;
+	DWORD nFileIndexLow;
+} BY_HANDLE_FILE_INFORMATION;
+
+#define TRUE 1
+#define FALSE 0
+
+#define INVALID_HANDLE_VALUE (reinterpret_cast<HANDLE>(static_cast<intptr_t>(-1)))
+
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 0x1
+#define FILE_SHARE_WRITE 0x2
+#define FILE_SHARE_DELETE 0x4
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define FILE_ATTRIBUTE_TEMPORARY 0x100
+#define FILE_FLAG_DELETE_ON_CLOSE 0x04000000
+#define FILE_FLAG_BACKUP_SEMANTICS 0x02000000
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+#define PAGE_READONLY 0x2
+#define FILE_MAP_READ 0x4
+#define MOVEFILE_REPLACE_EXISTING 0x1
+#define MOVEFILE_COPY_ALLOWED 0x2
+
+namespace posix_stand_in
+{
+	// file and mapping handles are both descriptors, a mapping keeps its own
+	// duplicate so it outlives the file handle like it does on Windows
+	struct Handle
+	{
+		int fd;
+		// removed by CloseHandle, empty unless opened with FILE_FLAG_DELETE_ON_CLOSE
+		std::string deleteOnClose{};
+	};
+
+	inline int descriptorOf(HANDLE handle)
+	{
+		return static_cast<Handle*>(handle)->fd;
+	}
+
+	// munmap needs the length UnmapViewOfFile isn't given
+	inline std::mutex viewMutex{};
+	inline std::map<const void*, size_t> viewSizes{};
+}
+
+inline HANDLE CreateFileW(const char* path, DWORD, DWORD shareMode, void*, DWORD creationDisposition, DWORD flags, void*)
+{
+	// an unshared file that's created if it's missing is how lock files are
+	// taken, creating it exclusively holds it the same way as long as it's
+	// deleted on close, which lock files are
+	if (shareMode == 0 && creationDisposition == OPEN_ALWAYS)
+	{
+		const int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+
+		if (fd < 0)
+			return INVALID_HANDLE_VALUE;
+
+		return new posix_stand_in::Handle{ fd, (flags & FILE_FLAG_DELETE_ON_CLOSE) != 0 ? path : "" };
+	}
+
+	const int fd = open(path, O_RDONLY | O_CLOEXEC);
+	return fd < 0 ? INVALID_HANDLE_VALUE : new posix_stand_in::Handle{ fd };
+}
+
+inline BOOL CloseHandle(HANDLE handle)
+{
+	auto* h = static_cast<posix_stand_in::Handle*>(handle);
+
+	// before it's closed, so whoever takes the lock next creates a new file
+	if (!h->deleteOnClose.empty())
+		unlink(h->deleteOnClose.c_str());
+
+	const bool closed = close(h->fd) == 0;
+	delete h;
+	return closed;
+}
+
+inline BOOL ReadFile(HANDLE file, void* buffer, DWORD length, DWORD* read, void*)
+{
+	const ssize_t result = ::read(posix_stand_in::descriptorOf(file), buffer, length);
+
+	if (result < 0)
+		return FALSE;
+
+	*read = static_cast<DWORD>(result);
+	return TRUE;
+}
+
+inline BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size)
+{
+	struct stat info;
+
+	if (fstat(posix_stand_in::descriptorOf(file), &info) != 0)
+		return FALSE;
+
+	size->QuadPart = info.st_size;
+	return TRUE;
+}
+
+inline BOOL GetFileInformationByHandle(HANDLE file, BY_HANDLE_FILE_INFORMATION* information)
+{
+	struct stat info;
+
+	if (fstat(posix_stand_in::descriptorOf(file), &info) != 0)
+		return FALSE;
+
+	memset(information, 0, sizeof(*information));
+
+	// 100ns ticks like a FILETIME, the epoch doesn't matter for fingerprints
+	const uint64_t writeTime = static_cast<uint64_t>(info.st_mtim.tv_sec) * 10000000 + info.st_mtim.tv_nsec / 100;
+	information->ftLastWriteTime.dwLowDateTime = static_cast<DWORD>(writeTime);
+	information->ftLastWriteTime.dwHighDateTime = static_cast<DWORD>(writeTime >> 32);
+
+	const uint64_t size = static_cast<uint64_t>(info.st_size);
+	information->nFileSizeLow = static_cast<DWORD>(size);
+	information->nFileSizeHigh = static_cast<DWORD>(size >> 32);
+
+	const uint64_t inode = static_cast<uint64_t>(info.st_ino);
+	information->nFileIndexLow = static_cast<DWORD>(inode);
+	information->nFileIndexHigh = static_cast<DWORD>(inode >> 32);
+	information->dwVolumeSerialNumber = static_cast<DWORD>(info.st_dev);
+	information->nNumberOfLinks = static_cast<DWORD>(info.st_nlink);
+
+	return TRUE;
+}
+
+inline HANDLE CreateFileMappingW(HANDLE file, void*, DWORD, DWORD, DWORD, const void*)
+{
+	const int fd = dup(posix_stand_in::descriptorOf(file));
+	return fd < 0 ? NULL : new posix_stand_in::Handle{ fd };
+}
+
+inline void* MapViewOfFile(HANDLE mapping, DWORD, DWORD offsetHigh, DWORD offsetLow, size_t length)
+{
+	const int fd = posix_stand_in::descriptorOf(mapping);
+	const off_t offset = static_cast<off_t>((static_cast<uint64_t>(offsetHigh) << 32) | offsetLow);
+
+	// 0 maps everything from offset to the end of the file
+	if (length == 0)
+	{
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size <= offset)
+			return NULL;
+		length = static_cast<size_t>(info.st_size - offset);
+	}
+
+	void* view = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, offset);
+
+	if (view == MAP_FAILED)
+		return NULL;
+
+	std::lock_guard lock{ posix_stand_in::viewMutex };
+	posix_stand_in::viewSizes[view] = length;
+	return view;
+}
+
+inline BOOL UnmapViewOfFile(const void* view)
+{
+	size_t length;
+
+	{
+		std::lock_guard lock{ posix_stand_in::viewMutex };
+		auto it = posix_stand_in::viewSizes.find(view);
+
+		if (it == posix_stand_in::viewSizes.end())
+			return FALSE;
+
+		length = it->second;
+		posix_stand_in::viewSizes.erase(it);
+	}
+
+	return munmap(const_cast<void*>(view), length) == 0;
+}
+
+// rename already replaces an existing destination, MOVEFILE_COPY_ALLOWED only
+// matters across volumes, which the tests never move between
+inline BOOL MoveFileExW(const char* existingPath, const char* newPath, DWORD)
+{
+	return rename(existingPath, newPath) == 0;
+}